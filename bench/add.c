@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <math.h>
 
 #include "smartarr/defines.h"
 #include "smartarr/bench.h"
@@ -11,6 +12,19 @@
 #define _ARRAY_TYPE_NAME int64
 #include "smartarr/array.inc.h"
 
+#define _ARRAY_TYPE float
+#define _ARRAY_TYPE_NAME f32
+#include "smartarr/array.inc.h"
+
+#define _ARRAY_TYPE int32_t
+#define _ARRAY_TYPE_NAME i32
+#include "smartarr/array.inc.h"
+
+#include "smartarr/fused.h"
+
+// d = a*b + c - e
+ARRAY_FUSED_KERNEL(int64, mul_add_sub, (a, b, c, e), a * b + c - e)
+
 #define _ARRAY_TYPE int64_t
 #define _ARRAY_TYPE_NAME xint64
 #undef _SMART_ARRAY_ALIGN
@@ -215,7 +229,165 @@ double bench5(unsigned int len, unsigned int times)
     return tf;
 }
 
-#include <math.h>
+// Chain of kernels with a temporary vs one fused loop, arrays do not fit in cache.
+double bench_fused(unsigned int len, unsigned int times)
+{
+    auto_free int64_smart_array_t* a = int64_smart_array_heap_new(len);
+    auto_free int64_smart_array_t* b = int64_smart_array_heap_new(len);
+    auto_free int64_smart_array_t* c = int64_smart_array_heap_new(len);
+    auto_free int64_smart_array_t* e = int64_smart_array_heap_new(len);
+    auto_free int64_smart_array_t* d = int64_smart_array_heap_new(len);
+    int64_smart_array_random_sequence(a);
+    int64_smart_array_random_sequence(b);
+    int64_smart_array_random_sequence(c);
+    int64_smart_array_random_sequence(e);
+
+    printf("a*b+c-e chain   : "); fflush(0);
+
+    auto start_time = bench_start_timer();
+    for (unsigned int n = 0; n < times; ++n)
+    {
+        auto_free int64_smart_array_t* tmp = int64_smart_array_heap_new(len);
+        int64_smart_array_mul(a, b, tmp);
+        int64_smart_array_add_destruct(tmp, c);
+        int64_smart_array_sub(tmp, e, d);
+    }
+    double t1 = bench_stop_timer(&start_time);
+
+    printf("%10.8f    %f MOPS\n", t1, (len * times) / (1000000.0 * t1));
+    printf("a*b+c-e fused   : "); fflush(0);
+
+    start_time = bench_start_timer();
+    for (unsigned int n = 0; n < times; ++n)
+    {
+        int64_smart_array_mul_add_sub(a, b, c, e, d);
+    }
+    double t2 = bench_stop_timer(&start_time);
+
+    printf("%10.8f    %f MOPS\n", t2, (len * times) / (1000000.0 * t2));
+    printf("fused speedup: %f\n", t1/t2);
+
+    return t2;
+}
+
+typedef float (*f32_reduce_fn)(size_t len, const float a[len]);
+
+static
+double bench_reduce_f32(const char* name, f32_reduce_fn reduce,
+    const f32_smart_array_t* a, double exact, unsigned int times)
+{
+    printf("%-16s: ", name); fflush(0);
+
+    float sum = 0;
+    auto start_time = bench_start_timer();
+    for (unsigned int n = 0; n < times; ++n)
+    {
+        sum = reduce(a->len, a->data);
+        __asm__ volatile("" : : "g"(&sum) : "memory");
+    }
+    double tf = bench_stop_timer(&start_time);
+
+    printf("%10.8f    %8.1f MOPS    rel. error %.2e\n",
+        tf, (a->len * times) / (1000000.0 * tf), fabs(sum - exact) / exact);
+
+    return tf;
+}
+
+// Summation speed and accuracy of float array that fits in L2 cache.
+void bench_reduce(unsigned int len, unsigned int times)
+{
+    auto_free f32_smart_array_t* a = f32_smart_array_heap_new(len);
+    double exact = 0;
+    for (unsigned int i = 0; i < len; ++i) {
+        a->data[i] = (float)rand() / RAND_MAX;
+        exact += a->data[i];
+    }
+
+    printf("\nreduce_add %u floats, %u times\n", len, times);
+    double t1 = bench_reduce_f32("serial", f32_array_reduce_add_serial, a, exact, times);
+    double t2 = bench_reduce_f32("simd", f32_array_reduce_add_simd, a, exact, times);
+    double t3 = bench_reduce_f32("pairwise", f32_array_reduce_add_pairwise, a, exact, times);
+    double t4 = bench_reduce_f32("kahan", f32_array_reduce_add_kahan, a, exact, times);
+    printf("speedup vs serial: simd %.2f, pairwise %.2f, kahan %.2f\n", t1/t2, t1/t3, t1/t4);
+
+    printf("%-16s: ", "wide (double)"); fflush(0);
+    double wide = 0;
+    auto start_time = bench_start_timer();
+    for (unsigned int n = 0; n < times; ++n)
+    {
+        wide = f32_smart_array_reduce_add_wide(a);
+        __asm__ volatile("" : : "g"(&wide) : "memory");
+    }
+    double tf = bench_stop_timer(&start_time);
+    printf("%10.8f    %8.1f MOPS    rel. error %.2e\n",
+        tf, (len * times) / (1000000.0 * tf), fabs(wide - exact) / exact);
+
+    auto_free i32_smart_array_t* b = i32_smart_array_heap_new(len);
+    i32_smart_array_fill(b, INT32_MAX);
+
+    printf("%-16s: ", "i32 wide"); fflush(0);
+    int64_t isum = 0;
+    start_time = bench_start_timer();
+    for (unsigned int n = 0; n < times; ++n)
+    {
+        isum = i32_smart_array_reduce_add_wide(b);
+        __asm__ volatile("" : : "g"(&isum) : "memory");
+    }
+    tf = bench_stop_timer(&start_time);
+    printf("%10.8f    %8.1f MOPS    %s\n", tf, (len * times) / (1000000.0 * tf),
+        (isum == (int64_t)len * INT32_MAX)? "exact" : "WRONG");
+}
+
+
+__attribute__((noinline))
+int64_t scalar_scan(size_t len, const int64_t a[len], int64_t b[len])
+{
+    int64_t sum = 0;
+    for (size_t i = 0; i < len; ++i) {
+        sum += a[i];
+        b[i] = sum;
+    }
+    return sum;
+}
+
+// Inclusive scan: scalar loop vs in-register SIMD scan vs OMP two-pass scan.
+void bench_scan(unsigned int len, unsigned int times)
+{
+    auto_free int64_smart_array_t* a = int64_smart_array_heap_new(len);
+    auto_free int64_smart_array_t* b = int64_smart_array_heap_new(len);
+    int64_smart_array_random_sequence(a);
+    int64_smart_array_fill(b, 0);
+
+    printf("\nscan %u int64, %u times\n", len, times);
+
+    int64_t sum = 0, simd_sum = 0, omp_sum = 0;
+    printf("%-16s: ", "scalar loop"); fflush(0);
+    auto start_time = bench_start_timer();
+    for (unsigned int n = 0; n < times; ++n) {
+        sum += scalar_scan(len, a->data, b->data);
+    }
+    double t1 = bench_stop_timer(&start_time);
+    printf("%10.8f    %8.1f MOPS\n", t1, (len * times) / (1000000.0 * t1));
+
+    printf("%-16s: ", "scan"); fflush(0);
+    start_time = bench_start_timer();
+    for (unsigned int n = 0; n < times; ++n) {
+        simd_sum += int64_array_scan(len, a->data, b->data);
+    }
+    double t2 = bench_stop_timer(&start_time);
+    printf("%10.8f    %8.1f MOPS\n", t2, (len * times) / (1000000.0 * t2));
+
+    printf("%-16s: ", "OMP scan"); fflush(0);
+    double wall_time = omp_get_wtime();
+    for (unsigned int n = 0; n < times; ++n) {
+        omp_sum += int64_omp_array_scan(len, a->data, b->data);
+    }
+    double t3 = omp_get_wtime() - wall_time;
+    printf("%10.8f    %8.1f MOPS wall time, %d threads\n",
+        t3, (len * times) / (1000000.0 * t3), omp_get_max_threads());
+
+    printf("scan speedup: SIMD %.2f, OMP %.2f %s\n", t1/t2, t1/t3, (sum == simd_sum && sum == omp_sum)? "" : "WRONG");
+}
 
 int main(void)
 {
@@ -243,6 +415,14 @@ int main(void)
     t2 = bench3(len, times);
     t3 = bench4(len, times);
 
+    len = 1024*1024*8;
+    bench_fused(len, times);
+
+    bench_reduce(1024*64, 1000*4);
+
+    bench_scan(1024*32, 1000*5);
+    bench_scan(1024*1024*16, 10);
+
     return 0;
 }
 
@@ -1,4 +1,7 @@
 #include <stdio.h>
+#include <stdlib.h>
+
+#include <omp.h>
 
 #include "smartarr/defines.h"
 #include "smartarr/bench.h"
@@ -6,25 +9,58 @@
 #define _ARRAY_OMP_ENABLE
 #include "smartarr/basic_type_array.h"
 
+static
 float
-bench_find_in_array(f64_smart_array_t* a,
+bench_find_in_array(const char* name,
+    optional_uint_t (*finder)(size_t, const double*, double),
+    f64_smart_array_t* a,
     unsigned int times)
 {
-    printf("%32s: ", "Find in array");
+    printf("%32s: ", name);
 
     // warm up
-    auto pos = f64_smart_array_find(a, (double)(a->len - 1));
+    auto pos = finder(a->len, a->data, (double)(a->len - 1));
     assert(pos.present && pos.value == (a->len - 1));
 
     auto start_time = bench_start_timer();
     for (unsigned int n = 0; n < times; ++n)
     {
-        auto pos = f64_smart_array_find(a, (double)(a->len - 1));
+        auto pos = finder(a->len, a->data, (double)(a->len - 1));
         assert(pos.present && pos.value == (a->len - 1));
     }
     double time = bench_stop_timer(&start_time);
 
-    printf("%10.8f\n", time);
+    double gbps = ((double)a->len * sizeof(a->data[0]) * times) / (1.0e9 * time);
+
+    printf("%10.8f    %6.2f GB/s\n", time, gbps);
+
+    return time;
+}
+
+static
+float
+bench_find_in_i64_array(const char* name,
+    optional_uint_t (*finder)(size_t, const int64_t*, int64_t),
+    i64_smart_array_t* a,
+    unsigned int times)
+{
+    printf("%32s: ", name);
+
+    // warm up
+    auto pos = finder(a->len, a->data, a->len - 1);
+    assert(pos.present && pos.value == (a->len - 1));
+
+    auto start_time = bench_start_timer();
+    for (unsigned int n = 0; n < times; ++n)
+    {
+        auto pos = finder(a->len, a->data, a->len - 1);
+        assert(pos.present && pos.value == (a->len - 1));
+    }
+    double time = bench_stop_timer(&start_time);
+
+    double gbps = ((double)a->len * sizeof(a->data[0]) * times) / (1.0e9 * time);
+
+    printf("%10.8f    %6.2f GB/s\n", time, gbps);
 
     return time;
 }
@@ -33,13 +69,21 @@ static
 void benches_find_val(unsigned int len, unsigned int times)
 {
     auto_free f64_smart_array_t* a = f64_smart_array_heap_new(len);
+    auto_free i64_smart_array_t* b = i64_smart_array_heap_new(len);
 
     for (unsigned int n = 0; n < len; ++n)
     {
         a->data[n] = n;
+        b->data[n] = n;
     }
 
-    bench_find_in_array(a, times);
+    float t1 = bench_find_in_array("Find in f64 array, scalar", f64_array_find_scalar, a, times);
+    float t2 = bench_find_in_array("Find in f64 array, SIMD", f64_array_find, a, times);
+    printf("%32s: %6.2fx\n", "SIMD speedup", t1/t2);
+
+    t1 = bench_find_in_i64_array("Find in i64 array, scalar", i64_array_find_scalar, b, times);
+    t2 = bench_find_in_i64_array("Find in i64 array, SIMD", i64_array_find, b, times);
+    printf("%32s: %6.2fx\n", "SIMD speedup", t1/t2);
 }
 
 float
@@ -88,6 +132,45 @@ bench_omp_find_max_in_array(f64_smart_array_t* a,
     return time;
 }
 
+float
+bench_find_minmax_in_array(f64_smart_array_t* a,
+    unsigned int times)
+{
+    printf("%32s: ", "Find MIN and MAX in one pass");
+
+    auto start_time = bench_start_timer();
+    for (unsigned int n = 0; n < times; ++n)
+    {
+        auto mm = f64_smart_array_find_minmax(a);
+        assert(mm.min.pos == 0 && mm.max.pos == (a->len - 1));
+    }
+    double time = bench_stop_timer(&start_time);
+
+    printf("%10.8f\n", time);
+
+    return time;
+}
+
+float
+bench_find_min_and_max_in_array(f64_smart_array_t* a,
+    unsigned int times)
+{
+    printf("%32s: ", "Find MIN, then find MAX");
+
+    auto start_time = bench_start_timer();
+    for (unsigned int n = 0; n < times; ++n)
+    {
+        auto min_pos = f64_smart_array_find_min(a);
+        auto max_pos = f64_smart_array_find_max(a);
+        assert(min_pos == 0 && max_pos == (a->len - 1));
+    }
+    double time = bench_stop_timer(&start_time);
+
+    printf("%10.8f\n", time);
+
+    return time;
+}
+
 static
 void benches_find_max(unsigned int len, unsigned int times)
 {
@@ -100,19 +183,184 @@ void benches_find_max(unsigned int len, unsigned int times)
 
     bench_find_max_in_array(a, times);
     bench_omp_find_max_in_array(a, times);
+    bench_find_minmax_in_array(a, times);
+    bench_find_min_and_max_in_array(a, times);
+}
+
+// Set of needles that are not in the array: one find per needle vs find_any.
+static
+void benches_find_any(unsigned int len, unsigned int nr_needles, unsigned int times)
+{
+    auto_free f64_smart_array_t* a = f64_smart_array_heap_new(len);
+    auto_free f64_smart_array_t* needles = f64_smart_array_heap_new(nr_needles);
+
+    for (unsigned int n = 0; n < len; ++n)
+    {
+        a->data[n] = n;
+    }
+    for (unsigned int n = 0; n < nr_needles; ++n)
+    {
+        needles->data[n] = -1.0 - n;
+    }
+
+    printf("%24s %3u needles: ", "Find per needle", nr_needles);
+    auto start_time = bench_start_timer();
+    for (unsigned int n = 0; n < times; ++n)
+    {
+        for (unsigned int k = 0; k < nr_needles; ++k)
+        {
+            auto pos = f64_smart_array_find(a, needles->data[k]);
+            assert(!pos.present);
+        }
+    }
+    double t1 = bench_stop_timer(&start_time);
+    printf("%10.8f\n", t1);
+
+    printf("%24s %3u needles: ", "Find any", nr_needles);
+    start_time = bench_start_timer();
+    for (unsigned int n = 0; n < times; ++n)
+    {
+        auto pos = f64_smart_array_find_any(a, needles);
+        assert(!pos.present);
+    }
+    double t2 = bench_stop_timer(&start_time);
+    printf("%10.8f    %6.2fx\n", t2, t1/t2);
+}
+
+// Wall time of the serial and parallel find with hit at 3/4 of the array.
+static
+void benches_omp_find(unsigned int len, unsigned int times)
+{
+    auto_free f64_smart_array_t* a = f64_smart_array_heap_new(len);
+
+    for (unsigned int n = 0; n < len; ++n)
+    {
+        a->data[n] = n;
+    }
+
+    const double val = (double)(len / 4 * 3);
+
+    printf("%32s: ", "Find in f64 array, serial");
+    double start_time = omp_get_wtime();
+    for (unsigned int n = 0; n < times; ++n)
+    {
+        auto pos = f64_smart_array_find(a, val);
+        assert(pos.present && pos.value == len / 4 * 3);
+    }
+    double t1 = omp_get_wtime() - start_time;
+    printf("%10.8f    %6.2f GB/s\n", t1, (0.75 * len * sizeof(double) * times) / (1.0e9 * t1));
+
+    const int max_threads = omp_get_max_threads();
+    for (int nr_threads = 1; nr_threads <= max_threads; nr_threads *= 2)
+    {
+        omp_set_num_threads(nr_threads);
+        printf("%24s %3d thr: ", "OMP find", nr_threads);
+        start_time = omp_get_wtime();
+        for (unsigned int n = 0; n < times; ++n)
+        {
+            auto pos = f64_omp_smart_array_find(a, val);
+            assert(pos.present && pos.value == len / 4 * 3);
+        }
+        double t2 = omp_get_wtime() - start_time;
+        printf("%10.8f    %6.2f GB/s  %6.2fx\n",
+            t2, (0.75 * len * sizeof(double) * times) / (1.0e9 * t2), t1/t2);
+    }
+    omp_set_num_threads(max_threads);
+}
+
+// Branchy scalar filter, baseline for the stream compaction.
+static
+size_t scalar_filter_lt(size_t len, const double a[len], double val, double dst[len])
+{
+    size_t n = 0;
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (a[i] < val)
+        {
+            dst[n++] = a[i];
+        }
+    }
+    return n;
+}
+
+// Filter random values with 50% selectivity, the worst case for branches.
+static
+void benches_filter(unsigned int len, unsigned int times)
+{
+    auto_free f64_smart_array_t* a = f64_smart_array_heap_new(len);
+    auto_free f64_smart_array_t* dst = f64_smart_array_heap_new(len);
+
+    srand(7);
+    for (unsigned int n = 0; n < len; ++n)
+    {
+        a->data[n] = (double)rand() / RAND_MAX;
+    }
+
+    const double val = 0.5;
+    const size_t expected = scalar_filter_lt(a->len, a->data, val, dst->data);
+
+    printf("%32s: ", "Filter f64 < 0.5, scalar");
+    double start_time = omp_get_wtime();
+    for (unsigned int n = 0; n < times; ++n)
+    {
+        size_t nr = scalar_filter_lt(a->len, a->data, val, dst->data);
+        assert(nr == expected);
+    }
+    double t1 = omp_get_wtime() - start_time;
+    printf("%10.8f\n", t1);
+
+    printf("%32s: ", "Filter f64 < 0.5, SIMD");
+    start_time = omp_get_wtime();
+    for (unsigned int n = 0; n < times; ++n)
+    {
+        size_t nr = f64_smart_array_filter_lt(a, val, dst);
+        assert(nr == expected);
+    }
+    double t2 = omp_get_wtime() - start_time;
+    printf("%10.8f    %6.2fx\n", t2, t1/t2);
+
+    const int max_threads = omp_get_max_threads();
+    for (int nr_threads = 1; nr_threads <= max_threads; nr_threads *= 2)
+    {
+        omp_set_num_threads(nr_threads);
+        printf("%24s %3d thr: ", "OMP filter", nr_threads);
+        start_time = omp_get_wtime();
+        for (unsigned int n = 0; n < times; ++n)
+        {
+            size_t nr = f64_omp_smart_array_filter_lt(a, val, dst);
+            assert(nr == expected);
+        }
+        double t3 = omp_get_wtime() - start_time;
+        printf("%10.8f    %6.2fx\n", t3, t1/t3);
+    }
+    omp_set_num_threads(max_threads);
 }
 
 int main(void)
 {
-    unsigned int len = 1024*1024*2 + 3;
-    unsigned int times = 1000;
+    unsigned int len = 1024*16 + 3; // stay in L2 cache
+    unsigned int times = 1000*100;
+
+    benches_find_val(len, times);
+
+    len = 1024*1024*2 + 3;
+    times = 1000;
 
     benches_find_val(len, times);
 
+    benches_find_any(len, 4, times / 10);
+    benches_find_any(len, 16, times / 10);
+    benches_find_any(len, 64, times / 10);
+
     len = 1024*1024*32 + 3;
     times = 10;
     benches_find_max(len, times);
 
+    benches_omp_find(len, times);
+
+    benches_filter(1024*16 + 3, 1000*10);
+    benches_filter(len, times);
+
     return 0;
 }
 
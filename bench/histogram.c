@@ -0,0 +1,122 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "smartarr/defines.h"
+
+#include <omp.h>
+
+#define _ARRAY_OMP_ENABLE
+#include "smartarr/histogram.h"
+
+// Plain counting loop, every increment of a hot bin waits for the previous one.
+static
+void naive_bincount(size_t len, const uint32_t a[len], size_t nbins, uint64_t counts[nbins])
+{
+    for (size_t i = 0; i < len; ++i) {
+        if (a[i] < nbins) {
+            counts[a[i]] += 1;
+        }
+    }
+}
+
+static
+void benches_bincount(const char* name, u32_smart_array_t* codes, size_t nbins,
+    unsigned int times)
+{
+    printf("%s, %lu bins:\n", name, nbins);
+
+    auto_free uint64_t* counts = calloc(nbins, sizeof(uint64_t));
+
+    printf("%24s: ", "Naive bincount"); fflush(0);
+    double start_time = omp_get_wtime();
+    for (unsigned int n = 0; n < times; ++n) {
+        naive_bincount(codes->len, codes->data, nbins, counts);
+    }
+    double t1 = omp_get_wtime() - start_time;
+    printf("%10.8f    %6.2f ns/elem\n", t1, 1.0e9 * t1 / ((double)codes->len * times));
+
+    uint64_t total = 0;
+    printf("%24s: ", "Bincount"); fflush(0);
+    start_time = omp_get_wtime();
+    for (unsigned int n = 0; n < times; ++n) {
+        auto_free u64_smart_array_t* c = u32_smart_array_bincount(codes, nbins);
+        total += c->data[0];
+    }
+    double t2 = omp_get_wtime() - start_time;
+    printf("%10.8f    %6.2f ns/elem  %6.2fx\n",
+        t2, 1.0e9 * t2 / ((double)codes->len * times), t1/t2);
+    assert(total == counts[0]);
+
+    printf("%24s: ", "OMP bincount"); fflush(0);
+    start_time = omp_get_wtime();
+    for (unsigned int n = 0; n < times; ++n) {
+        auto_free u64_smart_array_t* c = u32_omp_smart_array_bincount(codes, nbins);
+        total += c->data[0];
+    }
+    t2 = omp_get_wtime() - start_time;
+    printf("%10.8f    %6.2f ns/elem  %6.2fx wall time, %d threads\n",
+        t2, 1.0e9 * t2 / ((double)codes->len * times), t1/t2, omp_get_max_threads());
+}
+
+static
+void benches_uniform(size_t len, size_t nbins, unsigned int times)
+{
+    printf("Uniform f64, %lu bins:\n", nbins);
+
+    auto_free f64_smart_array_t* a = f64_smart_array_heap_new(len);
+    for (size_t i = 0; i < len; ++i) {
+        a->data[i] = (double)rand() / RAND_MAX;
+    }
+
+    auto_free uint64_t* counts = calloc(nbins, sizeof(uint64_t));
+
+    printf("%24s: ", "Naive histogram"); fflush(0);
+    double start_time = omp_get_wtime();
+    for (unsigned int n = 0; n < times; ++n) {
+        for (size_t i = 0; i < len; ++i) {
+            const double x = a->data[i];
+            if (x >= 0.0 && x <= 1.0) {
+                size_t bin = x * nbins;
+                counts[(bin < nbins)? bin : nbins - 1] += 1;
+            }
+        }
+    }
+    double t1 = omp_get_wtime() - start_time;
+    printf("%10.8f    %6.2f ns/elem\n", t1, 1.0e9 * t1 / ((double)len * times));
+
+    printf("%24s: ", "Histogram uniform"); fflush(0);
+    start_time = omp_get_wtime();
+    for (unsigned int n = 0; n < times; ++n) {
+        auto_free u64_smart_array_t* c = f64_smart_array_histogram_uniform(a, 0.0, 1.0, nbins);
+        assert(c->data[0] * times == counts[0]);
+    }
+    double t2 = omp_get_wtime() - start_time;
+    printf("%10.8f    %6.2f ns/elem  %6.2fx\n", t2, 1.0e9 * t2 / ((double)len * times), t1/t2);
+}
+
+int main(void)
+{
+    constexpr size_t len = 1024*1024*16;
+    constexpr unsigned int times = 10;
+
+    auto_free u32_smart_array_t* codes = u32_smart_array_heap_new(len);
+
+    u32_smart_array_fill(codes, 7);
+    benches_bincount("Same code", codes, 256, times);
+
+    for (size_t i = 0; i < len; ++i) {
+        codes->data[i] = (rand() % 8 == 0)? rand() % 256 : 7;
+    }
+    benches_bincount("Skewed codes", codes, 256, times);
+
+    for (size_t i = 0; i < len; ++i) {
+        codes->data[i] = rand() % 256;
+    }
+    benches_bincount("Random codes", codes, 256, times);
+
+    benches_uniform(len, 100, times);
+
+    return 0;
+}
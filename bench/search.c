@@ -0,0 +1,224 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "smartarr/defines.h"
+#include "smartarr/bench.h"
+
+#include <omp.h>
+
+#define _ARRAY_OMP_ENABLE
+#include "smartarr/basic_type_array.h"
+
+static
+double bench_binary_search(i64_smart_array_t* a, i64_smart_array_t* queries)
+{
+    printf("%24s: ", "Binary search"); fflush(0);
+
+    size_t sum = 0;
+
+    auto start_time = bench_start_timer();
+    for (size_t i = 0; i < queries->len; ++i)
+    {
+        sum += i64_smart_array_lower_bound(a, queries->data[i]);
+    }
+    double time = bench_stop_timer(&start_time);
+
+    printf("%10.8f    %6.1f ns/query  (%lu)\n", time, 1.0e9 * time / queries->len, sum);
+
+    return time;
+}
+
+static
+double bench_btree_search(i64_smart_array_t* a, i64_smart_array_t* queries)
+{
+    printf("%24s: ", "Static B-tree search"); fflush(0);
+
+    auto_free i64_btree_t* index = i64_btree_new(a);
+
+    size_t sum = 0;
+
+    auto start_time = bench_start_timer();
+    for (size_t i = 0; i < queries->len; ++i)
+    {
+        sum += i64_btree_lower_bound(index, queries->data[i]);
+    }
+    double time = bench_stop_timer(&start_time);
+
+    printf("%10.8f    %6.1f ns/query  (%lu)\n", time, 1.0e9 * time / queries->len, sum);
+
+    return time;
+}
+
+static
+double bench_batch_search(i64_smart_array_t* a, i64_smart_array_t* queries)
+{
+    printf("%24s: ", "Batched binary search"); fflush(0);
+
+    auto_free size_t* pos = malloc(queries->len * sizeof(size_t));
+
+    auto start_time = bench_start_timer();
+    i64_smart_array_lower_bound_batch(a, queries, pos);
+    double time = bench_stop_timer(&start_time);
+
+    size_t sum = 0;
+    for (size_t i = 0; i < queries->len; ++i) {
+        sum += pos[i];
+    }
+
+    printf("%10.8f    %6.1f ns/query  (%lu)\n", time, 1.0e9 * time / queries->len, sum);
+
+    return time;
+}
+
+static
+double bench_omp_batch_search(i64_smart_array_t* a, i64_smart_array_t* queries)
+{
+    printf("%24s: ", "OMP batched search"); fflush(0);
+
+    auto_free size_t* pos = malloc(queries->len * sizeof(size_t));
+
+    double start_time = omp_get_wtime();
+    i64_omp_smart_array_lower_bound_batch(a, queries, pos);
+    double time = omp_get_wtime() - start_time;
+
+    size_t sum = 0;
+    for (size_t i = 0; i < queries->len; ++i) {
+        sum += pos[i];
+    }
+
+    printf("%10.8f    %6.1f ns/query  (%lu) wall time, %d threads\n",
+        time, 1.0e9 * time / queries->len, sum, omp_get_max_threads());
+
+    return time;
+}
+
+static
+void benches(const char* name, size_t len, size_t nr_queries)
+{
+    printf("%s: %lu elements, %lu KB\n", name, len, len * sizeof(int64_t) / 1024);
+
+    auto_free i64_smart_array_t* a = i64_smart_array_heap_new(len);
+    auto_free i64_smart_array_t* queries = i64_smart_array_heap_new(nr_queries);
+
+    for (size_t i = 0; i < len; ++i) {
+        a->data[i] = 2 * i;
+    }
+
+    for (size_t i = 0; i < nr_queries; ++i) {
+        queries->data[i] = ((size_t)rand() * RAND_MAX + rand()) % (2 * len);
+    }
+
+    double t1 = bench_binary_search(a, queries);
+    double t2 = bench_btree_search(a, queries);
+
+    printf("%24s: %6.2fx\n", "B-tree speedup", t1/t2);
+
+    t2 = bench_batch_search(a, queries);
+
+    printf("%24s: %6.2fx\n", "Batch speedup", t1/t2);
+
+    bench_omp_batch_search(a, queries);
+}
+
+// Plain loops the gather and scatter kernels replace.
+static
+void naive_gather(size_t len, const uint32_t idx[len], const double src[], double dst[len])
+{
+    for (size_t i = 0; i < len; ++i) {
+        dst[i] = src[idx[i]];
+    }
+}
+
+static
+void naive_scatter_add(size_t len, const uint32_t idx[len], const double src[len], double dst[])
+{
+    for (size_t i = 0; i < len; ++i) {
+        dst[idx[i]] += src[i];
+    }
+}
+
+static
+void benches_gather(const char* name, size_t src_len, size_t len, unsigned int times)
+{
+    printf("%s gather: %lu elements, %lu KB\n", name, src_len, src_len * sizeof(double) / 1024);
+
+    auto_free f64_smart_array_t* src = f64_smart_array_heap_new(src_len);
+    auto_free f32_smart_array_t* src32 = f32_smart_array_heap_new(src_len);
+    auto_free f64_smart_array_t* dst = f64_smart_array_heap_new(len);
+    auto_free f32_smart_array_t* dst32 = f32_smart_array_heap_new(len);
+    auto_free uint32_t* idx = malloc(len * sizeof(uint32_t));
+
+    for (size_t i = 0; i < src_len; ++i) {
+        src->data[i] = i;
+        src32->data[i] = i;
+    }
+    for (size_t i = 0; i < len; ++i) {
+        idx[i] = ((size_t)rand() * RAND_MAX + rand()) % src_len;
+    }
+
+    printf("%24s: ", "Naive gather f64"); fflush(0);
+    double start_time = omp_get_wtime();
+    for (unsigned int n = 0; n < times; ++n) {
+        naive_gather(len, idx, src->data, dst->data);
+    }
+    double t1 = omp_get_wtime() - start_time;
+    printf("%10.8f    %6.2f ns/elem\n", t1, 1.0e9 * t1 / ((double)len * times));
+
+    printf("%24s: ", "Gather f64"); fflush(0);
+    start_time = omp_get_wtime();
+    for (unsigned int n = 0; n < times; ++n) {
+        f64_smart_array_gather_u32(idx, src, dst);
+    }
+    double t2 = omp_get_wtime() - start_time;
+    printf("%10.8f    %6.2f ns/elem  %6.2fx\n", t2, 1.0e9 * t2 / ((double)len * times), t1/t2);
+
+    printf("%24s: ", "Gather f32"); fflush(0);
+    start_time = omp_get_wtime();
+    for (unsigned int n = 0; n < times; ++n) {
+        f32_smart_array_gather_u32(idx, src32, dst32);
+    }
+    t2 = omp_get_wtime() - start_time;
+    printf("%10.8f    %6.2f ns/elem  %6.2fx\n", t2, 1.0e9 * t2 / ((double)len * times), t1/t2);
+
+    printf("%24s: ", "OMP gather f64"); fflush(0);
+    start_time = omp_get_wtime();
+    for (unsigned int n = 0; n < times; ++n) {
+        f64_omp_smart_array_gather_u32(idx, src, dst);
+    }
+    t2 = omp_get_wtime() - start_time;
+    printf("%10.8f    %6.2f ns/elem  %6.2fx wall time, %d threads\n",
+        t2, 1.0e9 * t2 / ((double)len * times), t1/t2, omp_get_max_threads());
+
+    printf("%24s: ", "Naive scatter add f64"); fflush(0);
+    start_time = omp_get_wtime();
+    for (unsigned int n = 0; n < times; ++n) {
+        naive_scatter_add(len, idx, dst->data, src->data);
+    }
+    t1 = omp_get_wtime() - start_time;
+    printf("%10.8f    %6.2f ns/elem\n", t1, 1.0e9 * t1 / ((double)len * times));
+
+    printf("%24s: ", "Scatter add f64"); fflush(0);
+    start_time = omp_get_wtime();
+    for (unsigned int n = 0; n < times; ++n) {
+        f64_array_scatter_add_u32(len, idx, dst->data, src->data);
+    }
+    t2 = omp_get_wtime() - start_time;
+    printf("%10.8f    %6.2f ns/elem  %6.2fx\n", t2, 1.0e9 * t2 / ((double)len * times), t1/t2);
+}
+
+int main(void)
+{
+    constexpr size_t nr_queries = 1024*1024*4;
+
+    benches("L1",   1024*2, nr_queries);
+    benches("L2",   1024*64, nr_queries);
+    benches("L3",   1024*1024, nr_queries);
+    benches("DRAM", 1024*1024*32, nr_queries);
+
+    benches_gather("L2",   1024*16, nr_queries, 10);
+    benches_gather("DRAM", 1024*1024*32, nr_queries, 4);
+
+    return 0;
+}
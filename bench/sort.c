@@ -6,6 +6,9 @@
 #include "smartarr/defines.h"
 #include "smartarr/bench.h"
 
+#include <omp.h>
+
+#define _ARRAY_OMP_ENABLE
 #include "smartarr/basic_type_array.h"
 
 
@@ -61,6 +64,43 @@ void bench_lib_qsort(unsigned int len, unsigned int times,
     bench("Library Q sort", library_qsort, len, times, a, pattern);
 }
 
+static
+void bench_introsort(unsigned int len, unsigned int times,
+    i64_smart_array_t* a, i64_smart_array_t* pattern)
+{
+    bench("Introsort", i64_smart_array_sort, len, times, a, pattern);
+}
+
+static i64_smart_array_t* radix_scratch;
+
+static
+int64_t*
+radix_sort(i64_smart_array_t* a)
+{
+    return i64_smart_array_radix_sort(a, radix_scratch);
+}
+
+static
+void bench_radix_sort(unsigned int len, unsigned int times,
+    i64_smart_array_t* a, i64_smart_array_t* pattern)
+{
+    bench("Radix sort", radix_sort, len, times, a, pattern);
+}
+
+static
+int64_t*
+stable_sort(i64_smart_array_t* a)
+{
+    return i64_smart_array_stable_sort(a, radix_scratch);
+}
+
+static
+void bench_stable_sort(unsigned int len, unsigned int times,
+    i64_smart_array_t* a, i64_smart_array_t* pattern)
+{
+    bench("Stable sort", stable_sort, len, times, a, pattern);
+}
+
 static
 void
 pattern_sorted(i64_smart_array_t* a)
@@ -94,29 +134,272 @@ pattern_random(i64_smart_array_t* a)
     }
 }
 
+// Sorted data with 1% of out-of-order elements appended.
+static
+void
+pattern_sorted_tail(i64_smart_array_t* a)
+{
+    for (unsigned int i = 0; i < a->len; ++i) {
+         a->data[i] = (i < a->len - a->len / 100)? i : rand() % a->len;
+    }
+}
+
+static
+void
+pattern_few_unique(i64_smart_array_t* a)
+{
+    for (unsigned int i = 0; i < a->len; ++i) {
+         a->data[i] = rand() % 16;
+    }
+}
+
 static
 void benches(unsigned int len, unsigned int times)
 {
     auto_free i64_smart_array_t* a = i64_smart_array_heap_new(len);
     auto_free i64_smart_array_t* pattern = i64_smart_array_heap_new(len);
+    auto_free i64_smart_array_t* scratch = i64_smart_array_heap_new(len);
+    radix_scratch = scratch;
 
     printf("Sorted pattern\n");
     pattern_sorted(pattern);
     bench_insertion_sort(len, times, a, pattern);
     bench_bubble_sort(len, times, a, pattern);
     bench_lib_qsort(len, times, a, pattern);
+    bench_introsort(len, times, a, pattern);
+    bench_radix_sort(len, times, a, pattern);
+    bench_stable_sort(len, times, a, pattern);
 
     printf("Reverse Sorted pattern\n");
     pattern_reverse_sorted(pattern);
     bench_insertion_sort(len, times, a, pattern);
     bench_bubble_sort(len, times, a, pattern);
     bench_lib_qsort(len, times, a, pattern);
+    bench_introsort(len, times, a, pattern);
+    bench_radix_sort(len, times, a, pattern);
+    bench_stable_sort(len, times, a, pattern);
 
     printf("Random pattern\n");
     pattern_random(pattern);
     bench_insertion_sort(len, times, a, pattern);
     bench_bubble_sort(len, times, a, pattern);
     bench_lib_qsort(len, times, a, pattern);
+    bench_introsort(len, times, a, pattern);
+    bench_radix_sort(len, times, a, pattern);
+    bench_stable_sort(len, times, a, pattern);
+
+    printf("Few unique pattern\n");
+    pattern_few_unique(pattern);
+    bench_insertion_sort(len, times, a, pattern);
+    bench_lib_qsort(len, times, a, pattern);
+    bench_introsort(len, times, a, pattern);
+    bench_radix_sort(len, times, a, pattern);
+    bench_stable_sort(len, times, a, pattern);
+}
+
+// Only sorts that are fast enough for large arrays.
+static
+void benches_large(unsigned int len, unsigned int times)
+{
+    auto_free i64_smart_array_t* a = i64_smart_array_heap_new(len);
+    auto_free i64_smart_array_t* pattern = i64_smart_array_heap_new(len);
+    auto_free i64_smart_array_t* scratch = i64_smart_array_heap_new(len);
+    radix_scratch = scratch;
+
+    printf("Large array %u elements\n", len);
+
+    printf("Sorted pattern\n");
+    pattern_sorted(pattern);
+    bench_lib_qsort(len, times, a, pattern);
+    bench_introsort(len, times, a, pattern);
+    bench_radix_sort(len, times, a, pattern);
+    bench_stable_sort(len, times, a, pattern);
+
+    printf("Reverse Sorted pattern\n");
+    pattern_reverse_sorted(pattern);
+    bench_lib_qsort(len, times, a, pattern);
+    bench_introsort(len, times, a, pattern);
+    bench_radix_sort(len, times, a, pattern);
+    bench_stable_sort(len, times, a, pattern);
+
+    printf("Random pattern\n");
+    pattern_random(pattern);
+    bench_lib_qsort(len, times, a, pattern);
+    bench_introsort(len, times, a, pattern);
+    bench_radix_sort(len, times, a, pattern);
+    bench_stable_sort(len, times, a, pattern);
+
+    printf("Sorted with unsorted tail pattern\n");
+    pattern_sorted_tail(pattern);
+    bench_lib_qsort(len, times, a, pattern);
+    bench_introsort(len, times, a, pattern);
+    bench_radix_sort(len, times, a, pattern);
+    bench_stable_sort(len, times, a, pattern);
+
+    printf("Few unique pattern\n");
+    pattern_few_unique(pattern);
+    bench_lib_qsort(len, times, a, pattern);
+    bench_introsort(len, times, a, pattern);
+    bench_radix_sort(len, times, a, pattern);
+    bench_stable_sort(len, times, a, pattern);
+}
+
+// Many independent tiny arrays, as leaves of a recursive sort see them.
+static
+double bench_small(const char* name,
+    void (*sorter)(size_t, int64_t[]),
+    unsigned int group_len, i64_smart_array_t* a, i64_smart_array_t* pattern)
+{
+    printf("%16s %2u: ", name, group_len); fflush(0);
+
+    i64_array_memcopy(a->len, pattern->data, a->data);
+
+    auto start_time = bench_start_timer();
+    for (size_t i = 0; i + group_len <= a->len; i += group_len) {
+        sorter(group_len, &a->data[i]);
+    }
+    double time = bench_stop_timer(&start_time);
+
+    printf("%10.8f\n", time);
+
+    for (size_t i = 0; i + group_len <= a->len; i += group_len) {
+        for (size_t j = 1; j < group_len; ++j) {
+            assert(a->data[i + j - 1] <= a->data[i + j]);
+        }
+    }
+
+    return time;
+}
+
+static
+void insertion_sort_part(size_t len, int64_t a[])
+{
+    i64_array_insertion_sort_part(len, a);
+}
+
+static
+void small_sort(size_t len, int64_t a[])
+{
+    i64_array_small_sort(len, a);
+}
+
+static
+void benches_small(unsigned int len)
+{
+    auto_free i64_smart_array_t* a = i64_smart_array_heap_new(len);
+    auto_free i64_smart_array_t* pattern = i64_smart_array_heap_new(len);
+
+    printf("Small arrays, %u elements total\n", len);
+    pattern_random(pattern);
+
+    const unsigned int group_lens[] = {8, 16, 24, 32, 64};
+    for (size_t i = 0; i < fixlen_array_len(group_lens); ++i) {
+        double t1 = bench_small("Insertion sort", insertion_sort_part, group_lens[i], a, pattern);
+        double t2 = bench_small("Small sort", small_sort, group_lens[i], a, pattern);
+        printf("%19s: %6.2fx\n", "speedup", t1/t2);
+    }
+}
+
+// Percentiles and top-100 of a column, compared with sorting it.
+static
+void benches_select(size_t len)
+{
+    constexpr size_t k = 100;
+    auto_free i64_smart_array_t* a = i64_smart_array_heap_new(len);
+    auto_free i64_smart_array_t* pattern = i64_smart_array_heap_new(len);
+    int64_t top[k];
+
+    printf("Selection, random i64 array %lu elements\n", len);
+    for (size_t i = 0; i < len; ++i) {
+        pattern->data[i] = ((int64_t)rand() << 31) ^ rand();
+    }
+
+    printf("%24s: ", "Introsort"); fflush(0);
+    i64_array_memcopy(len, pattern->data, a->data);
+    double start_time = omp_get_wtime();
+    i64_smart_array_sort(a);
+    double t1 = omp_get_wtime() - start_time;
+    printf("%10.6f\n", t1);
+    const int64_t p50 = a->data[len / 2], p99 = a->data[len * 99 / 100];
+    const int64_t top1 = a->data[len - 1];
+
+    printf("%24s: ", "nth_element p50"); fflush(0);
+    i64_array_memcopy(len, pattern->data, a->data);
+    start_time = omp_get_wtime();
+    int64_t x = i64_smart_array_nth_element(a, len / 2);
+    double t2 = omp_get_wtime() - start_time;
+    printf("%10.6f  %6.2fx\n", t2, t1/t2);
+    assert(x == p50);
+
+    printf("%24s: ", "nth_element p99"); fflush(0);
+    i64_array_memcopy(len, pattern->data, a->data);
+    start_time = omp_get_wtime();
+    x = i64_smart_array_nth_element(a, len * 99 / 100);
+    t2 = omp_get_wtime() - start_time;
+    printf("%10.6f  %6.2fx\n", t2, t1/t2);
+    assert(x == p99);
+
+    printf("%24s: ", "partial_sort 100"); fflush(0);
+    i64_array_memcopy(len, pattern->data, a->data);
+    start_time = omp_get_wtime();
+    i64_smart_array_partial_sort(a, k);
+    t2 = omp_get_wtime() - start_time;
+    printf("%10.6f  %6.2fx\n", t2, t1/t2);
+
+    printf("%24s: ", "topk 100"); fflush(0);
+    start_time = omp_get_wtime();
+    i64_smart_array_topk(pattern, k, top);
+    t2 = omp_get_wtime() - start_time;
+    printf("%10.6f  %6.2fx\n", t2, t1/t2);
+    assert(top[0] == top1);
+
+    printf("%24s: ", "OMP topk 100"); fflush(0);
+    start_time = omp_get_wtime();
+    i64_omp_smart_array_topk(pattern, k, top);
+    t2 = omp_get_wtime() - start_time;
+    printf("%10.6f  %6.2fx  %d threads\n", t2, t1/t2, omp_get_max_threads());
+    assert(top[0] == top1);
+}
+
+static
+void benches_omp_sort(size_t len)
+{
+    auto_free i64_smart_array_t* a = i64_smart_array_heap_new(len);
+    auto_free i64_smart_array_t* pattern = i64_smart_array_heap_new(len);
+    auto_free i64_smart_array_t* scratch = i64_smart_array_heap_new(len);
+
+    printf("Parallel sort, random i64 array %lu elements\n", len);
+    for (size_t i = 0; i < len; ++i) {
+        pattern->data[i] = ((int64_t)rand() << 31) ^ rand();
+    }
+
+    printf("%24s: ", "Introsort"); fflush(0);
+    i64_array_memcopy(len, pattern->data, a->data);
+    double start_time = omp_get_wtime();
+    i64_smart_array_sort(a);
+    double t1 = omp_get_wtime() - start_time;
+    printf("%10.6f\n", t1);
+
+    const int max_threads = omp_get_max_threads();
+    for (int nr_threads = 1; ; nr_threads *= 2)
+    {
+        nr_threads = (nr_threads < max_threads)? nr_threads : max_threads;
+        omp_set_num_threads(nr_threads);
+        printf("%16s %3d thr: ", "OMP sort", nr_threads); fflush(0);
+        i64_array_memcopy(len, pattern->data, a->data);
+        start_time = omp_get_wtime();
+        i64_omp_smart_array_sort(a, scratch);
+        double t2 = omp_get_wtime() - start_time;
+        printf("%10.6f  %6.2fx\n", t2, t1/t2);
+
+        for (size_t i = 1; i < len; ++i) {
+            assert(a->data[i-1] <= a->data[i]);
+        }
+        if (nr_threads == max_threads) {
+            break;
+        }
+    }
+    omp_set_num_threads(max_threads);
 }
 
 int main(void)
@@ -126,6 +409,14 @@ int main(void)
 
     benches(len, times);
 
+    benches_small(1024*1024*4);
+
+    benches_large(1024*1024*4, times);
+
+    benches_select(50*1000*1000);
+
+    benches_omp_sort(100*1000*1000);
+
     return 0;
 }
 
@@ -0,0 +1,91 @@
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "smartarr/defines.h"
+
+#include <omp.h>
+
+#define _ARRAY_OMP_ENABLE
+#include "smartarr/vmath.h"
+
+// libm call per element against vector kernel and its OMP version.
+#define BENCH_VMATH(T, name, libm_fn) \
+static \
+void bench_##T##_##name(const T##_smart_array_t* a, T##_smart_array_t* b, unsigned int times) \
+{ \
+    const size_t len = a->len; \
+    printf("%24s: ", "libm " #libm_fn); fflush(0); \
+    double start_time = omp_get_wtime(); \
+    for (unsigned int n = 0; n < times; ++n) { \
+        for (size_t i = 0; i < len; ++i) { \
+            b->data[i] = libm_fn(a->data[i]); \
+        } \
+    } \
+    double t1 = omp_get_wtime() - start_time; \
+    printf("%10.8f    %6.2f ns/elem\n", t1, 1.0e9 * t1 / ((double)len * times)); \
+\
+    printf("%24s: ", #T " " #name); fflush(0); \
+    start_time = omp_get_wtime(); \
+    for (unsigned int n = 0; n < times; ++n) { \
+        T##_smart_array_##name(a, b); \
+    } \
+    double t2 = omp_get_wtime() - start_time; \
+    printf("%10.8f    %6.2f ns/elem  %6.2fx\n", \
+        t2, 1.0e9 * t2 / ((double)len * times), t1/t2); \
+\
+    printf("%24s: ", "OMP " #T " " #name); fflush(0); \
+    start_time = omp_get_wtime(); \
+    for (unsigned int n = 0; n < times; ++n) { \
+        T##_omp_smart_array_##name(a, b); \
+    } \
+    t2 = omp_get_wtime() - start_time; \
+    printf("%10.8f    %6.2f ns/elem  %6.2fx wall time, %d threads\n", \
+        t2, 1.0e9 * t2 / ((double)len * times), t1/t2, omp_get_max_threads()); \
+}
+
+static inline float libm_sigmoidf(float x)
+{
+    return 1.0f / (1.0f + expf(-x));
+}
+
+BENCH_VMATH(f32, exp, expf)
+BENCH_VMATH(f32, log, logf)
+BENCH_VMATH(f32, tanh, tanhf)
+BENCH_VMATH(f32, sigmoid, libm_sigmoidf)
+BENCH_VMATH(f32, sin, sinf)
+BENCH_VMATH(f64, exp, exp)
+BENCH_VMATH(f64, log, log)
+BENCH_VMATH(f64, tanh, tanh)
+BENCH_VMATH(f64, sin, sin)
+
+int main(void)
+{
+    constexpr size_t len = 1024*1024*4;
+    constexpr unsigned int times = 10;
+
+    auto_free f32_smart_array_t* a32 = f32_smart_array_heap_new(len);
+    auto_free f32_smart_array_t* b32 = f32_smart_array_heap_new(len);
+    auto_free f64_smart_array_t* a64 = f64_smart_array_heap_new(len);
+    auto_free f64_smart_array_t* b64 = f64_smart_array_heap_new(len);
+
+    // arguments in [-10, 10], positive for log
+    for (size_t i = 0; i < len; ++i) {
+        a32->data[i] = a64->data[i] = 20.0 * rand() / RAND_MAX - 10.0;
+    }
+
+    bench_f32_exp(a32, b32, times);
+    bench_f32_sigmoid(a32, b32, times);
+    bench_f32_tanh(a32, b32, times);
+    bench_f32_sin(a32, b32, times);
+    bench_f64_exp(a64, b64, times);
+    bench_f64_tanh(a64, b64, times);
+    bench_f64_sin(a64, b64, times);
+
+    f32_smart_array_abs_destruct(a32);
+    f64_smart_array_abs_destruct(a64);
+    bench_f32_log(a32, b32, times);
+    bench_f64_log(a64, b64, times);
+
+    return 0;
+}
@@ -10,6 +10,7 @@
 
 #include "smartarr/defines.h"
 #include "smartarr/cpu.h"
+#include "smartarr/simd.h"
 
 
 #define PPCAT_NX(a, b) a ## b
@@ -23,6 +24,25 @@
 #define _ARRAY_WO(ref_index, size_index) __attribute__ ((access (write_only, ref_index, size_index)))
 #define _ARRAY_RW(ref_index, size_index) __attribute__ ((access (read_write, ref_index, size_index)))
 
+// Explicit SIMD kernels rely on built-in `==` and `<` of vector types,
+// custom comparators or `_ARRAY_NO_SIMD` fall back to scalar loops.
+#if !defined(_ARRAY_TYPE_EQ) && !defined(_ARRAY_TYPE_LT) && !defined(_ARRAY_NO_SIMD) && \
+    !defined(_ARRAY_TYPE_COMPOUND)
+#define _ARRAY_SIMD
+#endif
+
+// Arithmetic element type ordered by built-in `<`, sorts may go by `sortable_key`.
+#if !defined(_ARRAY_TYPE_LT) && !defined(_ARRAY_TYPE_COMPOUND)
+#define _ARRAY_NATIVE_ORDER
+#endif
+
+// Element type without arithmetic operators, for example a struct,
+// must define `_ARRAY_TYPE_COMPOUND`, `_ARRAY_TYPE_EQ` and `_ARRAY_TYPE_LT`.
+// Only functions built on the comparators are generated for such type.
+#if defined(_ARRAY_TYPE_COMPOUND) && (!defined(_ARRAY_TYPE_EQ) || !defined(_ARRAY_TYPE_LT))
+#error "_ARRAY_TYPE_COMPOUND requires _ARRAY_TYPE_EQ and _ARRAY_TYPE_LT"
+#endif
+
 #ifndef _ARRAY_TYPE_EQ
 #define _ARRAY_TYPE_EQ(a, b) ({(a) == (b);})
 #endif
@@ -40,6 +60,28 @@
 
 #define ATTR_SMART_ARRAY_ALIGNED __attribute__((aligned(_SMART_ARRAY_ALIGN)))
 
+#define _ARRAY_VEC_T     PPCAT(_ARRAY_TYPE_NAME, _array_vec_t)
+#define _ARRAY_VEC_LANES (SMARTARR_SIMD_VLEN / sizeof(_ARRAY_TYPE))
+#define _ARRAY_BITS_T     PPCAT(_ARRAY_TYPE_NAME, _array_bits_t)
+#define _ARRAY_BITS_VEC_T PPCAT(_ARRAY_TYPE_NAME, _array_bits_vec_t)
+#define _ARRAY_VAL_POS_T  PPCAT(_ARRAY_TYPE_NAME, _val_pos_t)
+#define _ARRAY_MINMAX_T   PPCAT(_ARRAY_TYPE_NAME, _minmax_t)
+#define _ARRAY_NEEDLES_T  PPCAT(_ARRAY_TYPE_NAME, _needles_t)
+#define _ARRAY_TOPK_T     PPCAT(_ARRAY_TYPE_NAME, _topk_t)
+#define _ARRAY_WIDE_T     PPCAT(_ARRAY_TYPE_NAME, _wide_t)
+
+// Type traits of arithmetic element types, with or without SIMD kernels.
+#ifndef _ARRAY_TYPE_COMPOUND
+#define _ARRAY_TYPE_IS_FLOAT _Generic((_ARRAY_TYPE)0, \
+    float: true, double: true, long double: true, default: false)
+#define _ARRAY_TYPE_IS_SIGNED ((_ARRAY_TYPE)-1 < (_ARRAY_TYPE)1)
+#define _ARRAY_IS_NAN(x) _ARRAY_FN(is_nan)(x)
+#else
+#define _ARRAY_TYPE_IS_FLOAT false
+#define _ARRAY_TYPE_IS_SIGNED true
+#define _ARRAY_IS_NAN(x) false
+#endif
+
 #ifdef _ARRAY_DEBUG
 #define ARRAY_ASSERT_ALIGNED(ptr) assert(((size_t)ptr & (_SMART_ARRAY_ALIGN - 1)) == 0);
 #else
@@ -68,6 +110,170 @@ typedef struct _SMART_ARRAY {
     _ARRAY_TYPE data[] __attribute__((aligned(_SMART_ARRAY_ALIGN)));
 } _SMART_ARRAY_T;
 
+#ifndef _ARRAY_TYPE_COMPOUND
+/** Return true if value is NaN, always false for integer types.
+ *
+ */
+static inline
+FN_ATTR_CONST
+bool
+_ARRAY_FN(is_nan)(_ARRAY_TYPE x)
+{
+    _ARRAY_TYPE y = x; // x != x is a tautology warning for integers
+    return x != y;
+}
+
+/** Unsigned integer with the same size as array element, used for bit tricks.
+ *
+ */
+typedef typeof(_Generic((char (*)[sizeof(_ARRAY_TYPE)])0,
+    char (*)[1]: (uint8_t)0,
+    char (*)[2]: (uint16_t)0,
+    char (*)[4]: (uint32_t)0,
+    default: (uint64_t)0)) _ARRAY_BITS_T;
+
+/** Map element to unsigned integer with the same order.
+ *
+ * `a < b` implies `key(a) < key(b)`. Float sign-magnitude bits are turned
+ * into an offset binary number, -0.0 and +0.0 have the same key,
+ * keys of adjacent floats differ by one. NaNs with clear sign bit
+ * go after +inf, NaNs with set sign bit go before -inf.
+ * Signed integers get the sign bit flipped, unsigned ones are unchanged.
+ */
+static inline
+FN_ATTR_CONST
+_ARRAY_BITS_T
+_ARRAY_FN(sortable_key)(_ARRAY_TYPE x)
+{
+    constexpr _ARRAY_BITS_T sign = (_ARRAY_BITS_T)1 << (8 * sizeof(_ARRAY_TYPE) - 1);
+    _ARRAY_BITS_T bits;
+    __builtin_memcpy(&bits, &x, sizeof(bits));
+    if (_ARRAY_TYPE_IS_FLOAT) {
+        const _ARRAY_BITS_T m = bits & ~sign;
+        return (bits & sign)? sign - m : sign + m;
+    }
+    return _ARRAY_TYPE_IS_SIGNED? bits ^ sign : bits;
+}
+#endif // _ARRAY_TYPE_COMPOUND
+
+#ifdef _ARRAY_SIMD
+/** SIMD vector of array elements.
+ *
+ * Alignment is reduced to the element alignment, so a vector can be loaded
+ * from any element of an array, arrays with `_SMART_ARRAY_ALIGN` smaller
+ * than the vector width are fine.
+ */
+typedef _ARRAY_TYPE _ARRAY_VEC_T
+    __attribute__((vector_size(SMARTARR_SIMD_VLEN), aligned(sizeof(_ARRAY_TYPE))));
+
+/** Vector of unsigned integers with the same number of lanes as `_ARRAY_VEC_T`,
+ * result of vector comparison can be casted to it.
+ */
+typedef _ARRAY_BITS_T _ARRAY_BITS_VEC_T __attribute__((vector_size(SMARTARR_SIMD_VLEN)));
+
+/** Lanes that are NaN, always zero for integer types.
+ *
+ */
+static inline
+FN_ATTR_CONST
+_ARRAY_BITS_VEC_T
+_ARRAY_FN(vec_is_nan)(_ARRAY_VEC_T v)
+{
+    _ARRAY_VEC_T w = v;
+    return (_ARRAY_BITS_VEC_T)(v != w);
+}
+
+/** Vector of lane indices {0, 1, 2, ...}.
+ *
+ */
+static inline
+FN_ATTR_CONST
+_ARRAY_BITS_VEC_T
+_ARRAY_FN(vec_iota)(void)
+{
+    _ARRAY_BITS_VEC_T iota;
+    for (size_t i = 0; i < _ARRAY_VEC_LANES; ++i) {
+        iota[i] = i;
+    }
+    return iota;
+}
+
+/** Per lane `mask? a : b`, mask lanes must be all ones or all zeros.
+ *
+ */
+static inline
+FN_ATTR_CONST
+_ARRAY_VEC_T
+_ARRAY_FN(vec_select)(_ARRAY_BITS_VEC_T mask, _ARRAY_VEC_T a, _ARRAY_VEC_T b)
+{
+    return (_ARRAY_VEC_T)(((_ARRAY_BITS_VEC_T)a & mask) | ((_ARRAY_BITS_VEC_T)b & ~mask));
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_PURE
+_ARRAY_VEC_T
+_ARRAY_FN(vec_load)(const _ARRAY_TYPE* a)
+{
+    return *(const _ARRAY_VEC_T*)a;
+}
+
+/** Load vector from address that may be not aligned.
+ *
+ */
+static inline
+__attribute__((nonnull(1))) FN_ATTR_PURE
+_ARRAY_VEC_T
+_ARRAY_FN(vec_load_unaligned)(const _ARRAY_TYPE* a)
+{
+    _ARRAY_VEC_T v;
+    __builtin_memcpy(&v, a, sizeof(v));
+    return v;
+}
+
+/** Load `len` < `_ARRAY_VEC_LANES` elements, other lanes are zero.
+ *
+ */
+static inline
+__attribute__((nonnull(1))) FN_ATTR_PURE
+_ARRAY_VEC_T
+_ARRAY_FN(vec_load_partial)(const _ARRAY_TYPE* a, size_t len)
+{
+    _ARRAY_VEC_T v = {};
+    __builtin_memcpy(&v, a, len * sizeof(_ARRAY_TYPE));
+    return v;
+}
+
+/** Mask of lanes where vector elements are equal to the value.
+ *
+ * Each lane contributes `sizeof(_ARRAY_TYPE)` bits to the mask.
+ */
+static inline
+FN_ATTR_CONST
+uint64_t
+_ARRAY_FN(vec_eq_mask)(_ARRAY_VEC_T v, _ARRAY_VEC_T val)
+{
+    return simd_movemask_i8((simd_i8_t)(v == val));
+}
+
+/** Vector version of `sortable_key`.
+ *
+ */
+static inline
+FN_ATTR_CONST
+_ARRAY_BITS_VEC_T
+_ARRAY_FN(vec_sortable_key)(_ARRAY_VEC_T v)
+{
+    constexpr _ARRAY_BITS_T sign = (_ARRAY_BITS_T)1 << (8 * sizeof(_ARRAY_TYPE) - 1);
+    const _ARRAY_BITS_VEC_T bits = (_ARRAY_BITS_VEC_T)v;
+    if (_ARRAY_TYPE_IS_FLOAT) {
+        const _ARRAY_BITS_VEC_T m = bits & ~sign;
+        const _ARRAY_BITS_VEC_T neg = -(bits >> (8 * sizeof(_ARRAY_TYPE) - 1));
+        return ((sign - m) & neg) | ((sign + m) & ~neg);
+    }
+    return _ARRAY_TYPE_IS_SIGNED? bits ^ sign : bits;
+}
+#endif // _ARRAY_SIMD
+
 static inline
 FN_ATTR_CONST
 size_t
@@ -102,7 +308,7 @@ _SARRAY_FN(align_len)(size_t len)
     ptr->num_cols = 1; \
     ptr;})
 
-/** Allocate smart_array on heap.
+/** Allocate smart_array on heap, return NULL if allocation fails.
  *
  * Example:
  * ```
@@ -117,6 +323,9 @@ _SARRAY_FN(heap_new)(size_t len)
     size_t aligned_len = _SARRAY_FN(align_len)(len);
     _SMART_ARRAY_T* ptr = (_SMART_ARRAY_T*)
         aligned_alloc(_SMART_ARRAY_ALIGN, sizeof(_SMART_ARRAY_T) + aligned_len*sizeof(_ARRAY_TYPE));
+    if (ptr == NULL) {
+        return NULL;
+    }
     ptr->len = len;
     ptr->num_cols = 1;
     ARRAY_ASSERT_ALIGNED(ptr->data);
@@ -202,10 +411,14 @@ _MATRIX_FN(set_at)(_SMART_ARRAY_T* a, size_t row, size_t col, _ARRAY_TYPE val)
     a->data[matrix_index(row , col, a->num_cols)] = val;
 }
 
+/** Find first element equal to the value, scalar version.
+ *
+ * Uses `_ARRAY_TYPE_EQ` and works for any element type.
+ */
 static inline
 _ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
 optional_uint_t
-_ARRAY_FN(find)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val_to_find)
+_ARRAY_FN(find_scalar)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val_to_find)
 {
     ARRAY_ASSERT_ALIGNED(a);
     a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
@@ -241,6 +454,75 @@ _ARRAY_FN(find)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val_to_find)
     return pos;
 }
 
+/** Find first element equal to the value.
+ *
+ * SIMD version compares a full vector of elements at a time,
+ * checks four vectors per iteration and exits on the first hit.
+ * The tail is handled by one more load that overlaps with already
+ * checked elements, their lanes are masked out.
+ *
+ * Example:
+ * ```
+ * auto pos = f64_array_find(a->len, a->data, 7.0);
+ * if (pos.present) {printf("a[%u] == 7\n", pos.value);}
+ * ```
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+optional_uint_t
+_ARRAY_FN(find)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val_to_find)
+{
+#ifdef _ARRAY_SIMD
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    constexpr size_t lanes = _ARRAY_VEC_LANES;
+    constexpr size_t step_size = 4 * lanes;
+    const _ARRAY_VEC_T val = (_ARRAY_VEC_T){} + val_to_find;
+
+    size_t i = 0;
+
+    for (; i + step_size <= len; i += step_size) {
+        _ARRAY_VEC_T v0 = _ARRAY_FN(vec_load)(&a[i]);
+        _ARRAY_VEC_T v1 = _ARRAY_FN(vec_load)(&a[i + lanes]);
+        _ARRAY_VEC_T v2 = _ARRAY_FN(vec_load)(&a[i + 2*lanes]);
+        _ARRAY_VEC_T v3 = _ARRAY_FN(vec_load)(&a[i + 3*lanes]);
+        simd_i8_t eq = (simd_i8_t)((v0 == val) | (v1 == val) | (v2 == val) | (v3 == val));
+        if (__builtin_expect(simd_movemask_i8(eq) != 0, 0)) {
+            break; // hit is somewhere in these 4 vectors
+        }
+    }
+
+    for (; i + lanes <= len; i += lanes) {
+        uint64_t mask = _ARRAY_FN(vec_eq_mask)(_ARRAY_FN(vec_load)(&a[i]), val);
+        if (mask) {
+            return (optional_uint_t){.present = true, .value = i + ctz(mask) / sizeof(_ARRAY_TYPE)};
+        }
+    }
+
+    if (i < len) {
+        size_t rest = len - i;
+        uint64_t mask;
+        if (len >= lanes) {
+            // last full vector, drop lanes that were already checked
+            i = len - lanes;
+            mask = _ARRAY_FN(vec_eq_mask)(_ARRAY_FN(vec_load)(&a[i]), val);
+            mask &= ~simd_low_bytes_mask((lanes - rest) * sizeof(_ARRAY_TYPE));
+        } else {
+            mask = _ARRAY_FN(vec_eq_mask)(_ARRAY_FN(vec_load_partial)(&a[i], rest), val);
+            mask &= simd_low_bytes_mask(rest * sizeof(_ARRAY_TYPE));
+        }
+        if (mask) {
+            return (optional_uint_t){.present = true, .value = i + ctz(mask) / sizeof(_ARRAY_TYPE)};
+        }
+    }
+
+    return (optional_uint_t){.present = false};
+#else
+    return _ARRAY_FN(find_scalar)(len, a, val_to_find);
+#endif
+}
+
 static inline
 __attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
 optional_uint_t
@@ -259,352 +541,4348 @@ _ARRAY_FN(contains)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val_to_fin
     return pos.present;
 }
 
+/** Count elements equal to the value.
+ *
+ */
 static inline
 _ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
 size_t
-_ARRAY_FN(find_max)(size_t len, const _ARRAY_TYPE a[len])
+_ARRAY_FN(count)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val)
 {
     ARRAY_ASSERT_ALIGNED(a);
     a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
 
-    size_t pos = 0;
-    _ARRAY_TYPE max_val = a[0];
+    size_t count = 0;
+    size_t i = 0;
 
-    for (size_t i = 0; i < len; ++i) {
-        const bool max_val_lt_a = max_val < a[i]; 
-        max_val = max_val_lt_a ? a[i] : max_val;
-        pos     = max_val_lt_a ? i : pos;
+#ifdef _ARRAY_SIMD
+    constexpr size_t lanes = _ARRAY_VEC_LANES;
+    const _ARRAY_VEC_T v = (_ARRAY_VEC_T){} + val;
+
+    for (; i + 2*lanes <= len; i += 2*lanes) {
+        uint64_t m0 = _ARRAY_FN(vec_eq_mask)(_ARRAY_FN(vec_load)(&a[i]), v);
+        uint64_t m1 = _ARRAY_FN(vec_eq_mask)(_ARRAY_FN(vec_load)(&a[i + lanes]), v);
+        count += __builtin_popcountll(m0) + __builtin_popcountll(m1);
     }
+    count /= sizeof(_ARRAY_TYPE); // each lane sets sizeof(_ARRAY_TYPE) bits
+#endif
 
-    return pos;
+    for (; i < len; ++i) {
+        count += _ARRAY_TYPE_EQ(a[i], val)? 1:0;
+    }
+
+    return count;
 }
 
 static inline
 __attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
 size_t
-_SARRAY_FN(find_max)(_SMART_ARRAY_T* a)
+_SARRAY_FN(count)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val)
 {
-    return _ARRAY_FN(find_max)(a->len, a->data);
+    return _ARRAY_FN(count)(a->len, a->data, val);
 }
 
+/** Return bit mask of elements equal to the value for up to 64 elements.
+ *
+ * Bit N is set if `a[N]` is equal to `val`.
+ */
 static inline
-_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) FN_ATTR_WARN_UNUSED_RESULT
-bool
-_ARRAY_FN(equal)(size_t len, const _ARRAY_TYPE a[len], const _ARRAY_TYPE b[len])
+__attribute__((nonnull(2))) FN_ATTR_WARN_UNUSED_RESULT
+uint64_t
+_ARRAY_FN(eq_mask64)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val)
 {
-    ARRAY_ASSERT_ALIGNED(a);
-    ARRAY_ASSERT_ALIGNED(b);
-    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
-    b = __builtin_assume_aligned(b, _SMART_ARRAY_ALIGN);
+    uint64_t mask = 0;
+    size_t i = 0;
 
-    bool equal = true;
+#ifdef _ARRAY_SIMD
+    constexpr size_t lanes = _ARRAY_VEC_LANES;
+    const _ARRAY_VEC_T v = (_ARRAY_VEC_T){} + val;
 
-    for (size_t i = 0; i < len; ++i) {
-        if (!_ARRAY_TYPE_EQ(a[i], b[i])) {
-            equal = false;
-            break;
+    if (len >= 64) {
+        #pragma GCC unroll 16
+        for (; i < 64; i += lanes) {
+            simd_i8_t eq = (simd_i8_t)(_ARRAY_FN(vec_load)(&a[i]) == v);
+            mask |= simd_movemask_lanes(eq, sizeof(_ARRAY_TYPE)) << i;
         }
+        return mask;
     }
+#endif
 
-    return equal;
+    for (; i < len && i < 64; ++i) {
+        mask |= (uint64_t)(_ARRAY_TYPE_EQ(a[i], val)? 1:0) << i;
+    }
+
+    return mask;
 }
 
+/** Find all elements equal to the value and set their bits in a bitmap.
+ *
+ * Bitmap must have `(len + 63) / 64` words, bit `i % 64` of word `i / 64`
+ * is set if `a[i]` is equal to `val`. Return number of found elements.
+ *
+ * Example:
+ * ```
+ * uint64_t bitmap[(100 + 63) / 64];
+ * size_t count = i64_array_find_all_bitmap(100, a, 7, bitmap);
+ * ```
+ */
 static inline
-_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) FN_ATTR_WARN_UNUSED_RESULT
-bool
-_ARRAY_FN(equal_with_tolerance)(size_t len,
-    const _ARRAY_TYPE a[len], const _ARRAY_TYPE b[len], _ARRAY_TYPE tolerance)
+_ARRAY_RO(2, 1) __attribute__((nonnull(4)))
+size_t
+_ARRAY_FN(find_all_bitmap)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val,
+    uint64_t bitmap[])
 {
     ARRAY_ASSERT_ALIGNED(a);
-    ARRAY_ASSERT_ALIGNED(b);
     a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
-    b = __builtin_assume_aligned(b, _SMART_ARRAY_ALIGN);
 
-    bool equal = true;
+    size_t count = 0;
 
-    for (size_t i = 0; i < len; ++i) {
-        _ARRAY_TYPE abs_diff = (a[i] < b[i])? (b[i] - a[i]) : (a[i] - b[i]);
-        if (tolerance < abs_diff) {
-            equal = false;
-            break;
-        }
+    for (size_t i = 0; i < len; i += 64) {
+        uint64_t mask = _ARRAY_FN(eq_mask64)(len - i, &a[i], val);
+        bitmap[i / 64] = mask;
+        count += __builtin_popcountll(mask);
     }
 
-    return equal;
+    return count;
 }
 
 static inline
-_ARRAY_RO(2, 1) _ARRAY_WO(3, 1) FN_ATTR_RETURNS_NONNULL
-_ARRAY_TYPE*
-_ARRAY_FN(copy)(size_t len, const _ARRAY_TYPE src[len], _ARRAY_TYPE dst[len])
+__attribute__((nonnull(1, 3)))
+size_t
+_SARRAY_FN(find_all_bitmap)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val, uint64_t bitmap[])
 {
-    ARRAY_ASSERT_ALIGNED(src);
-    ARRAY_ASSERT_ALIGNED(dst);
-    src = __builtin_assume_aligned(src, _SMART_ARRAY_ALIGN);
-    dst = __builtin_assume_aligned(dst, _SMART_ARRAY_ALIGN);
+    return _ARRAY_FN(find_all_bitmap)(a->len, a->data, val, bitmap);
+}
 
-    for (size_t i = 0; i < len; ++i) {
-        dst[i] = src[i];
+/** Find all elements equal to the value and write their indices.
+ *
+ * At most `max_count` indices are written to `idx`,
+ * total number of found elements is returned.
+ *
+ * Example:
+ * ```
+ * size_t idx[10];
+ * size_t count = i64_array_find_all_indices(a->len, a->data, 7, 10, idx);
+ * for (size_t i = 0; i < count && i < 10; ++i) {assert(a->data[idx[i]] == 7);}
+ * ```
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(5, 4)
+size_t
+_ARRAY_FN(find_all_indices)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val,
+    size_t max_count, size_t idx[max_count])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    size_t count = 0;
+
+    for (size_t i = 0; i < len; i += 64) {
+        uint64_t mask = _ARRAY_FN(eq_mask64)(len - i, &a[i], val);
+        if (count + __builtin_popcountll(mask) > max_count) {
+            // output is full, only count the rest
+            for_each_bit(mask, pos) {
+                if (count < max_count) {
+                    idx[count] = i + pos;
+                }
+                ++count;
+            }
+            continue;
+        }
+        for_each_bit(mask, pos) {
+            idx[count++] = i + pos;
+        }
     }
 
-    return dst;
+    return count;
 }
 
 static inline
-_ARRAY_RO(2, 1) _ARRAY_WO(3, 1) FN_ATTR_RETURNS_NONNULL
-_ARRAY_TYPE*
-_ARRAY_FN(memcopy)(size_t len, const _ARRAY_TYPE src[len], _ARRAY_TYPE dst[len])
+__attribute__((nonnull(1, 4)))
+size_t
+_SARRAY_FN(find_all_indices)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val,
+    size_t max_count, size_t idx[max_count])
 {
-    ARRAY_ASSERT_ALIGNED(src);
-    ARRAY_ASSERT_ALIGNED(dst);
-    src = __builtin_assume_aligned(src, _SMART_ARRAY_ALIGN);
-    dst = __builtin_assume_aligned(dst, _SMART_ARRAY_ALIGN);
-
-    return (_ARRAY_TYPE*) __builtin_memcpy(dst, src, len * sizeof(dst[0]));
+    return _ARRAY_FN(find_all_indices)(a->len, a->data, val, max_count, idx);
 }
 
+#ifdef _ARRAY_SIMD
+/** Move lanes selected by `mask` to the low lanes keeping their order, other lanes are unspecified.
+ *
+ * Uses AVX-512 compress instruction if available, otherwise a shuffle
+ * with control built by `simd_compress_indices`.
+ */
 static inline
-_ARRAY_WO(2, 1) FN_ATTR_RETURNS_NONNULL
-_ARRAY_TYPE*
-_ARRAY_FN(fill)(size_t len, _ARRAY_TYPE a[len], _ARRAY_TYPE val)
+FN_ATTR_CONST
+_ARRAY_VEC_T
+_ARRAY_FN(vec_compress)(_ARRAY_VEC_T v, uint64_t mask)
 {
-    ARRAY_ASSERT_ALIGNED(a);
-    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
-
-    for (size_t i = 0; i < len; ++i) {
-        a[i] = val;
+#if SMARTARR_SIMD_VLEN == 32 && defined(__AVX512F__) && defined(__AVX512VL__)
+    if (sizeof(_ARRAY_TYPE) == 4) {
+        return (_ARRAY_VEC_T)_mm256_maskz_compress_epi32(mask, (__m256i)v);
+    }
+    if (sizeof(_ARRAY_TYPE) == 8) {
+        return (_ARRAY_VEC_T)_mm256_maskz_compress_epi64(mask, (__m256i)v);
+    }
+#elif SMARTARR_SIMD_VLEN == 64 && defined(__AVX512F__)
+    if (sizeof(_ARRAY_TYPE) == 4) {
+        return (_ARRAY_VEC_T)_mm512_maskz_compress_epi32(mask, (__m512i)v);
+    }
+    if (sizeof(_ARRAY_TYPE) == 8) {
+        return (_ARRAY_VEC_T)_mm512_maskz_compress_epi64(mask, (__m512i)v);
+    }
+#endif
+    if (_ARRAY_VEC_LANES <= 8) {
+        typedef uint8_t index8_t __attribute__((vector_size(_ARRAY_VEC_LANES)));
+        const uint64_t indices = simd_compress_indices(mask);
+        index8_t index8;
+        __builtin_memcpy(&index8, &indices, sizeof(index8));
+        return __builtin_shuffle(v, __builtin_convertvector(index8, _ARRAY_BITS_VEC_T));
     }
 
-    return a;
+    _ARRAY_VEC_T out = {};
+    size_t k = 0;
+    for_each_bit(mask, pos) {
+        out[k++] = v[pos];
+    }
+    return out;
 }
 
+/** Store `nr` first lanes of `v` to `dst` that has room for `dst_len` elements.
+ *
+ * Whole vector is stored if it fits, it is faster than a partial store.
+ */
 static inline
-__attribute__((nonnull(1))) FN_ATTR_RETURNS_NONNULL
-_ARRAY_TYPE*
-_SARRAY_FN(fill)(_SMART_ARRAY_T* a, _ARRAY_TYPE val)
+__attribute__((always_inline, nonnull(1)))
+void
+_ARRAY_FN(store_compressed)(_ARRAY_TYPE* dst, size_t dst_len, _ARRAY_VEC_T v, size_t nr)
 {
-    return _ARRAY_FN(fill)(a->len, a->data, val);
+    if (__builtin_expect(_ARRAY_VEC_LANES <= dst_len, 1)) {
+        *(_ARRAY_VEC_T*)dst = v;
+    } else {
+        __builtin_memcpy(dst, &v, nr * sizeof(_ARRAY_TYPE));
+    }
 }
+#endif // _ARRAY_SIMD
 
+/** `compress` into `dst` with room for `dst_len` elements, see `store_compressed`.
+ *
+ */
 static inline
-_ARRAY_RW(2, 1) FN_ATTR_RETURNS_NONNULL
-_ARRAY_TYPE*
-_ARRAY_FN(insertion_sort)(size_t len, _ARRAY_TYPE a[len])
+__attribute__((always_inline))
+size_t
+_ARRAY_FN(compress_to)(size_t len, const _ARRAY_TYPE a[len], const uint64_t bitmap[],
+    _ARRAY_TYPE* dst, size_t dst_len UNUSED)
 {
     ARRAY_ASSERT_ALIGNED(a);
     a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
 
-    size_t j;
-    _ARRAY_TYPE key;
+    size_t count = 0;
+    size_t vec_len = 0;
+#ifdef _ARRAY_SIMD
+    constexpr size_t lanes = _ARRAY_VEC_LANES;
+    constexpr uint64_t lanes_mask = (lanes >= 64)? ~0ull : (1ull << lanes) - 1;
 
-    for (size_t i = 1; i < len; ++i) {
-        key = a[i];
-        j = i;
- 
-        /* Shift elements of a[0..i-1], that are GT key, to one position right */
-        while (j > 0 && _ARRAY_TYPE_LT(key, a[j - 1])) {
-            a[j] = a[j - 1];
-            --j;
+    vec_len = len - len % lanes;
+    for (size_t i = 0; i < vec_len; i += lanes) {
+        const uint64_t mask = (bitmap[i / 64] >> (i % 64)) & lanes_mask;
+        if (mask == 0) {
+            continue;
         }
-        a[j] = key;
+        const _ARRAY_VEC_T v = _ARRAY_FN(vec_load)(&a[i]);
+        const size_t nr = __builtin_popcountll(mask);
+        _ARRAY_FN(store_compressed)(&dst[count], dst_len - count,
+            (mask == lanes_mask)? v : _ARRAY_FN(vec_compress)(v, mask), nr);
+        count += nr;
     }
-
-    return a;
+#endif // _ARRAY_SIMD
+    for (size_t i = vec_len; i < len; ++i) {
+        if ((bitmap[i / 64] >> (i % 64)) & 1) {
+            dst[count++] = a[i];
+        }
+    }
+    return count;
 }
 
+/** Copy elements whose bits are set in the bitmap to `dst` contiguously, return their number.
+ *
+ * Bitmap has the layout of `find_all_bitmap`. `dst` must have room for `len`
+ * elements, whole vectors may be stored past the last copied element.
+ * `dst` may be `a`.
+ */
+static inline
+_ARRAY_RO(2, 1) __attribute__((nonnull(3))) _ARRAY_WO(4, 1)
+size_t
+_ARRAY_FN(compress)(size_t len, const _ARRAY_TYPE a[len], const uint64_t bitmap[],
+    _ARRAY_TYPE dst[len])
+{
+    return _ARRAY_FN(compress_to)(len, a, bitmap, dst, len);
+}
+
+static inline
+__attribute__((nonnull(1, 2, 3)))
+size_t
+_SARRAY_FN(compress)(const _SMART_ARRAY_T* a, const uint64_t bitmap[], _SMART_ARRAY_T* dst)
+{
+    assert(dst->len >= a->len);
+    return _ARRAY_FN(compress)(a->len, a->data, bitmap, dst->data);
+}
+
+// Predicates of `filter_by`.
+#ifndef _ARRAY_FILTER_LT
+#define _ARRAY_FILTER_LT      0
+#define _ARRAY_FILTER_GT      1
+#define _ARRAY_FILTER_EQ      2
+#define _ARRAY_FILTER_BETWEEN 3
+#endif
+
+/** Filter predicate of one element, `hi` is used only by `_ARRAY_FILTER_BETWEEN`.
+ *
+ */
+static inline
+__attribute__((always_inline)) FN_ATTR_CONST
+bool
+_ARRAY_FN(filter_pass)(_ARRAY_TYPE x, int op, _ARRAY_TYPE lo, _ARRAY_TYPE hi)
+{
+    switch (op) {
+    case _ARRAY_FILTER_LT: return _ARRAY_TYPE_LT(x, lo);
+    case _ARRAY_FILTER_GT: return _ARRAY_TYPE_LT(lo, x);
+    case _ARRAY_FILTER_EQ: return _ARRAY_TYPE_EQ(x, lo);
+    default:
+        return !_ARRAY_TYPE_LT(x, lo) && !_ARRAY_TYPE_LT(hi, x) && !_ARRAY_IS_NAN(x);
+    }
+}
+
+#ifdef _ARRAY_SIMD
+/** Lane mask of vector elements that pass the filter predicate.
+ *
+ */
+static inline
+__attribute__((always_inline)) FN_ATTR_CONST
+uint64_t
+_ARRAY_FN(vec_filter_mask)(_ARRAY_VEC_T v, int op, _ARRAY_VEC_T lo, _ARRAY_VEC_T hi)
+{
+    simd_i8_t pass;
+    switch (op) {
+    case _ARRAY_FILTER_LT: pass = (simd_i8_t)(v < lo); break;
+    case _ARRAY_FILTER_GT: pass = (simd_i8_t)(v > lo); break;
+    case _ARRAY_FILTER_EQ: pass = (simd_i8_t)(v == lo); break;
+    default: pass = (simd_i8_t)((v >= lo) & (v <= hi)); break;
+    }
+    return simd_movemask_lanes(pass, sizeof(_ARRAY_TYPE));
+}
+#endif // _ARRAY_SIMD
+
+/** Copy elements that pass the predicate `op` to `dst`, return their number.
+ *
+ * Branch-free: every vector is compared, compressed and stored whole,
+ * the output position advances by the number of passed elements.
+ * `dst` has room for `dst_len` elements, with `count_only` nothing is written.
+ */
+static inline
+__attribute__((always_inline))
+size_t
+_ARRAY_FN(filter_by)(size_t len, const _ARRAY_TYPE a[len], int op,
+    _ARRAY_TYPE lo, _ARRAY_TYPE hi, _ARRAY_TYPE* dst, size_t dst_len, bool count_only)
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    size_t count = 0;
+    size_t vec_len = 0;
+#ifdef _ARRAY_SIMD
+    constexpr size_t lanes = _ARRAY_VEC_LANES;
+    const _ARRAY_VEC_T vlo = (_ARRAY_VEC_T){} + lo;
+    const _ARRAY_VEC_T vhi = (_ARRAY_VEC_T){} + hi;
+
+    vec_len = len - len % lanes;
+    for (size_t i = 0; i < vec_len; i += lanes) {
+        const _ARRAY_VEC_T v = _ARRAY_FN(vec_load)(&a[i]);
+        const uint64_t mask = _ARRAY_FN(vec_filter_mask)(v, op, vlo, vhi);
+        const size_t nr = __builtin_popcountll(mask);
+        if (!count_only) {
+            _ARRAY_FN(store_compressed)(&dst[count], dst_len - count,
+                _ARRAY_FN(vec_compress)(v, mask), nr);
+        }
+        count += nr;
+    }
+#endif // _ARRAY_SIMD
+    for (size_t i = vec_len; i < len; ++i) {
+        const bool pass = _ARRAY_FN(filter_pass)(a[i], op, lo, hi);
+        if (!count_only && count < dst_len) {
+            dst[count] = a[i];
+        }
+        count += pass;
+    }
+    return count;
+}
+
+/** Copy elements less than `val` to `dst` contiguously, return their number.
+ *
+ * `dst` must have room for `len` elements, see `compress`. `dst` may be `a`.
+ *
+ * Example:
+ * ```
+ * size_t n = i64_array_filter_lt(a->len, a->data, 100, out->data);
+ * ```
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(4, 1)
+size_t
+_ARRAY_FN(filter_lt)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val, _ARRAY_TYPE dst[len])
+{
+    return _ARRAY_FN(filter_by)(len, a, _ARRAY_FILTER_LT, val, val, dst, len, false);
+}
+
+/** Copy elements greater than `val` to `dst` contiguously, return their number.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(4, 1)
+size_t
+_ARRAY_FN(filter_gt)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val, _ARRAY_TYPE dst[len])
+{
+    return _ARRAY_FN(filter_by)(len, a, _ARRAY_FILTER_GT, val, val, dst, len, false);
+}
+
+/** Copy elements equal to `val` to `dst` contiguously, return their number.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(4, 1)
+size_t
+_ARRAY_FN(filter_eq)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val, _ARRAY_TYPE dst[len])
+{
+    return _ARRAY_FN(filter_by)(len, a, _ARRAY_FILTER_EQ, val, val, dst, len, false);
+}
+
+/** Copy elements in closed range `[lo, hi]` to `dst` contiguously, return their number.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(5, 1)
+size_t
+_ARRAY_FN(filter_between)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE lo, _ARRAY_TYPE hi,
+    _ARRAY_TYPE dst[len])
+{
+    return _ARRAY_FN(filter_by)(len, a, _ARRAY_FILTER_BETWEEN, lo, hi, dst, len, false);
+}
+
+static inline
+__attribute__((nonnull(1, 3)))
+size_t
+_SARRAY_FN(filter_lt)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val, _SMART_ARRAY_T* dst)
+{
+    assert(dst->len >= a->len);
+    return _ARRAY_FN(filter_lt)(a->len, a->data, val, dst->data);
+}
+
+static inline
+__attribute__((nonnull(1, 3)))
+size_t
+_SARRAY_FN(filter_gt)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val, _SMART_ARRAY_T* dst)
+{
+    assert(dst->len >= a->len);
+    return _ARRAY_FN(filter_gt)(a->len, a->data, val, dst->data);
+}
+
+static inline
+__attribute__((nonnull(1, 3)))
+size_t
+_SARRAY_FN(filter_eq)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val, _SMART_ARRAY_T* dst)
+{
+    assert(dst->len >= a->len);
+    return _ARRAY_FN(filter_eq)(a->len, a->data, val, dst->data);
+}
+
+static inline
+__attribute__((nonnull(1, 4)))
+size_t
+_SARRAY_FN(filter_between)(const _SMART_ARRAY_T* a, _ARRAY_TYPE lo, _ARRAY_TYPE hi,
+    _SMART_ARRAY_T* dst)
+{
+    assert(dst->len >= a->len);
+    return _ARRAY_FN(filter_between)(a->len, a->data, lo, hi, dst->data);
+}
+
+// Needle sets up to this size are compared with every element in registers,
+// larger sets go through a bitmap filter.
+#ifndef SMARTARR_FIND_ANY_BROADCAST_MAX
+#define SMARTARR_FIND_ANY_BROADCAST_MAX 16
+#endif
+
+// Number of bits in the filter of a large needle set, power of 2.
+#ifndef SMARTARR_FIND_ANY_FILTER_BITS
+#define SMARTARR_FIND_ANY_FILTER_BITS 4096
+#endif
+
+/** Set of values to look for with `find_any` and `count_any`.
+ *
+ * Small set is kept as vectors with a needle broadcast to all lanes.
+ * For large set a filter bit is set for hash of every needle,
+ * an element is compared with the needles only if its filter bit is set.
+ * Needles are not copied, they must live as long as the set.
+ */
+typedef struct {
+    size_t len;
+    const _ARRAY_TYPE* data;
+#ifdef _ARRAY_SIMD
+    _ARRAY_VEC_T vec[SMARTARR_FIND_ANY_BROADCAST_MAX];
+    uint64_t filter[SMARTARR_FIND_ANY_FILTER_BITS / 64];
+#endif
+} _ARRAY_NEEDLES_T;
+
+#ifdef _ARRAY_SIMD
+/** Hash of element bits to a filter bit index, -0.0 and +0.0 have the same hash.
+ *
+ */
+static inline
+FN_ATTR_CONST
+size_t
+_ARRAY_FN(needle_hash)(_ARRAY_TYPE x)
+{
+    x = x + (_ARRAY_TYPE)0; // -0.0 + 0.0 is +0.0
+    _ARRAY_BITS_T bits;
+    __builtin_memcpy(&bits, &x, sizeof(bits));
+    constexpr int filter_log2 = __builtin_ctz(SMARTARR_FIND_ANY_FILTER_BITS);
+    return ((uint64_t)bits * 0x9E3779B97F4A7C15ull) >> (64 - filter_log2);
+}
+#endif
+
+/** Prepare set of needles for `needles_find` and `needles_count`.
+ *
+ */
+static inline
+__attribute__((nonnull(1))) _ARRAY_RO(3, 2)
+void
+_ARRAY_FN(needles_init)(_ARRAY_NEEDLES_T* set, size_t len, const _ARRAY_TYPE needles[len])
+{
+    set->len = len;
+    set->data = needles;
+#ifdef _ARRAY_SIMD
+    if (len <= SMARTARR_FIND_ANY_BROADCAST_MAX) {
+        for (size_t i = 0; i < len; ++i) {
+            set->vec[i] = (_ARRAY_VEC_T){} + needles[i];
+        }
+    } else {
+        __builtin_memset(set->filter, 0, sizeof(set->filter));
+        for (size_t i = 0; i < len; ++i) {
+            const size_t h = _ARRAY_FN(needle_hash)(needles[i]);
+            set->filter[h / 64] |= 1ull << (h % 64);
+        }
+    }
+#endif
+}
+
+/** Return true if the value is equal to one of the needles.
+ *
+ */
+static inline
+__attribute__((nonnull(1))) FN_ATTR_PURE
+bool
+_ARRAY_FN(needles_contain)(const _ARRAY_NEEDLES_T* set, _ARRAY_TYPE x)
+{
+#ifdef _ARRAY_SIMD
+    if (set->len > SMARTARR_FIND_ANY_BROADCAST_MAX) {
+        const size_t h = _ARRAY_FN(needle_hash)(x);
+        if (((set->filter[h / 64] >> (h % 64)) & 1) == 0) {
+            return false;
+        }
+    }
+#endif
+    for (size_t i = 0; i < set->len; ++i) {
+        if (_ARRAY_TYPE_EQ(x, set->data[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Return bit mask of elements equal to any needle for up to 64 elements.
+ *
+ * Bit N is set if `a[N]` is in the set.
+ */
+static inline
+__attribute__((nonnull(2, 3))) FN_ATTR_WARN_UNUSED_RESULT
+uint64_t
+_ARRAY_FN(needles_mask64)(size_t len, const _ARRAY_TYPE a[len], const _ARRAY_NEEDLES_T* set)
+{
+    uint64_t mask = 0;
+    size_t i = 0;
+
+#ifdef _ARRAY_SIMD
+    constexpr size_t lanes = _ARRAY_VEC_LANES;
+
+    if (len >= 64 && set->len <= SMARTARR_FIND_ANY_BROADCAST_MAX) {
+        #pragma GCC unroll 16
+        for (; i < 64; i += lanes) {
+            const _ARRAY_VEC_T v = _ARRAY_FN(vec_load)(&a[i]);
+            _ARRAY_BITS_VEC_T eq = {};
+            for (size_t n = 0; n < set->len; ++n) {
+                eq |= (_ARRAY_BITS_VEC_T)(v == set->vec[n]);
+            }
+            mask |= simd_movemask_lanes((simd_i8_t)eq, sizeof(_ARRAY_TYPE)) << i;
+        }
+        return mask;
+    }
+#endif
+
+    for (; i < len && i < 64; ++i) {
+        mask |= (uint64_t)(_ARRAY_FN(needles_contain)(set, a[i])? 1:0) << i;
+    }
+
+    return mask;
+}
+
+/** Find first element that is equal to any needle of the set.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) __attribute__((nonnull(3))) FN_ATTR_WARN_UNUSED_RESULT
+optional_uint_t
+_ARRAY_FN(needles_find)(size_t len, const _ARRAY_TYPE a[len], const _ARRAY_NEEDLES_T* set)
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    for (size_t i = 0; i < len; i += 64) {
+        uint64_t mask = _ARRAY_FN(needles_mask64)(len - i, &a[i], set);
+        if (mask) {
+            return (optional_uint_t){.present = true, .value = i + ctz(mask)};
+        }
+    }
+
+    return (optional_uint_t){.present = false};
+}
+
+/** Count elements that are equal to any needle of the set.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) __attribute__((nonnull(3))) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_ARRAY_FN(needles_count)(size_t len, const _ARRAY_TYPE a[len], const _ARRAY_NEEDLES_T* set)
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    size_t count = 0;
+
+    for (size_t i = 0; i < len; i += 64) {
+        count += __builtin_popcountll(_ARRAY_FN(needles_mask64)(len - i, &a[i], set));
+    }
+
+    return count;
+}
+
+/** Find first element equal to any of the needles in one pass.
+ *
+ * Same result as the smallest position returned by `find` for every needle.
+ *
+ * Example:
+ * ```
+ * const int64_t sentinels[3] = {-1, 0, INT64_MAX};
+ * auto pos = i64_array_find_any(a->len, a->data, 3, sentinels);
+ * ```
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(4, 3) FN_ATTR_WARN_UNUSED_RESULT
+optional_uint_t
+_ARRAY_FN(find_any)(size_t len, const _ARRAY_TYPE a[len],
+    size_t nr_needles, const _ARRAY_TYPE needles[nr_needles])
+{
+    if (nr_needles == 1) {
+        return _ARRAY_FN(find)(len, a, needles[0]);
+    }
+
+    _ARRAY_NEEDLES_T set;
+    _ARRAY_FN(needles_init)(&set, nr_needles, needles);
+
+    return _ARRAY_FN(needles_find)(len, a, &set);
+}
+
+static inline
+__attribute__((nonnull(1, 2))) FN_ATTR_WARN_UNUSED_RESULT
+optional_uint_t
+_SARRAY_FN(find_any)(const _SMART_ARRAY_T* a, const _SMART_ARRAY_T* needles)
+{
+    return _ARRAY_FN(find_any)(a->len, a->data, needles->len, needles->data);
+}
+
+/** Count elements equal to any of the needles in one pass.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(4, 3) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_ARRAY_FN(count_any)(size_t len, const _ARRAY_TYPE a[len],
+    size_t nr_needles, const _ARRAY_TYPE needles[nr_needles])
+{
+    _ARRAY_NEEDLES_T set;
+    _ARRAY_FN(needles_init)(&set, nr_needles, needles);
+
+    return _ARRAY_FN(needles_count)(len, a, &set);
+}
+
+static inline
+__attribute__((nonnull(1, 2))) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_SARRAY_FN(count_any)(const _SMART_ARRAY_T* a, const _SMART_ARRAY_T* needles)
+{
+    return _ARRAY_FN(count_any)(a->len, a->data, needles->len, needles->data);
+}
+
+#ifndef _ARRAY_TYPE_COMPOUND
+/** Return true if `|x - val| <= tolerance`, NaN is never within tolerance.
+ *
+ */
+static inline
+FN_ATTR_CONST
+bool
+_ARRAY_FN(is_within)(_ARRAY_TYPE x, _ARRAY_TYPE val, _ARRAY_TYPE tolerance)
+{
+    _ARRAY_TYPE abs_diff = (x < val)? (val - x) : (x - val);
+    return abs_diff <= tolerance;
+}
+
+/** Return bit mask of elements within tolerance of the value for up to 64 elements.
+ *
+ */
+static inline
+__attribute__((nonnull(2))) FN_ATTR_WARN_UNUSED_RESULT
+uint64_t
+_ARRAY_FN(within_mask64)(size_t len, const _ARRAY_TYPE a[len],
+    _ARRAY_TYPE val, _ARRAY_TYPE tolerance)
+{
+    uint64_t mask = 0;
+    size_t i = 0;
+
+#ifdef _ARRAY_SIMD
+    constexpr size_t lanes = _ARRAY_VEC_LANES;
+    const _ARRAY_VEC_T vval = (_ARRAY_VEC_T){} + val;
+    const _ARRAY_VEC_T vtol = (_ARRAY_VEC_T){} + tolerance;
+
+    if (len >= 64) {
+        #pragma GCC unroll 16
+        for (; i < 64; i += lanes) {
+            const _ARRAY_VEC_T v = _ARRAY_FN(vec_load)(&a[i]);
+            const _ARRAY_VEC_T diff = _ARRAY_FN(vec_select)(
+                (_ARRAY_BITS_VEC_T)(v < vval), vval - v, v - vval);
+            mask |= simd_movemask_lanes((simd_i8_t)(diff <= vtol), sizeof(_ARRAY_TYPE)) << i;
+        }
+        return mask;
+    }
+#endif
+
+    for (; i < len && i < 64; ++i) {
+        mask |= (uint64_t)(_ARRAY_FN(is_within)(a[i], val, tolerance)? 1:0) << i;
+    }
+
+    return mask;
+}
+
+/** Find first element with `|a[i] - val| <= tolerance`.
+ *
+ * Integer types are compared the same way, difference of signed
+ * values must not overflow.
+ *
+ * Example:
+ * ```
+ * auto pos = f64_array_find_within(a->len, a->data, 36.6, 0.05);
+ * ```
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+optional_uint_t
+_ARRAY_FN(find_within)(size_t len, const _ARRAY_TYPE a[len],
+    _ARRAY_TYPE val, _ARRAY_TYPE tolerance)
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    for (size_t i = 0; i < len; i += 64) {
+        uint64_t mask = _ARRAY_FN(within_mask64)(len - i, &a[i], val, tolerance);
+        if (mask) {
+            return (optional_uint_t){.present = true, .value = i + ctz(mask)};
+        }
+    }
+
+    return (optional_uint_t){.present = false};
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+optional_uint_t
+_SARRAY_FN(find_within)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val, _ARRAY_TYPE tolerance)
+{
+    return _ARRAY_FN(find_within)(a->len, a->data, val, tolerance);
+}
+
+/** Count elements with `|a[i] - val| <= tolerance`.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_ARRAY_FN(count_within)(size_t len, const _ARRAY_TYPE a[len],
+    _ARRAY_TYPE val, _ARRAY_TYPE tolerance)
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    size_t count = 0;
+
+    for (size_t i = 0; i < len; i += 64) {
+        count += __builtin_popcountll(_ARRAY_FN(within_mask64)(len - i, &a[i], val, tolerance));
+    }
+
+    return count;
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_SARRAY_FN(count_within)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val, _ARRAY_TYPE tolerance)
+{
+    return _ARRAY_FN(count_within)(a->len, a->data, val, tolerance);
+}
+
+/** Return number of representable values between `x` and `val`.
+ *
+ * Distance between -0.0 and +0.0 is zero, for integers it is `|x - val|`.
+ * Distance to NaN is the largest value of the unsigned type.
+ */
+static inline
+FN_ATTR_CONST
+_ARRAY_BITS_T
+_ARRAY_FN(ulp_distance)(_ARRAY_TYPE x, _ARRAY_TYPE val)
+{
+    if (_ARRAY_IS_NAN(x) || _ARRAY_IS_NAN(val)) {
+        return (_ARRAY_BITS_T)-1;
+    }
+    const _ARRAY_BITS_T kx = _ARRAY_FN(sortable_key)(x);
+    const _ARRAY_BITS_T kv = _ARRAY_FN(sortable_key)(val);
+    return (kx < kv)? kv - kx : kx - kv;
+}
+
+/** Return bit mask of elements at most `max_ulps` apart from the value for up to 64 elements.
+ *
+ */
+static inline
+__attribute__((nonnull(2))) FN_ATTR_WARN_UNUSED_RESULT
+uint64_t
+_ARRAY_FN(within_ulps_mask64)(size_t len, const _ARRAY_TYPE a[len],
+    _ARRAY_TYPE val, _ARRAY_BITS_T max_ulps)
+{
+    uint64_t mask = 0;
+    size_t i = 0;
+
+#ifdef _ARRAY_SIMD
+    constexpr size_t lanes = _ARRAY_VEC_LANES;
+    const _ARRAY_BITS_VEC_T kval = _ARRAY_FN(vec_sortable_key)((_ARRAY_VEC_T){} + val);
+    const _ARRAY_BITS_VEC_T vmax = (_ARRAY_BITS_VEC_T){} + max_ulps;
+
+    if (len >= 64 && !_ARRAY_IS_NAN(val)) {
+        #pragma GCC unroll 16
+        for (; i < 64; i += lanes) {
+            const _ARRAY_VEC_T v = _ARRAY_FN(vec_load)(&a[i]);
+            const _ARRAY_BITS_VEC_T k = _ARRAY_FN(vec_sortable_key)(v);
+            const _ARRAY_BITS_VEC_T lt = (_ARRAY_BITS_VEC_T)(k < kval);
+            const _ARRAY_BITS_VEC_T diff = ((kval - k) & lt) | ((k - kval) & ~lt);
+            const _ARRAY_BITS_VEC_T ok = (_ARRAY_BITS_VEC_T)(diff <= vmax) & ~_ARRAY_FN(vec_is_nan)(v);
+            mask |= simd_movemask_lanes((simd_i8_t)ok, sizeof(_ARRAY_TYPE)) << i;
+        }
+        return mask;
+    }
+#endif
+
+    for (; i < len && i < 64; ++i) {
+        const bool ok = !_ARRAY_IS_NAN(a[i]) && !_ARRAY_IS_NAN(val) &&
+            _ARRAY_FN(ulp_distance)(a[i], val) <= max_ulps;
+        mask |= (uint64_t)(ok? 1:0) << i;
+    }
+
+    return mask;
+}
+
+/** Find first element at most `max_ulps` representable values apart from the value.
+ *
+ * Relative tolerance that does not depend on magnitude of the value,
+ * `max_ulps` 0 finds an element equal to the value.
+ *
+ * Example:
+ * ```
+ * auto pos = f32_array_find_within_ulps(a->len, a->data, 0.1f, 4);
+ * ```
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+optional_uint_t
+_ARRAY_FN(find_within_ulps)(size_t len, const _ARRAY_TYPE a[len],
+    _ARRAY_TYPE val, _ARRAY_BITS_T max_ulps)
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    for (size_t i = 0; i < len; i += 64) {
+        uint64_t mask = _ARRAY_FN(within_ulps_mask64)(len - i, &a[i], val, max_ulps);
+        if (mask) {
+            return (optional_uint_t){.present = true, .value = i + ctz(mask)};
+        }
+    }
+
+    return (optional_uint_t){.present = false};
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+optional_uint_t
+_SARRAY_FN(find_within_ulps)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val, _ARRAY_BITS_T max_ulps)
+{
+    return _ARRAY_FN(find_within_ulps)(a->len, a->data, val, max_ulps);
+}
+
+/** Count elements at most `max_ulps` representable values apart from the value.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_ARRAY_FN(count_within_ulps)(size_t len, const _ARRAY_TYPE a[len],
+    _ARRAY_TYPE val, _ARRAY_BITS_T max_ulps)
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    size_t count = 0;
+
+    for (size_t i = 0; i < len; i += 64) {
+        count += __builtin_popcountll(_ARRAY_FN(within_ulps_mask64)(len - i, &a[i], val, max_ulps));
+    }
+
+    return count;
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_SARRAY_FN(count_within_ulps)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val, _ARRAY_BITS_T max_ulps)
+{
+    return _ARRAY_FN(count_within_ulps)(a->len, a->data, val, max_ulps);
+}
+#endif // _ARRAY_TYPE_COMPOUND
+
+/** Element value and its position in array.
+ *
+ */
+typedef struct {
+    _ARRAY_TYPE val;
+    size_t pos;
+} _ARRAY_VAL_POS_T;
+
+/** Minimum and maximum elements of array.
+ *
+ */
+typedef struct {
+    _ARRAY_VAL_POS_T min;
+    _ARRAY_VAL_POS_T max;
+} _ARRAY_MINMAX_T;
+
+/** Return true if `a` is a better minimum than `b`.
+ *
+ * NaN is never better than a number, from equal elements
+ * the one with smaller position is better.
+ */
+static inline
+FN_ATTR_CONST
+bool
+_ARRAY_FN(val_pos_min_first)(_ARRAY_VAL_POS_T a, _ARRAY_VAL_POS_T b)
+{
+    bool a_nan = _ARRAY_IS_NAN(a.val);
+    bool b_nan = _ARRAY_IS_NAN(b.val);
+    if (a_nan != b_nan) return b_nan;
+    if (_ARRAY_TYPE_LT(a.val, b.val)) return true;
+    if (_ARRAY_TYPE_LT(b.val, a.val)) return false;
+    return a.pos < b.pos;
+}
+
+/** Return true if `a` is a better maximum than `b`.
+ *
+ */
+static inline
+FN_ATTR_CONST
+bool
+_ARRAY_FN(val_pos_max_first)(_ARRAY_VAL_POS_T a, _ARRAY_VAL_POS_T b)
+{
+    bool a_nan = _ARRAY_IS_NAN(a.val);
+    bool b_nan = _ARRAY_IS_NAN(b.val);
+    if (a_nan != b_nan) return b_nan;
+    if (_ARRAY_TYPE_LT(b.val, a.val)) return true;
+    if (_ARRAY_TYPE_LT(a.val, b.val)) return false;
+    return a.pos < b.pos;
+}
+
+/** Merge min/max of two parts of an array.
+ *
+ */
+static inline
+FN_ATTR_CONST
+_ARRAY_MINMAX_T
+_ARRAY_FN(minmax_merge)(_ARRAY_MINMAX_T a, _ARRAY_MINMAX_T b)
+{
+    return (_ARRAY_MINMAX_T){
+        .min = _ARRAY_FN(val_pos_min_first)(a.min, b.min)? a.min : b.min,
+        .max = _ARRAY_FN(val_pos_max_first)(a.max, b.max)? a.max : b.max
+    };
+}
+
+/** Find minimum and maximum elements in one pass.
+ *
+ * Array must not be empty. NaN elements are skipped, if all elements
+ * are NaN then the first element is returned. From equal elements
+ * the first one is returned.
+ *
+ * SIMD version keeps running minimum and maximum with their positions
+ * in every vector lane and reduces lanes once at the end.
+ *
+ * Example:
+ * ```
+ * auto mm = f64_array_find_minmax(a->len, a->data);
+ * double range = mm.max.val - mm.min.val;
+ * ```
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_MINMAX_T
+_ARRAY_FN(find_minmax)(size_t len, const _ARRAY_TYPE a[len])
+{
+    assert(len > 0);
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    _ARRAY_MINMAX_T res = {.min = {a[0], 0}, .max = {a[0], 0}};
+    size_t i = 0;
+
+#ifdef _ARRAY_SIMD
+    constexpr size_t lanes = _ARRAY_VEC_LANES;
+    // lane positions have the size of an element, so 32-bit types go in blocks
+    constexpr size_t max_block_len = (size_t)1 << (8 * sizeof(_ARRAY_TYPE) - 1);
+    const _ARRAY_BITS_VEC_T iota = _ARRAY_FN(vec_iota)();
+
+    while (len - i >= lanes) {
+        const size_t n = (len - i < max_block_len)? len - i : max_block_len;
+        const _ARRAY_TYPE* b = &a[i];
+
+        _ARRAY_VEC_T vmin = _ARRAY_FN(vec_load)(b), vmax = vmin;
+        _ARRAY_BITS_VEC_T pmin = iota, pmax = iota, pos = iota;
+
+        for (size_t j = lanes; j < n; j += lanes) {
+            if (j + lanes > n) {
+                // last vector overlaps with already processed elements
+                j = n - lanes;
+                pos = iota + (_ARRAY_BITS_T)j;
+            } else {
+                pos += lanes;
+            }
+            _ARRAY_VEC_T v = _ARRAY_FN(vec_load)(&b[j]);
+            // running NaN is replaced by anything
+            _ARRAY_BITS_VEC_T lt = (_ARRAY_BITS_VEC_T)(v < vmin) | _ARRAY_FN(vec_is_nan)(vmin);
+            _ARRAY_BITS_VEC_T gt = (_ARRAY_BITS_VEC_T)(vmax < v) | _ARRAY_FN(vec_is_nan)(vmax);
+            vmin = _ARRAY_FN(vec_select)(lt, v, vmin);
+            vmax = _ARRAY_FN(vec_select)(gt, v, vmax);
+            pmin = (pos & lt) | (pmin & ~lt);
+            pmax = (pos & gt) | (pmax & ~gt);
+        }
+
+        for (size_t l = 0; l < lanes; ++l) {
+            _ARRAY_MINMAX_T lane = {
+                .min = {vmin[l], i + pmin[l]},
+                .max = {vmax[l], i + pmax[l]}
+            };
+            res = _ARRAY_FN(minmax_merge)(res, lane);
+        }
+
+        i += n;
+    }
+#endif
+
+    for (; i < len; ++i) {
+        _ARRAY_MINMAX_T el = {.min = {a[i], i}, .max = {a[i], i}};
+        res = _ARRAY_FN(minmax_merge)(res, el);
+    }
+
+    return res;
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_MINMAX_T
+_SARRAY_FN(find_minmax)(const _SMART_ARRAY_T* a)
+{
+    return _ARRAY_FN(find_minmax)(a->len, a->data);
+}
+
+/** Find minimum element, return its value and position.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_VAL_POS_T
+_ARRAY_FN(find_min_val)(size_t len, const _ARRAY_TYPE a[len])
+{
+    return _ARRAY_FN(find_minmax)(len, a).min;
+}
+
+/** Find maximum element, return its value and position.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_VAL_POS_T
+_ARRAY_FN(find_max_val)(size_t len, const _ARRAY_TYPE a[len])
+{
+    return _ARRAY_FN(find_minmax)(len, a).max;
+}
+
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_ARRAY_FN(find_min)(size_t len, const _ARRAY_TYPE a[len])
+{
+    return _ARRAY_FN(find_minmax)(len, a).min.pos;
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_SARRAY_FN(find_min)(_SMART_ARRAY_T* a)
+{
+    return _ARRAY_FN(find_min)(a->len, a->data);
+}
+
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_ARRAY_FN(find_max)(size_t len, const _ARRAY_TYPE a[len])
+{
+    return _ARRAY_FN(find_minmax)(len, a).max.pos;
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_SARRAY_FN(find_max)(_SMART_ARRAY_T* a)
+{
+    return _ARRAY_FN(find_max)(a->len, a->data);
+}
+
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) FN_ATTR_WARN_UNUSED_RESULT
+bool
+_ARRAY_FN(equal)(size_t len, const _ARRAY_TYPE a[len], const _ARRAY_TYPE b[len])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    ARRAY_ASSERT_ALIGNED(b);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+    b = __builtin_assume_aligned(b, _SMART_ARRAY_ALIGN);
+
+    bool equal = true;
+
+    for (size_t i = 0; i < len; ++i) {
+        if (!_ARRAY_TYPE_EQ(a[i], b[i])) {
+            equal = false;
+            break;
+        }
+    }
+
+    return equal;
+}
+
+#ifndef _ARRAY_TYPE_COMPOUND
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) FN_ATTR_WARN_UNUSED_RESULT
+bool
+_ARRAY_FN(equal_with_tolerance)(size_t len,
+    const _ARRAY_TYPE a[len], const _ARRAY_TYPE b[len], _ARRAY_TYPE tolerance)
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    ARRAY_ASSERT_ALIGNED(b);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+    b = __builtin_assume_aligned(b, _SMART_ARRAY_ALIGN);
+
+    bool equal = true;
+
+    for (size_t i = 0; i < len; ++i) {
+        _ARRAY_TYPE abs_diff = (a[i] < b[i])? (b[i] - a[i]) : (a[i] - b[i]);
+        if (tolerance < abs_diff) {
+            equal = false;
+            break;
+        }
+    }
+
+    return equal;
+}
+#endif // _ARRAY_TYPE_COMPOUND
+
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(3, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(copy)(size_t len, const _ARRAY_TYPE src[len], _ARRAY_TYPE dst[len])
+{
+    ARRAY_ASSERT_ALIGNED(src);
+    ARRAY_ASSERT_ALIGNED(dst);
+    src = __builtin_assume_aligned(src, _SMART_ARRAY_ALIGN);
+    dst = __builtin_assume_aligned(dst, _SMART_ARRAY_ALIGN);
+
+    for (size_t i = 0; i < len; ++i) {
+        dst[i] = src[i];
+    }
+
+    return dst;
+}
+
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(3, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(memcopy)(size_t len, const _ARRAY_TYPE src[len], _ARRAY_TYPE dst[len])
+{
+    ARRAY_ASSERT_ALIGNED(src);
+    ARRAY_ASSERT_ALIGNED(dst);
+    src = __builtin_assume_aligned(src, _SMART_ARRAY_ALIGN);
+    dst = __builtin_assume_aligned(dst, _SMART_ARRAY_ALIGN);
+
+    return (_ARRAY_TYPE*) __builtin_memcpy(dst, src, len * sizeof(dst[0]));
+}
+
+static inline
+_ARRAY_WO(2, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(fill)(size_t len, _ARRAY_TYPE a[len], _ARRAY_TYPE val)
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    for (size_t i = 0; i < len; ++i) {
+        a[i] = val;
+    }
+
+    return a;
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(fill)(_SMART_ARRAY_T* a, _ARRAY_TYPE val)
+{
+    return _ARRAY_FN(fill)(a->len, a->data, val);
+}
+
+/** Insertion sort of a part of array, does not assume alignment.
+ *
+ */
+static inline
+_ARRAY_RW(2, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(insertion_sort_part)(size_t len, _ARRAY_TYPE a[len])
+{
+    size_t j;
+    _ARRAY_TYPE key;
+
+    for (size_t i = 1; i < len; ++i) {
+        key = a[i];
+        j = i;
+ 
+        /* Shift elements of a[0..i-1], that are GT key, to one position right */
+        while (j > 0 && _ARRAY_TYPE_LT(key, a[j - 1])) {
+            a[j] = a[j - 1];
+            --j;
+        }
+        a[j] = key;
+    }
+
+    return a;
+}
+
+static inline
+_ARRAY_RW(2, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(insertion_sort)(size_t len, _ARRAY_TYPE a[len])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    return _ARRAY_FN(insertion_sort_part)(len, a);
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(insertion_sort)(_SMART_ARRAY_T* a)
+{
+    return _ARRAY_FN(insertion_sort)(a->len, a->data);
+}
+
+static inline
+__attribute__((nonnull(1, 2)))
+void
+_ARRAY_FN(swap_two_pointers)(_ARRAY_TYPE* a, _ARRAY_TYPE* b)
+{
+    _ARRAY_TYPE tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+static inline
+_ARRAY_RW(2, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(bubble_sort)(size_t len, _ARRAY_TYPE a[len])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    _ARRAY_TYPE tmp;
+    bool swapped;
+    for (size_t step = 0; step < len - 1; ++step) {
+        swapped = false;
+        for (size_t i = 0; i < len - step - 1; ++i) {
+            if (_ARRAY_TYPE_LT(a[i + 1], a[i]) ) {
+                //_ARRAY_FN(swap_two_pointers)(&a[i], &a[i + 1]);
+                tmp = a[i+1]; a[i+1] = a[i]; a[i] = tmp;
+                swapped = true;
+            }
+        }
+    
+        // no swapping means the array is already sorted
+        if (!swapped) {
+            break;
+        }
+    }
+
+    return a;
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(bubble_sort)(_SMART_ARRAY_T* a)
+{
+    return _ARRAY_FN(bubble_sort)(a->len, a->data);
+}
+
+static inline
+FN_ATTR_WARN_UNUSED_RESULT
+int
+_ARRAY_FN(qsort_compare)(const void *restrict pa, const void *restrict pb)
+{
+    _ARRAY_TYPE a = *((_ARRAY_TYPE*)pa);
+    _ARRAY_TYPE b = *((_ARRAY_TYPE*)pb);
+
+    // (a-b) does not work for unsigned types
+    return _ARRAY_TYPE_LT(a, b)? -1 : (_ARRAY_TYPE_LT(b, a)? 1 : 0);
+}
+
+static inline
+_ARRAY_RW(2, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(qsort)(size_t len, _ARRAY_TYPE a[len])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    qsort(a, len, sizeof(_ARRAY_TYPE), _ARRAY_FN(qsort_compare));
+
+    return a;
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(qsort)(_SMART_ARRAY_T* a)
+{
+    return _ARRAY_FN(qsort)(a->len, a->data);
+}
+
+// Longest array that `small_sort` sorts with a sorting network, at most 64.
+#ifndef SMARTARR_SMALL_SORT_MAX_LEN
+#define SMARTARR_SMALL_SORT_MAX_LEN 64
+#endif
+
+#if SMARTARR_SMALL_SORT_MAX_LEN > 64
+#error "SMARTARR_SMALL_SORT_MAX_LEN is longer than the largest sorting network"
+#endif
+
+#ifdef _ARRAY_SIMD
+/** Per lane minimum and maximum of two vectors, both are a permutation of the inputs.
+ *
+ */
+static inline
+__attribute__((always_inline, nonnull(3, 4)))
+void
+_ARRAY_FN(vec_minmax)(_ARRAY_VEC_T a, _ARRAY_VEC_T b, _ARRAY_VEC_T* min, _ARRAY_VEC_T* max)
+{
+    const _ARRAY_BITS_VEC_T lt = (_ARRAY_BITS_VEC_T)(a < b);
+    *min = _ARRAY_FN(vec_select)(lt, a, b);
+    *max = _ARRAY_FN(vec_select)(lt, b, a);
+}
+
+/** Sort `nr_vecs * _ARRAY_VEC_LANES` elements in vectors with bitonic network.
+ *
+ * `nr_vecs` is a power of 2 and a compile time constant, then the loops
+ * unroll, and the lane permutations and masks fold into constants.
+ * Compare-exchange of elements that are `j` apart is done on whole
+ * vectors when `j` is not less than the vector length, otherwise
+ * a vector is compared with its own lanes shuffled by `lane ^ j`.
+ */
+static inline
+__attribute__((always_inline, nonnull(2)))
+void
+_ARRAY_FN(bitonic_sort_vecs)(size_t nr_vecs, _ARRAY_VEC_T v[nr_vecs])
+{
+    constexpr size_t lanes = _ARRAY_VEC_LANES;
+    const size_t len = nr_vecs * lanes;
+    const _ARRAY_BITS_VEC_T iota = _ARRAY_FN(vec_iota)();
+
+    #pragma GCC unroll 8
+    for (size_t k = 2; k <= len; k *= 2) {
+        #pragma GCC unroll 8
+        for (size_t j = k / 2; j > 0; j /= 2) {
+            if (j >= lanes) {
+                const size_t jv = j / lanes;
+                #pragma GCC unroll 64
+                for (size_t r = 0; r < nr_vecs / 2; ++r) {
+                    // r-th pair of vectors that are jv apart
+                    const size_t lo = (r / jv) * 2 * jv + r % jv;
+                    _ARRAY_VEC_T mn, mx;
+                    _ARRAY_FN(vec_minmax)(v[lo], v[lo + jv], &mn, &mx);
+                    const bool up = ((lo * lanes) & k) == 0;
+                    v[lo] = up? mn : mx;
+                    v[lo + jv] = up? mx : mn;
+                }
+            } else {
+                const _ARRAY_BITS_VEC_T partner = iota ^ (_ARRAY_BITS_T)j;
+                const _ARRAY_BITS_VEC_T low = (_ARRAY_BITS_VEC_T)((iota & (_ARRAY_BITS_T)j) == 0);
+                #pragma GCC unroll 64
+                for (size_t r = 0; r < nr_vecs; ++r) {
+                    const _ARRAY_BITS_VEC_T pos = iota + (_ARRAY_BITS_T)(r * lanes);
+                    const _ARRAY_BITS_VEC_T up = (_ARRAY_BITS_VEC_T)((pos & (_ARRAY_BITS_T)k) == 0);
+                    _ARRAY_VEC_T mn, mx;
+                    _ARRAY_FN(vec_minmax)(v[r], __builtin_shuffle(v[r], partner), &mn, &mx);
+                    v[r] = _ARRAY_FN(vec_select)(~(low ^ up), mn, mx);
+                }
+            }
+        }
+    }
+}
+
+/** Sort up to 64 elements with sorting network of `nr_vecs` vectors.
+ *
+ * Elements are padded with the largest value of the type.
+ */
+static inline
+__attribute__((always_inline)) _ARRAY_RW(2, 1)
+void
+_ARRAY_FN(network_sort)(size_t len, _ARRAY_TYPE a[len], size_t nr_vecs)
+{
+    constexpr size_t lanes = _ARRAY_VEC_LANES;
+    const _ARRAY_TYPE pad = _ARRAY_TYPE_IS_FLOAT? (_ARRAY_TYPE)__builtin_inf() :
+        (_ARRAY_TYPE)(_ARRAY_TYPE_IS_SIGNED? (_ARRAY_BITS_T)-1 >> 1 : (_ARRAY_BITS_T)-1);
+
+    // sized for the largest network, padding may go past `SMARTARR_SMALL_SORT_MAX_LEN`
+    _ARRAY_TYPE buf[64] __attribute__((aligned(SMARTARR_SIMD_VLEN)));
+    _ARRAY_VEC_T v[64 / _ARRAY_VEC_LANES];
+
+    #pragma GCC unroll 64
+    for (size_t i = 0; i < nr_vecs * lanes; ++i) {
+        buf[i] = pad;
+    }
+    __builtin_memcpy(buf, a, len * sizeof(_ARRAY_TYPE));
+
+    #pragma GCC unroll 64
+    for (size_t r = 0; r < nr_vecs; ++r) {
+        v[r] = _ARRAY_FN(vec_load)(&buf[r * lanes]);
+    }
+
+    _ARRAY_FN(bitonic_sort_vecs)(nr_vecs, v);
+
+    #pragma GCC unroll 64
+    for (size_t r = 0; r < nr_vecs; ++r) {
+        *(_ARRAY_VEC_T*)&buf[r * lanes] = v[r];
+    }
+    __builtin_memcpy(a, buf, len * sizeof(_ARRAY_TYPE));
+}
+#endif // _ARRAY_SIMD
+
+/** Sort short array with SIMD sorting network, does not assume alignment.
+ *
+ * Arrays of up to `SMARTARR_SMALL_SORT_MAX_LEN` elements are padded
+ * to 8, 16, 32 or 64 elements, or at least one vector, and sorted with
+ * bitonic network of vector min/max and lane shuffles, no branches
+ * depend on the data. Longer arrays, arrays with NaN and element types
+ * without SIMD are sorted with insertion sort.
+ *
+ * Example:
+ * ```
+ * float group[13] = {...};
+ * f32_array_small_sort(13, group);
+ * ```
+ */
+static inline
+_ARRAY_RW(2, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(small_sort)(size_t len, _ARRAY_TYPE a[len])
+{
+#ifdef _ARRAY_SIMD
+    constexpr size_t lanes = _ARRAY_VEC_LANES;
+
+    if (len < 2 || len > SMARTARR_SMALL_SORT_MAX_LEN) {
+        return _ARRAY_FN(insertion_sort_part)(len, a);
+    }
+
+    if (_ARRAY_TYPE_IS_FLOAT) {
+        // NaN is not ordered, padding could go before it
+        bool nan = false;
+        for (size_t i = 0; i < len; ++i) {
+            nan |= _ARRAY_IS_NAN(a[i]);
+        }
+        if (nan) {
+            return _ARRAY_FN(insertion_sort_part)(len, a);
+        }
+    }
+
+    if (len <= 8 && lanes <= 8) {
+        _ARRAY_FN(network_sort)(len, a, 8 / lanes);
+    } else if (len <= 16 && lanes <= 16) {
+        _ARRAY_FN(network_sort)(len, a, 16 / lanes);
+    } else if (len <= 32 && lanes <= 32) {
+        _ARRAY_FN(network_sort)(len, a, 32 / lanes);
+    } else {
+        _ARRAY_FN(network_sort)(len, a, 64 / lanes);
+    }
+
+    return a;
+#else
+    return _ARRAY_FN(insertion_sort_part)(len, a);
+#endif
+}
+
+// Partitions shorter than this are sorted with `small_sort` by `sort`.
+#ifndef SMARTARR_SORT_INSERTION_LEN
+#define SMARTARR_SORT_INSERTION_LEN 32
+#endif
+
+// Partitions longer than this take pivot as median of 3 medians of 3.
+#ifndef SMARTARR_SORT_NINTHER_LEN
+#define SMARTARR_SORT_NINTHER_LEN 128
+#endif
+
+// Sorted input is detected by insertion sort that gives up after this many moves.
+#ifndef SMARTARR_SORT_PARTIAL_INSERTION_LIMIT
+#define SMARTARR_SORT_PARTIAL_INSERTION_LIMIT 8
+#endif
+
+/** Order two elements, branchless, return true if they were swapped.
+ *
+ */
+static inline
+__attribute__((nonnull(1, 2)))
+bool
+_ARRAY_FN(sort2)(_ARRAY_TYPE* a, _ARRAY_TYPE* b)
+{
+    const _ARRAY_TYPE x = *a, y = *b;
+    const bool swap = _ARRAY_TYPE_LT(y, x);
+    *a = swap? y : x;
+    *b = swap? x : y;
+    return swap;
+}
+
+/** Order three elements, median ends up in `b`, return true if any swapped.
+ *
+ */
+static inline
+__attribute__((nonnull(1, 2, 3)))
+bool
+_ARRAY_FN(sort3)(_ARRAY_TYPE* a, _ARRAY_TYPE* b, _ARRAY_TYPE* c)
+{
+    bool swapped = _ARRAY_FN(sort2)(a, b);
+    swapped |= _ARRAY_FN(sort2)(b, c);
+    swapped |= _ARRAY_FN(sort2)(a, b);
+    return swapped;
+}
+
+/** Insertion sort that gives up after `SMARTARR_SORT_PARTIAL_INSERTION_LIMIT` moves.
+ *
+ * Return true if array got sorted.
+ */
+static inline
+_ARRAY_RW(2, 1)
+bool
+_ARRAY_FN(partial_insertion_sort)(size_t len, _ARRAY_TYPE a[len])
+{
+    size_t moves = 0;
+
+    for (size_t i = 1; i < len; ++i) {
+        if (_ARRAY_TYPE_LT(a[i], a[i - 1])) {
+            const _ARRAY_TYPE key = a[i];
+            size_t j = i;
+            do {
+                a[j] = a[j - 1];
+                --j;
+            } while (j > 0 && _ARRAY_TYPE_LT(key, a[j - 1]));
+            a[j] = key;
+            moves += i - j;
+            if (moves > SMARTARR_SORT_PARTIAL_INSERTION_LIMIT) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static inline
+_ARRAY_RW(3, 1)
+void
+_ARRAY_FN(heap_sift_down)(size_t len, size_t root, _ARRAY_TYPE a[len])
+{
+    const _ARRAY_TYPE x = a[root];
+    size_t child;
+
+    while ((child = 2 * root + 1) < len) {
+        if (child + 1 < len && _ARRAY_TYPE_LT(a[child], a[child + 1])) {
+            ++child;
+        }
+        if (!_ARRAY_TYPE_LT(x, a[child])) {
+            break;
+        }
+        a[root] = a[child];
+        root = child;
+    }
+    a[root] = x;
+}
+
+/** Sort array with heapsort, O(n log(n)) for any input.
+ *
+ */
+static inline
+_ARRAY_RW(2, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(heap_sort)(size_t len, _ARRAY_TYPE a[len])
+{
+    for (size_t i = len / 2; i-- > 0;) {
+        _ARRAY_FN(heap_sift_down)(len, i, a);
+    }
+    for (size_t n = len; n-- > 1;) {
+        _ARRAY_FN(swap_two_pointers)(&a[0], &a[n]);
+        _ARRAY_FN(heap_sift_down)(n, 0, a);
+    }
+
+    return a;
+}
+
+/** Partition around pivot `a[0]`, return final position of the pivot.
+ *
+ * Elements less than the pivot go left, or not greater than the pivot
+ * if `equal_left` is set. Every element is swapped with the first element
+ * of the right part unconditionally and the boundary moves by the result
+ * of comparison, so there is no branch to mispredict.
+ */
+static inline
+_ARRAY_RW(2, 1)
+size_t
+_ARRAY_FN(partition)(size_t len, _ARRAY_TYPE a[len], bool equal_left)
+{
+    const _ARRAY_TYPE pivot = a[0];
+    size_t left = 1;
+
+    if (equal_left) {
+        for (size_t i = 1; i < len; ++i) {
+            const _ARRAY_TYPE x = a[i];
+            const bool go_left = !_ARRAY_TYPE_LT(pivot, x);
+            a[i] = a[left];
+            a[left] = x;
+            left += go_left;
+        }
+    } else {
+        for (size_t i = 1; i < len; ++i) {
+            const _ARRAY_TYPE x = a[i];
+            const bool go_left = _ARRAY_TYPE_LT(x, pivot);
+            a[i] = a[left];
+            a[left] = x;
+            left += go_left;
+        }
+    }
+
+    a[0] = a[left - 1];
+    a[left - 1] = pivot;
+
+    return left - 1;
+}
+
+/** Put median of 3, or of 3 medians of 3 for long arrays, to `a[len / 2]`.
+ *
+ * Return true if the sampled elements were already in order.
+ */
+static inline
+_ARRAY_RW(2, 1)
+bool
+_ARRAY_FN(choose_pivot)(size_t len, _ARRAY_TYPE a[len])
+{
+    const size_t mid = len / 2;
+    bool swapped;
+
+    if (len > SMARTARR_SORT_NINTHER_LEN) {
+        swapped = _ARRAY_FN(sort3)(&a[0], &a[mid], &a[len - 1]);
+        swapped |= _ARRAY_FN(sort3)(&a[1], &a[mid - 1], &a[len - 2]);
+        swapped |= _ARRAY_FN(sort3)(&a[2], &a[mid + 1], &a[len - 3]);
+        swapped |= _ARRAY_FN(sort3)(&a[mid - 1], &a[mid], &a[mid + 1]);
+    } else {
+        swapped = _ARRAY_FN(sort3)(&a[0], &a[mid], &a[len - 1]);
+    }
+
+    return !swapped;
+}
+
+static inline
+_ARRAY_RW(2, 1)
+void
+_ARRAY_FN(introsort_loop)(size_t len, _ARRAY_TYPE a[len], unsigned int depth, bool leftmost)
+{
+    while (len > SMARTARR_SORT_INSERTION_LEN) {
+        if (depth == 0) {
+            _ARRAY_FN(heap_sort)(len, a);
+            return;
+        }
+        --depth;
+
+        // samples in order hint that array may be already sorted
+        if (_ARRAY_FN(choose_pivot)(len, a) && _ARRAY_FN(partial_insertion_sort)(len, a)) {
+            return;
+        }
+        _ARRAY_FN(swap_two_pointers)(&a[0], &a[len / 2]);
+
+        // a[-1] is a previous pivot and it is not greater than any element here,
+        // if it is equal to the new pivot, then all elements equal to pivot
+        // are put to the left and are already in place
+        if (!leftmost && !_ARRAY_TYPE_LT(a[-1], a[0])) {
+            const size_t p = _ARRAY_FN(partition)(len, a, true);
+            a += p + 1;
+            len -= p + 1;
+            continue;
+        }
+
+        const size_t p = _ARRAY_FN(partition)(len, a, false);
+
+        // recurse into the smaller part, so the stack depth is O(log(n))
+        if (p < len - p - 1) {
+            _ARRAY_FN(introsort_loop)(p, a, depth, leftmost);
+            a += p + 1;
+            len -= p + 1;
+            leftmost = false;
+        } else {
+            _ARRAY_FN(introsort_loop)(len - p - 1, &a[p + 1], depth, false);
+            len = p;
+        }
+    }
+
+    _ARRAY_FN(small_sort)(len, a);
+}
+
+/** Sort array with introsort, comparisons are inlined `_ARRAY_TYPE_LT`.
+ *
+ * Quicksort with median of 3 or ninther pivot and branchless partition,
+ * partitions shorter than `SMARTARR_SORT_INSERTION_LEN` are finished
+ * with `small_sort`. When recursion gets deeper than 2*log2(len)
+ * heapsort takes over, so the worst case is O(n log(n)). Runs of elements
+ * equal to a previous pivot are split off in linear time, sorted
+ * and almost sorted partitions are finished by insertion sort.
+ * Not stable, works for any element type including structs.
+ *
+ * Example:
+ * ```
+ * i64_smart_array_sort(a);
+ * ```
+ */
+static inline
+_ARRAY_RW(2, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(sort)(size_t len, _ARRAY_TYPE a[len])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    const unsigned int depth = (len > 1)? 2 * (63 - __builtin_clzll(len)) : 0;
+    _ARRAY_FN(introsort_loop)(len, a, depth, true);
+
+    return a;
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(sort)(_SMART_ARRAY_T* a)
+{
+    return _ARRAY_FN(sort)(a->len, a->data);
+}
+
+/** Put the element that would be at position `n` after sorting to `a[n]`.
+ *
+ * Elements before `n` are not greater than `a[n]`, elements after it
+ * are not less, otherwise their order is unspecified. Introselect:
+ * quickselect with the same pivots and partition as `sort` goes
+ * into the part with `n` only, so it is O(n) on average, heapsort
+ * of the remaining part bounds the worst case by O(n log(n)).
+ * Runs of elements equal to a previous pivot are skipped in one pass.
+ * Return the value of `a[n]`, `n` must be less than `len`.
+ *
+ * Example:
+ * ```
+ * double p99 = f64_array_nth_element(len, a, len * 99 / 100);
+ * ```
+ */
+static inline
+_ARRAY_RW(2, 1)
+_ARRAY_TYPE
+_ARRAY_FN(nth_element)(size_t len, _ARRAY_TYPE a[len], size_t n)
+{
+    assert(n < len);
+
+    size_t lo = 0, hi = len;
+    unsigned int depth = (len > 1)? 2 * (63 - __builtin_clzll(len)) : 0;
+
+    while (hi - lo > SMARTARR_SORT_INSERTION_LEN) {
+        _ARRAY_TYPE* b = &a[lo];
+        const size_t m = hi - lo;
+        if (depth == 0) {
+            _ARRAY_FN(heap_sort)(m, b);
+            return a[n];
+        }
+        --depth;
+
+        _ARRAY_FN(choose_pivot)(m, b);
+        _ARRAY_FN(swap_two_pointers)(&b[0], &b[m / 2]);
+
+        // a[lo - 1] is not greater than any element here, if it is equal
+        // to the pivot, elements equal to the pivot go left and are final
+        if (lo > 0 && !_ARRAY_TYPE_LT(a[lo - 1], b[0])) {
+            const size_t p = lo + _ARRAY_FN(partition)(m, b, true);
+            if (n <= p) {
+                return a[n];
+            }
+            lo = p + 1;
+            continue;
+        }
+
+        const size_t p = lo + _ARRAY_FN(partition)(m, b, false);
+        if (p == n) {
+            return a[n];
+        }
+        if (n < p) {
+            hi = p;
+        } else {
+            lo = p + 1;
+        }
+    }
+
+    _ARRAY_FN(small_sort)(hi - lo, &a[lo]);
+
+    return a[n];
+}
+
+static inline
+__attribute__((nonnull(1)))
+_ARRAY_TYPE
+_SARRAY_FN(nth_element)(_SMART_ARRAY_T* a, size_t n)
+{
+    return _ARRAY_FN(nth_element)(a->len, a->data, n);
+}
+
+/** Sort the `k` smallest elements into `a[0..k)`, O(n + k log(k)).
+ *
+ * Order of the rest of the array is unspecified.
+ *
+ * Example:
+ * ```
+ * i64_smart_array_partial_sort(a, 100);
+ * ```
+ */
+static inline
+_ARRAY_RW(2, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(partial_sort)(size_t len, _ARRAY_TYPE a[len], size_t k)
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    if (k >= len) {
+        return _ARRAY_FN(sort)(len, a);
+    }
+    if (k > 0) {
+        _ARRAY_FN(nth_element)(len, a, k);
+        _ARRAY_FN(sort)(k, a);
+    }
+
+    return a;
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(partial_sort)(_SMART_ARRAY_T* a, size_t k)
+{
+    return _ARRAY_FN(partial_sort)(a->len, a->data, k);
+}
+
+/** State of streaming top-k, the `k` largest elements seen so far.
+ *
+ * `heap` is a min-heap of `len` <= `k` elements provided by the caller,
+ * its root is the smallest element that is still in the top,
+ * so new element goes in only if it is greater than the root.
+ */
+typedef struct {
+    size_t k;
+    size_t len;
+    _ARRAY_TYPE* heap;
+} _ARRAY_TOPK_T;
+
+static inline
+__attribute__((nonnull(1)))
+void
+_ARRAY_FN(topk_init)(_ARRAY_TOPK_T* self, size_t k, _ARRAY_TYPE heap[k])
+{
+    *self = (_ARRAY_TOPK_T){.k = k, .len = 0, .heap = heap};
+}
+
+static inline
+_ARRAY_RW(3, 1)
+void
+_ARRAY_FN(topk_sift_down)(size_t len, size_t root, _ARRAY_TYPE a[len])
+{
+    const _ARRAY_TYPE x = a[root];
+    size_t child;
+
+    while ((child = 2 * root + 1) < len) {
+        if (child + 1 < len && _ARRAY_TYPE_LT(a[child + 1], a[child])) {
+            ++child;
+        }
+        if (!_ARRAY_TYPE_LT(a[child], x)) {
+            break;
+        }
+        a[root] = a[child];
+        root = child;
+    }
+    a[root] = x;
+}
+
+/** Add one element to the top-k.
+ *
+ */
+static inline
+__attribute__((nonnull(1)))
+void
+_ARRAY_FN(topk_push_one)(_ARRAY_TOPK_T* self, _ARRAY_TYPE x)
+{
+    _ARRAY_TYPE* heap = self->heap;
+
+    if (self->len < self->k) {
+        size_t i = self->len++;
+        while (i > 0 && _ARRAY_TYPE_LT(x, heap[(i - 1) / 2])) {
+            heap[i] = heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        heap[i] = x;
+    } else if (self->k > 0 && _ARRAY_TYPE_LT(heap[0], x)) {
+        heap[0] = x;
+        _ARRAY_FN(topk_sift_down)(self->len, 0, heap);
+    }
+}
+
+/** Add elements of a chunk of data to the top-k.
+ *
+ * Once the heap is full, blocks of 64 elements are compared with
+ * the root with SIMD and only the elements greater than the root
+ * go to the heap. For random data that is about `k * ln(n / k)` elements,
+ * so for `k` much less than `n` the pass runs at the speed of the scan.
+ *
+ * Example:
+ * ```
+ * i64_topk_t top;
+ * i64_array_topk_init(&top, 100, heap);
+ * i64_array_topk_push(&top, chunk_len, chunk1);
+ * i64_array_topk_push(&top, chunk_len, chunk2);
+ * size_t n = i64_array_topk_finish(&top); // heap[0] is the largest
+ * ```
+ */
+static inline
+_ARRAY_RO(3, 2) __attribute__((nonnull(1)))
+void
+_ARRAY_FN(topk_push)(_ARRAY_TOPK_T* self, size_t len, const _ARRAY_TYPE a[len])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    size_t i = 0;
+
+    for (; i < len && self->len < self->k; ++i) {
+        _ARRAY_FN(topk_push_one)(self, a[i]);
+    }
+
+#ifdef _ARRAY_SIMD
+    if (self->k > 0) {
+        constexpr size_t lanes = _ARRAY_VEC_LANES;
+
+        for (; i < len && i % 64 != 0; ++i) {
+            _ARRAY_FN(topk_push_one)(self, a[i]);
+        }
+
+        for (; i + 64 <= len; i += 64) {
+            const _ARRAY_VEC_T thr = (_ARRAY_VEC_T){} + self->heap[0];
+            uint64_t mask = 0;
+            #pragma GCC unroll 16
+            for (size_t j = 0; j < 64; j += lanes) {
+                const _ARRAY_VEC_T v = _ARRAY_FN(vec_load)(&a[i + j]);
+                mask |= simd_movemask_lanes((simd_i8_t)(v > thr), sizeof(_ARRAY_TYPE)) << j;
+            }
+            // root only grows, so some of these may be rejected by push_one
+            for_each_bit(mask, pos) {
+                _ARRAY_FN(topk_push_one)(self, a[i + pos]);
+            }
+        }
+    }
+#endif
+
+    for (; i < len; ++i) {
+        _ARRAY_FN(topk_push_one)(self, a[i]);
+    }
+}
+
+/** Add elements of another top-k, for example of another thread.
+ *
+ */
+static inline
+__attribute__((nonnull(1, 2)))
+void
+_ARRAY_FN(topk_merge)(_ARRAY_TOPK_T* self, const _ARRAY_TOPK_T* other)
+{
+    for (size_t i = 0; i < other->len; ++i) {
+        _ARRAY_FN(topk_push_one)(self, other->heap[i]);
+    }
+}
+
+/** Sort the heap from the largest to the smallest, return number of elements.
+ *
+ * State must not be used after it.
+ */
+static inline
+__attribute__((nonnull(1)))
+size_t
+_ARRAY_FN(topk_finish)(_ARRAY_TOPK_T* self)
+{
+    // min-heap sort: the smallest goes to the end
+    for (size_t n = self->len; n-- > 1;) {
+        _ARRAY_FN(swap_two_pointers)(&self->heap[0], &self->heap[n]);
+        _ARRAY_FN(topk_sift_down)(n, 0, self->heap);
+    }
+
+    return self->len;
+}
+
+/** Write the `k` largest elements to `out` from the largest, return their number.
+ *
+ * One streaming pass over the array, see `topk_push`,
+ * less than `k` elements are written if the array is shorter.
+ *
+ * Example:
+ * ```
+ * double top[100];
+ * size_t n = f64_smart_array_topk(a, 100, top);
+ * ```
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(4, 3)
+size_t
+_ARRAY_FN(topk)(size_t len, const _ARRAY_TYPE a[len], size_t k, _ARRAY_TYPE out[k])
+{
+    _ARRAY_TOPK_T top;
+    _ARRAY_FN(topk_init)(&top, k, out);
+    _ARRAY_FN(topk_push)(&top, len, a);
+
+    return _ARRAY_FN(topk_finish)(&top);
+}
+
+static inline
+__attribute__((nonnull(1, 3)))
+size_t
+_SARRAY_FN(topk)(const _SMART_ARRAY_T* a, size_t k, _ARRAY_TYPE out[k])
+{
+    return _ARRAY_FN(topk)(a->len, a->data, k, out);
+}
+
+/** Return position of the first element that is less than the previous one.
+ *
+ * Return `len` if the array is sorted by `_ARRAY_TYPE_LT`.
+ * Blocks of 64 elements are compared with the same block shifted
+ * by one element with SIMD, so the check runs at memory speed.
+ *
+ * Example:
+ * ```
+ * if (i64_smart_array_is_sorted_until(a) != a->len) i64_smart_array_sort(a);
+ * ```
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT FN_ATTR_PURE
+size_t
+_ARRAY_FN(is_sorted_until)(size_t len, const _ARRAY_TYPE a[len])
+{
+    size_t i = 1;
+
+#ifdef _ARRAY_SIMD
+    constexpr size_t lanes = _ARRAY_VEC_LANES;
+
+    for (; i + 64 <= len; i += 64) {
+        uint64_t mask = 0;
+        #pragma GCC unroll 16
+        for (size_t j = 0; j < 64; j += lanes) {
+            const _ARRAY_VEC_T v = _ARRAY_FN(vec_load_unaligned)(&a[i + j]);
+            const _ARRAY_VEC_T prev = _ARRAY_FN(vec_load_unaligned)(&a[i + j - 1]);
+            mask |= simd_movemask_lanes((simd_i8_t)(v < prev), sizeof(_ARRAY_TYPE)) << j;
+        }
+        if (mask) {
+            return i + ctz(mask);
+        }
+    }
+#endif
+
+    for (; i < len; ++i) {
+        if (_ARRAY_TYPE_LT(a[i], a[i - 1])) {
+            return i;
+        }
+    }
+
+    return len;
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT FN_ATTR_PURE
+size_t
+_SARRAY_FN(is_sorted_until)(const _SMART_ARRAY_T* a)
+{
+    return _ARRAY_FN(is_sorted_until)(a->len, a->data);
+}
+
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT FN_ATTR_PURE
+bool
+_ARRAY_FN(is_sorted)(size_t len, const _ARRAY_TYPE a[len])
+{
+    return _ARRAY_FN(is_sorted_until)(len, a) >= len;
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT FN_ATTR_PURE
+bool
+_SARRAY_FN(is_sorted)(const _SMART_ARRAY_T* a)
+{
+    return _ARRAY_FN(is_sorted)(a->len, a->data);
+}
+
+// Merge switches to galloping after this many elements in a row from one run.
+#ifndef SMARTARR_STABLE_SORT_MIN_GALLOP
+#define SMARTARR_STABLE_SORT_MIN_GALLOP 7
+#endif
+
+// Maximum number of pending runs, run lengths grow at least as Fibonacci numbers.
+#define _ARRAY_STABLE_SORT_MAX_RUNS 96
+
+/** Return number of leading elements that are not greater than the key.
+ *
+ * Exponential search from the start, then binary search, so it is
+ * O(log(result)) and cheap when the key is near the start.
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_PURE
+size_t
+_ARRAY_FN(gallop_upper)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE key)
+{
+    size_t lo = 0, hi = 1;
+
+    while (hi < len && !_ARRAY_TYPE_LT(key, a[hi - 1])) {
+        lo = hi;
+        hi = 2 * hi + 1;
+    }
+    hi = (hi < len)? hi : len;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (!_ARRAY_TYPE_LT(key, a[mid])) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/** Return number of leading elements that are less than the key.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_PURE
+size_t
+_ARRAY_FN(gallop_lower)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE key)
+{
+    size_t lo = 0, hi = 1;
+
+    while (hi < len && _ARRAY_TYPE_LT(a[hi - 1], key)) {
+        lo = hi;
+        hi = 2 * hi + 1;
+    }
+    hi = (hi < len)? hi : len;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (_ARRAY_TYPE_LT(a[mid], key)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/** Stable merge of sorted `a[0..left_len)` and `a[left_len..len)`.
+ *
+ * Elements of the left run that are already in place and elements of the
+ * right run that are already in place are found by galloping and
+ * not moved. The rest of the left run is copied to `scratch` and merged
+ * forward, when one run wins `SMARTARR_STABLE_SORT_MIN_GALLOP` times
+ * in a row merge gallops to find how many elements to copy at once.
+ */
+static inline
+_ARRAY_RW(3, 1)
+void
+_ARRAY_FN(merge_runs)(size_t len, size_t left_len, _ARRAY_TYPE a[len], _ARRAY_TYPE scratch[])
+{
+    constexpr size_t min_gallop = SMARTARR_STABLE_SORT_MIN_GALLOP;
+
+    const size_t skip = _ARRAY_FN(gallop_upper)(left_len, a, a[left_len]);
+    a += skip;
+    size_t n1 = left_len - skip;
+    if (n1 == 0) {
+        return;
+    }
+    size_t n2 = _ARRAY_FN(gallop_lower)(len - left_len, &a[n1], a[n1 - 1]);
+
+    _ARRAY_TYPE* left = scratch;
+    _ARRAY_TYPE* right = &a[n1];
+    __builtin_memcpy(left, a, n1 * sizeof(_ARRAY_TYPE));
+
+    // output a[i + j] is always before the unread right[j]
+    size_t i = 0, j = 0;
+    while (i < n1 && j < n2) {
+        size_t left_wins = 0, right_wins = 0;
+        while (left_wins < min_gallop && right_wins < min_gallop) {
+            if (_ARRAY_TYPE_LT(right[j], left[i])) {
+                a[i + j] = right[j];
+                ++j;
+                ++right_wins;
+                left_wins = 0;
+                if (j == n2) break;
+            } else {
+                a[i + j] = left[i];
+                ++i;
+                ++left_wins;
+                right_wins = 0;
+                if (i == n1) break;
+            }
+        }
+
+        size_t c = 0, d = 0;
+        do {
+            if (i == n1 || j == n2) break;
+            c = _ARRAY_FN(gallop_upper)(n1 - i, &left[i], right[j]);
+            __builtin_memcpy(&a[i + j], &left[i], c * sizeof(_ARRAY_TYPE));
+            i += c;
+            if (i == n1) break;
+            a[i + j] = right[j];
+            ++j;
+            if (j == n2) break;
+            d = _ARRAY_FN(gallop_lower)(n2 - j, &right[j], left[i]);
+            __builtin_memmove(&a[i + j], &right[j], d * sizeof(_ARRAY_TYPE));
+            j += d;
+            if (j == n2) break;
+            a[i + j] = left[i];
+            ++i;
+        } while (c >= min_gallop || d >= min_gallop);
+    }
+
+    // rest of the right run is already in place
+    __builtin_memcpy(&a[i + j], &left[i], (n1 - i) * sizeof(_ARRAY_TYPE));
+}
+
+/** Sort `a[start..len)` into sorted `a[0..start)` with binary insertion, stable.
+ *
+ */
+static inline
+_ARRAY_RW(2, 1)
+void
+_ARRAY_FN(binary_insertion_sort)(size_t len, _ARRAY_TYPE a[len], size_t start)
+{
+    for (size_t i = (start > 0)? start : 1; i < len; ++i) {
+        const _ARRAY_TYPE key = a[i];
+        size_t lo = 0, hi = i;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (_ARRAY_TYPE_LT(key, a[mid])) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        __builtin_memmove(&a[lo + 1], &a[lo], (i - lo) * sizeof(_ARRAY_TYPE));
+        a[lo] = key;
+    }
+}
+
+/** Merge pending runs `m` and `m + 1` of `stable_sort` and remove run `m + 1`.
+ *
+ */
+static inline
+__attribute__((nonnull(1, 2, 3, 4, 6)))
+void
+_ARRAY_FN(merge_pending_runs)(_ARRAY_TYPE a[], size_t run_start[], size_t run_len[],
+    size_t* nr_runs, size_t m, _ARRAY_TYPE scratch[])
+{
+    _ARRAY_FN(merge_runs)(run_len[m] + run_len[m + 1], run_len[m], &a[run_start[m]], scratch);
+    run_len[m] += run_len[m + 1];
+    for (size_t r = m + 1; r + 1 < *nr_runs; ++r) {
+        run_start[r] = run_start[r + 1];
+        run_len[r] = run_len[r + 1];
+    }
+    --(*nr_runs);
+}
+
+/** Stable adaptive merge sort, `scratch` must have at least `len` elements.
+ *
+ * Timsort: array is split into natural runs, strictly descending runs
+ * are reversed, runs shorter than 32..64 elements are extended with
+ * binary insertion sort. Runs are merged with galloping while their
+ * lengths on the stack keep the timsort invariants. Sorted array costs
+ * one SIMD pass of `is_sorted_until`, array with few out-of-order
+ * tails costs little more than merging the tails in.
+ *
+ * Example:
+ * ```
+ * auto_free i64_smart_array_t* scratch = i64_smart_array_heap_new(a->len);
+ * i64_smart_array_stable_sort(a, scratch);
+ * ```
+ */
+static inline
+_ARRAY_RW(2, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(stable_sort)(size_t len, _ARRAY_TYPE a[len], _ARRAY_TYPE scratch[])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    if (_ARRAY_FN(is_sorted_until)(len, a) == len) {
+        return a;
+    }
+
+    size_t min_run = len, odd = 0;
+    while (min_run >= 64) {
+        odd |= min_run & 1;
+        min_run >>= 1;
+    }
+    min_run += odd;
+
+    size_t run_start[_ARRAY_STABLE_SORT_MAX_RUNS];
+    size_t run_len[_ARRAY_STABLE_SORT_MAX_RUNS];
+    size_t nr_runs = 0;
+
+    for (size_t i = 0; i < len;) {
+        size_t j = i + 1;
+        if (j < len && _ARRAY_TYPE_LT(a[j], a[i])) {
+            while (j + 1 < len && _ARRAY_TYPE_LT(a[j + 1], a[j])) ++j;
+            ++j;
+            for (size_t l = i, r = j - 1; l < r; ++l, --r) {
+                _ARRAY_FN(swap_two_pointers)(&a[l], &a[r]);
+            }
+        } else {
+            while (j < len && !_ARRAY_TYPE_LT(a[j], a[j - 1])) ++j;
+        }
+
+        if (j - i < min_run) {
+            const size_t end = (len - i < min_run)? len : i + min_run;
+            _ARRAY_FN(binary_insertion_sort)(end - i, &a[i], j - i);
+            j = end;
+        }
+
+        run_start[nr_runs] = i;
+        run_len[nr_runs] = j - i;
+        ++nr_runs;
+        i = j;
+
+        // merge while the last 3 runs break: X > Y + Z and Y > Z,
+        // checked 4 deep to keep the invariant on the whole stack
+        while (nr_runs > 1) {
+            size_t m = nr_runs - 2;
+            const size_t* n = run_len;
+            if ((m > 0 && n[m - 1] <= n[m] + n[m + 1]) ||
+                (m > 1 && n[m - 2] <= n[m - 1] + n[m]))
+            {
+                if (n[m - 1] < n[m + 1]) --m;
+            } else if (n[m] > n[m + 1]) {
+                break;
+            }
+            _ARRAY_FN(merge_pending_runs)(a, run_start, run_len, &nr_runs, m, scratch);
+        }
+    }
+
+    while (nr_runs > 1) {
+        size_t m = nr_runs - 2;
+        if (m > 0 && run_len[m - 1] < run_len[m + 1]) --m;
+        _ARRAY_FN(merge_pending_runs)(a, run_start, run_len, &nr_runs, m, scratch);
+    }
+
+    return a;
+}
+
+static inline
+__attribute__((nonnull(1, 2))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(stable_sort)(_SMART_ARRAY_T* a, _SMART_ARRAY_T* scratch)
+{
+    assert(scratch->len >= a->len);
+    return _ARRAY_FN(stable_sort)(a->len, a->data, scratch->data);
+}
+
+// Arrays shorter than this are sorted by insertion sort of the same keys by radix sort.
+#ifndef SMARTARR_RADIX_SORT_MIN_LEN
+#define SMARTARR_RADIX_SORT_MIN_LEN 64
+#endif
+
+#ifndef _ARRAY_TYPE_COMPOUND
+/** Stable insertion sort by `sortable_key`, short arrays of `radix_sort`.
+ *
+ */
+static inline
+_ARRAY_RW(2, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(key_insertion_sort)(size_t len, _ARRAY_TYPE a[len])
+{
+    for (size_t i = 1; i < len; ++i) {
+        const _ARRAY_TYPE x = a[i];
+        const _ARRAY_BITS_T key = _ARRAY_FN(sortable_key)(x);
+        size_t j = i;
+        while (j > 0 && key < _ARRAY_FN(sortable_key)(a[j - 1])) {
+            a[j] = a[j - 1];
+            --j;
+        }
+        a[j] = x;
+    }
+
+    return a;
+}
+
+/** Sort array with LSD radix sort, `scratch` must have at least `len` elements.
+ *
+ * Elements are sorted by 8-bit digits of `sortable_key`, from the lowest
+ * digit to the highest, every pass is a stable counting sort from one
+ * buffer to the other. Histograms of all digits are built in one pass
+ * over the array, digits that are the same for all elements are skipped.
+ * Sorted array ends up in `a`, no memory is allocated.
+ * Order is the same as with built-in `<` even if `_ARRAY_TYPE_LT` is custom,
+ * NaNs go to the ends of the array: after +inf, or before -inf if their
+ * sign bit is set. Arrays shorter than `SMARTARR_RADIX_SORT_MIN_LEN`
+ * are sorted by insertion sort of the same keys, in the same order.
+ *
+ * Example:
+ * ```
+ * auto_free f64_smart_array_t* scratch = f64_smart_array_heap_new(a->len);
+ * f64_smart_array_radix_sort(a, scratch);
+ * ```
+ */
+static inline
+_ARRAY_RW(2, 1) _ARRAY_RW(3, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(radix_sort)(size_t len, _ARRAY_TYPE a[len], _ARRAY_TYPE scratch[len])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    ARRAY_ASSERT_ALIGNED(scratch);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+    scratch = __builtin_assume_aligned(scratch, _SMART_ARRAY_ALIGN);
+
+    if (len < SMARTARR_RADIX_SORT_MIN_LEN) {
+        return _ARRAY_FN(key_insertion_sort)(len, a);
+    }
+
+    constexpr size_t nr_digits = sizeof(_ARRAY_TYPE);
+    size_t hist[nr_digits][256];
+    __builtin_memset(hist, 0, sizeof(hist));
+
+    for (size_t i = 0; i < len; ++i) {
+        const _ARRAY_BITS_T key = _ARRAY_FN(sortable_key)(a[i]);
+        #pragma GCC unroll 8
+        for (size_t d = 0; d < nr_digits; ++d) {
+            ++hist[d][(key >> (8 * d)) & 0xff];
+        }
+    }
+
+    const _ARRAY_BITS_T first_key = _ARRAY_FN(sortable_key)(a[0]);
+    _ARRAY_TYPE* src = a;
+    _ARRAY_TYPE* dst = scratch;
+
+    for (size_t d = 0; d < nr_digits; ++d) {
+        size_t* offset = hist[d];
+        if (offset[(first_key >> (8 * d)) & 0xff] == len) {
+            continue; // all elements have the same digit
+        }
+
+        size_t sum = 0;
+        for (size_t b = 0; b < 256; ++b) {
+            const size_t count = offset[b];
+            offset[b] = sum;
+            sum += count;
+        }
+
+        for (size_t i = 0; i < len; ++i) {
+            const _ARRAY_TYPE x = src[i];
+            dst[offset[(_ARRAY_FN(sortable_key)(x) >> (8 * d)) & 0xff]++] = x;
+        }
+
+        _ARRAY_TYPE* tmp = src; src = dst; dst = tmp;
+    }
+
+    if (src != a) {
+        __builtin_memcpy(a, src, len * sizeof(_ARRAY_TYPE));
+    }
+
+    return a;
+}
+
+static inline
+__attribute__((nonnull(1, 2))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(radix_sort)(_SMART_ARRAY_T* a, _SMART_ARRAY_T* scratch)
+{
+    assert(scratch->len >= a->len);
+    return _ARRAY_FN(radix_sort)(a->len, a->data, scratch->data);
+}
+#endif // _ARRAY_TYPE_COMPOUND
+
+// Runs of this length are sorted by insertion sort before merging.
+#ifndef SMARTARR_MERGE_SORT_RUN_LEN
+#define SMARTARR_MERGE_SORT_RUN_LEN 16
+#endif
+
+/** Stable merge sort of keys, `payload_size` bytes of payload move with every key.
+ *
+ * Bottom-up: runs are sorted by insertion sort, then pairs of runs are
+ * merged from one buffer to the other. `payload_size` can be 0,
+ * it is expected to be a compile time constant.
+ */
+static inline __attribute__((always_inline))
+_ARRAY_RW(2, 1)
+void
+_ARRAY_FN(merge_sort_payload)(size_t len, _ARRAY_TYPE keys[len],
+    size_t payload_size, char payload[],
+    _ARRAY_TYPE key_tmp[len], char payload_tmp[])
+{
+    constexpr size_t run_len = SMARTARR_MERGE_SORT_RUN_LEN;
+    const size_t ps = payload_size;
+    char el[ps + 1];
+
+    for (size_t r = 0; r < len; r += run_len) {
+        const size_t end = (len - r < run_len)? len : r + run_len;
+        for (size_t i = r + 1; i < end; ++i) {
+            const _ARRAY_TYPE key = keys[i];
+            size_t j = i;
+            if (!_ARRAY_TYPE_LT(key, keys[j - 1])) {
+                continue;
+            }
+            __builtin_memcpy(el, &payload[i * ps], ps);
+            do {
+                keys[j] = keys[j - 1];
+                __builtin_memcpy(&payload[j * ps], &payload[(j - 1) * ps], ps);
+                --j;
+            } while (j > r && _ARRAY_TYPE_LT(key, keys[j - 1]));
+            keys[j] = key;
+            __builtin_memcpy(&payload[j * ps], el, ps);
+        }
+    }
+
+    _ARRAY_TYPE* src = keys;
+    _ARRAY_TYPE* dst = key_tmp;
+    char* psrc = payload;
+    char* pdst = payload_tmp;
+
+    for (size_t width = run_len; width < len; width *= 2) {
+        for (size_t lo = 0; lo < len; lo += 2 * width) {
+            const size_t mid = (len - lo < width)? len : lo + width;
+            const size_t hi = (len - mid < width)? len : mid + width;
+            size_t i = lo, j = mid, k = lo;
+            while (i < mid && j < hi) {
+                // equal keys are taken from the left run first
+                const size_t from = _ARRAY_TYPE_LT(src[j], src[i])? j++ : i++;
+                dst[k] = src[from];
+                __builtin_memcpy(&pdst[k * ps], &psrc[from * ps], ps);
+                ++k;
+            }
+            __builtin_memcpy(&dst[k], &src[i], (mid - i) * sizeof(_ARRAY_TYPE));
+            __builtin_memcpy(&pdst[k * ps], &psrc[i * ps], (mid - i) * ps);
+            k += mid - i;
+            __builtin_memcpy(&dst[k], &src[j], (hi - j) * sizeof(_ARRAY_TYPE));
+            __builtin_memcpy(&pdst[k * ps], &psrc[j * ps], (hi - j) * ps);
+        }
+        _ARRAY_TYPE* t = src; src = dst; dst = t;
+        char* pt = psrc; psrc = pdst; pdst = pt;
+    }
+
+    if (src != keys) {
+        __builtin_memcpy(keys, src, len * sizeof(_ARRAY_TYPE));
+        __builtin_memcpy(payload, psrc, len * ps);
+    }
+}
+
+#ifndef _ARRAY_TYPE_COMPOUND
+/** LSD radix sort of keys, payload elements are moved in the same scatter passes.
+ *
+ * Same passes as `radix_sort`, so it is stable, `payload_size`
+ * is expected to be a compile time constant.
+ */
+static inline __attribute__((always_inline))
+_ARRAY_RW(2, 1)
+void
+_ARRAY_FN(radix_sort_payload)(size_t len, _ARRAY_TYPE keys[len],
+    size_t payload_size, char payload[],
+    _ARRAY_TYPE key_tmp[len], char payload_tmp[])
+{
+    const size_t ps = payload_size;
+    constexpr size_t nr_digits = sizeof(_ARRAY_TYPE);
+    size_t hist[nr_digits][256];
+    __builtin_memset(hist, 0, sizeof(hist));
+
+    for (size_t i = 0; i < len; ++i) {
+        const _ARRAY_BITS_T key = _ARRAY_FN(sortable_key)(keys[i]);
+        #pragma GCC unroll 8
+        for (size_t d = 0; d < nr_digits; ++d) {
+            ++hist[d][(key >> (8 * d)) & 0xff];
+        }
+    }
+
+    const _ARRAY_BITS_T first_key = _ARRAY_FN(sortable_key)(keys[0]);
+    _ARRAY_TYPE* src = keys;
+    _ARRAY_TYPE* dst = key_tmp;
+    char* psrc = payload;
+    char* pdst = payload_tmp;
+
+    for (size_t d = 0; d < nr_digits; ++d) {
+        size_t* offset = hist[d];
+        if (offset[(first_key >> (8 * d)) & 0xff] == len) {
+            continue; // all elements have the same digit
+        }
+
+        size_t sum = 0;
+        for (size_t b = 0; b < 256; ++b) {
+            const size_t count = offset[b];
+            offset[b] = sum;
+            sum += count;
+        }
+
+        for (size_t i = 0; i < len; ++i) {
+            const _ARRAY_TYPE x = src[i];
+            const size_t pos = offset[(_ARRAY_FN(sortable_key)(x) >> (8 * d)) & 0xff]++;
+            dst[pos] = x;
+            __builtin_memcpy(&pdst[pos * ps], &psrc[i * ps], ps);
+        }
+
+        _ARRAY_TYPE* t = src; src = dst; dst = t;
+        char* pt = psrc; psrc = pdst; pdst = pt;
+    }
+
+    if (src != keys) {
+        __builtin_memcpy(keys, src, len * sizeof(_ARRAY_TYPE));
+        __builtin_memcpy(payload, psrc, len * ps);
+    }
+}
+#endif // _ARRAY_TYPE_COMPOUND
+
+// Return false and leave keys and payload unchanged if buffers cannot be allocated.
+static inline __attribute__((always_inline))
+_ARRAY_RW(2, 1)
+bool
+_ARRAY_FN(sort_by_key_size)(size_t len, _ARRAY_TYPE keys[len],
+    size_t payload_size, char payload[])
+{
+    if (len < 2) {
+        return true;
+    }
+
+    auto_free _ARRAY_TYPE* key_tmp = malloc(len * sizeof(_ARRAY_TYPE));
+    auto_free char* payload_tmp = malloc(len * payload_size + 1);
+    if (key_tmp == NULL || payload_tmp == NULL) {
+        return false;
+    }
+
+#ifdef _ARRAY_NATIVE_ORDER
+    if (len >= SMARTARR_RADIX_SORT_MIN_LEN) {
+        _ARRAY_FN(radix_sort_payload)(len, keys, payload_size, payload, key_tmp, payload_tmp);
+        return true;
+    }
+#endif
+    _ARRAY_FN(merge_sort_payload)(len, keys, payload_size, payload, key_tmp, payload_tmp);
+    return true;
+}
+
+/** Stable sort of keys that moves payload elements together with their keys.
+ *
+ * `payload` has `len` elements of `payload_size` bytes, for example
+ * a sibling column of the table. Built-in types are sorted by LSD radix
+ * sort that carries payload in the same scatter passes, types with
+ * custom `_ARRAY_TYPE_LT` by merge sort. Temporary buffers are allocated,
+ * NULL is returned and nothing is moved if allocation fails.
+ *
+ * Example:
+ * ```
+ * // order rows of `price` by `time`
+ * i64_smart_array_sort_by_key(time, sizeof(double), price->data);
+ * ```
+ */
+static inline
+_ARRAY_RW(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_TYPE*
+_ARRAY_FN(sort_by_key)(size_t len, _ARRAY_TYPE keys[len],
+    size_t payload_size, void* payload)
+{
+    bool sorted;
+    // constant payload size lets the compiler inline the payload copies
+    switch (payload_size) {
+    case 4: sorted = _ARRAY_FN(sort_by_key_size)(len, keys, 4, payload); break;
+    case 8: sorted = _ARRAY_FN(sort_by_key_size)(len, keys, 8, payload); break;
+    default: sorted = _ARRAY_FN(sort_by_key_size)(len, keys, payload_size, payload); break;
+    }
+    return sorted? keys : NULL;
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_TYPE*
+_SARRAY_FN(sort_by_key)(_SMART_ARRAY_T* keys, size_t payload_size, void* payload)
+{
+    return _ARRAY_FN(sort_by_key)(keys->len, keys->data, payload_size, payload);
+}
+
+/** Write to `idx` the permutation that sorts the array, stable.
+ *
+ * `a[idx[0]], a[idx[1]], ...` is sorted, equal elements keep
+ * their order, array itself is not changed. Return NULL if
+ * temporary buffers cannot be allocated.
+ *
+ * Example:
+ * ```
+ * f64_array_argsort_u32(len, price, idx);
+ * i64_array_apply_permutation_u32(len, time, idx, time_by_price);
+ * ```
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(3, 1) FN_ATTR_WARN_UNUSED_RESULT
+uint32_t*
+_ARRAY_FN(argsort_u32)(size_t len, const _ARRAY_TYPE a[len], uint32_t idx[len])
+{
+    assert(len <= UINT32_MAX);
+
+    auto_free _ARRAY_TYPE* keys = malloc(len * sizeof(_ARRAY_TYPE) + 1);
+    if (keys == NULL) {
+        return NULL;
+    }
+    __builtin_memcpy(keys, a, len * sizeof(_ARRAY_TYPE));
+    for (size_t i = 0; i < len; ++i) {
+        idx[i] = i;
+    }
+
+    if (!_ARRAY_FN(sort_by_key_size)(len, keys, sizeof(uint32_t), (char*)idx)) {
+        return NULL;
+    }
+
+    return idx;
+}
+
+/** Write to `idx` the permutation that sorts the array, stable, 64-bit indices.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(3, 1) FN_ATTR_WARN_UNUSED_RESULT
+uint64_t*
+_ARRAY_FN(argsort_u64)(size_t len, const _ARRAY_TYPE a[len], uint64_t idx[len])
+{
+    auto_free _ARRAY_TYPE* keys = malloc(len * sizeof(_ARRAY_TYPE) + 1);
+    if (keys == NULL) {
+        return NULL;
+    }
+    __builtin_memcpy(keys, a, len * sizeof(_ARRAY_TYPE));
+    for (size_t i = 0; i < len; ++i) {
+        idx[i] = i;
+    }
+
+    if (!_ARRAY_FN(sort_by_key_size)(len, keys, sizeof(uint64_t), (char*)idx)) {
+        return NULL;
+    }
+
+    return idx;
+}
+
+static inline
+__attribute__((nonnull(1, 2))) FN_ATTR_WARN_UNUSED_RESULT
+uint32_t*
+_SARRAY_FN(argsort_u32)(const _SMART_ARRAY_T* a, uint32_t idx[])
+{
+    return _ARRAY_FN(argsort_u32)(a->len, a->data, idx);
+}
+
+static inline
+__attribute__((nonnull(1, 2))) FN_ATTR_WARN_UNUSED_RESULT
+uint64_t*
+_SARRAY_FN(argsort_u64)(const _SMART_ARRAY_T* a, uint64_t idx[])
+{
+    return _ARRAY_FN(argsort_u64)(a->len, a->data, idx);
+}
+
+// Distance in elements at which `gather` and `scatter` prefetch
+// `src[idx[i + dist]]` or `dst[idx[i + dist]]`, so many cache misses
+// are in flight at once instead of one per element.
+#ifndef SMARTARR_GATHER_PREFETCH_DIST
+#define SMARTARR_GATHER_PREFETCH_DIST 64
+#endif
+
+/** Gather 8 elements `dst[i] = src[idx[i]]`.
+ *
+ * With AVX2 4 and 8 byte elements are loaded by hardware gathers,
+ * 32-bit indices are zero extended unless all of them fit `int32_t`
+ * since gather instructions take signed indices.
+ */
+static inline __attribute__((always_inline))
+void
+_ARRAY_FN(gather8_u32)(const _ARRAY_TYPE* src, const uint32_t* idx, _ARRAY_TYPE* dst)
+{
+#if defined(__AVX2__) && !defined(_ARRAY_NO_SIMD)
+    if (sizeof(_ARRAY_TYPE) == 4 || sizeof(_ARRAY_TYPE) == 8) {
+        const __m256i ix = _mm256_loadu_si256((const __m256i*)idx);
+        if (sizeof(_ARRAY_TYPE) == 4 && !_mm256_movemask_ps(_mm256_castsi256_ps(ix))) {
+            _mm256_storeu_si256((__m256i*)dst, _mm256_i32gather_epi32((const int*)src, ix, 4));
+            return;
+        }
+        const __m256i lo = _mm256_cvtepu32_epi64(_mm256_castsi256_si128(ix));
+        const __m256i hi = _mm256_cvtepu32_epi64(_mm256_extracti128_si256(ix, 1));
+        if (sizeof(_ARRAY_TYPE) == 4) {
+            _mm_storeu_si128((__m128i*)dst, _mm256_i64gather_epi32((const int*)src, lo, 4));
+            _mm_storeu_si128((__m128i*)dst + 1, _mm256_i64gather_epi32((const int*)src, hi, 4));
+        }
+        else {
+            _mm256_storeu_si256((__m256i*)dst,
+                _mm256_i64gather_epi64((const long long*)src, lo, 8));
+            _mm256_storeu_si256((__m256i*)dst + 1,
+                _mm256_i64gather_epi64((const long long*)src, hi, 8));
+        }
+        return;
+    }
+#endif
+    for (unsigned int i = 0; i < 8; ++i) {
+        dst[i] = src[idx[i]];
+    }
+}
+
+/** Gather 8 elements `dst[i] = src[idx[i]]`, see `gather8_u32`.
+ *
+ */
+static inline __attribute__((always_inline))
+void
+_ARRAY_FN(gather8_u64)(const _ARRAY_TYPE* src, const uint64_t* idx, _ARRAY_TYPE* dst)
+{
+#if defined(__AVX2__) && !defined(_ARRAY_NO_SIMD)
+    if (sizeof(_ARRAY_TYPE) == 4 || sizeof(_ARRAY_TYPE) == 8) {
+        const __m256i lo = _mm256_loadu_si256((const __m256i*)idx);
+        const __m256i hi = _mm256_loadu_si256((const __m256i*)idx + 1);
+        if (sizeof(_ARRAY_TYPE) == 4) {
+            _mm_storeu_si128((__m128i*)dst, _mm256_i64gather_epi32((const int*)src, lo, 4));
+            _mm_storeu_si128((__m128i*)dst + 1, _mm256_i64gather_epi32((const int*)src, hi, 4));
+        }
+        else {
+            _mm256_storeu_si256((__m256i*)dst,
+                _mm256_i64gather_epi64((const long long*)src, lo, 8));
+            _mm256_storeu_si256((__m256i*)dst + 1,
+                _mm256_i64gather_epi64((const long long*)src, hi, 8));
+        }
+        return;
+    }
+#endif
+    for (unsigned int i = 0; i < 8; ++i) {
+        dst[i] = src[idx[i]];
+    }
+}
+
+// Gather `dst[i] = src[idx[i]]` 8 elements at a time with `gather8`,
+// sources are prefetched `SMARTARR_GATHER_PREFETCH_DIST` elements ahead.
+#ifndef _ARRAY_GATHER
+#define _ARRAY_GATHER(len, idx, src, dst, gather8) ({ \
+    constexpr size_t _dist = SMARTARR_GATHER_PREFETCH_DIST; \
+    const size_t _len = (len); \
+    const size_t _pf_len = (_len > _dist)? _len - _dist : 0; \
+    const size_t _main_len = _pf_len - _pf_len % 8; \
+    for (size_t _i = 0; _i < _main_len; _i += 8) { \
+        for (size_t _k = _i + _dist; _k < _i + _dist + 8; ++_k) { \
+            __builtin_prefetch(&(src)[(idx)[_k]]); \
+        } \
+        gather8((src), &(idx)[_i], &(dst)[_i]); \
+    } \
+    for (size_t _i = _main_len; _i < _len; ++_i) { \
+        (dst)[_i] = (src)[(idx)[_i]]; \
+    } \
+    (dst); \
+})
+#endif
+
+// Scatter `dst[idx[i]] op src[i]`, destinations are prefetched for write
+// `SMARTARR_GATHER_PREFETCH_DIST` elements ahead.
+#ifndef _ARRAY_SCATTER
+#define _ARRAY_SCATTER(len, idx, src, dst, op) ({ \
+    constexpr size_t _dist = SMARTARR_GATHER_PREFETCH_DIST; \
+    const size_t _len = (len); \
+    const size_t _pf_len = (_len > _dist)? _len - _dist : 0; \
+    for (size_t _i = 0; _i < _pf_len; ++_i) { \
+        __builtin_prefetch(&(dst)[(idx)[_i + _dist]], 1); \
+        (dst)[(idx)[_i]] op (src)[_i]; \
+    } \
+    for (size_t _i = _pf_len; _i < _len; ++_i) { \
+        (dst)[(idx)[_i]] op (src)[_i]; \
+    } \
+    (dst); \
+})
+#endif
+
+/** Gather elements by index, `dst[i] = src[idx[i]]`.
+ *
+ * Use it to reorder a column by a permutation or to look up dictionary
+ * values by their codes. Every index must be less than the length of `src`,
+ * `src` and `dst` must not overlap.
+ *
+ * Example:
+ * ```
+ * // decode dictionary encoded column
+ * f64_array_gather_u32(len, codes, dictionary, values);
+ * ```
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(4, 1) __attribute__((nonnull(3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(gather_u32)(size_t len, const uint32_t idx[len], const _ARRAY_TYPE src[],
+    _ARRAY_TYPE dst[len])
+{
+    return _ARRAY_GATHER(len, idx, src, dst, _ARRAY_FN(gather8_u32));
+}
+
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(4, 1) __attribute__((nonnull(3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(gather_u64)(size_t len, const uint64_t idx[len], const _ARRAY_TYPE src[],
+    _ARRAY_TYPE dst[len])
+{
+    return _ARRAY_GATHER(len, idx, src, dst, _ARRAY_FN(gather8_u64));
+}
+
+static inline
+__attribute__((nonnull(1, 2, 3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(gather_u32)(const uint32_t idx[], const _SMART_ARRAY_T* src, _SMART_ARRAY_T* dst)
+{
+    return _ARRAY_FN(gather_u32)(dst->len, idx, src->data, dst->data);
+}
+
+static inline
+__attribute__((nonnull(1, 2, 3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(gather_u64)(const uint64_t idx[], const _SMART_ARRAY_T* src, _SMART_ARRAY_T* dst)
+{
+    return _ARRAY_FN(gather_u64)(dst->len, idx, src->data, dst->data);
+}
+
+/** Scatter elements by index, `dst[idx[i]] = src[i]`.
+ *
+ * Inverse of `gather` for a permutation. If indices repeat the last
+ * element written to a position wins. Every index must be less than
+ * the length of `dst`, `src` and `dst` must not overlap.
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) __attribute__((nonnull(4))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(scatter_u32)(size_t len, const uint32_t idx[len], const _ARRAY_TYPE src[len],
+    _ARRAY_TYPE dst[])
+{
+    return _ARRAY_SCATTER(len, idx, src, dst, =);
+}
+
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) __attribute__((nonnull(4))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(scatter_u64)(size_t len, const uint64_t idx[len], const _ARRAY_TYPE src[len],
+    _ARRAY_TYPE dst[])
+{
+    return _ARRAY_SCATTER(len, idx, src, dst, =);
+}
+
+static inline
+__attribute__((nonnull(1, 2, 3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(scatter_u32)(const uint32_t idx[], const _SMART_ARRAY_T* src, _SMART_ARRAY_T* dst)
+{
+    return _ARRAY_FN(scatter_u32)(src->len, idx, src->data, dst->data);
+}
+
+static inline
+__attribute__((nonnull(1, 2, 3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(scatter_u64)(const uint64_t idx[], const _SMART_ARRAY_T* src, _SMART_ARRAY_T* dst)
+{
+    return _ARRAY_FN(scatter_u64)(src->len, idx, src->data, dst->data);
+}
+
+#ifndef _ARRAY_TYPE_COMPOUND
+/** Accumulate elements by index, `dst[idx[i]] += src[i]`.
+ *
+ * Repeated indices add up, use it for weighted histograms
+ * and group-by sums over precomputed group codes.
+ *
+ * Example:
+ * ```
+ * // sum of sales per store
+ * f64_array_fill(nr_stores, sum, 0);
+ * f64_array_scatter_add_u32(len, store, sales, sum);
+ * ```
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) __attribute__((nonnull(4))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(scatter_add_u32)(size_t len, const uint32_t idx[len], const _ARRAY_TYPE src[len],
+    _ARRAY_TYPE dst[])
+{
+    return _ARRAY_SCATTER(len, idx, src, dst, +=);
+}
+
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) __attribute__((nonnull(4))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(scatter_add_u64)(size_t len, const uint64_t idx[len], const _ARRAY_TYPE src[len],
+    _ARRAY_TYPE dst[])
+{
+    return _ARRAY_SCATTER(len, idx, src, dst, +=);
+}
+
+static inline
+__attribute__((nonnull(1, 2, 3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(scatter_add_u32)(const uint32_t idx[], const _SMART_ARRAY_T* src, _SMART_ARRAY_T* dst)
+{
+    return _ARRAY_FN(scatter_add_u32)(src->len, idx, src->data, dst->data);
+}
+
+static inline
+__attribute__((nonnull(1, 2, 3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(scatter_add_u64)(const uint64_t idx[], const _SMART_ARRAY_T* src, _SMART_ARRAY_T* dst)
+{
+    return _ARRAY_FN(scatter_add_u64)(src->len, idx, src->data, dst->data);
+}
+#endif // _ARRAY_TYPE_COMPOUND
+
+/** Reorder array by permutation, `dst[i] = src[idx[i]]`.
+ *
+ * Use it to move sibling columns after `argsort` of the key column,
+ * same as `gather`. `src` and `dst` must not overlap.
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) _ARRAY_WO(4, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(apply_permutation_u32)(size_t len, const _ARRAY_TYPE src[],
+    const uint32_t idx[len], _ARRAY_TYPE dst[len])
+{
+    return _ARRAY_FN(gather_u32)(len, idx, src, dst);
+}
+
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) _ARRAY_WO(4, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(apply_permutation_u64)(size_t len, const _ARRAY_TYPE src[],
+    const uint64_t idx[len], _ARRAY_TYPE dst[len])
+{
+    return _ARRAY_FN(gather_u64)(len, idx, src, dst);
+}
+
+static inline
+__attribute__((nonnull(1, 2, 3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(apply_permutation_u32)(const _SMART_ARRAY_T* src, const uint32_t idx[],
+    _SMART_ARRAY_T* dst)
+{
+    return _ARRAY_FN(apply_permutation_u32)(dst->len, src->data, idx, dst->data);
+}
+
+static inline
+__attribute__((nonnull(1, 2, 3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(apply_permutation_u64)(const _SMART_ARRAY_T* src, const uint64_t idx[],
+    _SMART_ARRAY_T* dst)
+{
+    return _ARRAY_FN(apply_permutation_u64)(dst->len, src->data, idx, dst->data);
+}
+
+/** Return position of the first element that is not less than the value.
+ *
+ * Array must be sorted by `_ARRAY_TYPE_LT`, return `len` if all elements
+ * are less than the value.
+ *
+ * Search is branchless: every step halves the range with a conditional
+ * move, and both possible next middle elements are prefetched,
+ * so the only branch is the loop, which runs log2(len) times.
+ *
+ * Example:
+ * ```
+ * i64_smart_array_qsort(a);
+ * size_t pos = i64_array_lower_bound(a->len, a->data, 42);
+ * bool found = pos < a->len && a->data[pos] == 42;
+ * ```
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_ARRAY_FN(lower_bound)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val)
+{
+    if (len == 0) {
+        return 0;
+    }
+
+    const _ARRAY_TYPE* base = a;
+    size_t n = len;
+
+    while (n > 1) {
+        size_t half = n / 2;
+        __builtin_prefetch(&base[half / 2]);
+        __builtin_prefetch(&base[half + half / 2]);
+        // mask instead of `?:`, so the compiler does not make it a branch
+        base += half & -(size_t)_ARRAY_TYPE_LT(base[half - 1], val);
+        n -= half;
+    }
+
+    return (base - a) + (_ARRAY_TYPE_LT(*base, val)? 1:0);
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_SARRAY_FN(lower_bound)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val)
+{
+    return _ARRAY_FN(lower_bound)(a->len, a->data, val);
+}
+
+// Number of searches advanced in lockstep by batched search.
+#ifndef SMARTARR_SEARCH_BATCH_LEN
+#define SMARTARR_SEARCH_BATCH_LEN 16
+#endif
+
+/** Find `lower_bound` for every query, write positions to `pos`.
+ *
+ * Binary search on array of given length makes the same number of steps
+ * for any value, so a group of searches goes in lockstep: one step
+ * of every search in the group, then the next step. Loads of different
+ * searches do not depend on each other, and every search prefetches its
+ * next middle element, so cache misses of the group overlap instead of
+ * being paid one after another.
+ *
+ * Example:
+ * ```
+ * i64_array_lower_bound_batch(ids->len, ids->data, keys->len, keys->data, pos);
+ * ```
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(4, 3) _ARRAY_WO(5, 3)
+void
+_ARRAY_FN(lower_bound_batch)(size_t len, const _ARRAY_TYPE a[len],
+    size_t nr_queries, const _ARRAY_TYPE queries[nr_queries], size_t pos[nr_queries])
+{
+    constexpr size_t G = SMARTARR_SEARCH_BATCH_LEN;
+
+    size_t q = 0;
+
+    if (len > 1) {
+        for (; q + G <= nr_queries; q += G) {
+            const _ARRAY_TYPE* base[G];
+            for (size_t g = 0; g < G; ++g) {
+                base[g] = a;
+            }
+
+            size_t n = len;
+            while (n > 1) {
+                const size_t half = n / 2;
+                const size_t next_half = (n - half) / 2;
+                for (size_t g = 0; g < G; ++g) {
+                    base[g] += half & -(size_t)_ARRAY_TYPE_LT(base[g][half - 1], queries[q + g]);
+                    __builtin_prefetch(&base[g][next_half - (next_half? 1:0)]);
+                }
+                n -= half;
+            }
+
+            for (size_t g = 0; g < G; ++g) {
+                pos[q + g] = (base[g] - a) + (_ARRAY_TYPE_LT(*base[g], queries[q + g])? 1:0);
+            }
+        }
+    }
+
+    for (; q < nr_queries; ++q) {
+        pos[q] = _ARRAY_FN(lower_bound)(len, a, queries[q]);
+    }
+}
+
+static inline
+__attribute__((nonnull(1, 2, 3)))
+void
+_SARRAY_FN(lower_bound_batch)(const _SMART_ARRAY_T* a, const _SMART_ARRAY_T* queries,
+    size_t pos[])
+{
+    _ARRAY_FN(lower_bound_batch)(a->len, a->data, queries->len, queries->data, pos);
+}
+
+/** Return position of the first element that is greater than the value.
+ *
+ * Array must be sorted by `_ARRAY_TYPE_LT`, return `len` if no element
+ * is greater than the value.
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_ARRAY_FN(upper_bound)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val)
+{
+    if (len == 0) {
+        return 0;
+    }
+
+    const _ARRAY_TYPE* base = a;
+    size_t n = len;
+
+    while (n > 1) {
+        size_t half = n / 2;
+        __builtin_prefetch(&base[half / 2]);
+        __builtin_prefetch(&base[half + half / 2]);
+        base += half & ((size_t)_ARRAY_TYPE_LT(val, base[half - 1]) - 1);
+        n -= half;
+    }
+
+    return (base - a) + (_ARRAY_TYPE_LT(val, *base)? 0:1);
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_SARRAY_FN(upper_bound)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val)
+{
+    return _ARRAY_FN(upper_bound)(a->len, a->data, val);
+}
+
+/** Return range of elements equal to the value in sorted array.
+ *
+ * Range is empty, `first == last`, if there is no such element,
+ * `first` is then where the value would be inserted.
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+index_range_t
+_ARRAY_FN(equal_range)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val)
+{
+    size_t first = _ARRAY_FN(lower_bound)(len, a, val);
+    size_t last = first + _ARRAY_FN(upper_bound)(len - first, &a[first], val);
+
+    return (index_range_t){.first = first, .last = last};
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+index_range_t
+_SARRAY_FN(equal_range)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val)
+{
+    return _ARRAY_FN(equal_range)(a->len, a->data, val);
+}
+
+/** Find element equal to the value in sorted array, O(log(n)) version of `find`.
+ *
+ * Returns position of the first of equal elements.
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+optional_uint_t
+_ARRAY_FN(find_sorted)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val)
+{
+    size_t pos = _ARRAY_FN(lower_bound)(len, a, val);
+
+    if (pos < len && !_ARRAY_TYPE_LT(val, a[pos])) {
+        return (optional_uint_t){.present = true, .value = pos};
+    }
+
+    return (optional_uint_t){.present = false};
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+optional_uint_t
+_SARRAY_FN(find_sorted)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val)
+{
+    return _ARRAY_FN(find_sorted)(a->len, a->data, val);
+}
+
+// Arithmetic functions need numeric element type.
+#ifndef _ARRAY_TYPE_COMPOUND
+static inline
+_ARRAY_RW(2, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(random_sequence)(size_t len, _ARRAY_TYPE a[len])
+{
+    // make a sequence [0, 1, 2, 3, 4...]
+    for (size_t i = 0; i < len; ++i) {
+         a[i] = i;
+    }
+
+    // randomly shuffle elements of the original sequence
+    for (size_t range = len; range > 1; --range) {
+        size_t random_index = rand() % range;
+        _ARRAY_FN(swap_two_pointers)(&a[random_index], &a[range - 1]);
+    }
+
+    return a;
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(random_sequence)(_SMART_ARRAY_T* a)
+{
+    return _ARRAY_FN(random_sequence)(a->len, a->data);
+}
+
+#ifndef _ARRAY_GEN_BINARY
+// Element operations of the arithmetic kernels, same for all types.
+#define _ARRAY_OP_ADD(x, y) ((x) + (y))
+#define _ARRAY_OP_SUB(x, y) ((x) - (y))
+#define _ARRAY_OP_MUL(x, y) ((x) * (y))
+#define _ARRAY_OP_DIV(x, y) ((x) / (y))
+#define _ARRAY_OP_MIN(x, y) (((y) < (x))? (y) : (x))
+#define _ARRAY_OP_MAX(x, y) (((x) < (y))? (y) : (x))
+#define _ARRAY_OP_NEG(x) (-(x))
+
+/* Generate `name(len, a, b, c)` that computes `c[i] = op(a[i], b[i])`,
+ * in-place `name_destruct(len, a, b)` that computes `a[i] = op(a[i], b[i])`
+ * and smart array wrappers that take the shortest length.
+ */
+#define _ARRAY_GEN_BINARY(name, op) \
+static inline \
+_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) _ARRAY_WO(4, 1) FN_ATTR_RETURNS_NONNULL \
+_ARRAY_TYPE* \
+_ARRAY_FN(name)( \
+    size_t len, \
+    const _ARRAY_TYPE a[len], \
+    const _ARRAY_TYPE b[len], \
+          _ARRAY_TYPE c[len]) \
+{ \
+    ARRAY_ASSERT_ALIGNED(a); \
+    ARRAY_ASSERT_ALIGNED(b); \
+    ARRAY_ASSERT_ALIGNED(c); \
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN); \
+    b = __builtin_assume_aligned(b, _SMART_ARRAY_ALIGN); \
+    c = __builtin_assume_aligned(c, _SMART_ARRAY_ALIGN); \
+    _Pragma("GCC ivdep") \
+    for (size_t i = 0; i < len; ++i) { \
+         c[i] = op(a[i], b[i]); \
+    } \
+    return c; \
+} \
+\
+static inline \
+_ARRAY_RW(2, 1) _ARRAY_RO(3, 1) FN_ATTR_RETURNS_NONNULL \
+_ARRAY_TYPE* \
+_ARRAY_FN(name##_destruct)( \
+    size_t len, \
+          _ARRAY_TYPE a[len], \
+    const _ARRAY_TYPE b[len]) \
+{ \
+    ARRAY_ASSERT_ALIGNED(a); \
+    ARRAY_ASSERT_ALIGNED(b); \
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN); \
+    b = __builtin_assume_aligned(b, _SMART_ARRAY_ALIGN); \
+    _Pragma("GCC ivdep") \
+    for (size_t i = 0; i < len; ++i) { \
+         a[i] = op(a[i], b[i]); \
+    } \
+    return a; \
+} \
+\
+static inline \
+__attribute__((nonnull(1, 2, 3))) FN_ATTR_RETURNS_NONNULL \
+_ARRAY_TYPE* \
+_SARRAY_FN(name)(const _SMART_ARRAY_T* a, const _SMART_ARRAY_T* b, _SMART_ARRAY_T* c) \
+{ \
+    size_t len = (a->len < b->len)? a->len : b->len; \
+    len = (len < c->len)? len : c->len; \
+    return _ARRAY_FN(name)(len, a->data, b->data, c->data); \
+} \
+\
+static inline \
+__attribute__((nonnull(1, 2))) FN_ATTR_RETURNS_NONNULL \
+_ARRAY_TYPE* \
+_SARRAY_FN(name##_destruct)(_SMART_ARRAY_T* a, const _SMART_ARRAY_T* b) \
+{ \
+    size_t len = (a->len < b->len)? a->len : b->len; \
+    return _ARRAY_FN(name##_destruct)(len, a->data, b->data); \
+}
+
+/* Generate `name(len, a, b)` that computes `b[i] = op(a[i])`,
+ * in-place `name_destruct(len, a)` and smart array wrappers.
+ */
+#define _ARRAY_GEN_UNARY(name, op) \
+static inline \
+_ARRAY_RO(2, 1) _ARRAY_WO(3, 1) FN_ATTR_RETURNS_NONNULL \
+_ARRAY_TYPE* \
+_ARRAY_FN(name)( \
+    size_t len, \
+    const _ARRAY_TYPE a[len], \
+          _ARRAY_TYPE b[len]) \
+{ \
+    ARRAY_ASSERT_ALIGNED(a); \
+    ARRAY_ASSERT_ALIGNED(b); \
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN); \
+    b = __builtin_assume_aligned(b, _SMART_ARRAY_ALIGN); \
+    _Pragma("GCC ivdep") \
+    for (size_t i = 0; i < len; ++i) { \
+         b[i] = op(a[i]); \
+    } \
+    return b; \
+} \
+\
+static inline \
+_ARRAY_RW(2, 1) FN_ATTR_RETURNS_NONNULL \
+_ARRAY_TYPE* \
+_ARRAY_FN(name##_destruct)(size_t len, _ARRAY_TYPE a[len]) \
+{ \
+    ARRAY_ASSERT_ALIGNED(a); \
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN); \
+    _Pragma("GCC ivdep") \
+    for (size_t i = 0; i < len; ++i) { \
+         a[i] = op(a[i]); \
+    } \
+    return a; \
+} \
+\
+static inline \
+__attribute__((nonnull(1, 2))) FN_ATTR_RETURNS_NONNULL \
+_ARRAY_TYPE* \
+_SARRAY_FN(name)(const _SMART_ARRAY_T* a, _SMART_ARRAY_T* b) \
+{ \
+    size_t len = (a->len < b->len)? a->len : b->len; \
+    return _ARRAY_FN(name)(len, a->data, b->data); \
+} \
+\
+static inline \
+__attribute__((nonnull(1))) FN_ATTR_RETURNS_NONNULL \
+_ARRAY_TYPE* \
+_SARRAY_FN(name##_destruct)(_SMART_ARRAY_T* a) \
+{ \
+    return _ARRAY_FN(name##_destruct)(a->len, a->data); \
+}
+#endif // _ARRAY_GEN_BINARY
+
+/** Absolute value of an element, `abs(-0.0)` is `+0.0`.
+ *
+ */
+static inline
+FN_ATTR_CONST
+_ARRAY_TYPE
+_ARRAY_FN(abs_one)(_ARRAY_TYPE x)
+{
+    return _Generic(x,
+        float: __builtin_fabsf((float)x),
+        double: __builtin_fabs((double)x),
+        long double: __builtin_fabsl((long double)x),
+        default: (x > 0)? x : -x);
+}
+
+/* Element-wise arithmetic, every kernel comes as
+ *   name(len, a, b, c)          c = a op b
+ *   name_destruct(len, a, b)    a = a op b
+ * plus `_SARRAY_FN` wrappers, and `_OMP_ARRAY_FN` versions in omp_array.inc.h.
+ * Integer division by zero is undefined as for `/`,
+ * `min` and `max` follow `<`, so with NaN the result depends on the order.
+ */
+_ARRAY_GEN_BINARY(add, _ARRAY_OP_ADD)
+_ARRAY_GEN_BINARY(sub, _ARRAY_OP_SUB)
+_ARRAY_GEN_BINARY(mul, _ARRAY_OP_MUL)
+_ARRAY_GEN_BINARY(div, _ARRAY_OP_DIV)
+_ARRAY_GEN_BINARY(min, _ARRAY_OP_MIN)
+_ARRAY_GEN_BINARY(max, _ARRAY_OP_MAX)
+_ARRAY_GEN_UNARY(neg, _ARRAY_OP_NEG)
+_ARRAY_GEN_UNARY(abs, _ARRAY_FN(abs_one))
+
+/** Multiply array by a scalar, `b[i] = a[i] * s`.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(4, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(scale)(
+    size_t len,
+    const _ARRAY_TYPE a[len],
+    _ARRAY_TYPE s,
+          _ARRAY_TYPE b[len])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    ARRAY_ASSERT_ALIGNED(b);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+    b = __builtin_assume_aligned(b, _SMART_ARRAY_ALIGN);
+
+    #pragma GCC ivdep
+    for (size_t i = 0; i < len; ++i) {
+         b[i] = a[i] * s;
+    }
+    return b;
+}
+
+static inline
+_ARRAY_RW(2, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(scale_destruct)(size_t len, _ARRAY_TYPE a[len], _ARRAY_TYPE s)
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    #pragma GCC ivdep
+    for (size_t i = 0; i < len; ++i) {
+         a[i] = a[i] * s;
+    }
+    return a;
+}
+
+static inline
+__attribute__((nonnull(1, 3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(scale)(const _SMART_ARRAY_T* a, _ARRAY_TYPE s, _SMART_ARRAY_T* b)
+{
+    size_t len = (a->len < b->len)? a->len : b->len;
+    return _ARRAY_FN(scale)(len, a->data, s, b->data);
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(scale_destruct)(_SMART_ARRAY_T* a, _ARRAY_TYPE s)
+{
+    return _ARRAY_FN(scale_destruct)(a->len, a->data, s);
+}
+
+/** BLAS axpy, `z[i] = alpha * x[i] + y[i]`.
+ *
+ * Multiply and add are fused into FMA instruction if the target has it.
+ */
+static inline
+_ARRAY_RO(3, 1) _ARRAY_RO(4, 1) _ARRAY_WO(5, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(axpy)(
+    size_t len,
+    _ARRAY_TYPE alpha,
+    const _ARRAY_TYPE x[len],
+    const _ARRAY_TYPE y[len],
+          _ARRAY_TYPE z[len])
+{
+    ARRAY_ASSERT_ALIGNED(x);
+    ARRAY_ASSERT_ALIGNED(y);
+    ARRAY_ASSERT_ALIGNED(z);
+    x = __builtin_assume_aligned(x, _SMART_ARRAY_ALIGN);
+    y = __builtin_assume_aligned(y, _SMART_ARRAY_ALIGN);
+    z = __builtin_assume_aligned(z, _SMART_ARRAY_ALIGN);
+
+    #pragma GCC ivdep
+    for (size_t i = 0; i < len; ++i) {
+         z[i] = alpha * x[i] + y[i];
+    }
+    return z;
+}
+
+/** BLAS axpy in place, `y[i] += alpha * x[i]`.
+ *
+ */
+static inline
+_ARRAY_RO(3, 1) _ARRAY_RW(4, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(axpy_destruct)(
+    size_t len,
+    _ARRAY_TYPE alpha,
+    const _ARRAY_TYPE x[len],
+          _ARRAY_TYPE y[len])
+{
+    ARRAY_ASSERT_ALIGNED(x);
+    ARRAY_ASSERT_ALIGNED(y);
+    x = __builtin_assume_aligned(x, _SMART_ARRAY_ALIGN);
+    y = __builtin_assume_aligned(y, _SMART_ARRAY_ALIGN);
+
+    #pragma GCC ivdep
+    for (size_t i = 0; i < len; ++i) {
+         y[i] = alpha * x[i] + y[i];
+    }
+    return y;
+}
+
+static inline
+__attribute__((nonnull(2, 3, 4))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(axpy)(_ARRAY_TYPE alpha, const _SMART_ARRAY_T* x, const _SMART_ARRAY_T* y,
+    _SMART_ARRAY_T* z)
+{
+    size_t len = (x->len < y->len)? x->len : y->len;
+    len = (len < z->len)? len : z->len;
+    return _ARRAY_FN(axpy)(len, alpha, x->data, y->data, z->data);
+}
+
+static inline
+__attribute__((nonnull(2, 3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(axpy_destruct)(_ARRAY_TYPE alpha, const _SMART_ARRAY_T* x, _SMART_ARRAY_T* y)
+{
+    size_t len = (x->len < y->len)? x->len : y->len;
+    return _ARRAY_FN(axpy_destruct)(len, alpha, x->data, y->data);
+}
+
+/** Multiply-add, `d[i] = a[i] * b[i] + c[i]`.
+ *
+ * Multiply and add are fused into FMA instruction if the target has it.
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) _ARRAY_RO(4, 1) _ARRAY_WO(5, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(fma)(
+    size_t len,
+    const _ARRAY_TYPE a[len],
+    const _ARRAY_TYPE b[len],
+    const _ARRAY_TYPE c[len],
+          _ARRAY_TYPE d[len])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    ARRAY_ASSERT_ALIGNED(b);
+    ARRAY_ASSERT_ALIGNED(c);
+    ARRAY_ASSERT_ALIGNED(d);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+    b = __builtin_assume_aligned(b, _SMART_ARRAY_ALIGN);
+    c = __builtin_assume_aligned(c, _SMART_ARRAY_ALIGN);
+    d = __builtin_assume_aligned(d, _SMART_ARRAY_ALIGN);
+
+    #pragma GCC ivdep
+    for (size_t i = 0; i < len; ++i) {
+         d[i] = a[i] * b[i] + c[i];
+    }
+    return d;
+}
+
+/** Multiply-accumulate in place, `c[i] += a[i] * b[i]`.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) _ARRAY_RW(4, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_ARRAY_FN(fma_destruct)(
+    size_t len,
+    const _ARRAY_TYPE a[len],
+    const _ARRAY_TYPE b[len],
+          _ARRAY_TYPE c[len])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    ARRAY_ASSERT_ALIGNED(b);
+    ARRAY_ASSERT_ALIGNED(c);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+    b = __builtin_assume_aligned(b, _SMART_ARRAY_ALIGN);
+    c = __builtin_assume_aligned(c, _SMART_ARRAY_ALIGN);
+
+    #pragma GCC ivdep
+    for (size_t i = 0; i < len; ++i) {
+         c[i] = a[i] * b[i] + c[i];
+    }
+    return c;
+}
+
+static inline
+__attribute__((nonnull(1, 2, 3, 4))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(fma)(const _SMART_ARRAY_T* a, const _SMART_ARRAY_T* b, const _SMART_ARRAY_T* c,
+    _SMART_ARRAY_T* d)
+{
+    size_t len = (a->len < b->len)? a->len : b->len;
+    len = (len < c->len)? len : c->len;
+    len = (len < d->len)? len : d->len;
+    return _ARRAY_FN(fma)(len, a->data, b->data, c->data, d->data);
+}
+
+static inline
+__attribute__((nonnull(1, 2, 3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_SARRAY_FN(fma_destruct)(const _SMART_ARRAY_T* a, const _SMART_ARRAY_T* b, _SMART_ARRAY_T* c)
+{
+    size_t len = (a->len < b->len)? a->len : b->len;
+    len = (len < c->len)? len : c->len;
+    return _ARRAY_FN(fma_destruct)(len, a->data, b->data, c->data);
+}
+
+// Summation modes of `reduce_add`, see `SMARTARR_REDUCE_ADD_MODE`.
+#ifndef SMARTARR_REDUCE_ADD_SERIAL
+#define SMARTARR_REDUCE_ADD_SERIAL   0
+#define SMARTARR_REDUCE_ADD_SIMD     1
+#define SMARTARR_REDUCE_ADD_PAIRWISE 2
+#define SMARTARR_REDUCE_ADD_KAHAN    3
+#endif
+
+// Summation used by `reduce_add`, left to right by default.
+#ifndef SMARTARR_REDUCE_ADD_MODE
+#define SMARTARR_REDUCE_ADD_MODE SMARTARR_REDUCE_ADD_SERIAL
+#endif
+
+// Number of independent accumulators of `reduce_add_simd`,
+// enough to hide latency of FP add.
+#ifndef SMARTARR_REDUCE_ADD_ACCS
+#define SMARTARR_REDUCE_ADD_ACCS 4
+#endif
+
+// Pairwise summation adds blocks of this length with `reduce_add_simd`.
+#ifndef SMARTARR_PAIRWISE_BLOCK_LEN
+#define SMARTARR_PAIRWISE_BLOCK_LEN 256
+#endif
+
+/** Sum of elements added left to right.
+ *
+ * Single accumulator, for floating point types each add waits for
+ * the previous one unless compiled with `-ffast-math`.
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_TYPE
+_ARRAY_FN(reduce_add_serial)(
+    size_t len,
+    const _ARRAY_TYPE a[len])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    _ARRAY_TYPE sum = 0;
+
+    #pragma GCC ivdep
+    for (size_t i = 0; i < len; ++i) {
+         sum += a[i];
+    }
+    return sum;
+}
+
+/** Sum of elements with `SMARTARR_REDUCE_ADD_ACCS` vector accumulators.
+ *
+ * Element `i` goes to lane `i % lanes` of one of accumulators,
+ * floating point result differs from `reduce_add_serial` by rounding.
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_TYPE
+_ARRAY_FN(reduce_add_simd)(
+    size_t len,
+    const _ARRAY_TYPE a[len])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    constexpr size_t nr_accs = SMARTARR_REDUCE_ADD_ACCS;
+#ifdef _ARRAY_SIMD
+    constexpr size_t lanes = _ARRAY_VEC_LANES;
+    _ARRAY_VEC_T acc[SMARTARR_REDUCE_ADD_ACCS] = {};
+
+    const size_t main_len = len - len % (nr_accs * lanes);
+    const size_t vec_len = len - len % lanes;
+    size_t i = 0;
+    for (; i < main_len; i += nr_accs * lanes) {
+        for (size_t k = 0; k < nr_accs; ++k) {
+            acc[k] += _ARRAY_FN(vec_load)(&a[i + k * lanes]);
+        }
+    }
+    for (; i < vec_len; i += lanes) {
+        acc[0] += _ARRAY_FN(vec_load)(&a[i]);
+    }
+    if (i < len) {
+        acc[nr_accs - 1] += _ARRAY_FN(vec_load_partial)(&a[i], len - i);
+    }
+
+    for (size_t k = 1; k < nr_accs; ++k) {
+        acc[0] += acc[k];
+    }
+    _ARRAY_TYPE sum = 0;
+    for (size_t l = 0; l < lanes; ++l) {
+        sum += acc[0][l];
+    }
+    return sum;
+#else
+    _ARRAY_TYPE acc[SMARTARR_REDUCE_ADD_ACCS] = {};
+
+    const size_t main_len = len - len % nr_accs;
+    for (size_t i = 0; i < main_len; i += nr_accs) {
+        for (size_t k = 0; k < nr_accs; ++k) {
+            acc[k] += a[i + k];
+        }
+    }
+    for (size_t i = main_len; i < len; ++i) {
+        acc[0] += a[i];
+    }
+
+    _ARRAY_TYPE sum = 0;
+    for (size_t k = 0; k < nr_accs; ++k) {
+        sum += acc[k];
+    }
+    return sum;
+#endif // _ARRAY_SIMD
+}
+
+/** Sum of elements by pairwise summation.
+ *
+ * Array is split in halves recursively down to `SMARTARR_PAIRWISE_BLOCK_LEN`
+ * blocks summed by `reduce_add_simd`, rounding error grows as `O(log(len))`
+ * instead of `O(len)` of serial sum, at about the speed of `reduce_add_simd`.
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_TYPE
+_ARRAY_FN(reduce_add_pairwise)(
+    size_t len,
+    const _ARRAY_TYPE a[len])
+{
+    constexpr size_t block_len = SMARTARR_PAIRWISE_BLOCK_LEN;
+
+    if (len <= block_len) {
+        return _ARRAY_FN(reduce_add_simd)(len, a);
+    }
+
+    // Split on block boundary to keep the second half aligned.
+    const size_t half = (len / 2 + block_len - 1) / block_len * block_len;
+
+    return _ARRAY_FN(reduce_add_pairwise)(half, a) +
+        _ARRAY_FN(reduce_add_pairwise)(len - half, &a[half]);
+}
+
+/** Add `x` to compensated sum `sum + comp`, Neumaier's variant of Kahan summation.
+ *
+ */
 static inline
-__attribute__((nonnull(1))) FN_ATTR_RETURNS_NONNULL
-_ARRAY_TYPE*
-_SARRAY_FN(insertion_sort)(_SMART_ARRAY_T* a)
+__attribute__((nonnull(1, 2)))
+void
+_ARRAY_FN(neumaier_add)(_ARRAY_TYPE* sum, _ARRAY_TYPE* comp, _ARRAY_TYPE x)
 {
-    return _ARRAY_FN(insertion_sort)(a->len, a->data);
+    const _ARRAY_TYPE t = *sum + x;
+    if (_ARRAY_FN(abs_one)(*sum) >= _ARRAY_FN(abs_one)(x)) {
+        *comp += (*sum - t) + x;
+    } else {
+        *comp += (x - t) + *sum;
+    }
+    *sum = t;
 }
 
+#ifdef _ARRAY_SIMD
+/** Lane-wise Kahan summation step, `comp` holds the negated lost low part.
+ *
+ * Unlike Neumaier's variant the compensation stays within rounding error
+ * of the sum, so it does not lose precision over long runs of same sign terms.
+ */
 static inline
 __attribute__((nonnull(1, 2)))
 void
-_ARRAY_FN(swap_two_pointers)(_ARRAY_TYPE* a, _ARRAY_TYPE* b)
+_ARRAY_FN(vec_kahan_add)(_ARRAY_VEC_T* sum, _ARRAY_VEC_T* comp, _ARRAY_VEC_T x)
 {
-    _ARRAY_TYPE tmp = *a;
-    *a = *b;
-    *b = tmp;
+    const _ARRAY_VEC_T y = x - *comp;
+    const _ARRAY_VEC_T t = *sum + y;
+    *comp = (t - *sum) - y;
+    *sum = t;
 }
+#endif // _ARRAY_SIMD
 
+/** Sum of elements with compensated (Kahan) summation.
+ *
+ * Rounding error does not grow with array length, about twice slower
+ * than `reduce_add_simd`. Vector lanes use classic Kahan summation,
+ * lane sums and the tail are added with Neumaier's variant that also
+ * keeps small terms next to large ones of opposite signs.
+ * Compensation is optimized away by `-ffast-math`.
+ * For integer types it is the same as plain sum.
+ */
 static inline
-_ARRAY_RW(2, 1) FN_ATTR_RETURNS_NONNULL
-_ARRAY_TYPE*
-_ARRAY_FN(bubble_sort)(size_t len, _ARRAY_TYPE a[len])
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_TYPE
+_ARRAY_FN(reduce_add_kahan)(
+    size_t len,
+    const _ARRAY_TYPE a[len])
 {
     ARRAY_ASSERT_ALIGNED(a);
     a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
 
-    _ARRAY_TYPE tmp;
-    bool swapped;
-    for (size_t step = 0; step < len - 1; ++step) {
-        swapped = false;
-        for (size_t i = 0; i < len - step - 1; ++i) {
-            if (_ARRAY_TYPE_LT(a[i + 1], a[i]) ) {
-                //_ARRAY_FN(swap_two_pointers)(&a[i], &a[i + 1]);
-                tmp = a[i+1]; a[i+1] = a[i]; a[i] = tmp;
-                swapped = true;
-            }
-        }
-    
-        // no swapping means the array is already sorted
-        if (!swapped) {
-            break;
+    _ARRAY_TYPE sum = 0, comp = 0;
+    size_t main_len = 0;
+#ifdef _ARRAY_SIMD
+    constexpr size_t lanes = _ARRAY_VEC_LANES;
+    _ARRAY_VEC_T vsum[2] = {}, vcomp[2] = {};
+
+    // Two independent chains, each add depends on the previous one.
+    main_len = len - len % (2 * lanes);
+    for (size_t i = 0; i < main_len; i += 2 * lanes) {
+        _ARRAY_FN(vec_kahan_add)(&vsum[0], &vcomp[0], _ARRAY_FN(vec_load)(&a[i]));
+        _ARRAY_FN(vec_kahan_add)(&vsum[1], &vcomp[1], _ARRAY_FN(vec_load)(&a[i + lanes]));
+    }
+    for (size_t k = 0; k < 2; ++k) {
+        for (size_t l = 0; l < lanes; ++l) {
+            _ARRAY_FN(neumaier_add)(&sum, &comp, vsum[k][l]);
+            comp -= vcomp[k][l];
         }
     }
-
-    return a;
+#endif // _ARRAY_SIMD
+    for (size_t i = main_len; i < len; ++i) {
+        _ARRAY_FN(neumaier_add)(&sum, &comp, a[i]);
+    }
+    return sum + comp;
 }
 
+/** Sum of elements, summation is set by `SMARTARR_REDUCE_ADD_MODE`.
+ *
+ */
 static inline
-__attribute__((nonnull(1))) FN_ATTR_RETURNS_NONNULL
-_ARRAY_TYPE*
-_SARRAY_FN(bubble_sort)(_SMART_ARRAY_T* a)
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_TYPE
+_ARRAY_FN(reduce_add)(
+    size_t len,
+    const _ARRAY_TYPE a[len])
 {
-    return _ARRAY_FN(bubble_sort)(a->len, a->data);
+#if SMARTARR_REDUCE_ADD_MODE == SMARTARR_REDUCE_ADD_SIMD
+    return _ARRAY_FN(reduce_add_simd)(len, a);
+#elif SMARTARR_REDUCE_ADD_MODE == SMARTARR_REDUCE_ADD_PAIRWISE
+    return _ARRAY_FN(reduce_add_pairwise)(len, a);
+#elif SMARTARR_REDUCE_ADD_MODE == SMARTARR_REDUCE_ADD_KAHAN
+    return _ARRAY_FN(reduce_add_kahan)(len, a);
+#else
+    return _ARRAY_FN(reduce_add_serial)(len, a);
+#endif
 }
 
+/** Type of `reduce_add_wide` sum.
+ *
+ * 64-bit integer for smaller integers, 128-bit for 64-bit integers,
+ * `double` for `float`.
+ */
+typedef typeof(_Generic((_ARRAY_TYPE)0,
+    float: (double)0,
+    double: (double)0,
+    long double: (long double)0,
+    char: (int64_t)0,
+    signed char: (int64_t)0,
+    short: (int64_t)0,
+    int: (int64_t)0,
+    long: (__int128)0,
+    long long: (__int128)0,
+    bool: (uint64_t)0,
+    unsigned char: (uint64_t)0,
+    unsigned short: (uint64_t)0,
+    unsigned int: (uint64_t)0,
+    unsigned long: (unsigned __int128)0,
+    unsigned long long: (unsigned __int128)0,
+    default: (_ARRAY_TYPE)0)) _ARRAY_WIDE_T;
+
+/** Sum of elements in wider type that does not overflow, see `_ARRAY_WIDE_T`.
+ *
+ */
 static inline
-FN_ATTR_WARN_UNUSED_RESULT
-int
-_ARRAY_FN(qsort_compare)(const void *restrict pa, const void *restrict pb)
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_WIDE_T
+_ARRAY_FN(reduce_add_wide)(
+    size_t len,
+    const _ARRAY_TYPE a[len])
 {
-    _ARRAY_TYPE a = *((_ARRAY_TYPE*)pa);
-    _ARRAY_TYPE b = *((_ARRAY_TYPE*)pb);
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
 
-    // (a-b) does not work for unsigned types
-    return ( (a < b)? -1 : ( (a == b)? 0 : 1) );
+    constexpr size_t nr_accs = SMARTARR_REDUCE_ADD_ACCS;
+    _ARRAY_WIDE_T acc[SMARTARR_REDUCE_ADD_ACCS] = {};
+
+    const size_t main_len = len - len % nr_accs;
+    for (size_t i = 0; i < main_len; i += nr_accs) {
+        for (size_t k = 0; k < nr_accs; ++k) {
+            acc[k] += (_ARRAY_WIDE_T)a[i + k];
+        }
+    }
+    for (size_t i = main_len; i < len; ++i) {
+        acc[0] += (_ARRAY_WIDE_T)a[i];
+    }
+
+    _ARRAY_WIDE_T sum = 0;
+    for (size_t k = 0; k < nr_accs; ++k) {
+        sum += acc[k];
+    }
+    return sum;
 }
 
 static inline
-_ARRAY_RW(2, 1) FN_ATTR_RETURNS_NONNULL
-_ARRAY_TYPE*
-_ARRAY_FN(qsort)(size_t len, _ARRAY_TYPE a[len])
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_TYPE
+_SARRAY_FN(reduce_add)(const _SMART_ARRAY_T* a)
 {
-    ARRAY_ASSERT_ALIGNED(a);
-    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
-
-    qsort(a, len, sizeof(_ARRAY_TYPE), _ARRAY_FN(qsort_compare));
+    return _ARRAY_FN(reduce_add)(a->len, a->data);
+}
 
-    return a;
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_TYPE
+_SARRAY_FN(reduce_add_serial)(const _SMART_ARRAY_T* a)
+{
+    return _ARRAY_FN(reduce_add_serial)(a->len, a->data);
 }
 
 static inline
-__attribute__((nonnull(1))) FN_ATTR_RETURNS_NONNULL
-_ARRAY_TYPE*
-_SARRAY_FN(qsort)(_SMART_ARRAY_T* a)
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_TYPE
+_SARRAY_FN(reduce_add_simd)(const _SMART_ARRAY_T* a)
 {
-    return _ARRAY_FN(qsort)(a->len, a->data);
+    return _ARRAY_FN(reduce_add_simd)(a->len, a->data);
 }
 
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_TYPE
+_SARRAY_FN(reduce_add_pairwise)(const _SMART_ARRAY_T* a)
+{
+    return _ARRAY_FN(reduce_add_pairwise)(a->len, a->data);
+}
 
 static inline
-_ARRAY_RW(2, 1) FN_ATTR_RETURNS_NONNULL
-_ARRAY_TYPE*
-_ARRAY_FN(random_sequence)(size_t len, _ARRAY_TYPE a[len])
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_TYPE
+_SARRAY_FN(reduce_add_kahan)(const _SMART_ARRAY_T* a)
 {
-    // make a sequence [0, 1, 2, 3, 4...]
-    for (size_t i = 0; i < len; ++i) {
-         a[i] = i;
-    }
+    return _ARRAY_FN(reduce_add_kahan)(a->len, a->data);
+}
 
-    // randomly shuffle elements of the original sequence
-    for (size_t range = len; range > 1; --range) {
-        size_t random_index = rand() % range;
-        _ARRAY_FN(swap_two_pointers)(&a[random_index], &a[range - 1]);
-    }
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_WIDE_T
+_SARRAY_FN(reduce_add_wide)(const _SMART_ARRAY_T* a)
+{
+    return _ARRAY_FN(reduce_add_wide)(a->len, a->data);
+}
 
-    return a;
+#ifdef _ARRAY_SIMD
+/** Shift lanes up by `k`, lane `i` gets lane `i - k`, lower lanes are zero.
+ *
+ */
+static inline
+FN_ATTR_CONST
+_ARRAY_VEC_T
+_ARRAY_FN(vec_shift_lanes_up)(_ARRAY_VEC_T v, size_t k)
+{
+    const _ARRAY_VEC_T zero = {};
+    const _ARRAY_BITS_VEC_T iota = _ARRAY_FN(vec_iota)();
+    const _ARRAY_BITS_VEC_T keep = (_ARRAY_BITS_VEC_T)(iota >= (_ARRAY_BITS_T)k);
+    // Index `lanes` and above select lanes of `zero`.
+    const _ARRAY_BITS_VEC_T index = (keep & (iota - (_ARRAY_BITS_T)k)) |
+        (~keep & (_ARRAY_BITS_T)_ARRAY_VEC_LANES);
+    return __builtin_shuffle(v, zero, index);
 }
 
+/** Inclusive prefix sum of vector lanes in `log2(lanes)` shift-add steps.
+ *
+ */
 static inline
-__attribute__((nonnull(1))) FN_ATTR_RETURNS_NONNULL
-_ARRAY_TYPE*
-_SARRAY_FN(random_sequence)(_SMART_ARRAY_T* a)
+FN_ATTR_CONST
+_ARRAY_VEC_T
+_ARRAY_FN(vec_scan)(_ARRAY_VEC_T v)
 {
-    return _ARRAY_FN(random_sequence)(a->len, a->data);
+    #pragma GCC unroll 8
+    for (size_t k = 1; k < _ARRAY_VEC_LANES; k *= 2) {
+        v += _ARRAY_FN(vec_shift_lanes_up)(v, k);
+    }
+    return v;
 }
+#endif // _ARRAY_SIMD
 
+/** Prefix sum starting from `carry`, inclusive or exclusive, return `carry` + total.
+ *
+ * Output may be the input array.
+ */
 static inline
-_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) _ARRAY_WO(4, 1) FN_ATTR_RETURNS_NONNULL
-_ARRAY_TYPE*
-_ARRAY_FN(add)(
+__attribute__((always_inline))
+_ARRAY_TYPE
+_ARRAY_FN(scan_from)(
     size_t len,
     const _ARRAY_TYPE a[len],
-    const _ARRAY_TYPE b[len],
-          _ARRAY_TYPE c[len])
+          _ARRAY_TYPE b[len],
+    _ARRAY_TYPE carry,
+    bool exclusive)
 {
     ARRAY_ASSERT_ALIGNED(a);
     ARRAY_ASSERT_ALIGNED(b);
-    ARRAY_ASSERT_ALIGNED(c);
     a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
     b = __builtin_assume_aligned(b, _SMART_ARRAY_ALIGN);
-    c = __builtin_assume_aligned(c, _SMART_ARRAY_ALIGN);
 
-    #pragma GCC ivdep
-    for (size_t i = 0; i < len; ++i) {
-         c[i] = a[i] + b[i];
+    size_t vec_len = 0;
+#ifdef _ARRAY_SIMD
+    constexpr size_t lanes = _ARRAY_VEC_LANES;
+    _ARRAY_BITS_VEC_T last = {};
+    last += (_ARRAY_BITS_T)(lanes - 1);
+
+    _ARRAY_VEC_T vcarry = (_ARRAY_VEC_T){} + carry;
+    vec_len = len - len % lanes;
+    for (size_t i = 0; i < vec_len; i += lanes) {
+        const _ARRAY_VEC_T s = _ARRAY_FN(vec_scan)(_ARRAY_FN(vec_load)(&a[i]));
+        const _ARRAY_VEC_T out = exclusive? _ARRAY_FN(vec_shift_lanes_up)(s, 1) : s;
+        *(_ARRAY_VEC_T*)&b[i] = out + vcarry;
+        vcarry += __builtin_shuffle(s, last);
     }
-    return c;
+    carry = vcarry[0];
+#endif // _ARRAY_SIMD
+    for (size_t i = vec_len; i < len; ++i) {
+        const _ARRAY_TYPE x = a[i];
+        if (exclusive) {
+            b[i] = carry;
+            carry += x;
+        } else {
+            carry += x;
+            b[i] = carry;
+        }
+    }
+    return carry;
 }
 
+/** Inclusive prefix sum `b[i] = a[0] + ... + a[i]`, return sum of all elements.
+ *
+ * Each vector is scanned in registers and added to the running total,
+ * so for floating point types rounding differs from a serial loop.
+ * Output may be the input array.
+ */
 static inline
-_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) FN_ATTR_RETURNS_NONNULL
-_ARRAY_TYPE*
-_ARRAY_FN(add_destruct)(
+_ARRAY_RO(2, 1) _ARRAY_WO(3, 1)
+_ARRAY_TYPE
+_ARRAY_FN(scan)(
     size_t len,
-          _ARRAY_TYPE a[len],
-    const _ARRAY_TYPE b[len])
+    const _ARRAY_TYPE a[len],
+          _ARRAY_TYPE b[len])
 {
-    ARRAY_ASSERT_ALIGNED(a);
-    ARRAY_ASSERT_ALIGNED(b);
-    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
-    b = __builtin_assume_aligned(b, _SMART_ARRAY_ALIGN);
+    return _ARRAY_FN(scan_from)(len, a, b, 0, false);
+}
 
-    #pragma GCC ivdep
-    for (size_t i = 0; i < len; ++i) {
-         a[i] = a[i] + b[i];
-    }
-    return a;
+/** Exclusive prefix sum `b[i] = a[0] + ... + a[i-1]`, `b[0] = 0`, return sum of all elements.
+ *
+ * Output may be the input array. Turns lengths of records into their offsets.
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(3, 1)
+_ARRAY_TYPE
+_ARRAY_FN(scan_exclusive)(
+    size_t len,
+    const _ARRAY_TYPE a[len],
+          _ARRAY_TYPE b[len])
+{
+    return _ARRAY_FN(scan_from)(len, a, b, 0, true);
 }
 
 static inline
-FN_ATTR_RETURNS_NONNULL
-_ARRAY_TYPE*
-_SARRAY_FN(add_destruct)(_SMART_ARRAY_T* a, _SMART_ARRAY_T* b)
+__attribute__((nonnull(1, 2)))
+_ARRAY_TYPE
+_SARRAY_FN(scan)(const _SMART_ARRAY_T* a, _SMART_ARRAY_T* b)
 {
     size_t len = (a->len < b->len)? a->len : b->len;
-    return _ARRAY_FN(add_destruct)(len, a->data, b->data);
+    return _ARRAY_FN(scan)(len, a->data, b->data);
 }
 
 static inline
-_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+__attribute__((nonnull(1, 2)))
 _ARRAY_TYPE
-_ARRAY_FN(reduce_add)(
-    size_t len,
-    const _ARRAY_TYPE a[len])
+_SARRAY_FN(scan_exclusive)(const _SMART_ARRAY_T* a, _SMART_ARRAY_T* b)
+{
+    size_t len = (a->len < b->len)? a->len : b->len;
+    return _ARRAY_FN(scan_exclusive)(len, a->data, b->data);
+}
+
+// Number of interleaved sub-histograms, consecutive elements go to different
+// sub-histograms, so a run of equal values does not make every increment wait
+// for the store of the previous one.
+#ifndef SMARTARR_HISTOGRAM_SUBS
+#define SMARTARR_HISTOGRAM_SUBS 4
+#endif
+
+// Histograms with more bins are counted directly, their sub-histograms would
+// not fit in L2 cache and a hot bin is less likely.
+#ifndef SMARTARR_HISTOGRAM_SUBS_MAX_BINS
+#define SMARTARR_HISTOGRAM_SUBS_MAX_BINS 4096
+#endif
+
+/** Add counts of `bin_expr` values to `counts[nbins]`.
+ *
+ * `bin_expr` is the bin of element `_x`, or `nbins` if the element is not counted.
+ * Sub-histograms have an extra bin for such elements, so the counting loop
+ * has no branches.
+ */
+#ifndef _ARRAY_HISTOGRAM
+#define _ARRAY_HISTOGRAM(len, a, nbins, counts, bin_expr) ({ \
+    constexpr size_t _subs = SMARTARR_HISTOGRAM_SUBS; \
+    const size_t _len = (len); \
+    const size_t _nbins = (nbins); \
+    uint64_t* _counts = (counts); \
+    auto_free uint64_t* _sub = NULL; \
+    if (_nbins > 0 && _nbins <= SMARTARR_HISTOGRAM_SUBS_MAX_BINS && _len > _subs * _nbins && \
+        (_sub = calloc(_subs * (_nbins + 1), sizeof(uint64_t))) != NULL) \
+    { \
+        const size_t _main_len = _len - _len % _subs; \
+        for (size_t _i = 0; _i < _main_len; _i += _subs) { \
+            for (size_t _s = 0; _s < _subs; ++_s) { \
+                const typeof((a)[0]) _x = (a)[_i + _s]; \
+                _sub[_s * (_nbins + 1) + (bin_expr)] += 1; \
+            } \
+        } \
+        for (size_t _i = _main_len; _i < _len; ++_i) { \
+            const typeof((a)[0]) _x = (a)[_i]; \
+            _sub[bin_expr] += 1; \
+        } \
+        for (size_t _s = 0; _s < _subs; ++_s) { \
+            for (size_t _b = 0; _b < _nbins; ++_b) { \
+                _counts[_b] += _sub[_s * (_nbins + 1) + _b]; \
+            } \
+        } \
+    } \
+    else { \
+        for (size_t _i = 0; _i < _len; ++_i) { \
+            const typeof((a)[0]) _x = (a)[_i]; \
+            const size_t _b = (bin_expr); \
+            if (_b < _nbins) { \
+                _counts[_b] += 1; \
+            } \
+        } \
+    } \
+    _counts; \
+})
+#endif
+
+/** Bin of `x` in `nbins` equal bins over `[min, max]` with `scale = nbins / (max - min)`.
+ *
+ * Return `nbins` if `x` is out of range or NaN, `max` is in the last bin.
+ */
+static inline
+FN_ATTR_CONST
+size_t
+_ARRAY_FN(uniform_bin)(_ARRAY_TYPE x, _ARRAY_TYPE min, _ARRAY_TYPE max, double scale,
+    size_t nbins)
+{
+    if (!(x >= min && x <= max)) {
+        return nbins;
+    }
+    const size_t bin = ((double)x - (double)min) * scale;
+    return (bin < nbins)? bin : nbins - 1;
+}
+
+/** Count elements in `nbins` equal bins over `[min, max]`, add to `counts`.
+ *
+ * Bins are half-open except the last one that includes `max`,
+ * elements out of range and NaN are not counted. Element close to a bin
+ * edge may be counted in the neighbour bin due to rounding.
+ * Counts are added to `counts`, zero it for a new histogram.
+ *
+ * Example:
+ * ```
+ * uint64_t counts[10] = {};
+ * f64_array_histogram_uniform(len, a, 0.0, 1.0, 10, counts);
+ * ```
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RW(6, 5) FN_ATTR_RETURNS_NONNULL
+uint64_t*
+_ARRAY_FN(histogram_uniform)(size_t len, const _ARRAY_TYPE a[len],
+    _ARRAY_TYPE min, _ARRAY_TYPE max, size_t nbins, uint64_t counts[nbins])
 {
     ARRAY_ASSERT_ALIGNED(a);
     a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+    assert(min < max);
 
-    _ARRAY_TYPE sum = 0;
+    const double scale = nbins / ((double)max - (double)min);
 
-    #pragma GCC ivdep
-    for (size_t i = 0; i < len; ++i) {
-         sum += a[i];
+    return _ARRAY_HISTOGRAM(len, a, nbins, counts,
+        _ARRAY_FN(uniform_bin)(_x, min, max, scale, nbins));
+}
+
+/** Bin of `x` by sorted `edges`, `nedges - 1` if `x` is out of range or NaN.
+ *
+ */
+static inline
+_ARRAY_RO(3, 2) FN_ATTR_PURE
+size_t
+_ARRAY_FN(edges_bin)(_ARRAY_TYPE x, size_t nedges, const _ARRAY_TYPE edges[nedges])
+{
+    const size_t pos = _ARRAY_FN(upper_bound)(nedges, edges, x);
+    if (pos == 0) {
+        return nedges - 1;
     }
-    return sum;
+    if (pos == nedges) {
+        return _ARRAY_TYPE_EQ(x, edges[nedges - 1])? nedges - 2 : nedges - 1;
+    }
+    return pos - 1;
+}
+
+/** Count elements in bins between sorted `edges`, add to `counts[nedges - 1]`.
+ *
+ * Bin `k` is `[edges[k], edges[k + 1])`, the last bin also includes
+ * the last edge, elements out of range and NaN are not counted.
+ * Bin of an element is found by a branchless binary search.
+ * Counts are added to `counts`, zero it for a new histogram.
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(4, 3) __attribute__((nonnull(5))) FN_ATTR_RETURNS_NONNULL
+uint64_t*
+_ARRAY_FN(histogram_edges)(size_t len, const _ARRAY_TYPE a[len],
+    size_t nedges, const _ARRAY_TYPE edges[nedges], uint64_t counts[])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+    assert(nedges >= 2);
+
+    return _ARRAY_HISTOGRAM(len, a, nedges - 1, counts,
+        _ARRAY_FN(edges_bin)(_x, nedges, edges));
 }
 
+/** Bin of integer code `x`, `nbins` if `x` is negative or not less than `nbins`.
+ *
+ */
 static inline
-FN_ATTR_WARN_UNUSED_RESULT
-_ARRAY_TYPE
-_SARRAY_FN(reduce_add)(_SMART_ARRAY_T* a)
+FN_ATTR_CONST
+size_t
+_ARRAY_FN(code_bin)(_ARRAY_TYPE x, size_t nbins)
 {
-    return _ARRAY_FN(reduce_add)(a->len, a->data);
+    if (_ARRAY_TYPE_IS_FLOAT) {
+        return ((double)x >= 0 && (double)x < (double)nbins)? (size_t)x : nbins;
+    }
+    // negative codes wrap around to huge unsigned values
+    return ((uint64_t)x < nbins)? (size_t)x : nbins;
+}
+
+/** Count occurrences of every code in `[0, nbins)`, add to `counts`.
+ *
+ * Codes out of range are not counted, fractional part of
+ * floating point codes is dropped.
+ * Counts are added to `counts`, zero it for a new histogram.
+ *
+ * Example:
+ * ```
+ * uint64_t counts[256] = {};
+ * u32_array_bincount(len, codes, 256, counts);
+ * ```
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RW(4, 3) FN_ATTR_RETURNS_NONNULL
+uint64_t*
+_ARRAY_FN(bincount)(size_t len, const _ARRAY_TYPE a[len], size_t nbins, uint64_t counts[nbins])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    return _ARRAY_HISTOGRAM(len, a, nbins, counts, _ARRAY_FN(code_bin)(_x, nbins));
 }
 
 static inline
@@ -667,16 +4945,40 @@ _MATRIX_FN(matrix_multiply)(_SMART_ARRAY_T* a, _SMART_ARRAY_T* b, _SMART_ARRAY_T
         b->len, b->num_cols, b->data,
         c->len, c->num_cols, c->data);
 }
+#endif // _ARRAY_TYPE_COMPOUND
+
+#include "btree_array.inc.h"
 
 #ifdef _ARRAY_OMP_ENABLE
 #include "omp_array.inc.h"
 #endif
 
+#ifdef _ARRAY_EXTERNAL_SORT_ENABLE
+#include "external_sort.inc.h"
+#endif
+
 
 #undef _SMART_ARRAY
 #undef _SMART_ARRAY_T
+#undef _ARRAY_VEC_T
+#undef _ARRAY_VEC_LANES
+#undef _ARRAY_BITS_T
+#undef _ARRAY_BITS_VEC_T
+#undef _ARRAY_VAL_POS_T
+#undef _ARRAY_MINMAX_T
+#undef _ARRAY_NEEDLES_T
+#undef _ARRAY_TOPK_T
+#undef _ARRAY_WIDE_T
+#undef _ARRAY_STABLE_SORT_MAX_RUNS
+#undef _ARRAY_TYPE_IS_FLOAT
+#undef _ARRAY_TYPE_IS_SIGNED
+#undef _ARRAY_IS_NAN
+#undef _ARRAY_SIMD
+#undef _ARRAY_NATIVE_ORDER
+#undef _ARRAY_NO_SIMD
 #undef _ARRAY_TYPE_EQ
 #undef _ARRAY_TYPE_LT
+#undef _ARRAY_TYPE_COMPOUND
 #undef _ARRAY_RO
 #undef _ARRAY_WO
 #undef _ARRAY_RW
@@ -0,0 +1,164 @@
+/**@file
+ * @brief Static B-tree search index built from a sorted array.
+ * @author Igor Lesik 2023
+ *
+ * Keys of a sorted array are copied into nodes of one cache line each,
+ * node `k` has `B + 1` children `k * (B + 1) + i + 1`, nodes are stored
+ * in BFS order. Search compares the value with all keys of a node
+ * at once and goes down to the child, so each tree level costs
+ * one cache miss and there are log(B + 1) times fewer levels
+ * than steps of binary search.
+ *
+ * Example:
+ * ```
+ * i64_smart_array_qsort(a);
+ * auto_free i64_btree_t* index = i64_btree_new(a);
+ * size_t pos = i64_btree_lower_bound(index, 42);
+ * assert(pos == i64_smart_array_lower_bound(a, 42));
+ * ```
+ */
+
+#define _BTREE   PPCAT(_ARRAY_TYPE_NAME, _btree)
+#define _BTREE_T PPCAT(_ARRAY_TYPE_NAME, _btree_t)
+#define _BTREE_FN(name) PPCAT(_ARRAY_TYPE_NAME, PPCAT(_btree_, name))
+
+#define _BTREE_ALIGN ((_SMART_ARRAY_ALIGN > SMARTARR_L1_DCACHE_CL_SIZE)? \
+    _SMART_ARRAY_ALIGN : SMARTARR_L1_DCACHE_CL_SIZE)
+
+// Number of keys in a node, one node is one cache line.
+#define _BTREE_NODE_LEN (SMARTARR_L1_DCACHE_CL_SIZE / sizeof(_ARRAY_TYPE))
+
+/** Static B-tree index of a sorted array.
+ *
+ * `keys` has `nr_nodes * _BTREE_NODE_LEN` elements, unused slots of
+ * the last nodes repeat the largest key. `pos` maps every key slot
+ * to the position of the key in the original array.
+ */
+typedef struct _BTREE {
+    size_t len;
+    size_t nr_nodes;
+    size_t* pos;
+    _ARRAY_TYPE keys[] __attribute__((aligned(SMARTARR_L1_DCACHE_CL_SIZE)));
+} _BTREE_T;
+
+static inline
+__attribute__((nonnull(1, 2, 3)))
+void
+_BTREE_FN(build_node)(_BTREE_T* self, const _ARRAY_TYPE a[], size_t* next, size_t k)
+{
+    constexpr size_t B = _BTREE_NODE_LEN;
+
+    if (k >= self->nr_nodes) {
+        return;
+    }
+
+    // in-order traversal: child 0, key 0, child 1, key 1 ... child B
+    for (size_t i = 0; i < B; ++i) {
+        _BTREE_FN(build_node)(self, a, next, k * (B + 1) + i + 1);
+        const size_t t = *next;
+        self->keys[k * B + i] = a[(t < self->len)? t : self->len - 1];
+        self->pos[k * B + i] = (t < self->len)? t : self->len;
+        ++(*next);
+    }
+    _BTREE_FN(build_node)(self, a, next, k * (B + 1) + B + 1);
+}
+
+/** Build search index from array sorted by `_ARRAY_TYPE_LT`.
+ *
+ * Index is one heap allocation, release it with `free`,
+ * NULL is returned if allocation fails.
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+_BTREE_T*
+_BTREE_FN(new_from_array)(size_t len, const _ARRAY_TYPE a[len])
+{
+    constexpr size_t B = _BTREE_NODE_LEN;
+    const size_t nr_nodes = (len + B - 1) / B;
+    const size_t keys_size = nr_nodes * B * sizeof(_ARRAY_TYPE);
+    const size_t pos_size = nr_nodes * B * sizeof(size_t);
+    size_t size = sizeof(_BTREE_T) + keys_size + pos_size;
+    size = ((size + _BTREE_ALIGN - 1) / _BTREE_ALIGN) * _BTREE_ALIGN;
+
+    _BTREE_T* self = (_BTREE_T*) aligned_alloc(_BTREE_ALIGN, size);
+    if (self == NULL) {
+        return NULL;
+    }
+    self->len = len;
+    self->nr_nodes = nr_nodes;
+    self->pos = (size_t*)((char*)self->keys + keys_size);
+
+    size_t next = 0;
+    _BTREE_FN(build_node)(self, a, &next, 0);
+
+    return self;
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+_BTREE_T*
+_BTREE_FN(new)(const _SMART_ARRAY_T* a)
+{
+    return _BTREE_FN(new_from_array)(a->len, a->data);
+}
+
+/** Return number of keys in a node that are less than the value.
+ *
+ */
+static inline
+__attribute__((nonnull(1))) FN_ATTR_PURE
+size_t
+_BTREE_FN(node_rank)(const _ARRAY_TYPE node[], _ARRAY_TYPE val)
+{
+    constexpr size_t B = _BTREE_NODE_LEN;
+
+#ifdef _ARRAY_SIMD
+    node = __builtin_assume_aligned(node, SMARTARR_L1_DCACHE_CL_SIZE);
+    constexpr size_t lanes = _ARRAY_VEC_LANES;
+    const _ARRAY_VEC_T v = (_ARRAY_VEC_T){} + val;
+
+    // keys in a node are sorted, so count of lesser keys is the child index
+    size_t rank = 0;
+    #pragma GCC unroll 8
+    for (size_t i = 0; i < B; i += lanes) {
+        simd_i8_t lt = (simd_i8_t)(_ARRAY_FN(vec_load)(&node[i]) < v);
+        rank += __builtin_popcountll(simd_movemask_lanes(lt, sizeof(_ARRAY_TYPE)));
+    }
+    return rank;
+#else
+    size_t rank = 0;
+    for (size_t i = 0; i < B; ++i) {
+        rank += _ARRAY_TYPE_LT(node[i], val)? 1:0;
+    }
+    return rank;
+#endif
+}
+
+/** Return position of the first element that is not less than the value.
+ *
+ * Same result as `lower_bound` on the original sorted array.
+ */
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT FN_ATTR_PURE
+size_t
+_BTREE_FN(lower_bound)(const _BTREE_T* self, _ARRAY_TYPE val)
+{
+    constexpr size_t B = _BTREE_NODE_LEN;
+
+    size_t res = SIZE_MAX;
+    size_t k = 0;
+
+    while (k < self->nr_nodes) {
+        size_t i = _BTREE_FN(node_rank)(&self->keys[k * B], val);
+        res = (i < B)? k * B + i : res;
+        k = k * (B + 1) + i + 1;
+    }
+
+    return (res == SIZE_MAX)? self->len : self->pos[res];
+}
+
+#undef _BTREE
+#undef _BTREE_T
+#undef _BTREE_FN
+#undef _BTREE_ALIGN
+#undef _BTREE_NODE_LEN
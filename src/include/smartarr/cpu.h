@@ -21,4 +21,10 @@
 
 #endif
 
+// Number of elements processed by a thread at once when array is split into chunks,
+// must be a multiple of 64 to keep chunks aligned and bitmap words not shared.
+#ifndef SMARTARR_OMP_CHUNK_LEN
+#define SMARTARR_OMP_CHUNK_LEN (64 * 1024)
+#endif
+
 constexpr size_t SMARTARR_L1_DCACHE_SIZE = SMARTARR_L1_DCACHE_SIZE_KB * 1024;
@@ -97,8 +97,7 @@ static inline void cleanup_free(void* p) {
  * pos=6 bits=1000000
  */
 #define for_each_bit(bits, pos) \
-    for (unsigned int pos = ctz(bits); bits; \
-        bits &= bits - 1, pos = ctz(bits))
+    for (unsigned int pos; bits && (pos = ctz(bits), 1); bits &= bits - 1)
 
 /** IF-ELSE statement that returns a value. 
  *
@@ -145,6 +144,11 @@ static inline void cleanup_free(void* p) {
 typedef optional_type(int) optional_int_t;
 typedef optional_type(unsigned int) optional_uint_t;
 
+/** Half-open range of array indices [first, last).
+ *
+ */
+typedef struct { size_t first; size_t last; } index_range_t;
+
 /** Macro to define value type with an error.
  *
  * Example:
@@ -211,6 +215,29 @@ typedef optional_type(unsigned int) optional_uint_t;
  */
 #define fixlen_array_len(a) ((sizeof(a)) / (sizeof(a[0])))
 
+/** Atomically set `*p` to `val` if `val` is less.
+ *
+ * Example:
+ * ```
+ * size_t first = SIZE_MAX;
+ * #pragma omp parallel for
+ * for (size_t i = 0; i < len; ++i) {
+ *     if (a[i] == 7) atomic_min_size(&first, i);
+ * }
+ * ```
+ */
+static inline
+__attribute__((nonnull(1)))
+void
+atomic_min_size(size_t* p, size_t val)
+{
+    size_t cur = __atomic_load_n(p, __ATOMIC_RELAXED);
+    while (val < cur &&
+        !__atomic_compare_exchange_n(p, &cur, val, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
 /** Return index in array that represents a matrix.
  *
  *
@@ -0,0 +1,482 @@
+/**@file
+ * @brief External sort of a file of raw typed values that does not fit in memory.
+ * @author Igor Lesik 2023
+ *
+ * Included by `array.inc.h` when `_ARRAY_EXTERNAL_SORT_ENABLE` is defined.
+ *
+ * Input file is read in chunks that fit in the memory budget, every chunk
+ * is sorted in memory with the fastest sort for the type and appended
+ * as a run to a temporary file. Runs are merged with a loser tree,
+ * every run is read and the output is written with large sequential
+ * buffers, so the disk sees only long sequential reads and writes.
+ * Number of runs merged at once is limited by the memory budget,
+ * more runs are merged in several passes through a second temporary file.
+ *
+ * Example:
+ * ```
+ * #define _ARRAY_EXTERNAL_SORT_ENABLE
+ * #include "smartarr/basic_type_array.h"
+ *
+ * smartarr_external_sort_config_t config = {
+ *     .memory_budget = 1ull << 30, .nr_threads = 8, .tmp_dir = "/scratch"};
+ * auto res = u64_array_external_sort("keys.bin", "keys.sorted.bin", &config);
+ * if (res.iserr) perror(strerror(res.error));
+ * ```
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifndef SMARTARR_EXTERNAL_SORT_TYPES
+#define SMARTARR_EXTERNAL_SORT_TYPES
+
+/** Budgets of `external_sort`, zero fields take default values.
+ *
+ */
+typedef struct {
+    size_t memory_budget; ///< bytes for the chunk being sorted and merge buffers
+    unsigned int nr_threads; ///< threads to sort a chunk, needs `_ARRAY_OMP_ENABLE`
+    const char* tmp_dir; ///< directory for run files
+} smartarr_external_sort_config_t;
+
+/** Number of sorted elements or `errno` value of the failed operation.
+ *
+ */
+typedef error_value_type(size_t, int) smartarr_external_sort_result_t;
+
+#endif // SMARTARR_EXTERNAL_SORT_TYPES
+
+#ifndef SMARTARR_EXTERNAL_SORT_MEMORY_BUDGET
+#define SMARTARR_EXTERNAL_SORT_MEMORY_BUDGET (256 * 1024 * 1024)
+#endif
+
+#ifndef SMARTARR_EXTERNAL_SORT_TMP_DIR
+#define SMARTARR_EXTERNAL_SORT_TMP_DIR "/tmp"
+#endif
+
+// Smallest read buffer of a run in merge, smaller reads are too slow on disks.
+#ifndef SMARTARR_EXTERNAL_SORT_MIN_BUFFER
+#define SMARTARR_EXTERNAL_SORT_MIN_BUFFER (64 * 1024)
+#endif
+
+#define _EXTSORT_RUN_T PPCAT(_ARRAY_TYPE_NAME, _external_sort_run_t)
+
+/** Sorted run being merged, elements `[begin, end)` of the file are not read yet,
+ * `buf[pos..len)` are read but not merged yet.
+ */
+typedef struct {
+    size_t begin;
+    size_t end;
+    _ARRAY_TYPE* buf;
+    size_t pos;
+    size_t len;
+    bool done;
+} _EXTSORT_RUN_T;
+
+/** Sort chunk in memory with the fastest sort available for the type.
+ *
+ */
+static inline
+_ARRAY_RW(2, 1) _ARRAY_RW(3, 1)
+void
+_ARRAY_FN(external_sort_chunk)(size_t len, _ARRAY_TYPE a[len], _ARRAY_TYPE scratch[len],
+    unsigned int nr_threads)
+{
+#ifdef _ARRAY_OMP_ENABLE
+    if (nr_threads > 1) {
+        const int saved_nr_threads = omp_get_max_threads();
+        omp_set_num_threads(nr_threads);
+        PPCAT(_ARRAY_TYPE_NAME, _omp_array_sort)(len, a, scratch);
+        omp_set_num_threads(saved_nr_threads);
+        return;
+    }
+#else
+    (void)nr_threads;
+#endif
+#ifdef _ARRAY_NATIVE_ORDER
+    _ARRAY_FN(radix_sort)(len, a, scratch);
+#else
+    (void)scratch;
+    _ARRAY_FN(sort)(len, a);
+#endif
+}
+
+/** Create temporary file in `dir` that is deleted when closed.
+ *
+ */
+static inline
+__attribute__((nonnull(1)))
+FILE*
+_ARRAY_FN(external_sort_tmpfile)(const char* dir)
+{
+    char path[4096];
+    if (snprintf(path, sizeof(path), "%s/smartarr_run_XXXXXX", dir) >= (int)sizeof(path)) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return NULL;
+    }
+    unlink(path);
+    FILE* file = fdopen(fd, "w+b");
+    if (file == NULL) {
+        close(fd);
+    }
+    return file;
+}
+
+/** Read up to `len` elements, return number of elements read or -1 with `errno` set.
+ *
+ * File with length that is not a multiple of the element size is an error.
+ */
+static inline
+__attribute__((nonnull(1, 3)))
+ssize_t
+_ARRAY_FN(external_sort_read)(FILE* file, size_t len, _ARRAY_TYPE buf[len])
+{
+    const size_t nr_bytes = fread(buf, 1, len * sizeof(_ARRAY_TYPE), file);
+    if (ferror(file)) {
+        errno = EIO;
+        return -1;
+    }
+    if (nr_bytes % sizeof(_ARRAY_TYPE) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    return nr_bytes / sizeof(_ARRAY_TYPE);
+}
+
+static inline
+__attribute__((nonnull(1, 3)))
+bool
+_ARRAY_FN(external_sort_write)(FILE* file, size_t len, const _ARRAY_TYPE buf[len])
+{
+    if (fwrite(buf, sizeof(_ARRAY_TYPE), len, file) != len) {
+        errno = (errno != 0)? errno : EIO;
+        return false;
+    }
+    return true;
+}
+
+/** Return true if run `x` goes before run `y`, `nr_runs` is a run that always wins.
+ *
+ * Equal elements are taken from the earlier run, so merge is stable.
+ */
+static inline
+__attribute__((nonnull(1)))
+bool
+_ARRAY_FN(external_sort_beats)(const _EXTSORT_RUN_T runs[], size_t nr_runs, size_t x, size_t y)
+{
+    if (x == nr_runs) return true;
+    if (y == nr_runs) return false;
+    if (runs[x].done) return false;
+    if (runs[y].done) return true;
+
+    const _ARRAY_TYPE a = runs[x].buf[runs[x].pos];
+    const _ARRAY_TYPE b = runs[y].buf[runs[y].pos];
+    return _ARRAY_TYPE_LT(a, b) || (!_ARRAY_TYPE_LT(b, a) && x < y);
+}
+
+/** Replay matches of run `s` from its leaf to the root of the loser tree.
+ *
+ * Internal node `t` keeps the loser of the match, the winner goes up,
+ * `tree[0]` is the overall winner. Only log2(nr_runs) comparisons
+ * with the losers on the path are needed after a run advances.
+ */
+static inline
+__attribute__((nonnull(1, 3)))
+void
+_ARRAY_FN(external_sort_adjust)(const _EXTSORT_RUN_T runs[], size_t nr_runs, size_t tree[], size_t s)
+{
+    for (size_t t = (s + nr_runs) / 2; t > 0; t /= 2) {
+        if (_ARRAY_FN(external_sort_beats)(runs, nr_runs, tree[t], s)) {
+            const size_t winner = tree[t];
+            tree[t] = s;
+            s = winner;
+        }
+    }
+    tree[0] = s;
+}
+
+/** Read next part of the run from file `fd` into its buffer of `buf_len` elements.
+ *
+ * Return false with `errno` set on I/O error.
+ */
+static inline
+__attribute__((nonnull(2)))
+bool
+_ARRAY_FN(external_sort_fill)(int fd, _EXTSORT_RUN_T* run, size_t buf_len)
+{
+    const size_t n = (run->end - run->begin < buf_len)? run->end - run->begin : buf_len;
+    char* dst = (char*)run->buf;
+    size_t nr_bytes = n * sizeof(_ARRAY_TYPE);
+    off_t offset = run->begin * sizeof(_ARRAY_TYPE);
+
+    while (nr_bytes > 0) {
+        const ssize_t r = pread(fd, dst, nr_bytes, offset);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            errno = (r == 0)? EIO : errno; // run file is shorter than the run
+            return false;
+        }
+        dst += r;
+        offset += r;
+        nr_bytes -= r;
+    }
+
+    run->begin += n;
+    run->pos = 0;
+    run->len = n;
+    run->done = (n == 0);
+    return true;
+}
+
+/** Merge sorted runs of file `fd` into the output file with loser tree.
+ *
+ * `bufs` has `nr_runs + 1` buffers of `buf_len` elements, the first one
+ * is the output buffer, `tree` has `nr_runs` nodes.
+ * Return false with `errno` set on I/O error.
+ */
+static inline
+__attribute__((nonnull(2, 4, 6, 7)))
+bool
+_ARRAY_FN(external_sort_merge)(int fd, _EXTSORT_RUN_T runs[], size_t nr_runs, FILE* out,
+    size_t buf_len, _ARRAY_TYPE bufs[], size_t tree[])
+{
+    _ARRAY_TYPE* out_buf = bufs;
+
+    for (size_t r = 0; r < nr_runs; ++r) {
+        runs[r].buf = &bufs[(r + 1) * buf_len];
+        if (!_ARRAY_FN(external_sort_fill)(fd, &runs[r], buf_len)) {
+            return false;
+        }
+    }
+
+    // virtual run `nr_runs` wins all matches, every real run replaces it
+    for (size_t t = 0; t < nr_runs; ++t) {
+        tree[t] = nr_runs;
+    }
+    for (size_t r = nr_runs; r-- > 0;) {
+        _ARRAY_FN(external_sort_adjust)(runs, nr_runs, tree, r);
+    }
+
+    size_t out_len = 0;
+    while (!runs[tree[0]].done) {
+        _EXTSORT_RUN_T* run = &runs[tree[0]];
+        out_buf[out_len++] = run->buf[run->pos++];
+        if (out_len == buf_len) {
+            if (!_ARRAY_FN(external_sort_write)(out, out_len, out_buf)) {
+                return false;
+            }
+            out_len = 0;
+        }
+        if (run->pos == run->len && !_ARRAY_FN(external_sort_fill)(fd, run, buf_len)) {
+            return false;
+        }
+        _ARRAY_FN(external_sort_adjust)(runs, nr_runs, tree, tree[0]);
+    }
+
+    return _ARRAY_FN(external_sort_write)(out, out_len, out_buf);
+}
+
+/** Merge runs stored one after another in `files[0]` into the output file.
+ *
+ * At most `memory_budget / SMARTARR_EXTERNAL_SORT_MIN_BUFFER - 1` runs,
+ * but not less than 2, are merged at once, so buffers fit in the budget.
+ * While there are more runs, groups of runs are merged into runs of
+ * `files[1]`, created in `tmp_dir` if it is NULL, and the files swap.
+ * Only these two files are open however many runs there are.
+ * Return false with `errno` set on error.
+ */
+static inline
+__attribute__((nonnull(1, 2, 4, 6)))
+bool
+_ARRAY_FN(external_sort_merge_runs)(FILE* files[2], _EXTSORT_RUN_T runs[], size_t nr_runs,
+    FILE* out, size_t memory_budget, const char* tmp_dir)
+{
+    size_t fan_in = memory_budget / SMARTARR_EXTERNAL_SORT_MIN_BUFFER;
+    fan_in = (fan_in > 3)? fan_in - 1 : 2;
+    fan_in = (nr_runs < fan_in)? nr_runs : fan_in;
+
+    size_t buf_len = memory_budget / ((fan_in + 1) * sizeof(_ARRAY_TYPE));
+    if (buf_len * sizeof(_ARRAY_TYPE) < SMARTARR_EXTERNAL_SORT_MIN_BUFFER) {
+        buf_len = SMARTARR_EXTERNAL_SORT_MIN_BUFFER / sizeof(_ARRAY_TYPE);
+    }
+
+    auto_free _ARRAY_TYPE* bufs = malloc((fan_in + 1) * buf_len * sizeof(_ARRAY_TYPE));
+    auto_free size_t* tree = malloc(fan_in * sizeof(size_t));
+    if (bufs == NULL || tree == NULL) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    while (nr_runs > fan_in) {
+        if (files[1] == NULL) {
+            files[1] = _ARRAY_FN(external_sort_tmpfile)(tmp_dir);
+            if (files[1] == NULL) {
+                return false;
+            }
+        }
+        rewind(files[1]);
+        if (fflush(files[0]) != 0) {
+            return false;
+        }
+
+        // merged runs replace the first runs of the table, they are already read
+        size_t nr_merged = 0;
+        size_t offset = 0;
+        for (size_t r = 0; r < nr_runs; r += fan_in) {
+            const size_t n = (nr_runs - r < fan_in)? nr_runs - r : fan_in;
+            const size_t len = runs[r + n - 1].end - runs[r].begin;
+            if (!_ARRAY_FN(external_sort_merge)(fileno(files[0]), &runs[r], n, files[1],
+                buf_len, bufs, tree))
+            {
+                return false;
+            }
+            runs[nr_merged++] = (_EXTSORT_RUN_T){.begin = offset, .end = offset + len};
+            offset += len;
+        }
+        nr_runs = nr_merged;
+
+        FILE* tmp = files[0]; files[0] = files[1]; files[1] = tmp;
+    }
+
+    if (fflush(files[0]) != 0) {
+        return false;
+    }
+    return _ARRAY_FN(external_sort_merge)(fileno(files[0]), runs, nr_runs, out,
+        buf_len, bufs, tree);
+}
+
+/** Sort file of raw `_ARRAY_TYPE` values into another file.
+ *
+ * Memory used is about `config->memory_budget`, half of it holds
+ * the chunk being sorted and half is the sort scratch. Single run
+ * is written straight to the output, otherwise runs go to an unlinked
+ * temporary file in `config->tmp_dir` and are merged in as many passes
+ * as the budget needs, see `external_sort_merge_runs`. Budgets below
+ * 3 * `SMARTARR_EXTERNAL_SORT_MIN_BUFFER` are exceeded in merge
+ * by the smallest read buffers.
+ * `config` can be NULL for defaults: 256 MB, one thread, `/tmp`.
+ * Return number of sorted elements or `errno` of the failed operation,
+ * output file is incomplete on error.
+ */
+static inline
+__attribute__((nonnull(1, 2))) FN_ATTR_WARN_UNUSED_RESULT
+smartarr_external_sort_result_t
+_ARRAY_FN(external_sort)(const char* in_path, const char* out_path,
+    const smartarr_external_sort_config_t* config)
+{
+    const smartarr_external_sort_config_t defaults = {};
+    if (config == NULL) {
+        config = &defaults;
+    }
+    const size_t memory_budget = (config->memory_budget > 0)?
+        config->memory_budget : SMARTARR_EXTERNAL_SORT_MEMORY_BUDGET;
+    const unsigned int nr_threads = (config->nr_threads > 0)? config->nr_threads : 1;
+    const char* tmp_dir = (config->tmp_dir != NULL)? config->tmp_dir : SMARTARR_EXTERNAL_SORT_TMP_DIR;
+
+    const size_t min_chunk_len = (64 > _SMART_ARRAY_ALIGN)? 64 : _SMART_ARRAY_ALIGN;
+    size_t chunk_len = memory_budget / (2 * sizeof(_ARRAY_TYPE));
+    chunk_len = (chunk_len > min_chunk_len)? chunk_len : min_chunk_len;
+
+#define _EXTSORT_FAIL() ({ \
+    smartarr_external_sort_result_t _res = {.error = errno, .iserr = true}; \
+    if (in) fclose(in); \
+    if (out) fclose(out); \
+    if (files[0]) fclose(files[0]); \
+    if (files[1]) fclose(files[1]); \
+    free(runs); \
+    _res; })
+
+    FILE* in = NULL;
+    FILE* out = NULL;
+    FILE* files[2] = {};
+    _EXTSORT_RUN_T* runs = NULL;
+    size_t nr_runs = 0;
+    size_t total_len = 0;
+
+    in = fopen(in_path, "rb");
+    if (in == NULL) {
+        return _EXTSORT_FAIL();
+    }
+
+    {
+        auto_free _SMART_ARRAY_T* chunk = _SARRAY_FN(heap_new)(chunk_len);
+        auto_free _SMART_ARRAY_T* scratch = _SARRAY_FN(heap_new)(chunk_len);
+        if (chunk == NULL || scratch == NULL) {
+            errno = ENOMEM;
+            return _EXTSORT_FAIL();
+        }
+
+        for (;;) {
+            ssize_t n = _ARRAY_FN(external_sort_read)(in, chunk_len, chunk->data);
+            if (n < 0) {
+                return _EXTSORT_FAIL();
+            }
+            if (n == 0 && nr_runs > 0) {
+                break;
+            }
+            total_len += n;
+            _ARRAY_FN(external_sort_chunk)(n, chunk->data, scratch->data, nr_threads);
+
+            // all input fits in one chunk, no merge needed
+            if (nr_runs == 0 && (size_t)n < chunk_len) {
+                out = fopen(out_path, "wb");
+                if (out == NULL || !_ARRAY_FN(external_sort_write)(out, n, chunk->data)) {
+                    return _EXTSORT_FAIL();
+                }
+                break;
+            }
+
+            _EXTSORT_RUN_T* more = realloc(runs, (nr_runs + 1) * sizeof(_EXTSORT_RUN_T));
+            if (more == NULL) {
+                errno = ENOMEM;
+                return _EXTSORT_FAIL();
+            }
+            runs = more;
+            if (files[0] == NULL) {
+                files[0] = _ARRAY_FN(external_sort_tmpfile)(tmp_dir);
+                if (files[0] == NULL) {
+                    return _EXTSORT_FAIL();
+                }
+            }
+            runs[nr_runs] = (_EXTSORT_RUN_T){.begin = total_len - n, .end = total_len};
+            ++nr_runs;
+            if (!_ARRAY_FN(external_sort_write)(files[0], n, chunk->data)) {
+                return _EXTSORT_FAIL();
+            }
+        }
+    }
+
+    if (nr_runs > 0) {
+        out = fopen(out_path, "wb");
+        if (out == NULL || !_ARRAY_FN(external_sort_merge_runs)(files, runs, nr_runs, out,
+            memory_budget, tmp_dir))
+        {
+            return _EXTSORT_FAIL();
+        }
+    }
+
+    if (fclose(out) != 0) {
+        out = NULL;
+        return _EXTSORT_FAIL();
+    }
+    out = NULL;
+    fclose(in);
+    in = NULL;
+    if (files[0]) fclose(files[0]);
+    if (files[1]) fclose(files[1]);
+    free(runs);
+
+#undef _EXTSORT_FAIL
+
+    return (smartarr_external_sort_result_t){.value = total_len, .iserr = false};
+}
+
+#undef _EXTSORT_RUN_T
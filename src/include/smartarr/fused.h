@@ -0,0 +1,154 @@
+/**@file
+ * @brief     Fused element-wise expressions without temporary arrays.
+ * @author    Igor Lesik 2023
+ * @copyright Igor Lesik 2023
+ *
+ * Chain of element-wise kernels like `d = a*b + c - e` makes a pass through
+ * memory per operation and needs temporary arrays. `ARRAY_FUSED_KERNEL`
+ * generates one loop from the whole expression instead, each input is read
+ * once and the output is written once, the vectorized body and the tail
+ * are in the same function.
+ *
+ * Example:
+ *
+ * ```
+ * #include "smartarr/basic_type_array.h"
+ * #include "smartarr/fused.h"
+ *
+ * // out = a*b + c - e
+ * ARRAY_FUSED_KERNEL(f64, mul_add_sub, (a, b, c, e), a * b + c - e)
+ *
+ * f64_array_mul_add_sub(len, a, b, c, e, d);
+ * f64_smart_array_mul_add_sub(sa, sb, sc, se, sd);
+ * f64_omp_array_mul_add_sub(len, a, b, c, e, d); // with _ARRAY_OMP_ENABLE
+ * ```
+ *
+ * Inside the expression the input names stand for elements of the inputs.
+ */
+#pragma once
+
+#include <stddef.h>
+
+#include "smartarr/defines.h"
+#include "smartarr/cpu.h"
+
+#define _FUSED_COMMA() ,
+#define _FUSED_SEMICOL() ;
+
+// Apply `m(ctx, x)` to each of up to 8 arguments, separated by `sep()`.
+#define _FUSED_MAP1(m, sep, ctx, x) m(ctx, x)
+#define _FUSED_MAP2(m, sep, ctx, x, ...) m(ctx, x) sep() _FUSED_MAP1(m, sep, ctx, __VA_ARGS__)
+#define _FUSED_MAP3(m, sep, ctx, x, ...) m(ctx, x) sep() _FUSED_MAP2(m, sep, ctx, __VA_ARGS__)
+#define _FUSED_MAP4(m, sep, ctx, x, ...) m(ctx, x) sep() _FUSED_MAP3(m, sep, ctx, __VA_ARGS__)
+#define _FUSED_MAP5(m, sep, ctx, x, ...) m(ctx, x) sep() _FUSED_MAP4(m, sep, ctx, __VA_ARGS__)
+#define _FUSED_MAP6(m, sep, ctx, x, ...) m(ctx, x) sep() _FUSED_MAP5(m, sep, ctx, __VA_ARGS__)
+#define _FUSED_MAP7(m, sep, ctx, x, ...) m(ctx, x) sep() _FUSED_MAP6(m, sep, ctx, __VA_ARGS__)
+#define _FUSED_MAP8(m, sep, ctx, x, ...) m(ctx, x) sep() _FUSED_MAP7(m, sep, ctx, __VA_ARGS__)
+
+#define _FUSED_MAP_(m, sep, ctx, ...) \
+    _GET_NTH_ARG("ignored", __VA_ARGS__, \
+    _FUSED_MAP_TOO_MANY_INPUTS, _FUSED_MAP_TOO_MANY_INPUTS, _FUSED_MAP_TOO_MANY_INPUTS, \
+    _FUSED_MAP_TOO_MANY_INPUTS, _FUSED_MAP_TOO_MANY_INPUTS, \
+    _FUSED_MAP8, _FUSED_MAP7, _FUSED_MAP6, _FUSED_MAP5, \
+    _FUSED_MAP4, _FUSED_MAP3, _FUSED_MAP2, _FUSED_MAP1, _FUSED_MAP0)(m, sep, ctx, __VA_ARGS__)
+#define _FUSED_MAP(m, sep, ctx, ...) _FUSED_MAP_(m, sep, ctx, __VA_ARGS__)
+
+#define _FUSED_UNPACK(...) __VA_ARGS__
+
+// Element type of `T##_smart_array_t` and alignment of its data.
+#define _FUSED_ELEM_T(T) typeof(((T##_smart_array_t*)0)->data[0])
+#define _FUSED_ALIGN(T) __alignof__(((T##_smart_array_t*)0)->data)
+
+#define _FUSED_IN_PARAM(T, x) const _FUSED_ELEM_T(T) _fused_in_##x[len]
+#define _FUSED_IN_ASSERT_ALIGNED(T, x) ARRAY_ASSERT_ALIGNED(_fused_in_##x)
+#define _FUSED_IN_ASSUME_ALIGNED(T, x) \
+    _fused_in_##x = __builtin_assume_aligned(_fused_in_##x, _FUSED_ALIGN(T))
+#define _FUSED_IN_LOAD(T, x) const _FUSED_ELEM_T(T) x = _fused_in_##x[_i]
+#define _FUSED_IN_ARG(T, x) _fused_in_##x
+#define _FUSED_IN_CHUNK_ARG(T, x) &_fused_in_##x[_i]
+#define _FUSED_SIN_PARAM(T, x) const T##_smart_array_t* _fused_in_##x
+#define _FUSED_SIN_MIN_LEN(T, x) len = (_fused_in_##x->len < len)? _fused_in_##x->len : len
+#define _FUSED_SIN_ARG(T, x) _fused_in_##x->data
+
+/** Define fused element-wise kernel `out[i] = expr` for array type `T`.
+ *
+ * Generates
+ *   `T_array_name(len, in..., out)`,
+ *   `T_smart_array_name(in..., out)` on the shortest length,
+ *   `T_omp_array_name(len, in..., out)` and `T_omp_smart_array_name(in..., out)`
+ *   when `_ARRAY_OMP_ENABLE` is defined.
+ *
+ * `inputs` is a parenthesized list of 1 to 8 input names used in `expr`.
+ * Output may be one of the inputs.
+ */
+#define ARRAY_FUSED_KERNEL(T, name, inputs, expr) \
+static inline \
+FN_ATTR_RETURNS_NONNULL \
+_FUSED_ELEM_T(T)* \
+T##_array_##name( \
+    size_t len, \
+    _FUSED_MAP(_FUSED_IN_PARAM, _FUSED_COMMA, T, _FUSED_UNPACK inputs), \
+    _FUSED_ELEM_T(T) out[len]) \
+{ \
+    _FUSED_MAP(_FUSED_IN_ASSERT_ALIGNED, _FUSED_SEMICOL, T, _FUSED_UNPACK inputs); \
+    ARRAY_ASSERT_ALIGNED(out); \
+    _FUSED_MAP(_FUSED_IN_ASSUME_ALIGNED, _FUSED_SEMICOL, T, _FUSED_UNPACK inputs); \
+    out = __builtin_assume_aligned(out, _FUSED_ALIGN(T)); \
+    _Pragma("GCC ivdep") \
+    for (size_t _i = 0; _i < len; ++_i) { \
+        _FUSED_MAP(_FUSED_IN_LOAD, _FUSED_SEMICOL, T, _FUSED_UNPACK inputs); \
+        out[_i] = (expr); \
+    } \
+    return out; \
+} \
+\
+static inline \
+FN_ATTR_RETURNS_NONNULL \
+_FUSED_ELEM_T(T)* \
+T##_smart_array_##name( \
+    _FUSED_MAP(_FUSED_SIN_PARAM, _FUSED_COMMA, T, _FUSED_UNPACK inputs), \
+    T##_smart_array_t* out) \
+{ \
+    size_t len = out->len; \
+    _FUSED_MAP(_FUSED_SIN_MIN_LEN, _FUSED_SEMICOL, T, _FUSED_UNPACK inputs); \
+    return T##_array_##name(len, \
+        _FUSED_MAP(_FUSED_SIN_ARG, _FUSED_COMMA, T, _FUSED_UNPACK inputs), out->data); \
+} \
+_FUSED_OMP_KERNEL(T, name, inputs)
+
+#ifdef _ARRAY_OMP_ENABLE
+// Parallel version runs the serial kernel on aligned chunks.
+#define _FUSED_OMP_KERNEL(T, name, inputs) \
+static inline \
+FN_ATTR_RETURNS_NONNULL \
+_FUSED_ELEM_T(T)* \
+T##_omp_array_##name( \
+    size_t len, \
+    _FUSED_MAP(_FUSED_IN_PARAM, _FUSED_COMMA, T, _FUSED_UNPACK inputs), \
+    _FUSED_ELEM_T(T) out[len]) \
+{ \
+    const size_t _chunk_len = SMARTARR_OMP_CHUNK_LEN; \
+    _Pragma("omp parallel for schedule(static) if (len > _chunk_len)") \
+    for (size_t _i = 0; _i < len; _i += _chunk_len) { \
+        const size_t _n = (len - _i < _chunk_len)? len - _i : _chunk_len; \
+        T##_array_##name(_n, \
+            _FUSED_MAP(_FUSED_IN_CHUNK_ARG, _FUSED_COMMA, T, _FUSED_UNPACK inputs), &out[_i]); \
+    } \
+    return out; \
+} \
+\
+static inline \
+FN_ATTR_RETURNS_NONNULL \
+_FUSED_ELEM_T(T)* \
+T##_omp_smart_array_##name( \
+    _FUSED_MAP(_FUSED_SIN_PARAM, _FUSED_COMMA, T, _FUSED_UNPACK inputs), \
+    T##_smart_array_t* out) \
+{ \
+    size_t len = out->len; \
+    _FUSED_MAP(_FUSED_SIN_MIN_LEN, _FUSED_SEMICOL, T, _FUSED_UNPACK inputs); \
+    return T##_omp_array_##name(len, \
+        _FUSED_MAP(_FUSED_SIN_ARG, _FUSED_COMMA, T, _FUSED_UNPACK inputs), out->data); \
+}
+#else
+#define _FUSED_OMP_KERNEL(T, name, inputs)
+#endif // _ARRAY_OMP_ENABLE
@@ -0,0 +1,109 @@
+/**@file
+ * @brief     Histograms of smart arrays counted into a new `u64` smart array.
+ * @author    Igor Lesik 2023
+ * @copyright Igor Lesik 2023
+ *
+ * Counting kernels `histogram_uniform`, `histogram_edges` and `bincount`
+ * are generated for every array type by `array.inc.h` and add to a raw
+ * `uint64_t` array of counts. Functions here wrap them for smart arrays
+ * and return a new zeroed `u64_smart_array_t` of counts, one per bin,
+ * or NULL if it cannot be allocated.
+ *
+ * Example:
+ *
+ * ```
+ * #define _ARRAY_OMP_ENABLE
+ * #include "smartarr/histogram.h"
+ *
+ * auto_free u64_smart_array_t* h = f64_smart_array_histogram_uniform(a, 0.0, 1.0, 100);
+ * auto_free u64_smart_array_t* c = u32_omp_smart_array_bincount(codes, 256);
+ * ```
+ *
+ * `ARRAY_HISTOGRAM_FUNCTIONS(T)` generates the same functions for
+ * other array types instantiated after `basic_type_array.h`.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "smartarr/defines.h"
+#include "smartarr/basic_type_array.h"
+
+// Element type of `T##_smart_array_t`.
+#define _HISTOGRAM_ELEM_T(T) typeof(((T##_smart_array_t*)0)->data[0])
+
+/** Define smart array histograms of array type `T` with prefix `P`,
+ * `T_smart_array` for serial and `T_omp_smart_array` for OMP kernels.
+ */
+#define _ARRAY_HISTOGRAM_FUNCTIONS(T, P, kernel) \
+static inline \
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT \
+u64_smart_array_t* \
+P##_histogram_uniform(const T##_smart_array_t* a, \
+    _HISTOGRAM_ELEM_T(T) min, _HISTOGRAM_ELEM_T(T) max, size_t nbins) \
+{ \
+    u64_smart_array_t* counts = u64_smart_array_heap_new(nbins); \
+    if (counts == NULL) { \
+        return NULL; \
+    } \
+    u64_smart_array_fill(counts, 0); \
+    kernel##_histogram_uniform(a->len, a->data, min, max, nbins, counts->data); \
+    return counts; \
+} \
+\
+static inline \
+__attribute__((nonnull(1, 2))) FN_ATTR_WARN_UNUSED_RESULT \
+u64_smart_array_t* \
+P##_histogram_edges(const T##_smart_array_t* a, const T##_smart_array_t* edges) \
+{ \
+    assert(edges->len >= 2); \
+    u64_smart_array_t* counts = u64_smart_array_heap_new(edges->len - 1); \
+    if (counts == NULL) { \
+        return NULL; \
+    } \
+    u64_smart_array_fill(counts, 0); \
+    kernel##_histogram_edges(a->len, a->data, edges->len, edges->data, counts->data); \
+    return counts; \
+} \
+\
+static inline \
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT \
+u64_smart_array_t* \
+P##_bincount(const T##_smart_array_t* a, size_t nbins) \
+{ \
+    u64_smart_array_t* counts = u64_smart_array_heap_new(nbins); \
+    if (counts == NULL) { \
+        return NULL; \
+    } \
+    u64_smart_array_fill(counts, 0); \
+    kernel##_bincount(a->len, a->data, nbins, counts->data); \
+    return counts; \
+}
+
+#ifdef _ARRAY_OMP_ENABLE
+#define _ARRAY_OMP_HISTOGRAM_FUNCTIONS(T) \
+    _ARRAY_HISTOGRAM_FUNCTIONS(T, T##_omp_smart_array, T##_omp_array)
+#else
+#define _ARRAY_OMP_HISTOGRAM_FUNCTIONS(T)
+#endif
+
+/** Define histograms of smart arrays of type `T`, with OMP versions
+ * if `_ARRAY_OMP_ENABLE` is defined.
+ *
+ * Generates
+ *   `T_smart_array_histogram_uniform(a, min, max, nbins)`,
+ *   `T_smart_array_histogram_edges(a, edges)`,
+ *   `T_smart_array_bincount(a, nbins)`,
+ * every function returns a new `u64_smart_array_t` of counts or NULL.
+ */
+#define ARRAY_HISTOGRAM_FUNCTIONS(T) \
+    _ARRAY_HISTOGRAM_FUNCTIONS(T, T##_smart_array, T##_array) \
+    _ARRAY_OMP_HISTOGRAM_FUNCTIONS(T)
+
+ARRAY_HISTOGRAM_FUNCTIONS(i64)
+ARRAY_HISTOGRAM_FUNCTIONS(u64)
+ARRAY_HISTOGRAM_FUNCTIONS(i32)
+ARRAY_HISTOGRAM_FUNCTIONS(u32)
+ARRAY_HISTOGRAM_FUNCTIONS(f64)
+ARRAY_HISTOGRAM_FUNCTIONS(f32)
@@ -4,28 +4,282 @@
 #define _OMP_SARRAY_FN(name) PPCAT(_ARRAY_TYPE_NAME, PPCAT(_omp_smart_array_, name))
 #define _OMP_MATRIX_FN(name) PPCAT(_ARRAY_TYPE_NAME, PPCAT(_omp_matrix_, name))
 
+/** Find the first chunk hit in parallel and return it as `optional_uint_t`.
+ *
+ * `find_in_chunk` is a serial search of `_n` elements at `_chunk`.
+ * Lowest hit found so far is published through an atomic,
+ * threads skip chunks that start after it, so the search stops soon
+ * after the first hit and the result is the same as of serial search.
+ */
+#ifndef _OMP_FIND_FIRST
+#define _OMP_FIND_FIRST(len, a, find_in_chunk) ({ \
+    const size_t _len = (len); \
+    const size_t _chunk_len = SMARTARR_OMP_CHUNK_LEN; \
+    size_t _first = SIZE_MAX; \
+    _Pragma("omp parallel for schedule(dynamic) if (_len > _chunk_len)") \
+    for (size_t _i = 0; _i < _len; _i += _chunk_len) { \
+        if (_i >= __atomic_load_n(&_first, __ATOMIC_RELAXED)) { \
+            continue; \
+        } \
+        const size_t _n = (_len - _i < _chunk_len)? _len - _i : _chunk_len; \
+        const typeof(&(a)[0]) _chunk = &(a)[_i]; \
+        optional_uint_t _pos = (find_in_chunk); \
+        if (_pos.present) { \
+            atomic_min_size(&_first, _i + _pos.value); \
+        } \
+    } \
+    (_first == SIZE_MAX)? (optional_uint_t){.present = false} : \
+        (optional_uint_t){.present = true, .value = _first}; \
+})
+#endif
+
+/** Run `kernel_call` on aligned chunks in parallel.
+ *
+ * `kernel_call` is a serial kernel call on `_n` elements starting at `_i`.
+ */
+#ifndef _OMP_FOR_EACH_CHUNK
+#define _OMP_FOR_EACH_CHUNK(len, kernel_call) do { \
+    const size_t _len = (len); \
+    const size_t _chunk_len = SMARTARR_OMP_CHUNK_LEN; \
+    _Pragma("omp parallel for schedule(static) if (_len > _chunk_len)") \
+    for (size_t _i = 0; _i < _len; _i += _chunk_len) { \
+        const size_t _n = (_len - _i < _chunk_len)? _len - _i : _chunk_len; \
+        kernel_call; \
+    } \
+} while (0)
+#endif
+
+#ifndef _ARRAY_TYPE_COMPOUND
+#ifndef _OMP_ARRAY_GEN_BINARY
+// Parallel versions of the element-wise kernels from `_ARRAY_GEN_BINARY`.
+#define _OMP_ARRAY_GEN_BINARY(name) \
+static inline \
+_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) _ARRAY_WO(4, 1) FN_ATTR_RETURNS_NONNULL \
+_ARRAY_TYPE* \
+_OMP_ARRAY_FN(name)( \
+    size_t len, \
+    const _ARRAY_TYPE a[len], \
+    const _ARRAY_TYPE b[len], \
+          _ARRAY_TYPE c[len]) \
+{ \
+    _OMP_FOR_EACH_CHUNK(len, _ARRAY_FN(name)(_n, &a[_i], &b[_i], &c[_i])); \
+    return c; \
+} \
+\
+static inline \
+_ARRAY_RW(2, 1) _ARRAY_RO(3, 1) FN_ATTR_RETURNS_NONNULL \
+_ARRAY_TYPE* \
+_OMP_ARRAY_FN(name##_destruct)( \
+    size_t len, \
+          _ARRAY_TYPE a[len], \
+    const _ARRAY_TYPE b[len]) \
+{ \
+    _OMP_FOR_EACH_CHUNK(len, _ARRAY_FN(name##_destruct)(_n, &a[_i], &b[_i])); \
+    return a; \
+} \
+\
+static inline \
+__attribute__((nonnull(1, 2, 3))) FN_ATTR_RETURNS_NONNULL \
+_ARRAY_TYPE* \
+_OMP_SARRAY_FN(name)(const _SMART_ARRAY_T* a, const _SMART_ARRAY_T* b, _SMART_ARRAY_T* c) \
+{ \
+    size_t len = (a->len < b->len)? a->len : b->len; \
+    len = (len < c->len)? len : c->len; \
+    return _OMP_ARRAY_FN(name)(len, a->data, b->data, c->data); \
+} \
+\
+static inline \
+__attribute__((nonnull(1, 2))) FN_ATTR_RETURNS_NONNULL \
+_ARRAY_TYPE* \
+_OMP_SARRAY_FN(name##_destruct)(_SMART_ARRAY_T* a, const _SMART_ARRAY_T* b) \
+{ \
+    size_t len = (a->len < b->len)? a->len : b->len; \
+    return _OMP_ARRAY_FN(name##_destruct)(len, a->data, b->data); \
+}
+
+// Parallel versions of the element-wise kernels from `_ARRAY_GEN_UNARY`.
+#define _OMP_ARRAY_GEN_UNARY(name) \
+static inline \
+_ARRAY_RO(2, 1) _ARRAY_WO(3, 1) FN_ATTR_RETURNS_NONNULL \
+_ARRAY_TYPE* \
+_OMP_ARRAY_FN(name)( \
+    size_t len, \
+    const _ARRAY_TYPE a[len], \
+          _ARRAY_TYPE b[len]) \
+{ \
+    _OMP_FOR_EACH_CHUNK(len, _ARRAY_FN(name)(_n, &a[_i], &b[_i])); \
+    return b; \
+} \
+\
+static inline \
+_ARRAY_RW(2, 1) FN_ATTR_RETURNS_NONNULL \
+_ARRAY_TYPE* \
+_OMP_ARRAY_FN(name##_destruct)(size_t len, _ARRAY_TYPE a[len]) \
+{ \
+    _OMP_FOR_EACH_CHUNK(len, _ARRAY_FN(name##_destruct)(_n, &a[_i])); \
+    return a; \
+} \
+\
+static inline \
+__attribute__((nonnull(1, 2))) FN_ATTR_RETURNS_NONNULL \
+_ARRAY_TYPE* \
+_OMP_SARRAY_FN(name)(const _SMART_ARRAY_T* a, _SMART_ARRAY_T* b) \
+{ \
+    size_t len = (a->len < b->len)? a->len : b->len; \
+    return _OMP_ARRAY_FN(name)(len, a->data, b->data); \
+} \
+\
+static inline \
+__attribute__((nonnull(1))) FN_ATTR_RETURNS_NONNULL \
+_ARRAY_TYPE* \
+_OMP_SARRAY_FN(name##_destruct)(_SMART_ARRAY_T* a) \
+{ \
+    return _OMP_ARRAY_FN(name##_destruct)(a->len, a->data); \
+}
+#endif // _OMP_ARRAY_GEN_BINARY
+
+_OMP_ARRAY_GEN_BINARY(add)
+_OMP_ARRAY_GEN_BINARY(sub)
+_OMP_ARRAY_GEN_BINARY(mul)
+_OMP_ARRAY_GEN_BINARY(div)
+_OMP_ARRAY_GEN_BINARY(min)
+_OMP_ARRAY_GEN_BINARY(max)
+_OMP_ARRAY_GEN_UNARY(neg)
+_OMP_ARRAY_GEN_UNARY(abs)
+
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(4, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_ARRAY_FN(scale)(
+    size_t len,
+    const _ARRAY_TYPE a[len],
+    _ARRAY_TYPE s,
+          _ARRAY_TYPE b[len])
+{
+    _OMP_FOR_EACH_CHUNK(len, _ARRAY_FN(scale)(_n, &a[_i], s, &b[_i]));
+    return b;
+}
+
+static inline
+_ARRAY_RW(2, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_ARRAY_FN(scale_destruct)(size_t len, _ARRAY_TYPE a[len], _ARRAY_TYPE s)
+{
+    _OMP_FOR_EACH_CHUNK(len, _ARRAY_FN(scale_destruct)(_n, &a[_i], s));
+    return a;
+}
+
+static inline
+__attribute__((nonnull(1, 3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_SARRAY_FN(scale)(const _SMART_ARRAY_T* a, _ARRAY_TYPE s, _SMART_ARRAY_T* b)
+{
+    size_t len = (a->len < b->len)? a->len : b->len;
+    return _OMP_ARRAY_FN(scale)(len, a->data, s, b->data);
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_SARRAY_FN(scale_destruct)(_SMART_ARRAY_T* a, _ARRAY_TYPE s)
+{
+    return _OMP_ARRAY_FN(scale_destruct)(a->len, a->data, s);
+}
+
+static inline
+_ARRAY_RO(3, 1) _ARRAY_RO(4, 1) _ARRAY_WO(5, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_ARRAY_FN(axpy)(
+    size_t len,
+    _ARRAY_TYPE alpha,
+    const _ARRAY_TYPE x[len],
+    const _ARRAY_TYPE y[len],
+          _ARRAY_TYPE z[len])
+{
+    _OMP_FOR_EACH_CHUNK(len, _ARRAY_FN(axpy)(_n, alpha, &x[_i], &y[_i], &z[_i]));
+    return z;
+}
+
+static inline
+_ARRAY_RO(3, 1) _ARRAY_RW(4, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_ARRAY_FN(axpy_destruct)(
+    size_t len,
+    _ARRAY_TYPE alpha,
+    const _ARRAY_TYPE x[len],
+          _ARRAY_TYPE y[len])
+{
+    _OMP_FOR_EACH_CHUNK(len, _ARRAY_FN(axpy_destruct)(_n, alpha, &x[_i], &y[_i]));
+    return y;
+}
+
+static inline
+__attribute__((nonnull(2, 3, 4))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_SARRAY_FN(axpy)(_ARRAY_TYPE alpha, const _SMART_ARRAY_T* x, const _SMART_ARRAY_T* y,
+    _SMART_ARRAY_T* z)
+{
+    size_t len = (x->len < y->len)? x->len : y->len;
+    len = (len < z->len)? len : z->len;
+    return _OMP_ARRAY_FN(axpy)(len, alpha, x->data, y->data, z->data);
+}
+
+static inline
+__attribute__((nonnull(2, 3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_SARRAY_FN(axpy_destruct)(_ARRAY_TYPE alpha, const _SMART_ARRAY_T* x, _SMART_ARRAY_T* y)
+{
+    size_t len = (x->len < y->len)? x->len : y->len;
+    return _OMP_ARRAY_FN(axpy_destruct)(len, alpha, x->data, y->data);
+}
+
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) _ARRAY_RO(4, 1) _ARRAY_WO(5, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_ARRAY_FN(fma)(
+    size_t len,
+    const _ARRAY_TYPE a[len],
+    const _ARRAY_TYPE b[len],
+    const _ARRAY_TYPE c[len],
+          _ARRAY_TYPE d[len])
+{
+    _OMP_FOR_EACH_CHUNK(len, _ARRAY_FN(fma)(_n, &a[_i], &b[_i], &c[_i], &d[_i]));
+    return d;
+}
+
 static inline
-_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) _ARRAY_WO(4, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) _ARRAY_RW(4, 1) FN_ATTR_RETURNS_NONNULL
 _ARRAY_TYPE*
-_OMP_ARRAY_FN(add)(
+_OMP_ARRAY_FN(fma_destruct)(
     size_t len,
     const _ARRAY_TYPE a[len],
     const _ARRAY_TYPE b[len],
           _ARRAY_TYPE c[len])
 {
-    ARRAY_ASSERT_ALIGNED(a);
-    ARRAY_ASSERT_ALIGNED(b);
-    ARRAY_ASSERT_ALIGNED(c);
-    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
-    b = __builtin_assume_aligned(b, _SMART_ARRAY_ALIGN);
-    c = __builtin_assume_aligned(c, _SMART_ARRAY_ALIGN);
+    _OMP_FOR_EACH_CHUNK(len, _ARRAY_FN(fma_destruct)(_n, &a[_i], &b[_i], &c[_i]));
+    return c;
+}
 
-    #pragma omp parallel for if (len > 1024)
-    for (size_t i = 0; i < len; ++i) {
-         c[i] = a[i] + b[i];
-    }
+static inline
+__attribute__((nonnull(1, 2, 3, 4))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_SARRAY_FN(fma)(const _SMART_ARRAY_T* a, const _SMART_ARRAY_T* b, const _SMART_ARRAY_T* c,
+    _SMART_ARRAY_T* d)
+{
+    size_t len = (a->len < b->len)? a->len : b->len;
+    len = (len < c->len)? len : c->len;
+    len = (len < d->len)? len : d->len;
+    return _OMP_ARRAY_FN(fma)(len, a->data, b->data, c->data, d->data);
+}
 
-    return c;
+static inline
+__attribute__((nonnull(1, 2, 3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_SARRAY_FN(fma_destruct)(const _SMART_ARRAY_T* a, const _SMART_ARRAY_T* b, _SMART_ARRAY_T* c)
+{
+    size_t len = (a->len < b->len)? a->len : b->len;
+    len = (len < c->len)? len : c->len;
+    return _OMP_ARRAY_FN(fma_destruct)(len, a->data, b->data, c->data);
 }
 
 static inline
@@ -55,32 +309,261 @@ _OMP_SARRAY_FN(reduce_add)(_SMART_ARRAY_T* a)
     return _OMP_ARRAY_FN(reduce_add)(a->len, a->data);
 }
 
+/** Parallel prefix sum in two passes over `SMARTARR_OMP_CHUNK_LEN` chunks.
+ *
+ * First pass sums chunks, sums are scanned serially into chunk offsets,
+ * second pass scans every chunk from its offset. Chunks do not depend
+ * on the number of threads, so the result is the same for any number
+ * of threads, for floating point types it may differ from the serial scan
+ * by rounding. Falls back to serial scan if memory allocation fails.
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(3, 1)
+_ARRAY_TYPE
+_OMP_ARRAY_FN(scan_from)(
+    size_t len,
+    const _ARRAY_TYPE a[len],
+          _ARRAY_TYPE b[len],
+    bool exclusive)
+{
+    constexpr size_t chunk_len = SMARTARR_OMP_CHUNK_LEN;
+    const size_t nr_chunks = (len + chunk_len - 1) / chunk_len;
+
+    _ARRAY_TYPE* offsets = (nr_chunks > 1)? malloc(nr_chunks * sizeof(_ARRAY_TYPE)) : NULL;
+    if (offsets == NULL) {
+        return _ARRAY_FN(scan_from)(len, a, b, 0, exclusive);
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (size_t c = 0; c < nr_chunks; ++c) {
+        const size_t i = c * chunk_len;
+        const size_t n = (len - i < chunk_len)? len - i : chunk_len;
+        offsets[c] = _ARRAY_FN(reduce_add_simd)(n, &a[i]);
+    }
+
+    _ARRAY_TYPE total = 0;
+    for (size_t c = 0; c < nr_chunks; ++c) {
+        const _ARRAY_TYPE sum = offsets[c];
+        offsets[c] = total;
+        total += sum;
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (size_t c = 0; c < nr_chunks; ++c) {
+        const size_t i = c * chunk_len;
+        const size_t n = (len - i < chunk_len)? len - i : chunk_len;
+        if (exclusive) {
+            (void)_ARRAY_FN(scan_from)(n, &a[i], &b[i], offsets[c], true);
+        } else {
+            (void)_ARRAY_FN(scan_from)(n, &a[i], &b[i], offsets[c], false);
+        }
+    }
+
+    free(offsets);
+    return total;
+}
+
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(3, 1)
+_ARRAY_TYPE
+_OMP_ARRAY_FN(scan)(
+    size_t len,
+    const _ARRAY_TYPE a[len],
+          _ARRAY_TYPE b[len])
+{
+    return _OMP_ARRAY_FN(scan_from)(len, a, b, false);
+}
+
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(3, 1)
+_ARRAY_TYPE
+_OMP_ARRAY_FN(scan_exclusive)(
+    size_t len,
+    const _ARRAY_TYPE a[len],
+          _ARRAY_TYPE b[len])
+{
+    return _OMP_ARRAY_FN(scan_from)(len, a, b, true);
+}
+
+static inline
+__attribute__((nonnull(1, 2)))
+_ARRAY_TYPE
+_OMP_SARRAY_FN(scan)(const _SMART_ARRAY_T* a, _SMART_ARRAY_T* b)
+{
+    size_t len = (a->len < b->len)? a->len : b->len;
+    return _OMP_ARRAY_FN(scan)(len, a->data, b->data);
+}
+
+static inline
+__attribute__((nonnull(1, 2)))
+_ARRAY_TYPE
+_OMP_SARRAY_FN(scan_exclusive)(const _SMART_ARRAY_T* a, _SMART_ARRAY_T* b)
+{
+    size_t len = (a->len < b->len)? a->len : b->len;
+    return _OMP_ARRAY_FN(scan_exclusive)(len, a->data, b->data);
+}
+
+/** Run histogram `kernel_call` on parts of the array in parallel and merge the bins.
+ *
+ * Every thread counts a contiguous part of `_n` elements at `_i` into
+ * its own zeroed copy of bins `_mine`, copies are added to `counts` at the end,
+ * so threads never write to the same bins. Falls back to serial counting
+ * if memory allocation fails.
+ */
+#ifndef _OMP_HISTOGRAM
+#define _OMP_HISTOGRAM(len, nbins, counts, kernel_call) ({ \
+    const size_t _len = (len); \
+    const size_t _nbins = (nbins); \
+    uint64_t* _counts = (counts); \
+    const size_t _nr_threads = omp_get_max_threads(); \
+    auto_free uint64_t* _acc = NULL; \
+    if (_len <= SMARTARR_OMP_CHUNK_LEN || _nr_threads < 2 || \
+        (_acc = calloc(_nr_threads * _nbins + 1, sizeof(uint64_t))) == NULL) \
+    { \
+        uint64_t* _mine = _counts; \
+        const size_t _i = 0, _n = _len; \
+        kernel_call; \
+    } \
+    else { \
+        const size_t _part = ((_len + _nr_threads - 1) / _nr_threads + 63) & ~(size_t)63; \
+        _Pragma("omp parallel for schedule(static)") \
+        for (size_t _t = 0; _t < _nr_threads; ++_t) { \
+            const size_t _i = _t * _part; \
+            if (_i < _len) { \
+                const size_t _n = (_len - _i < _part)? _len - _i : _part; \
+                uint64_t* _mine = &_acc[_t * _nbins]; \
+                kernel_call; \
+            } \
+        } \
+        _Pragma("omp parallel for if (_nbins > SMARTARR_OMP_CHUNK_LEN)") \
+        for (size_t _b = 0; _b < _nbins; ++_b) { \
+            for (size_t _t = 0; _t < _nr_threads; ++_t) { \
+                _counts[_b] += _acc[_t * _nbins + _b]; \
+            } \
+        } \
+    } \
+    _counts; \
+})
+#endif
+
+/** Parallel `histogram_uniform`, see `_OMP_HISTOGRAM`.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RW(6, 5) FN_ATTR_RETURNS_NONNULL
+uint64_t*
+_OMP_ARRAY_FN(histogram_uniform)(size_t len, const _ARRAY_TYPE a[len],
+    _ARRAY_TYPE min, _ARRAY_TYPE max, size_t nbins, uint64_t counts[nbins])
+{
+    return _OMP_HISTOGRAM(len, nbins, counts,
+        _ARRAY_FN(histogram_uniform)(_n, &a[_i], min, max, nbins, _mine));
+}
+
+/** Parallel `histogram_edges`, see `_OMP_HISTOGRAM`.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(4, 3) __attribute__((nonnull(5))) FN_ATTR_RETURNS_NONNULL
+uint64_t*
+_OMP_ARRAY_FN(histogram_edges)(size_t len, const _ARRAY_TYPE a[len],
+    size_t nedges, const _ARRAY_TYPE edges[nedges], uint64_t counts[])
+{
+    assert(nedges >= 2);
+    return _OMP_HISTOGRAM(len, nedges - 1, counts,
+        _ARRAY_FN(histogram_edges)(_n, &a[_i], nedges, edges, _mine));
+}
+
+/** Parallel `bincount`, see `_OMP_HISTOGRAM`.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RW(4, 3) FN_ATTR_RETURNS_NONNULL
+uint64_t*
+_OMP_ARRAY_FN(bincount)(size_t len, const _ARRAY_TYPE a[len], size_t nbins, uint64_t counts[nbins])
+{
+    return _OMP_HISTOGRAM(len, nbins, counts,
+        _ARRAY_FN(bincount)(_n, &a[_i], nbins, _mine));
+}
+#endif // _ARRAY_TYPE_COMPOUND
+
+/** Find minimum and maximum elements, see `find_minmax`.
+ *
+ * Every thread finds min/max of its chunks with SIMD,
+ * results are merged by custom reduction.
+ */
 static inline
 _ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
-size_t
-_OMP_ARRAY_FN(find_max)(size_t len, const _ARRAY_TYPE a[len])
+_ARRAY_MINMAX_T
+_OMP_ARRAY_FN(find_minmax)(size_t len, const _ARRAY_TYPE a[len])
 {
     ARRAY_ASSERT_ALIGNED(a);
     a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
 
-    typedef struct { _ARRAY_TYPE val; size_t pos; } val_pos_tuple_t;
-    val_pos_tuple_t max_pos = {a[0], 0};
+    constexpr size_t chunk_len = SMARTARR_OMP_CHUNK_LEN;
+    _ARRAY_MINMAX_T minmax = {.min = {a[0], 0}, .max = {a[0], 0}};
 
-    #pragma omp declare reduction(get_max : val_pos_tuple_t :\
-        omp_out = omp_out.val > omp_in.val ? omp_out : omp_in)\
+    #pragma omp declare reduction(get_minmax : _ARRAY_MINMAX_T :\
+        omp_out = _ARRAY_FN(minmax_merge)(omp_out, omp_in))\
         initializer (omp_priv=(omp_orig))
 
-    #pragma omp parallel
-    {
-        #pragma omp for nowait reduction(get_max : max_pos)
-        for (size_t i = 0; i < len; ++i) {
-            if (a[i] > max_pos.val) { 
-                max_pos.val = a[i];
-                max_pos.pos = i;
-            }
-        }
+    #pragma omp parallel for reduction(get_minmax : minmax) if (len > chunk_len)
+    for (size_t i = 0; i < len; i += chunk_len) {
+        size_t n = (len - i < chunk_len)? len - i : chunk_len;
+        _ARRAY_MINMAX_T chunk = _ARRAY_FN(find_minmax)(n, &a[i]);
+        chunk.min.pos += i;
+        chunk.max.pos += i;
+        minmax = _ARRAY_FN(minmax_merge)(minmax, chunk);
     }
-    return max_pos.pos;
+
+    return minmax;
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_MINMAX_T
+_OMP_SARRAY_FN(find_minmax)(const _SMART_ARRAY_T* a)
+{
+    return _OMP_ARRAY_FN(find_minmax)(a->len, a->data);
+}
+
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_VAL_POS_T
+_OMP_ARRAY_FN(find_min_val)(size_t len, const _ARRAY_TYPE a[len])
+{
+    return _OMP_ARRAY_FN(find_minmax)(len, a).min;
+}
+
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+_ARRAY_VAL_POS_T
+_OMP_ARRAY_FN(find_max_val)(size_t len, const _ARRAY_TYPE a[len])
+{
+    return _OMP_ARRAY_FN(find_minmax)(len, a).max;
+}
+
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_OMP_ARRAY_FN(find_min)(size_t len, const _ARRAY_TYPE a[len])
+{
+    return _OMP_ARRAY_FN(find_minmax)(len, a).min.pos;
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_OMP_SARRAY_FN(find_min)(_SMART_ARRAY_T* a)
+{
+    return _OMP_ARRAY_FN(find_min)(a->len, a->data);
+}
+
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_OMP_ARRAY_FN(find_max)(size_t len, const _ARRAY_TYPE a[len])
+{
+    return _OMP_ARRAY_FN(find_minmax)(len, a).max.pos;
 }
 
 static inline
@@ -91,6 +574,914 @@ _OMP_SARRAY_FN(find_max)(_SMART_ARRAY_T* a)
     return _OMP_ARRAY_FN(find_max)(a->len, a->data);
 }
 
+/** Find first element equal to the value, see `find`.
+ *
+ * Example:
+ * ```
+ * auto pos = f64_omp_array_find(a->len, a->data, 7.0);
+ * assert(pos.present == f64_array_find(a->len, a->data, 7.0).present);
+ * ```
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+optional_uint_t
+_OMP_ARRAY_FN(find)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val_to_find)
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    return _OMP_FIND_FIRST(len, a, _ARRAY_FN(find)(_n, _chunk, val_to_find));
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+optional_uint_t
+_OMP_SARRAY_FN(find)(_SMART_ARRAY_T* a, _ARRAY_TYPE val)
+{
+    return _OMP_ARRAY_FN(find)(a->len, a->data, val);
+}
+
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_OMP_ARRAY_FN(count)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val)
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    constexpr size_t chunk_len = SMARTARR_OMP_CHUNK_LEN;
+    size_t count = 0;
+
+    #pragma omp parallel for reduction (+:count) if (len > chunk_len)
+    for (size_t i = 0; i < len; i += chunk_len) {
+        size_t n = (len - i < chunk_len)? len - i : chunk_len;
+        count += _ARRAY_FN(count)(n, &a[i], val);
+    }
+    return count;
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_OMP_SARRAY_FN(count)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val)
+{
+    return _OMP_ARRAY_FN(count)(a->len, a->data, val);
+}
+
+/** Find first element equal to any of the needles, see `find_any`.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(4, 3) FN_ATTR_WARN_UNUSED_RESULT
+optional_uint_t
+_OMP_ARRAY_FN(find_any)(size_t len, const _ARRAY_TYPE a[len],
+    size_t nr_needles, const _ARRAY_TYPE needles[nr_needles])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    _ARRAY_NEEDLES_T set;
+    _ARRAY_FN(needles_init)(&set, nr_needles, needles);
+
+    return _OMP_FIND_FIRST(len, a, _ARRAY_FN(needles_find)(_n, _chunk, &set));
+}
+
+static inline
+__attribute__((nonnull(1, 2))) FN_ATTR_WARN_UNUSED_RESULT
+optional_uint_t
+_OMP_SARRAY_FN(find_any)(const _SMART_ARRAY_T* a, const _SMART_ARRAY_T* needles)
+{
+    return _OMP_ARRAY_FN(find_any)(a->len, a->data, needles->len, needles->data);
+}
+
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(4, 3) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_OMP_ARRAY_FN(count_any)(size_t len, const _ARRAY_TYPE a[len],
+    size_t nr_needles, const _ARRAY_TYPE needles[nr_needles])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    _ARRAY_NEEDLES_T set;
+    _ARRAY_FN(needles_init)(&set, nr_needles, needles);
+
+    constexpr size_t chunk_len = SMARTARR_OMP_CHUNK_LEN;
+    size_t count = 0;
+
+    #pragma omp parallel for reduction (+:count) if (len > chunk_len)
+    for (size_t i = 0; i < len; i += chunk_len) {
+        size_t n = (len - i < chunk_len)? len - i : chunk_len;
+        count += _ARRAY_FN(needles_count)(n, &a[i], &set);
+    }
+    return count;
+}
+
+static inline
+__attribute__((nonnull(1, 2))) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_OMP_SARRAY_FN(count_any)(const _SMART_ARRAY_T* a, const _SMART_ARRAY_T* needles)
+{
+    return _OMP_ARRAY_FN(count_any)(a->len, a->data, needles->len, needles->data);
+}
+
+#ifndef _ARRAY_TYPE_COMPOUND
+/** Find first element within tolerance of the value, see `find_within`.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+optional_uint_t
+_OMP_ARRAY_FN(find_within)(size_t len, const _ARRAY_TYPE a[len],
+    _ARRAY_TYPE val, _ARRAY_TYPE tolerance)
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    return _OMP_FIND_FIRST(len, a, _ARRAY_FN(find_within)(_n, _chunk, val, tolerance));
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+optional_uint_t
+_OMP_SARRAY_FN(find_within)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val, _ARRAY_TYPE tolerance)
+{
+    return _OMP_ARRAY_FN(find_within)(a->len, a->data, val, tolerance);
+}
+
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_OMP_ARRAY_FN(count_within)(size_t len, const _ARRAY_TYPE a[len],
+    _ARRAY_TYPE val, _ARRAY_TYPE tolerance)
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    constexpr size_t chunk_len = SMARTARR_OMP_CHUNK_LEN;
+    size_t count = 0;
+
+    #pragma omp parallel for reduction (+:count) if (len > chunk_len)
+    for (size_t i = 0; i < len; i += chunk_len) {
+        size_t n = (len - i < chunk_len)? len - i : chunk_len;
+        count += _ARRAY_FN(count_within)(n, &a[i], val, tolerance);
+    }
+    return count;
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_OMP_SARRAY_FN(count_within)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val, _ARRAY_TYPE tolerance)
+{
+    return _OMP_ARRAY_FN(count_within)(a->len, a->data, val, tolerance);
+}
+
+/** Find first element at most `max_ulps` apart from the value, see `find_within_ulps`.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+optional_uint_t
+_OMP_ARRAY_FN(find_within_ulps)(size_t len, const _ARRAY_TYPE a[len],
+    _ARRAY_TYPE val, _ARRAY_BITS_T max_ulps)
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    return _OMP_FIND_FIRST(len, a, _ARRAY_FN(find_within_ulps)(_n, _chunk, val, max_ulps));
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+optional_uint_t
+_OMP_SARRAY_FN(find_within_ulps)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val, _ARRAY_BITS_T max_ulps)
+{
+    return _OMP_ARRAY_FN(find_within_ulps)(a->len, a->data, val, max_ulps);
+}
+
+static inline
+_ARRAY_RO(2, 1) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_OMP_ARRAY_FN(count_within_ulps)(size_t len, const _ARRAY_TYPE a[len],
+    _ARRAY_TYPE val, _ARRAY_BITS_T max_ulps)
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    constexpr size_t chunk_len = SMARTARR_OMP_CHUNK_LEN;
+    size_t count = 0;
+
+    #pragma omp parallel for reduction (+:count) if (len > chunk_len)
+    for (size_t i = 0; i < len; i += chunk_len) {
+        size_t n = (len - i < chunk_len)? len - i : chunk_len;
+        count += _ARRAY_FN(count_within_ulps)(n, &a[i], val, max_ulps);
+    }
+    return count;
+}
+
+static inline
+__attribute__((nonnull(1))) FN_ATTR_WARN_UNUSED_RESULT
+size_t
+_OMP_SARRAY_FN(count_within_ulps)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val, _ARRAY_BITS_T max_ulps)
+{
+    return _OMP_ARRAY_FN(count_within_ulps)(a->len, a->data, val, max_ulps);
+}
+#endif // _ARRAY_TYPE_COMPOUND
+
+static inline
+_ARRAY_RO(2, 1) __attribute__((nonnull(4)))
+size_t
+_OMP_ARRAY_FN(find_all_bitmap)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val,
+    uint64_t bitmap[])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    constexpr size_t chunk_len = SMARTARR_OMP_CHUNK_LEN;
+    size_t count = 0;
+
+    // chunks are multiple of 64, so threads never write the same bitmap word
+    #pragma omp parallel for reduction (+:count) if (len > chunk_len)
+    for (size_t i = 0; i < len; i += chunk_len) {
+        size_t n = (len - i < chunk_len)? len - i : chunk_len;
+        count += _ARRAY_FN(find_all_bitmap)(n, &a[i], val, &bitmap[i / 64]);
+    }
+    return count;
+}
+
+static inline
+__attribute__((nonnull(1, 3)))
+size_t
+_OMP_SARRAY_FN(find_all_bitmap)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val, uint64_t bitmap[])
+{
+    return _OMP_ARRAY_FN(find_all_bitmap)(a->len, a->data, val, bitmap);
+}
+
+/** Find all elements equal to the value and write their indices.
+ *
+ * First pass builds bitmap and count of found elements for every chunk,
+ * then chunk counts are turned into output offsets and
+ * every thread writes indices of its chunk from its own offset.
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(5, 4)
+size_t
+_OMP_ARRAY_FN(find_all_indices)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val,
+    size_t max_count, size_t idx[max_count])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    constexpr size_t chunk_len = SMARTARR_OMP_CHUNK_LEN;
+
+    if (len <= chunk_len) {
+        return _ARRAY_FN(find_all_indices)(len, a, val, max_count, idx);
+    }
+
+    const size_t nr_chunks = (len + chunk_len - 1) / chunk_len;
+    auto_free uint64_t* bitmap = malloc(((len + 63) / 64) * sizeof(uint64_t));
+    auto_free size_t* offset = malloc((nr_chunks + 1) * sizeof(size_t));
+    if (bitmap == NULL || offset == NULL) {
+        return _ARRAY_FN(find_all_indices)(len, a, val, max_count, idx);
+    }
+
+    #pragma omp parallel for
+    for (size_t c = 0; c < nr_chunks; ++c) {
+        size_t i = c * chunk_len;
+        size_t n = (len - i < chunk_len)? len - i : chunk_len;
+        offset[c + 1] = _ARRAY_FN(find_all_bitmap)(n, &a[i], val, &bitmap[i / 64]);
+    }
+
+    offset[0] = 0;
+    for (size_t c = 0; c < nr_chunks; ++c) {
+        offset[c + 1] += offset[c];
+    }
+
+    #pragma omp parallel for
+    for (size_t c = 0; c < nr_chunks; ++c) {
+        size_t count = offset[c];
+        if (count >= max_count) {
+            continue;
+        }
+        size_t word_end = (c + 1 < nr_chunks)? (c + 1) * (chunk_len / 64) : (len + 63) / 64;
+        for (size_t w = c * (chunk_len / 64); w < word_end; ++w) {
+            uint64_t mask = bitmap[w];
+            for_each_bit(mask, pos) {
+                if (count < max_count) {
+                    idx[count] = w * 64 + pos;
+                }
+                ++count;
+            }
+        }
+    }
+
+    return offset[nr_chunks];
+}
+
+static inline
+__attribute__((nonnull(1, 4)))
+size_t
+_OMP_SARRAY_FN(find_all_indices)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val,
+    size_t max_count, size_t idx[max_count])
+{
+    return _OMP_ARRAY_FN(find_all_indices)(a->len, a->data, val, max_count, idx);
+}
+
+/** Parallel `filter_by`: chunk counts, their scan and filter of every chunk at its offset.
+ *
+ * First pass only counts passed elements of every chunk,
+ * counts are scanned into output offsets and the second pass
+ * writes every chunk at its final position, so the output
+ * is the same as of the serial filter. `dst` must not be `a`.
+ */
+static inline
+__attribute__((always_inline))
+size_t
+_OMP_ARRAY_FN(filter_by)(size_t len, const _ARRAY_TYPE a[len], int op,
+    _ARRAY_TYPE lo, _ARRAY_TYPE hi, _ARRAY_TYPE* dst)
+{
+    constexpr size_t chunk_len = SMARTARR_OMP_CHUNK_LEN;
+
+    if (len <= chunk_len) {
+        return _ARRAY_FN(filter_by)(len, a, op, lo, hi, dst, len, false);
+    }
+
+    const size_t nr_chunks = (len + chunk_len - 1) / chunk_len;
+    auto_free size_t* offset = malloc((nr_chunks + 1) * sizeof(size_t));
+    if (offset == NULL) {
+        return _ARRAY_FN(filter_by)(len, a, op, lo, hi, dst, len, false);
+    }
+
+    #pragma omp parallel for
+    for (size_t c = 0; c < nr_chunks; ++c) {
+        const size_t i = c * chunk_len;
+        const size_t n = (len - i < chunk_len)? len - i : chunk_len;
+        offset[c + 1] = _ARRAY_FN(filter_by)(n, &a[i], op, lo, hi, NULL, 0, true);
+    }
+
+    offset[0] = 0;
+    for (size_t c = 0; c < nr_chunks; ++c) {
+        offset[c + 1] += offset[c];
+    }
+
+    // Output of a chunk is limited to its count, so vector stores
+    // do not overwrite output of the next chunk.
+    #pragma omp parallel for
+    for (size_t c = 0; c < nr_chunks; ++c) {
+        const size_t i = c * chunk_len;
+        const size_t n = (len - i < chunk_len)? len - i : chunk_len;
+        (void)_ARRAY_FN(filter_by)(n, &a[i], op, lo, hi,
+            &dst[offset[c]], offset[c + 1] - offset[c], false);
+    }
+
+    return offset[nr_chunks];
+}
+
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(4, 1)
+size_t
+_OMP_ARRAY_FN(filter_lt)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val, _ARRAY_TYPE dst[len])
+{
+    return _OMP_ARRAY_FN(filter_by)(len, a, _ARRAY_FILTER_LT, val, val, dst);
+}
+
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(4, 1)
+size_t
+_OMP_ARRAY_FN(filter_gt)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val, _ARRAY_TYPE dst[len])
+{
+    return _OMP_ARRAY_FN(filter_by)(len, a, _ARRAY_FILTER_GT, val, val, dst);
+}
+
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(4, 1)
+size_t
+_OMP_ARRAY_FN(filter_eq)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE val, _ARRAY_TYPE dst[len])
+{
+    return _OMP_ARRAY_FN(filter_by)(len, a, _ARRAY_FILTER_EQ, val, val, dst);
+}
+
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(5, 1)
+size_t
+_OMP_ARRAY_FN(filter_between)(size_t len, const _ARRAY_TYPE a[len], _ARRAY_TYPE lo, _ARRAY_TYPE hi,
+    _ARRAY_TYPE dst[len])
+{
+    return _OMP_ARRAY_FN(filter_by)(len, a, _ARRAY_FILTER_BETWEEN, lo, hi, dst);
+}
+
+static inline
+__attribute__((nonnull(1, 3)))
+size_t
+_OMP_SARRAY_FN(filter_lt)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val, _SMART_ARRAY_T* dst)
+{
+    assert(dst->len >= a->len);
+    return _OMP_ARRAY_FN(filter_lt)(a->len, a->data, val, dst->data);
+}
+
+static inline
+__attribute__((nonnull(1, 3)))
+size_t
+_OMP_SARRAY_FN(filter_gt)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val, _SMART_ARRAY_T* dst)
+{
+    assert(dst->len >= a->len);
+    return _OMP_ARRAY_FN(filter_gt)(a->len, a->data, val, dst->data);
+}
+
+static inline
+__attribute__((nonnull(1, 3)))
+size_t
+_OMP_SARRAY_FN(filter_eq)(const _SMART_ARRAY_T* a, _ARRAY_TYPE val, _SMART_ARRAY_T* dst)
+{
+    assert(dst->len >= a->len);
+    return _OMP_ARRAY_FN(filter_eq)(a->len, a->data, val, dst->data);
+}
+
+static inline
+__attribute__((nonnull(1, 4)))
+size_t
+_OMP_SARRAY_FN(filter_between)(const _SMART_ARRAY_T* a, _ARRAY_TYPE lo, _ARRAY_TYPE hi,
+    _SMART_ARRAY_T* dst)
+{
+    assert(dst->len >= a->len);
+    return _OMP_ARRAY_FN(filter_between)(a->len, a->data, lo, hi, dst->data);
+}
+
+/** Parallel `compress`, chunk counts are popcounts of the bitmap.
+ *
+ * `dst` must not be `a`.
+ */
+static inline
+_ARRAY_RO(2, 1) __attribute__((nonnull(3))) _ARRAY_WO(4, 1)
+size_t
+_OMP_ARRAY_FN(compress)(size_t len, const _ARRAY_TYPE a[len], const uint64_t bitmap[],
+    _ARRAY_TYPE dst[len])
+{
+    constexpr size_t chunk_len = SMARTARR_OMP_CHUNK_LEN;
+
+    if (len <= chunk_len) {
+        return _ARRAY_FN(compress)(len, a, bitmap, dst);
+    }
+
+    const size_t nr_chunks = (len + chunk_len - 1) / chunk_len;
+    auto_free size_t* offset = malloc((nr_chunks + 1) * sizeof(size_t));
+    if (offset == NULL) {
+        return _ARRAY_FN(compress)(len, a, bitmap, dst);
+    }
+
+    #pragma omp parallel for
+    for (size_t c = 0; c < nr_chunks; ++c) {
+        const size_t i = c * chunk_len;
+        const size_t n = (len - i < chunk_len)? len - i : chunk_len;
+        size_t count = 0;
+        for (size_t w = 0; w < n / 64; ++w) {
+            count += __builtin_popcountll(bitmap[i / 64 + w]);
+        }
+        if (n % 64) {
+            count += __builtin_popcountll(bitmap[(i + n) / 64] & ((1ull << (n % 64)) - 1));
+        }
+        offset[c + 1] = count;
+    }
+
+    offset[0] = 0;
+    for (size_t c = 0; c < nr_chunks; ++c) {
+        offset[c + 1] += offset[c];
+    }
+
+    #pragma omp parallel for
+    for (size_t c = 0; c < nr_chunks; ++c) {
+        const size_t i = c * chunk_len;
+        const size_t n = (len - i < chunk_len)? len - i : chunk_len;
+        (void)_ARRAY_FN(compress_to)(n, &a[i], &bitmap[i / 64],
+            &dst[offset[c]], offset[c + 1] - offset[c]);
+    }
+
+    return offset[nr_chunks];
+}
+
+static inline
+__attribute__((nonnull(1, 2, 3)))
+size_t
+_OMP_SARRAY_FN(compress)(const _SMART_ARRAY_T* a, const uint64_t bitmap[], _SMART_ARRAY_T* dst)
+{
+    assert(dst->len >= a->len);
+    return _OMP_ARRAY_FN(compress)(a->len, a->data, bitmap, dst->data);
+}
+
+/** Parallel `gather`, chunks of `idx` are split between threads.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(4, 1) __attribute__((nonnull(3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_ARRAY_FN(gather_u32)(size_t len, const uint32_t idx[len], const _ARRAY_TYPE src[],
+    _ARRAY_TYPE dst[len])
+{
+    _OMP_FOR_EACH_CHUNK(len, _ARRAY_FN(gather_u32)(_n, &idx[_i], src, &dst[_i]));
+    return dst;
+}
+
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(4, 1) __attribute__((nonnull(3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_ARRAY_FN(gather_u64)(size_t len, const uint64_t idx[len], const _ARRAY_TYPE src[],
+    _ARRAY_TYPE dst[len])
+{
+    _OMP_FOR_EACH_CHUNK(len, _ARRAY_FN(gather_u64)(_n, &idx[_i], src, &dst[_i]));
+    return dst;
+}
+
+static inline
+__attribute__((nonnull(1, 2, 3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_SARRAY_FN(gather_u32)(const uint32_t idx[], const _SMART_ARRAY_T* src, _SMART_ARRAY_T* dst)
+{
+    return _OMP_ARRAY_FN(gather_u32)(dst->len, idx, src->data, dst->data);
+}
+
+static inline
+__attribute__((nonnull(1, 2, 3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_SARRAY_FN(gather_u64)(const uint64_t idx[], const _SMART_ARRAY_T* src, _SMART_ARRAY_T* dst)
+{
+    return _OMP_ARRAY_FN(gather_u64)(dst->len, idx, src->data, dst->data);
+}
+
+/** Parallel `scatter`, chunks of `idx` are split between threads.
+ *
+ * If indices repeat it is unspecified which element is written.
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) __attribute__((nonnull(4))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_ARRAY_FN(scatter_u32)(size_t len, const uint32_t idx[len], const _ARRAY_TYPE src[len],
+    _ARRAY_TYPE dst[])
+{
+    _OMP_FOR_EACH_CHUNK(len, _ARRAY_FN(scatter_u32)(_n, &idx[_i], &src[_i], dst));
+    return dst;
+}
+
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) __attribute__((nonnull(4))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_ARRAY_FN(scatter_u64)(size_t len, const uint64_t idx[len], const _ARRAY_TYPE src[len],
+    _ARRAY_TYPE dst[])
+{
+    _OMP_FOR_EACH_CHUNK(len, _ARRAY_FN(scatter_u64)(_n, &idx[_i], &src[_i], dst));
+    return dst;
+}
+
+static inline
+__attribute__((nonnull(1, 2, 3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_SARRAY_FN(scatter_u32)(const uint32_t idx[], const _SMART_ARRAY_T* src, _SMART_ARRAY_T* dst)
+{
+    return _OMP_ARRAY_FN(scatter_u32)(src->len, idx, src->data, dst->data);
+}
+
+static inline
+__attribute__((nonnull(1, 2, 3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_SARRAY_FN(scatter_u64)(const uint64_t idx[], const _SMART_ARRAY_T* src, _SMART_ARRAY_T* dst)
+{
+    return _OMP_ARRAY_FN(scatter_u64)(src->len, idx, src->data, dst->data);
+}
+
+#ifndef _ARRAY_TYPE_COMPOUND
+/** Parallel `scatter_add` into `dst` of `dst_len` elements.
+ *
+ * Destination not larger than `len / nr_threads` is accumulated by every
+ * thread into its own zeroed copy, and copies are added to `dst` at the end,
+ * so threads do not fight for cache lines of a small histogram.
+ * Larger destination, where collisions are rare, is updated with atomic adds.
+ * For floating point types the order of additions differs from the serial one.
+ */
+#ifndef _OMP_SCATTER_ADD
+#define _OMP_SCATTER_ADD(len, idx, src, dst_len, dst, scatter_add) ({ \
+    const size_t _len = (len); \
+    const size_t _dst_len = (dst_len); \
+    const size_t _chunk_len = SMARTARR_OMP_CHUNK_LEN; \
+    const size_t _nr_threads = omp_get_max_threads(); \
+    auto_free typeof((dst)[0])* _acc = NULL; \
+    if (_len <= _chunk_len || _nr_threads < 2) { \
+        scatter_add(_len, (idx), (src), (dst)); \
+    } \
+    else if (_dst_len * _nr_threads <= _len && \
+        (_acc = calloc(_nr_threads * _dst_len, sizeof((dst)[0]))) != NULL) \
+    { \
+        _Pragma("omp parallel") \
+        { \
+            typeof((dst)[0])* _mine = &_acc[omp_get_thread_num() * _dst_len]; \
+            _Pragma("omp for schedule(static)") \
+            for (size_t _i = 0; _i < _len; _i += _chunk_len) { \
+                const size_t _n = (_len - _i < _chunk_len)? _len - _i : _chunk_len; \
+                scatter_add(_n, &(idx)[_i], &(src)[_i], _mine); \
+            } \
+        } \
+        _Pragma("omp parallel for if (_dst_len > _chunk_len)") \
+        for (size_t _j = 0; _j < _dst_len; ++_j) { \
+            for (size_t _t = 0; _t < _nr_threads; ++_t) { \
+                (dst)[_j] += _acc[_t * _dst_len + _j]; \
+            } \
+        } \
+    } \
+    else { \
+        _Pragma("omp parallel for schedule(static)") \
+        for (size_t _i = 0; _i < _len; ++_i) { \
+            _Pragma("omp atomic") \
+            (dst)[(idx)[_i]] += (src)[_i]; \
+        } \
+    } \
+    (dst); \
+})
+#endif
+
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) _ARRAY_RW(5, 4) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_ARRAY_FN(scatter_add_u32)(size_t len, const uint32_t idx[len], const _ARRAY_TYPE src[len],
+    size_t dst_len, _ARRAY_TYPE dst[dst_len])
+{
+    return _OMP_SCATTER_ADD(len, idx, src, dst_len, dst, _ARRAY_FN(scatter_add_u32));
+}
+
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(3, 1) _ARRAY_RW(5, 4) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_ARRAY_FN(scatter_add_u64)(size_t len, const uint64_t idx[len], const _ARRAY_TYPE src[len],
+    size_t dst_len, _ARRAY_TYPE dst[dst_len])
+{
+    return _OMP_SCATTER_ADD(len, idx, src, dst_len, dst, _ARRAY_FN(scatter_add_u64));
+}
+
+static inline
+__attribute__((nonnull(1, 2, 3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_SARRAY_FN(scatter_add_u32)(const uint32_t idx[], const _SMART_ARRAY_T* src,
+    _SMART_ARRAY_T* dst)
+{
+    return _OMP_ARRAY_FN(scatter_add_u32)(src->len, idx, src->data, dst->len, dst->data);
+}
+
+static inline
+__attribute__((nonnull(1, 2, 3))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_SARRAY_FN(scatter_add_u64)(const uint64_t idx[], const _SMART_ARRAY_T* src,
+    _SMART_ARRAY_T* dst)
+{
+    return _OMP_ARRAY_FN(scatter_add_u64)(src->len, idx, src->data, dst->len, dst->data);
+}
+#endif // _ARRAY_TYPE_COMPOUND
+
+/** Batched `lower_bound`, queries are split between threads.
+ *
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(4, 3) _ARRAY_WO(5, 3)
+void
+_OMP_ARRAY_FN(lower_bound_batch)(size_t len, const _ARRAY_TYPE a[len],
+    size_t nr_queries, const _ARRAY_TYPE queries[nr_queries], size_t pos[nr_queries])
+{
+    constexpr size_t chunk_len = SMARTARR_SEARCH_BATCH_LEN * 64;
+
+    #pragma omp parallel for schedule(dynamic) if (nr_queries > chunk_len)
+    for (size_t q = 0; q < nr_queries; q += chunk_len) {
+        size_t n = (nr_queries - q < chunk_len)? nr_queries - q : chunk_len;
+        _ARRAY_FN(lower_bound_batch)(len, a, n, &queries[q], &pos[q]);
+    }
+}
+
+static inline
+__attribute__((nonnull(1, 2, 3)))
+void
+_OMP_SARRAY_FN(lower_bound_batch)(const _SMART_ARRAY_T* a, const _SMART_ARRAY_T* queries,
+    size_t pos[])
+{
+    _OMP_ARRAY_FN(lower_bound_batch)(a->len, a->data, queries->len, queries->data, pos);
+}
+
+/** Write the `k` largest elements to `out` from the largest, return their number.
+ *
+ * Every thread keeps its own top-k of its chunks, then the
+ * candidates of all threads are merged into `out`.
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_WO(4, 3)
+size_t
+_OMP_ARRAY_FN(topk)(size_t len, const _ARRAY_TYPE a[len], size_t k, _ARRAY_TYPE out[k])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    constexpr size_t chunk_len = SMARTARR_OMP_CHUNK_LEN;
+    const size_t nr_threads = omp_get_max_threads();
+
+    if (len <= chunk_len || nr_threads < 2 || k == 0) {
+        return _ARRAY_FN(topk)(len, a, k, out);
+    }
+
+    auto_free _ARRAY_TYPE* heaps = malloc(nr_threads * k * sizeof(_ARRAY_TYPE));
+    auto_free _ARRAY_TOPK_T* tops = malloc(nr_threads * sizeof(_ARRAY_TOPK_T));
+    if (heaps == NULL || tops == NULL) {
+        return _ARRAY_FN(topk)(len, a, k, out);
+    }
+
+    for (size_t t = 0; t < nr_threads; ++t) {
+        _ARRAY_FN(topk_init)(&tops[t], k, &heaps[t * k]);
+    }
+
+    #pragma omp parallel
+    {
+        _ARRAY_TOPK_T* top = &tops[omp_get_thread_num()];
+        #pragma omp for schedule(static)
+        for (size_t i = 0; i < len; i += chunk_len) {
+            size_t n = (len - i < chunk_len)? len - i : chunk_len;
+            _ARRAY_FN(topk_push)(top, n, &a[i]);
+        }
+    }
+
+    _ARRAY_TOPK_T top;
+    _ARRAY_FN(topk_init)(&top, k, out);
+    for (size_t t = 0; t < nr_threads; ++t) {
+        _ARRAY_FN(topk_merge)(&top, &tops[t]);
+    }
+
+    return _ARRAY_FN(topk_finish)(&top);
+}
+
+static inline
+__attribute__((nonnull(1, 3)))
+size_t
+_OMP_SARRAY_FN(topk)(const _SMART_ARRAY_T* a, size_t k, _ARRAY_TYPE out[k])
+{
+    return _OMP_ARRAY_FN(topk)(a->len, a->data, k, out);
+}
+
+// Arrays shorter than this are sorted by one thread.
+#ifndef SMARTARR_OMP_SORT_MIN_LEN
+#define SMARTARR_OMP_SORT_MIN_LEN (256 * 1024)
+#endif
+
+/** Return how many elements of `a` are among the first `k` elements of
+ * merged `a` and `b` (merge path partition).
+ *
+ * Elements of `a` go first when equal, same as in `merge_part`.
+ */
+static inline
+_ARRAY_RO(2, 1) _ARRAY_RO(4, 3) FN_ATTR_PURE
+size_t
+_OMP_ARRAY_FN(merge_path)(size_t a_len, const _ARRAY_TYPE a[a_len],
+    size_t b_len, const _ARRAY_TYPE b[b_len], size_t k)
+{
+    size_t lo = (k > b_len)? k - b_len : 0;
+    size_t hi = (k < a_len)? k : a_len;
+
+    while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2;
+        if (!_ARRAY_TYPE_LT(b[k - i - 1], a[i])) {
+            lo = i + 1;
+        } else {
+            hi = i;
+        }
+    }
+    return lo;
+}
+
+/** Merge `a` and `b` into `out`, `out` has `a_len + b_len` elements.
+ *
+ */
+static inline
+__attribute__((nonnull(2, 4, 5)))
+void
+_OMP_ARRAY_FN(merge_part)(size_t a_len, const _ARRAY_TYPE a[a_len],
+    size_t b_len, const _ARRAY_TYPE b[b_len], _ARRAY_TYPE out[])
+{
+    size_t i = 0, j = 0, k = 0;
+
+    while (i < a_len && j < b_len) {
+        bool take_b = _ARRAY_TYPE_LT(b[j], a[i]);
+        out[k++] = take_b? b[j] : a[i];
+        j += take_b;
+        i += !take_b;
+    }
+    __builtin_memcpy(&out[k], &a[i], (a_len - i) * sizeof(_ARRAY_TYPE));
+    k += a_len - i;
+    __builtin_memcpy(&out[k], &b[j], (b_len - j) * sizeof(_ARRAY_TYPE));
+}
+
+/** One round of merge sort: merge pairs of sorted runs of `src` into `dst`.
+ *
+ * Output is cut into pieces of equal length, for every piece both
+ * inputs are found with `merge_path`, so all threads get the same amount
+ * of work no matter how many pairs of runs are left.
+ */
+static inline
+__attribute__((nonnull(2, 3)))
+void
+_OMP_ARRAY_FN(merge_runs)(size_t len, const _ARRAY_TYPE src[len], _ARRAY_TYPE dst[len],
+    size_t run_len, size_t piece_len)
+{
+    const size_t nr_pieces = (len + piece_len - 1) / piece_len;
+
+    #pragma omp parallel for schedule(static)
+    for (size_t p = 0; p < nr_pieces; ++p) {
+        size_t out = p * piece_len;
+        const size_t out_end = (len - out < piece_len)? len : out + piece_len;
+        // a piece may cover the end of one pair of runs and start of the next
+        while (out < out_end) {
+            const size_t pair = (out / (2 * run_len)) * (2 * run_len);
+            const size_t mid = (len - pair < run_len)? len : pair + run_len;
+            const size_t pair_end = (len - mid < run_len)? len : mid + run_len;
+            const size_t end = (out_end < pair_end)? out_end : pair_end;
+            const size_t a_len = mid - pair, b_len = pair_end - mid;
+            const size_t i0 = _OMP_ARRAY_FN(merge_path)(a_len, &src[pair], b_len, &src[mid], out - pair);
+            const size_t i1 = _OMP_ARRAY_FN(merge_path)(a_len, &src[pair], b_len, &src[mid], end - pair);
+            const size_t j0 = out - pair - i0, j1 = end - pair - i1;
+            _OMP_ARRAY_FN(merge_part)(i1 - i0, &src[pair + i0], j1 - j0, &src[mid + j0], &dst[out]);
+            out = end;
+        }
+    }
+}
+
+/** Sort array with parallel merge sort.
+ *
+ * Array is split into one run per thread, runs are sorted with serial
+ * `sort`, then pairs of runs are merged until one run is left.
+ * Every merge round is split between all threads with merge path
+ * partitioning, so the last rounds with few long runs scale too.
+ * `scratch` must have at least `len` elements, if it is NULL
+ * temporary buffer is allocated, serial `sort` is used if that fails.
+ * Result is in `a`, not stable.
+ *
+ * Example:
+ * ```
+ * i64_omp_smart_array_sort(a, NULL);
+ * ```
+ */
+static inline
+_ARRAY_RW(2, 1) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_ARRAY_FN(sort)(size_t len, _ARRAY_TYPE a[len], _ARRAY_TYPE scratch[])
+{
+    ARRAY_ASSERT_ALIGNED(a);
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN);
+
+    const size_t nr_threads = omp_get_max_threads();
+
+    if (len <= SMARTARR_OMP_SORT_MIN_LEN || nr_threads < 2) {
+        return _ARRAY_FN(sort)(len, a);
+    }
+
+    auto_free _ARRAY_TYPE* tmp = (scratch == NULL)? malloc(len * sizeof(_ARRAY_TYPE)) : NULL;
+    _ARRAY_TYPE* buf = (scratch == NULL)? tmp : scratch;
+    if (buf == NULL) {
+        return _ARRAY_FN(sort)(len, a);
+    }
+
+    // runs start at multiples of 64 elements to keep them aligned
+    size_t run_len = (len + nr_threads - 1) / nr_threads;
+    run_len = (run_len + 63) & ~(size_t)63;
+    const size_t nr_runs = (len + run_len - 1) / run_len;
+    const size_t piece_len = (len + nr_threads - 1) / nr_threads;
+
+    #pragma omp parallel for schedule(static)
+    for (size_t r = 0; r < nr_runs; ++r) {
+        size_t i = r * run_len;
+        _ARRAY_FN(sort)((len - i < run_len)? len - i : run_len, &a[i]);
+    }
+
+    _ARRAY_TYPE* src = a;
+    _ARRAY_TYPE* dst = buf;
+    for (; run_len < len; run_len *= 2) {
+        _OMP_ARRAY_FN(merge_runs)(len, src, dst, run_len, piece_len);
+        _ARRAY_TYPE* t = src; src = dst; dst = t;
+    }
+
+    if (src != a) {
+        #pragma omp parallel for schedule(static)
+        for (size_t p = 0; p < len; p += piece_len) {
+            size_t n = (len - p < piece_len)? len - p : piece_len;
+            __builtin_memcpy(&a[p], &src[p], n * sizeof(_ARRAY_TYPE));
+        }
+    }
+
+    return a;
+}
+
+/** Sort smart array with parallel merge sort, `scratch` may be NULL.
+ *
+ */
+static inline
+__attribute__((nonnull(1))) FN_ATTR_RETURNS_NONNULL
+_ARRAY_TYPE*
+_OMP_SARRAY_FN(sort)(_SMART_ARRAY_T* a, _SMART_ARRAY_T* scratch)
+{
+    assert(scratch == NULL || scratch->len >= a->len);
+    return _OMP_ARRAY_FN(sort)(a->len, a->data, (scratch == NULL)? NULL : scratch->data);
+}
+
+#ifndef _ARRAY_TYPE_COMPOUND
 static inline
 _ARRAY_RO(3, 1) _ARRAY_RO(6, 4) _ARRAY_WO(9, 7) FN_ATTR_RETURNS_NONNULL
 _ARRAY_TYPE*
@@ -156,6 +1547,7 @@ _OMP_MATRIX_FN(matrix_multiply)(
         b->len, b->num_cols, b->data,
         c->len, c->num_cols, c->data);
 }
+#endif // _ARRAY_TYPE_COMPOUND
 
 #undef _OMP_ARRAY_FN
 #undef _OMP_SARRAY_FN
@@ -0,0 +1,134 @@
+/**@file
+ * @brief     Helpers for explicit SIMD code written with GCC vector extensions.
+ * @author    Igor Lesik 2023
+ * @copyright Igor Lesik 2023
+ *
+ * Vector types are declared per element type in `array.inc.h`,
+ * this header only has type-agnostic helpers that work on raw bytes.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "smartarr/defines.h"
+#include "smartarr/cpu.h"
+
+#ifdef __x86_64
+#include <immintrin.h>
+#endif
+
+/** Vector of bytes with the same width as any other SMARTARR vector.
+ *
+ * Any vector of the same size can be casted to it without conversion,
+ * for example a result of comparison of two `double` vectors.
+ */
+typedef char simd_i8_t __attribute__((vector_size(SMARTARR_SIMD_VLEN)));
+
+/** Gather most significant bit of each byte of a vector into an integer.
+ *
+ * Comparison of vectors sets all bits of a lane, so for a vector with
+ * N-byte elements the mask has N consecutive bits per lane and
+ * `ctz(mask) / N` is the index of the first lane that is set.
+ *
+ * Example:
+ * ```
+ * typedef double v4d __attribute__((vector_size(32)));
+ * v4d a = {1, 2, 3, 4};
+ * uint64_t m = simd_movemask_i8((simd_i8_t)(a == 3)); // 0x00ff0000
+ * ```
+ */
+static inline
+FN_ATTR_CONST
+uint64_t
+simd_movemask_i8(simd_i8_t v)
+{
+#if SMARTARR_SIMD_VLEN == 64 && defined(__AVX512BW__)
+    return _mm512_movepi8_mask((__m512i)v);
+#elif SMARTARR_SIMD_VLEN == 32 && defined(__AVX2__)
+    return (uint32_t)_mm256_movemask_epi8((__m256i)v);
+#elif SMARTARR_SIMD_VLEN == 16 && defined(__SSE2__)
+    return (uint16_t)_mm_movemask_epi8((__m128i)v);
+#else
+    uint64_t mask = 0;
+    for (unsigned int i = 0; i < SMARTARR_SIMD_VLEN; ++i) {
+        mask |= (uint64_t)((unsigned char)v[i] >> 7) << i;
+    }
+    return mask;
+#endif
+}
+
+/** Mask with `nr_bytes` lowest bits set, `nr_bytes` is in [0, 64].
+ *
+ */
+static inline
+FN_ATTR_CONST
+uint64_t
+simd_low_bytes_mask(unsigned int nr_bytes)
+{
+    return (nr_bytes >= 64)? ~0ull : ((1ull << nr_bytes) - 1);
+}
+
+/** Gather one bit per lane of a comparison result into an integer.
+ *
+ * `lane_size` is the element size in bytes, it is expected
+ * to be a compile time constant, so all the branches fold away.
+ */
+static inline
+FN_ATTR_CONST
+uint64_t
+simd_movemask_lanes(simd_i8_t v, size_t lane_size)
+{
+#if SMARTARR_SIMD_VLEN == 64 && defined(__AVX512DQ__)
+    if (lane_size == 4) return _mm512_movepi32_mask((__m512i)v);
+    if (lane_size == 8) return _mm512_movepi64_mask((__m512i)v);
+#elif SMARTARR_SIMD_VLEN == 32 && defined(__AVX__)
+    if (lane_size == 4) return (uint8_t)_mm256_movemask_ps((__m256)v);
+    if (lane_size == 8) return (uint8_t)_mm256_movemask_pd((__m256d)v);
+#elif SMARTARR_SIMD_VLEN == 16 && defined(__SSE2__)
+    if (lane_size == 4) return (uint8_t)_mm_movemask_ps((__m128)v);
+    if (lane_size == 8) return (uint8_t)_mm_movemask_pd((__m128d)v);
+#endif
+    uint64_t bytes = simd_movemask_i8(v);
+    if (lane_size == 1) {
+        return bytes;
+    }
+#ifdef __BMI2__
+    // one bit from every lane: 0x5555... for 2 bytes, 0x1111... for 4 bytes
+    return _pext_u64(bytes, ~0ull / ((1ull << lane_size) - 1));
+#else
+    uint64_t mask = 0;
+    for (unsigned int i = 0; i < SMARTARR_SIMD_VLEN / lane_size; ++i) {
+        mask |= ((bytes >> (i * lane_size)) & 1) << i;
+    }
+    return mask;
+#endif
+}
+
+/** Pack indices of set bits of an up to 8-bit mask into bytes, lowest first.
+ *
+ * Used as shuffle control to move selected lanes to the low lanes
+ * when there is no compress instruction.
+ *
+ * Example:
+ * ```
+ * uint64_t idx = simd_compress_indices(0b10110); // 0x040201
+ * ```
+ */
+static inline
+FN_ATTR_CONST
+uint64_t
+simd_compress_indices(uint64_t mask)
+{
+#ifdef __BMI2__
+    // every mask bit becomes 0xff byte that selects its index byte
+    const uint64_t bytes = _pdep_u64(mask, 0x0101010101010101ull) * 0xff;
+    return _pext_u64(0x0706050403020100ull, bytes);
+#else
+    uint64_t indices = 0;
+    unsigned int k = 0;
+    for_each_bit(mask, pos) {
+        indices |= (uint64_t)pos << (8 * k++);
+    }
+    return indices;
+#endif
+}
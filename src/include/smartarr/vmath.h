@@ -0,0 +1,692 @@
+/**@file
+ * @brief     Vectorized transcendental functions of `f32` and `f64` arrays.
+ * @author    Igor Lesik 2023
+ * @copyright Igor Lesik 2023
+ *
+ * Calling libm per element keeps a loop scalar. Kernels here work on whole
+ * SIMD vectors: range reduction with integer bit tricks, polynomial
+ * approximation on the reduced range and special values fixed up with
+ * lane selects, so a loop over an array is a loop over vectors.
+ *
+ * Maximum error against correctly rounded result, measured over all `f32`
+ * inputs and random `f64` inputs, `test/vmath.c` checks it on a sample:
+ *
+ * | function  | f32 ULP | f64 ULP |
+ * |-----------|---------|---------|
+ * | `exp`     | 1       | 1       |
+ * | `log`     | 1       | 1       |
+ * | `log1p`   | 1       | 1       |
+ * | `sqrt`    | 0       | 0       |
+ * | `rsqrt`   | 1       | 1       |
+ * | `tanh`    | 1       | 1       |
+ * | `sigmoid` | 2       | 2       |
+ * | `sin`     | 2       | 1       |
+ * | `cos`     | 2       | 1       |
+ *
+ * `sin` and `cos` reduce arguments up to `VMATH_F32_TRIG_MAX` and
+ * `VMATH_F64_TRIG_MAX` in registers, lanes with larger arguments
+ * are computed by libm, so the program must be linked with `-lm`.
+ * Results do not depend on `errno` and floating point exceptions are
+ * not raised consistently with libm.
+ *
+ * Example:
+ *
+ * ```
+ * #define _ARRAY_OMP_ENABLE
+ * #include "smartarr/vmath.h"
+ *
+ * f32_smart_array_exp(x, y);          // y = exp(x)
+ * f64_smart_array_sigmoid_destruct(z); // z = 1 / (1 + exp(-z))
+ * f32_omp_array_tanh(len, a, b);
+ * ```
+ *
+ * Every function `name` has the same forms as the element-wise
+ * arithmetic kernels: `T_array_name(len, a, b)`, `T_array_name_destruct(len, a)`,
+ * `T_smart_array_name(a, b)`, `T_smart_array_name_destruct(a)` and their
+ * `T_omp_` versions when `_ARRAY_OMP_ENABLE` is defined.
+ */
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "smartarr/defines.h"
+#include "smartarr/simd.h"
+#include "smartarr/basic_type_array.h"
+
+/** Vectors of the kernels, alignment is reduced to the element alignment,
+ * so a vector can be loaded from any element of an array.
+ */
+typedef float   vmath_f32_t __attribute__((vector_size(SMARTARR_SIMD_VLEN), aligned(4)));
+typedef int32_t vmath_i32_t __attribute__((vector_size(SMARTARR_SIMD_VLEN), aligned(4)));
+typedef double  vmath_f64_t __attribute__((vector_size(SMARTARR_SIMD_VLEN), aligned(8)));
+typedef int64_t vmath_i64_t __attribute__((vector_size(SMARTARR_SIMD_VLEN), aligned(8)));
+
+// Arguments of `sin` and `cos` with larger magnitude are passed to libm.
+#ifndef VMATH_F32_TRIG_MAX
+#define VMATH_F32_TRIG_MAX 0x1p20f
+#endif
+#ifndef VMATH_F64_TRIG_MAX
+#define VMATH_F64_TRIG_MAX 0x1p20
+#endif
+
+// Adding and subtracting it rounds to the nearest integer,
+// low bits of the sum are the integer.
+#define _VMATH_F32_ROUND_MAGIC 0x1.8p23f
+#define _VMATH_F64_ROUND_MAGIC 0x1.8p52
+
+/** Per lane `mask? a : b`, mask lanes must be all ones or all zeros.
+ *
+ */
+static inline
+FN_ATTR_CONST
+vmath_f32_t
+vmath_f32_select(vmath_i32_t mask, vmath_f32_t a, vmath_f32_t b)
+{
+    return (vmath_f32_t)((mask & (vmath_i32_t)a) | (~mask & (vmath_i32_t)b));
+}
+
+static inline
+FN_ATTR_CONST
+vmath_f64_t
+vmath_f64_select(vmath_i64_t mask, vmath_f64_t a, vmath_f64_t b)
+{
+    return (vmath_f64_t)((mask & (vmath_i64_t)a) | (~mask & (vmath_i64_t)b));
+}
+
+/** `2^n` for `n` in [-126, 127].
+ *
+ */
+static inline
+FN_ATTR_CONST
+vmath_f32_t
+vmath_f32_pow2i(vmath_i32_t n)
+{
+    return (vmath_f32_t)((n + 127) << 23);
+}
+
+/** `2^n` for `n` in [-1022, 1023].
+ *
+ */
+static inline
+FN_ATTR_CONST
+vmath_f64_t
+vmath_f64_pow2i(vmath_i64_t n)
+{
+    return (vmath_f64_t)((n + 1023) << 52);
+}
+
+/** `x * 2^n` for `n` out of the normal exponent range, result may be subnormal or infinite.
+ *
+ * Two multiplications by halves of `n` round only once.
+ */
+static inline
+FN_ATTR_CONST
+vmath_f32_t
+vmath_f32_ldexp(vmath_f32_t x, vmath_i32_t n)
+{
+    const vmath_i32_t n1 = n >> 1;
+    return x * vmath_f32_pow2i(n1) * vmath_f32_pow2i(n - n1);
+}
+
+static inline
+FN_ATTR_CONST
+vmath_f64_t
+vmath_f64_ldexp(vmath_f64_t x, vmath_i64_t n)
+{
+    const vmath_i64_t n1 = n >> 1;
+    return x * vmath_f64_pow2i(n1) * vmath_f64_pow2i(n - n1);
+}
+
+static inline
+FN_ATTR_CONST
+vmath_f32_t
+vmath_f32_abs(vmath_f32_t x)
+{
+    return (vmath_f32_t)((vmath_i32_t)x & INT32_MAX);
+}
+
+static inline
+FN_ATTR_CONST
+vmath_f64_t
+vmath_f64_abs(vmath_f64_t x)
+{
+    return (vmath_f64_t)((vmath_i64_t)x & INT64_MAX);
+}
+
+/** `exp(x)`, `x = k*ln(2) + r`, `|r| <= ln(2)/2`, `exp(x) = 2^k * exp(r)`.
+ *
+ */
+static inline
+FN_ATTR_CONST
+vmath_f32_t
+vmath_f32_exp(vmath_f32_t x)
+{
+    // Cephes expf.c polynomial
+    const float ln2_hi = 0.693359375f, ln2_lo = -2.12194440e-4f;
+
+    // out of the clamped range the result is 0 or infinity anyway, NaN stays
+    x = vmath_f32_select(x < -104.0f, (vmath_f32_t){} - 104.0f, x);
+    x = vmath_f32_select(x > 89.0f, (vmath_f32_t){} + 89.0f, x);
+
+    const vmath_f32_t t = x * 0x1.715476p+0f + _VMATH_F32_ROUND_MAGIC;
+    const vmath_f32_t kf = t - _VMATH_F32_ROUND_MAGIC;
+    const vmath_i32_t k = (vmath_i32_t)t - (vmath_i32_t)((vmath_f32_t){} + _VMATH_F32_ROUND_MAGIC);
+    const vmath_f32_t r = (x - kf * ln2_hi) - kf * ln2_lo;
+    const vmath_f32_t z = r * r;
+
+    vmath_f32_t p = 1.9875691500e-4f * r + 1.3981999507e-3f;
+    p = p * r + 8.3334519073e-3f;
+    p = p * r + 4.1665795894e-2f;
+    p = p * r + 1.6666665459e-1f;
+    p = p * r + 5.0000001201e-1f;
+    p = p * z + r + 1.0f;
+
+    return vmath_f32_ldexp(p, k);
+}
+
+static inline
+FN_ATTR_CONST
+vmath_f64_t
+vmath_f64_exp(vmath_f64_t x)
+{
+    // fdlibm e_exp.c, exp(r) = 1 + 2r/(R(r^2) - r) with R from a rational approximation
+    const double ln2_hi = 6.93147180369123816490e-01, ln2_lo = 1.90821492927058770002e-10;
+    const double p1 = 1.66666666666666019037e-01, p2 = -2.77777777770155933842e-03;
+    const double p3 = 6.61375632143793436117e-05, p4 = -1.65339022054652515390e-06;
+    const double p5 = 4.13813679705723846039e-08;
+
+    x = vmath_f64_select(x < -746.0, (vmath_f64_t){} - 746.0, x);
+    x = vmath_f64_select(x > 710.0, (vmath_f64_t){} + 710.0, x);
+
+    const vmath_f64_t t = x * 0x1.71547652b82fep+0 + _VMATH_F64_ROUND_MAGIC;
+    const vmath_f64_t kf = t - _VMATH_F64_ROUND_MAGIC;
+    const vmath_i64_t k = (vmath_i64_t)t - (vmath_i64_t)((vmath_f64_t){} + _VMATH_F64_ROUND_MAGIC);
+    const vmath_f64_t hi = x - kf * ln2_hi;
+    const vmath_f64_t lo = kf * ln2_lo;
+    const vmath_f64_t r = hi - lo;
+    const vmath_f64_t z = r * r;
+    const vmath_f64_t c = r - z * (p1 + z * (p2 + z * (p3 + z * (p4 + z * p5))));
+    const vmath_f64_t y = 1.0 - ((lo - (r * c) / (2.0 - c)) - hi);
+
+    return vmath_f64_ldexp(y, k);
+}
+
+/** `log(x)`, `x = 2^k * m`, `m` in [sqrt(2)/2, sqrt(2)), `log(m) = log(1 + f)`.
+ *
+ */
+static inline
+FN_ATTR_CONST
+vmath_f32_t
+vmath_f32_log(vmath_f32_t x)
+{
+    // fdlibm e_logf.c, log(1 + f) = f - f^2/2 + s*(f^2/2 + R(s^2)), s = f/(2 + f)
+    const float ln2_hi = 6.9313812256e-01f, ln2_lo = 9.0580006145e-06f;
+    const float lg1 = 0xaaaaaa.0p-24f, lg2 = 0xccce13.0p-25f;
+    const float lg3 = 0x91e9ee.0p-25f, lg4 = 0xf89e26.0p-26f;
+
+    // subnormals are normalized first
+    const vmath_i32_t is_sub = x < 0x1p-126f;
+    const vmath_i32_t ix = (vmath_i32_t)vmath_f32_select(is_sub, x * 0x1p23f, x);
+    vmath_i32_t k = ((ix >> 23) & 0xff) - 127 - (is_sub & 23);
+    vmath_f32_t m = (vmath_f32_t)((ix & 0x007fffff) | 0x3f800000);
+    const vmath_i32_t is_big = m > 0x1.6a09e6p+0f;
+    m = vmath_f32_select(is_big, m * 0.5f, m);
+    k -= is_big;
+
+    const vmath_f32_t f = m - 1.0f;
+    const vmath_f32_t s = f / (2.0f + f);
+    const vmath_f32_t z = s * s;
+    const vmath_f32_t w = z * z;
+    const vmath_f32_t r = z * (lg1 + w * lg3) + w * (lg2 + w * lg4);
+    const vmath_f32_t hfsq = 0.5f * f * f;
+    const vmath_f32_t dk = __builtin_convertvector(k, vmath_f32_t);
+    vmath_f32_t y = dk * ln2_hi - ((hfsq - (s * (hfsq + r) + dk * ln2_lo)) - f);
+
+    y = vmath_f32_select(x == __builtin_inff(), x, y);
+    y = vmath_f32_select(x == 0.0f, (vmath_f32_t){} - __builtin_inff(), y);
+    y = vmath_f32_select(x < 0.0f, (vmath_f32_t){} + __builtin_nanf(""), y);
+    return vmath_f32_select(x != x, x, y);
+}
+
+static inline
+FN_ATTR_CONST
+vmath_f64_t
+vmath_f64_log(vmath_f64_t x)
+{
+    // fdlibm e_log.c
+    const double ln2_hi = 6.93147180369123816490e-01, ln2_lo = 1.90821492927058770002e-10;
+    const double lg1 = 6.666666666666735130e-01, lg2 = 3.999999999940941908e-01;
+    const double lg3 = 2.857142874366239149e-01, lg4 = 2.222219843214978396e-01;
+    const double lg5 = 1.818357216161805012e-01, lg6 = 1.531383769920937332e-01;
+    const double lg7 = 1.479819860511658591e-01;
+
+    const vmath_i64_t is_sub = x < 0x1p-1022;
+    const vmath_i64_t ix = (vmath_i64_t)vmath_f64_select(is_sub, x * 0x1p54, x);
+    vmath_i64_t k = ((ix >> 52) & 0x7ff) - 1023 - (is_sub & 54);
+    vmath_f64_t m = (vmath_f64_t)((ix & 0x000fffffffffffff) | 0x3ff0000000000000);
+    const vmath_i64_t is_big = m > 0x1.6a09e667f3bcdp+0;
+    m = vmath_f64_select(is_big, m * 0.5, m);
+    k -= is_big;
+
+    const vmath_f64_t f = m - 1.0;
+    const vmath_f64_t s = f / (2.0 + f);
+    const vmath_f64_t z = s * s;
+    const vmath_f64_t w = z * z;
+    const vmath_f64_t r = z * (lg1 + w * (lg3 + w * (lg5 + w * lg7))) +
+                          w * (lg2 + w * (lg4 + w * lg6));
+    const vmath_f64_t hfsq = 0.5 * f * f;
+    // small integer to double without AVX-512 conversion instructions
+    const vmath_f64_t magic = (vmath_f64_t){} + _VMATH_F64_ROUND_MAGIC;
+    const vmath_f64_t dk = (vmath_f64_t)(k + (vmath_i64_t)magic) - magic;
+    vmath_f64_t y = dk * ln2_hi - ((hfsq - (s * (hfsq + r) + dk * ln2_lo)) - f);
+
+    y = vmath_f64_select(x == __builtin_inf(), x, y);
+    y = vmath_f64_select(x == 0.0, (vmath_f64_t){} - __builtin_inf(), y);
+    y = vmath_f64_select(x < 0.0, (vmath_f64_t){} + __builtin_nan(""), y);
+    return vmath_f64_select(x != x, x, y);
+}
+
+/** `log(1 + x)`, rounding error of `u = 1 + x` is corrected by `(x - (u - 1)) / u`.
+ *
+ */
+static inline
+FN_ATTR_CONST
+vmath_f32_t
+vmath_f32_log1p(vmath_f32_t x)
+{
+    const vmath_f32_t u = 1.0f + x;
+    vmath_f32_t y = vmath_f32_log(u) + (x - (u - 1.0f)) / u;
+
+    y = vmath_f32_select(u == 0.0f, (vmath_f32_t){} - __builtin_inff(), y);
+    // keeps -0.0 and infinity
+    return vmath_f32_select((x == 0.0f) | (x == __builtin_inff()), x, y);
+}
+
+static inline
+FN_ATTR_CONST
+vmath_f64_t
+vmath_f64_log1p(vmath_f64_t x)
+{
+    const vmath_f64_t u = 1.0 + x;
+    vmath_f64_t y = vmath_f64_log(u) + (x - (u - 1.0)) / u;
+
+    y = vmath_f64_select(u == 0.0, (vmath_f64_t){} - __builtin_inf(), y);
+    return vmath_f64_select((x == 0.0) | (x == __builtin_inf()), x, y);
+}
+
+/** Correctly rounded square root by the hardware instruction.
+ *
+ */
+static inline
+FN_ATTR_CONST
+vmath_f32_t
+vmath_f32_sqrt(vmath_f32_t x)
+{
+#if SMARTARR_SIMD_VLEN == 64 && defined(__AVX512F__)
+    return (vmath_f32_t)_mm512_sqrt_ps((__m512)x);
+#elif SMARTARR_SIMD_VLEN == 32 && defined(__AVX__)
+    return (vmath_f32_t)_mm256_sqrt_ps((__m256)x);
+#elif SMARTARR_SIMD_VLEN == 16 && defined(__SSE__)
+    return (vmath_f32_t)_mm_sqrt_ps((__m128)x);
+#else
+    for (unsigned int i = 0; i < sizeof(x) / sizeof(x[0]); ++i) {
+        x[i] = __builtin_sqrtf(x[i]);
+    }
+    return x;
+#endif
+}
+
+static inline
+FN_ATTR_CONST
+vmath_f64_t
+vmath_f64_sqrt(vmath_f64_t x)
+{
+#if SMARTARR_SIMD_VLEN == 64 && defined(__AVX512F__)
+    return (vmath_f64_t)_mm512_sqrt_pd((__m512d)x);
+#elif SMARTARR_SIMD_VLEN == 32 && defined(__AVX__)
+    return (vmath_f64_t)_mm256_sqrt_pd((__m256d)x);
+#elif SMARTARR_SIMD_VLEN == 16 && defined(__SSE2__)
+    return (vmath_f64_t)_mm_sqrt_pd((__m128d)x);
+#else
+    for (unsigned int i = 0; i < sizeof(x) / sizeof(x[0]); ++i) {
+        x[i] = __builtin_sqrt(x[i]);
+    }
+    return x;
+#endif
+}
+
+/** `1 / sqrt(x)`, division of correctly rounded root.
+ *
+ * Hardware reciprocal square root estimate with a Newton step
+ * is faster but several ULP off.
+ */
+static inline
+FN_ATTR_CONST
+vmath_f32_t
+vmath_f32_rsqrt(vmath_f32_t x)
+{
+    return 1.0f / vmath_f32_sqrt(x);
+}
+
+static inline
+FN_ATTR_CONST
+vmath_f64_t
+vmath_f64_rsqrt(vmath_f64_t x)
+{
+    return 1.0 / vmath_f64_sqrt(x);
+}
+
+/** `tanh(x)`, odd polynomial for `|x| < 0.625`, `1 - 2 / (exp(2|x|) + 1)` otherwise.
+ *
+ * Both are computed for `|x|`, sign of `x` is copied to the result.
+ */
+static inline
+FN_ATTR_CONST
+vmath_f32_t
+vmath_f32_tanh(vmath_f32_t x)
+{
+    // Cephes tanhf.c
+    const vmath_f32_t ax = vmath_f32_abs(x);
+    const vmath_f32_t z = x * x;
+    vmath_f32_t p = -5.70498872745e-3f * z + 2.06390887954e-2f;
+    p = p * z - 5.37397155531e-2f;
+    p = p * z + 1.33314422036e-1f;
+    p = p * z - 3.33332819422e-1f;
+    p = p * z * ax + ax;
+
+    vmath_f32_t y = 1.0f - 2.0f / (vmath_f32_exp(2.0f * ax) + 1.0f);
+    y = vmath_f32_select(ax < 0.625f, p, y);
+
+    return (vmath_f32_t)((vmath_i32_t)y | ((vmath_i32_t)x & INT32_MIN));
+}
+
+static inline
+FN_ATTR_CONST
+vmath_f64_t
+vmath_f64_tanh(vmath_f64_t x)
+{
+    // Cephes tanh.c
+    const vmath_f64_t ax = vmath_f64_abs(x);
+    const vmath_f64_t z = x * x;
+    const vmath_f64_t p = (-9.64399179425052238628e-1 * z - 9.92877231001918586564e1) * z
+        - 1.61468768441708447952e3;
+    const vmath_f64_t q = ((z + 1.12811678491632931402e2) * z + 2.23548839060100448583e3) * z
+        + 4.84406305325125486048e3;
+
+    vmath_f64_t y = 1.0 - 2.0 / (vmath_f64_exp(2.0 * ax) + 1.0);
+    y = vmath_f64_select(ax < 0.625, ax + ax * z * p / q, y);
+
+    return (vmath_f64_t)((vmath_i64_t)y | ((vmath_i64_t)x & INT64_MIN));
+}
+
+/** `1 / (1 + exp(-x))`, computed as `e / (1 + e)` with `e = exp(x)` for negative `x`,
+ * so results close to 0 keep full precision instead of flushing to 0.
+ */
+static inline
+FN_ATTR_CONST
+vmath_f32_t
+vmath_f32_sigmoid(vmath_f32_t x)
+{
+    const vmath_f32_t e = vmath_f32_exp(-vmath_f32_abs(x));
+    const vmath_f32_t d = 1.0f + e;
+    return vmath_f32_select(x >= 0.0f, 1.0f / d, e / d);
+}
+
+static inline
+FN_ATTR_CONST
+vmath_f64_t
+vmath_f64_sigmoid(vmath_f64_t x)
+{
+    const vmath_f64_t e = vmath_f64_exp(-vmath_f64_abs(x));
+    const vmath_f64_t d = 1.0 + e;
+    return vmath_f64_select(x >= 0.0, 1.0 / d, e / d);
+}
+
+/** `sin(x + quadrant * pi/2)`, `x = n*pi/2 + r`, `|r| <= pi/4`.
+ *
+ * Lanes with `|x|` above `VMATH_F32_TRIG_MAX`, infinity or NaN are computed by libm.
+ */
+static inline __attribute__((always_inline))
+vmath_f32_t
+vmath_f32_sin_quadrant(vmath_f32_t x, int quadrant)
+{
+    // Float pi/2 in 3 parts loses r close to multiples of pi/2 already for |x| > 4,
+    // so x is reduced in double by 33 bits and 53 bits parts of pi/2.
+    typedef double wide_t __attribute__((vector_size(2 * SMARTARR_SIMD_VLEN)));
+    typedef int64_t wide_i_t __attribute__((vector_size(2 * SMARTARR_SIMD_VLEN)));
+    const wide_t xd = __builtin_convertvector(x, wide_t);
+    const wide_t t = xd * 0x1.45f306dc9c883p-1 + _VMATH_F64_ROUND_MAGIC;
+    const wide_t nf = t - _VMATH_F64_ROUND_MAGIC;
+    const vmath_i32_t q = __builtin_convertvector((wide_i_t)t, vmath_i32_t) + quadrant;
+    const vmath_f32_t r = __builtin_convertvector(
+        (xd - nf * 1.57079632673412561417e+00) - nf * 6.07710050650619224932e-11, vmath_f32_t);
+    const vmath_f32_t z = r * r;
+
+    // Cephes sinf.c polynomials
+    vmath_f32_t s = -1.9515295891e-4f * z + 8.3321608736e-3f;
+    s = s * z - 1.6666654611e-1f;
+    s = s * z * r + r;
+
+    vmath_f32_t c = 2.443315711809948e-5f * z - 1.388731625493765e-3f;
+    c = c * z + 4.166664568298827e-2f;
+    c = c * z * z - 0.5f * z + 1.0f;
+
+    vmath_f32_t y = vmath_f32_select(-(q & 1), c, s);
+    y = (vmath_f32_t)((vmath_i32_t)y ^ ((q & 2) << 30));
+    if (quadrant == 0) {
+        // sin(-0.0) is -0.0
+        y = vmath_f32_select(x == 0.0f, x, y);
+    }
+
+    const vmath_i32_t is_big = ~(vmath_f32_abs(x) <= VMATH_F32_TRIG_MAX);
+    if (simd_movemask_i8((simd_i8_t)is_big)) {
+        for (unsigned int i = 0; i < sizeof(x) / sizeof(x[0]); ++i) {
+            if (is_big[i]) {
+                y[i] = (quadrant == 0)? sinf(x[i]) : cosf(x[i]);
+            }
+        }
+    }
+    return y;
+}
+
+static inline __attribute__((always_inline))
+vmath_f64_t
+vmath_f64_sin_quadrant(vmath_f64_t x, int quadrant)
+{
+    // fdlibm k_sin.c, k_cos.c and medium size reduction of e_rem_pio2.c,
+    // r = hi + lo, lo keeps bits of r lost when x is close to a multiple of pi/2
+    const double s1 = -1.66666666666666324348e-01, s2 = 8.33333333332248946124e-03;
+    const double s3 = -1.98412698298579493134e-04, s4 = 2.75573137070700676789e-06;
+    const double s5 = -2.50507602534068634195e-08, s6 = 1.58969099521155010221e-10;
+    const double c1 = 4.16666666666666019037e-02, c2 = -1.38888888888741095749e-03;
+    const double c3 = 2.48015872894767294178e-05, c4 = -2.75573143513906633035e-07;
+    const double c5 = 2.08757232129817482790e-09, c6 = -1.13596475577881948265e-11;
+    const double pio2_1 = 1.57079632673412561417e+00, pio2_2 = 6.07710050630396597660e-11;
+    const double pio2_2t = 2.02226624879595063154e-21;
+
+    const vmath_f64_t t = x * 0x1.45f306dc9c883p-1 + _VMATH_F64_ROUND_MAGIC;
+    const vmath_f64_t nf = t - _VMATH_F64_ROUND_MAGIC;
+    const vmath_i64_t q = (vmath_i64_t)t + quadrant;
+    const vmath_f64_t r1 = x - nf * pio2_1;
+    const vmath_f64_t w1 = nf * pio2_2;
+    const vmath_f64_t r2 = r1 - w1;
+    const vmath_f64_t w2 = nf * pio2_2t - ((r1 - r2) - w1);
+    const vmath_f64_t hi = r2 - w2;
+    const vmath_f64_t lo = (r2 - hi) - w2;
+    const vmath_f64_t z = hi * hi;
+
+    const vmath_f64_t v = z * hi;
+    const vmath_f64_t sr = s2 + z * (s3 + z * (s4 + z * (s5 + z * s6)));
+    const vmath_f64_t s = hi - ((z * (0.5 * lo - v * sr) - lo) - v * s1);
+
+    const vmath_f64_t cr = z * (c1 + z * (c2 + z * (c3 + z * (c4 + z * (c5 + z * c6)))));
+    const vmath_f64_t hz = 0.5 * z;
+    const vmath_f64_t w = 1.0 - hz;
+    const vmath_f64_t c = w + (((1.0 - w) - hz) + (z * cr - hi * lo));
+
+    vmath_f64_t y = vmath_f64_select(-(q & 1), c, s);
+    y = (vmath_f64_t)((vmath_i64_t)y ^ ((q & 2) << 62));
+    if (quadrant == 0) {
+        y = vmath_f64_select(x == 0.0, x, y);
+    }
+
+    const vmath_i64_t is_big = ~(vmath_f64_abs(x) <= VMATH_F64_TRIG_MAX);
+    if (simd_movemask_i8((simd_i8_t)is_big)) {
+        for (unsigned int i = 0; i < sizeof(x) / sizeof(x[0]); ++i) {
+            if (is_big[i]) {
+                y[i] = (quadrant == 0)? sin(x[i]) : cos(x[i]);
+            }
+        }
+    }
+    return y;
+}
+
+static inline
+vmath_f32_t
+vmath_f32_sin(vmath_f32_t x)
+{
+    return vmath_f32_sin_quadrant(x, 0);
+}
+
+static inline
+vmath_f64_t
+vmath_f64_sin(vmath_f64_t x)
+{
+    return vmath_f64_sin_quadrant(x, 0);
+}
+
+/** `cos(x) = sin(x + pi/2)`.
+ *
+ */
+static inline
+vmath_f32_t
+vmath_f32_cos(vmath_f32_t x)
+{
+    return vmath_f32_sin_quadrant(x, 1);
+}
+
+static inline
+vmath_f64_t
+vmath_f64_cos(vmath_f64_t x)
+{
+    return vmath_f64_sin_quadrant(x, 1);
+}
+
+// Element type of `T##_smart_array_t`.
+#define _VMATH_ELEM_T(T) typeof(((T##_smart_array_t*)0)->data[0])
+
+/** Define array functions of vector kernel `vmath_T_name`.
+ *
+ * Whole vectors are loaded straight from the array, the tail
+ * goes through a zero padded vector.
+ */
+#define _VMATH_ARRAY_FUNCTIONS(T, name) \
+static inline \
+__attribute__((access(read_only, 2, 1), access(write_only, 3, 1))) FN_ATTR_RETURNS_NONNULL \
+_VMATH_ELEM_T(T)* \
+T##_array_##name(size_t len, const _VMATH_ELEM_T(T) a[len], _VMATH_ELEM_T(T) b[len]) \
+{ \
+    const size_t lanes = sizeof(vmath_##T##_t) / sizeof(a[0]); \
+    const size_t main_len = len - len % lanes; \
+    ARRAY_ASSERT_ALIGNED(a); \
+    ARRAY_ASSERT_ALIGNED(b); \
+    a = __builtin_assume_aligned(a, _SMART_ARRAY_ALIGN); \
+    b = __builtin_assume_aligned(b, _SMART_ARRAY_ALIGN); \
+    for (size_t i = 0; i < main_len; i += lanes) { \
+        *(vmath_##T##_t*)&b[i] = vmath_##T##_##name(*(const vmath_##T##_t*)&a[i]); \
+    } \
+    if (main_len < len) { \
+        vmath_##T##_t v = {}; \
+        __builtin_memcpy(&v, &a[main_len], (len - main_len) * sizeof(a[0])); \
+        v = vmath_##T##_##name(v); \
+        __builtin_memcpy(&b[main_len], &v, (len - main_len) * sizeof(a[0])); \
+    } \
+    return b; \
+} \
+\
+static inline \
+__attribute__((access(read_write, 2, 1))) FN_ATTR_RETURNS_NONNULL \
+_VMATH_ELEM_T(T)* \
+T##_array_##name##_destruct(size_t len, _VMATH_ELEM_T(T) a[len]) \
+{ \
+    return T##_array_##name(len, a, a); \
+} \
+\
+static inline \
+__attribute__((nonnull(1, 2))) FN_ATTR_RETURNS_NONNULL \
+_VMATH_ELEM_T(T)* \
+T##_smart_array_##name(const T##_smart_array_t* a, T##_smart_array_t* b) \
+{ \
+    size_t len = (a->len < b->len)? a->len : b->len; \
+    return T##_array_##name(len, a->data, b->data); \
+} \
+\
+static inline \
+__attribute__((nonnull(1))) FN_ATTR_RETURNS_NONNULL \
+_VMATH_ELEM_T(T)* \
+T##_smart_array_##name##_destruct(T##_smart_array_t* a) \
+{ \
+    return T##_array_##name(a->len, a->data, a->data); \
+} \
+_VMATH_OMP_ARRAY_FUNCTIONS(T, name)
+
+#ifdef _ARRAY_OMP_ENABLE
+// Parallel versions run the serial kernel on aligned chunks.
+#define _VMATH_OMP_ARRAY_FUNCTIONS(T, name) \
+static inline \
+__attribute__((access(read_only, 2, 1), access(write_only, 3, 1))) FN_ATTR_RETURNS_NONNULL \
+_VMATH_ELEM_T(T)* \
+T##_omp_array_##name(size_t len, const _VMATH_ELEM_T(T) a[len], _VMATH_ELEM_T(T) b[len]) \
+{ \
+    const size_t _chunk_len = SMARTARR_OMP_CHUNK_LEN; \
+    _Pragma("omp parallel for schedule(static) if (len > _chunk_len)") \
+    for (size_t _i = 0; _i < len; _i += _chunk_len) { \
+        const size_t _n = (len - _i < _chunk_len)? len - _i : _chunk_len; \
+        T##_array_##name(_n, &a[_i], &b[_i]); \
+    } \
+    return b; \
+} \
+\
+static inline \
+__attribute__((access(read_write, 2, 1))) FN_ATTR_RETURNS_NONNULL \
+_VMATH_ELEM_T(T)* \
+T##_omp_array_##name##_destruct(size_t len, _VMATH_ELEM_T(T) a[len]) \
+{ \
+    return T##_omp_array_##name(len, a, a); \
+} \
+\
+static inline \
+__attribute__((nonnull(1, 2))) FN_ATTR_RETURNS_NONNULL \
+_VMATH_ELEM_T(T)* \
+T##_omp_smart_array_##name(const T##_smart_array_t* a, T##_smart_array_t* b) \
+{ \
+    size_t len = (a->len < b->len)? a->len : b->len; \
+    return T##_omp_array_##name(len, a->data, b->data); \
+} \
+\
+static inline \
+__attribute__((nonnull(1))) FN_ATTR_RETURNS_NONNULL \
+_VMATH_ELEM_T(T)* \
+T##_omp_smart_array_##name##_destruct(T##_smart_array_t* a) \
+{ \
+    return T##_omp_array_##name(a->len, a->data, a->data); \
+}
+#else
+#define _VMATH_OMP_ARRAY_FUNCTIONS(T, name)
+#endif // _ARRAY_OMP_ENABLE
+
+#define _VMATH_ALL_ARRAY_FUNCTIONS(T) \
+    _VMATH_ARRAY_FUNCTIONS(T, exp) \
+    _VMATH_ARRAY_FUNCTIONS(T, log) \
+    _VMATH_ARRAY_FUNCTIONS(T, log1p) \
+    _VMATH_ARRAY_FUNCTIONS(T, sqrt) \
+    _VMATH_ARRAY_FUNCTIONS(T, rsqrt) \
+    _VMATH_ARRAY_FUNCTIONS(T, tanh) \
+    _VMATH_ARRAY_FUNCTIONS(T, sigmoid) \
+    _VMATH_ARRAY_FUNCTIONS(T, sin) \
+    _VMATH_ARRAY_FUNCTIONS(T, cos)
+
+_VMATH_ALL_ARRAY_FUNCTIONS(f32)
+_VMATH_ALL_ARRAY_FUNCTIONS(f64)
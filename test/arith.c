@@ -0,0 +1,455 @@
+#include "smartarr/defines.h"
+
+#define _ARRAY_OMP_ENABLE
+#include "smartarr/basic_type_array.h"
+#include "smartarr/fused.h"
+
+// see https://github.com/silentbicycle/greatest
+#include "third/greatest.h"
+
+// Lengths around the vector width and the OMP chunk boundary.
+static const size_t arith_lens[] = {0, 1, 7, 64, 1000, SMARTARR_OMP_CHUNK_LEN + 3};
+
+// Small integer values keep every result exact in all types,
+// `b` is never 0 to allow division.
+#define ARITH_A(i) ((i) % 23)
+#define ARITH_B(i) ((i) % 5 + 1)
+
+// Every kernel must match its scalar expression in 3-operand,
+// in-place and OMP forms.
+#define CHECK_BINARY(T, name, expr) do { \
+    T##_array_##name(len, a, b, c); \
+    T##_omp_array_##name(len, a, b, d); \
+    T##_array_copy(len, a, e); \
+    T##_array_##name##_destruct(len, e, b); \
+    for (size_t i = 0; i < len; ++i) { \
+        const elem_t x = a[i], y = b[i]; \
+        ASSERT_EQm(#name, (elem_t)(expr), c[i]); \
+        ASSERT_EQm(#name, c[i], d[i]); \
+        ASSERT_EQm(#name, c[i], e[i]); \
+    } \
+} while (0)
+
+#define CHECK_UNARY(T, name, expr) do { \
+    T##_array_##name(len, a, c); \
+    T##_omp_array_##name(len, a, d); \
+    T##_array_copy(len, a, e); \
+    T##_omp_array_##name##_destruct(len, e); \
+    for (size_t i = 0; i < len; ++i) { \
+        const elem_t x = a[i]; \
+        ASSERT_EQm(#name, (elem_t)(expr), c[i]); \
+        ASSERT_EQm(#name, c[i], d[i]); \
+        ASSERT_EQm(#name, c[i], e[i]); \
+    } \
+} while (0)
+
+#define TEST_ARITH(T, sign) \
+TEST T##_arith(void) \
+{ \
+    typedef typeof(((T##_smart_array_t*)0)->data[0]) elem_t; \
+    for (size_t l = 0; l < fixlen_array_len(arith_lens); ++l) { \
+        const size_t len = arith_lens[l]; \
+        auto_free T##_smart_array_t* sa = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* sb = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* sc = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* sd = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* se = T##_smart_array_heap_new(len); \
+        elem_t* a = sa->data; elem_t* b = sb->data; \
+        elem_t* c = sc->data; elem_t* d = sd->data; elem_t* e = se->data; \
+        for (size_t i = 0; i < len; ++i) { \
+            a[i] = (elem_t)(sign * (elem_t)ARITH_A(i)); \
+            b[i] = ARITH_B(i); \
+        } \
+        CHECK_BINARY(T, add, x + y); \
+        CHECK_BINARY(T, sub, x - y); \
+        CHECK_BINARY(T, mul, x * y); \
+        CHECK_BINARY(T, div, x / y); \
+        CHECK_BINARY(T, min, (x < y)? x : y); \
+        CHECK_BINARY(T, max, (x < y)? y : x); \
+        CHECK_UNARY(T, neg, -x); \
+        CHECK_UNARY(T, abs, (x > (elem_t)0)? x : -x); \
+        \
+        T##_smart_array_scale(sa, 3, sc); \
+        T##_omp_smart_array_scale(sa, 3, sd); \
+        for (size_t i = 0; i < len; ++i) { \
+            ASSERT_EQ((elem_t)(a[i] * 3), c[i]); \
+            ASSERT_EQ(c[i], d[i]); \
+        } \
+        T##_smart_array_axpy(2, sa, sb, sc); \
+        T##_omp_smart_array_axpy(2, sa, sb, sd); \
+        T##_array_copy(len, b, e); \
+        T##_smart_array_axpy_destruct(2, sa, se); \
+        for (size_t i = 0; i < len; ++i) { \
+            ASSERT_EQ((elem_t)(2 * a[i] + b[i]), c[i]); \
+            ASSERT_EQ(c[i], d[i]); \
+            ASSERT_EQ(c[i], e[i]); \
+        } \
+        T##_smart_array_fma(sa, sb, sa, sc); \
+        T##_omp_smart_array_fma(sa, sb, sa, sd); \
+        T##_array_copy(len, a, e); \
+        T##_omp_smart_array_fma_destruct(sa, sb, se); \
+        for (size_t i = 0; i < len; ++i) { \
+            ASSERT_EQ((elem_t)(a[i] * b[i] + a[i]), c[i]); \
+            ASSERT_EQ(c[i], d[i]); \
+            ASSERT_EQ(c[i], e[i]); \
+        } \
+    } \
+    PASS(); \
+}
+
+TEST_ARITH(i64, -1)
+TEST_ARITH(u64, 1)
+TEST_ARITH(i32, -1)
+TEST_ARITH(u32, 1)
+TEST_ARITH(f64, -1)
+TEST_ARITH(f32, -1)
+
+// Smart array wrappers work on the shortest length and keep the rest intact.
+TEST arith_smart_array_len(void)
+{
+    auto_free i32_smart_array_t* a = i32_smart_array_heap_new(10);
+    auto_free i32_smart_array_t* b = i32_smart_array_heap_new(5);
+    for (size_t i = 0; i < 10; ++i) {
+        a->data[i] = i;
+    }
+    for (size_t i = 0; i < 5; ++i) {
+        b->data[i] = 100;
+    }
+    i32_smart_array_sub_destruct(a, b);
+    i32_omp_smart_array_neg_destruct(b);
+    for (size_t i = 0; i < 10; ++i) {
+        ASSERT_EQ((i < 5)? (int32_t)i - 100 : (int32_t)i, a->data[i]);
+    }
+    for (size_t i = 0; i < 5; ++i) {
+        ASSERT_EQ(-100, b->data[i]);
+    }
+
+    PASS();
+}
+
+TEST arith_float_specials(void)
+{
+    ATTR_SMART_ARRAY_ALIGNED double a[4] = {-0.0, 0.0, -1.5, __builtin_inf()};
+    ATTR_SMART_ARRAY_ALIGNED double b[4];
+
+    f64_array_abs(4, a, b);
+    ASSERT_FALSE(__builtin_signbit(b[0]));
+    ASSERT_EQ(0.0, b[1]);
+    ASSERT_EQ(1.5, b[2]);
+    ASSERT_EQ(__builtin_inf(), b[3]);
+
+    f64_array_neg(4, a, b);
+    ASSERT_FALSE(__builtin_signbit(b[0]));
+    ASSERT(__builtin_signbit(b[1]));
+    ASSERT_EQ(-__builtin_inf(), b[3]);
+
+    PASS();
+}
+
+// Small integers are summed exactly by every summation.
+#define TEST_REDUCE_ADD(T, sign) \
+TEST T##_reduce_add(void) \
+{ \
+    for (size_t l = 0; l < fixlen_array_len(arith_lens); ++l) { \
+        const size_t len = arith_lens[l]; \
+        auto_free T##_smart_array_t* a = T##_smart_array_heap_new(len); \
+        int64_t expected = 0; \
+        for (size_t i = 0; i < len; ++i) { \
+            a->data[i] = sign * (int64_t)ARITH_A(i); \
+            expected += sign * (int64_t)ARITH_A(i); \
+        } \
+        typedef typeof(a->data[0]) elem_t; \
+        ASSERT_EQ((elem_t)expected, T##_smart_array_reduce_add(a)); \
+        ASSERT_EQ((elem_t)expected, T##_smart_array_reduce_add_serial(a)); \
+        ASSERT_EQ((elem_t)expected, T##_smart_array_reduce_add_simd(a)); \
+        ASSERT_EQ((elem_t)expected, T##_smart_array_reduce_add_pairwise(a)); \
+        ASSERT_EQ((elem_t)expected, T##_smart_array_reduce_add_kahan(a)); \
+        ASSERT((T##_wide_t)expected == T##_smart_array_reduce_add_wide(a)); \
+    } \
+    PASS(); \
+}
+
+TEST_REDUCE_ADD(i64, -1)
+TEST_REDUCE_ADD(u64, 1)
+TEST_REDUCE_ADD(i32, -1)
+TEST_REDUCE_ADD(u32, 1)
+TEST_REDUCE_ADD(f64, -1)
+TEST_REDUCE_ADD(f32, -1)
+
+// Sum of 4M values 0.1f, serial float sum is far off.
+TEST reduce_add_accuracy(void)
+{
+    constexpr size_t len = 4 * 1024 * 1024;
+    auto_free f32_smart_array_t* a = f32_smart_array_heap_new(len);
+    f32_smart_array_fill(a, 0.1f);
+    const double exact = (double)len * 0.1f;
+
+    const double serial = f32_smart_array_reduce_add_serial(a);
+    const double pairwise = f32_smart_array_reduce_add_pairwise(a);
+    const double kahan = f32_smart_array_reduce_add_kahan(a);
+    const double wide = f32_smart_array_reduce_add_wide(a);
+
+    ASSERT(__builtin_fabs(serial - exact) > 1e-3 * exact);
+    ASSERT_IN_RANGE(exact, pairwise, 1e-6 * exact);
+    ASSERT_IN_RANGE(exact, kahan, 1e-7 * exact);
+    ASSERT_IN_RANGE(exact, wide, 1e-12 * exact);
+
+    // Large terms must not absorb small ones.
+    ATTR_SMART_ARRAY_ALIGNED double b[] = {1.0, 1e100, 1.0, -1e100};
+    ASSERT_EQ(2.0, f64_array_reduce_add_kahan(fixlen_array_len(b), b));
+
+    PASS();
+}
+
+TEST reduce_add_wide(void)
+{
+    constexpr size_t len = 1024 * 1024 + 3;
+    auto_free i32_smart_array_t* a = i32_smart_array_heap_new(len);
+    auto_free u64_smart_array_t* b = u64_smart_array_heap_new(3);
+    i32_smart_array_fill(a, INT32_MAX);
+    u64_smart_array_fill(b, UINT64_MAX);
+
+    int64_t sum = i32_smart_array_reduce_add_wide(a);
+    ASSERT_EQ((int64_t)len * INT32_MAX, sum);
+    unsigned __int128 usum = u64_smart_array_reduce_add_wide(b);
+    ASSERT(3 * (unsigned __int128)UINT64_MAX == usum);
+
+    PASS();
+}
+
+// Inclusive and exclusive scan in serial, OMP and in-place forms match a naive loop.
+#define TEST_SCAN(T, sign) \
+TEST T##_scan(void) \
+{ \
+    for (size_t l = 0; l < fixlen_array_len(arith_lens); ++l) { \
+        const size_t len = arith_lens[l]; \
+        auto_free T##_smart_array_t* a = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* incl = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* excl = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* omp_incl = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* omp_excl = T##_smart_array_heap_new(len); \
+        typedef typeof(a->data[0]) elem_t; \
+        for (size_t i = 0; i < len; ++i) { \
+            a->data[i] = (elem_t)(sign * (elem_t)ARITH_A(i)); \
+        } \
+        const elem_t total = T##_smart_array_scan(a, incl); \
+        ASSERT_EQ(total, T##_smart_array_scan_exclusive(a, excl)); \
+        ASSERT_EQ(total, T##_omp_smart_array_scan(a, omp_incl)); \
+        ASSERT_EQ(total, T##_omp_smart_array_scan_exclusive(a, omp_excl)); \
+        elem_t sum = 0; \
+        for (size_t i = 0; i < len; ++i) { \
+            ASSERT_EQ(sum, excl->data[i]); \
+            ASSERT_EQ(sum, omp_excl->data[i]); \
+            sum += a->data[i]; \
+            ASSERT_EQ(sum, incl->data[i]); \
+            ASSERT_EQ(sum, omp_incl->data[i]); \
+        } \
+        ASSERT_EQ(sum, total); \
+        T##_smart_array_scan_exclusive(a, a); \
+        ASSERT_MEM_EQ(excl->data, a->data, len * sizeof(elem_t)); \
+    } \
+    PASS(); \
+}
+
+TEST_SCAN(i64, -1)
+TEST_SCAN(u64, 1)
+TEST_SCAN(i32, -1)
+TEST_SCAN(u32, 1)
+TEST_SCAN(f64, -1)
+TEST_SCAN(f32, -1)
+
+ARRAY_FUSED_KERNEL(f64, mul_add_sub, (a, b, c, e), a * b + c - e)
+ARRAY_FUSED_KERNEL(i32, square, (x), x * x)
+ARRAY_FUSED_KERNEL(u64, sum8, (a, b, c, d, e, f, g, h), a + b + c + d + e + f + g + h)
+
+// Fused kernel must give the same result as the chain of kernels with temporaries.
+TEST fused_kernel(void)
+{
+    for (size_t l = 0; l < fixlen_array_len(arith_lens); ++l) {
+        const size_t len = arith_lens[l];
+        auto_free f64_smart_array_t* a = f64_smart_array_heap_new(len);
+        auto_free f64_smart_array_t* b = f64_smart_array_heap_new(len);
+        auto_free f64_smart_array_t* c = f64_smart_array_heap_new(len);
+        auto_free f64_smart_array_t* e = f64_smart_array_heap_new(len);
+        auto_free f64_smart_array_t* d = f64_smart_array_heap_new(len);
+        auto_free f64_smart_array_t* omp_d = f64_smart_array_heap_new(len);
+        auto_free f64_smart_array_t* tmp = f64_smart_array_heap_new(len);
+        for (size_t i = 0; i < len; ++i) {
+            a->data[i] = ARITH_A(i);
+            b->data[i] = ARITH_B(i);
+            c->data[i] = (double)i;
+            e->data[i] = 0.5;
+        }
+        f64_smart_array_mul_add_sub(a, b, c, e, d);
+        f64_omp_smart_array_mul_add_sub(a, b, c, e, omp_d);
+        f64_smart_array_mul(a, b, tmp);
+        f64_smart_array_add_destruct(tmp, c);
+        f64_smart_array_sub_destruct(tmp, e);
+        for (size_t i = 0; i < len; ++i) {
+            ASSERT_EQ(tmp->data[i], d->data[i]);
+            ASSERT_EQ(tmp->data[i], omp_d->data[i]);
+        }
+    }
+
+    PASS();
+}
+
+TEST fused_kernel_in_place(void)
+{
+    constexpr size_t len = 1000;
+    auto_free i32_smart_array_t* x = i32_smart_array_heap_new(len);
+    auto_free u64_smart_array_t* u = u64_smart_array_heap_new(len);
+    auto_free u64_smart_array_t* sum = u64_smart_array_heap_new(len / 2);
+    for (size_t i = 0; i < len; ++i) {
+        x->data[i] = (int32_t)i - 500;
+        u->data[i] = i;
+    }
+    i32_omp_array_square(len, x->data, x->data);
+    for (size_t i = 0; i < len; ++i) {
+        ASSERT_EQ(((int32_t)i - 500) * ((int32_t)i - 500), x->data[i]);
+    }
+    // Length of the shortest array.
+    u64_smart_array_sum8(u, u, u, u, u, u, u, u, sum);
+    for (size_t i = 0; i < len / 2; ++i) {
+        ASSERT_EQ(8 * i, sum->data[i]);
+    }
+
+    PASS();
+}
+
+// Gather from a small dictionary, scatter by a permutation and back,
+// accumulate into a small histogram and into a large destination.
+#define TEST_GATHER(T) \
+TEST T##_gather_scatter(void) \
+{ \
+    constexpr size_t dict_len = 257; \
+    constexpr size_t hist_len = 10; \
+    typedef typeof(((T##_smart_array_t*)0)->data[0]) elem_t; \
+    const int max_threads = omp_get_max_threads(); \
+    omp_set_num_threads(4); \
+    auto_free T##_smart_array_t* dict = T##_smart_array_heap_new(dict_len); \
+    for (size_t i = 0; i < dict_len; ++i) { \
+        dict->data[i] = ARITH_A(i * 3); \
+    } \
+    for (size_t l = 0; l < sizeof(arith_lens) / sizeof(arith_lens[0]); ++l) { \
+        const size_t len = arith_lens[l]; \
+        auto_free uint32_t* idx32 = malloc(len * sizeof(uint32_t) + 1); \
+        auto_free uint64_t* idx64 = malloc(len * sizeof(uint64_t) + 1); \
+        auto_free uint32_t* perm = malloc(len * sizeof(uint32_t) + 1); \
+        auto_free T##_smart_array_t* a = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* b = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* c = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* d = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* hist = T##_smart_array_heap_new(hist_len); \
+        auto_free T##_smart_array_t* omp_hist = T##_smart_array_heap_new(hist_len); \
+        for (size_t i = 0; i < len; ++i) { \
+            idx32[i] = (i * 7919) % dict_len; \
+            idx64[i] = idx32[i]; \
+            perm[i] = (i * 7919 + 3) % len; \
+            a->data[i] = ARITH_A(i); \
+        } \
+        T##_smart_array_gather_u32(idx32, dict, b); \
+        T##_omp_smart_array_gather_u32(idx32, dict, c); \
+        T##_smart_array_gather_u64(idx64, dict, d); \
+        for (size_t i = 0; i < len; ++i) { \
+            ASSERT_EQ(dict->data[idx32[i]], b->data[i]); \
+            ASSERT_EQ(b->data[i], c->data[i]); \
+            ASSERT_EQ(b->data[i], d->data[i]); \
+        } \
+        T##_omp_smart_array_gather_u64(idx64, dict, d); \
+        for (size_t i = 0; i < len; ++i) { \
+            ASSERT_EQ(b->data[i], d->data[i]); \
+        } \
+        T##_smart_array_scatter_u32(perm, a, b); \
+        T##_omp_smart_array_scatter_u32(perm, a, c); \
+        for (size_t i = 0; i < len; ++i) { \
+            ASSERT_EQ(a->data[i], b->data[perm[i]]); \
+            ASSERT_EQ(a->data[i], c->data[perm[i]]); \
+        } \
+        T##_array_gather_u32(len, perm, b->data, c->data); \
+        for (size_t i = 0; i < len; ++i) { \
+            ASSERT_EQ(a->data[i], c->data[i]); \
+        } \
+        for (size_t i = 0; i < len; ++i) { \
+            idx64[i] = perm[i]; \
+        } \
+        T##_smart_array_fill(d, 0); \
+        T##_smart_array_scatter_u64(idx64, a, d); \
+        for (size_t i = 0; i < len; ++i) { \
+            ASSERT_EQ(a->data[i], d->data[perm[i]]); \
+        } \
+        T##_omp_smart_array_scatter_u64(idx64, a, c); \
+        T##_omp_smart_array_scatter_add_u64(idx64, a, d); \
+        for (size_t i = 0; i < len; ++i) { \
+            ASSERT_EQ(a->data[i], c->data[perm[i]]); \
+            ASSERT_EQ((elem_t)(2 * a->data[i]), d->data[perm[i]]); \
+        } \
+        for (size_t i = 0; i < len; ++i) { \
+            idx32[i] = i % hist_len; \
+        } \
+        T##_smart_array_fill(hist, 1); \
+        T##_smart_array_fill(omp_hist, 1); \
+        T##_smart_array_scatter_add_u32(idx32, a, hist); \
+        T##_omp_smart_array_scatter_add_u32(idx32, a, omp_hist); \
+        for (size_t h = 0; h < hist_len; ++h) { \
+            elem_t sum = 1; \
+            for (size_t i = h; i < len; i += hist_len) { \
+                sum += a->data[i]; \
+            } \
+            ASSERT_EQ(sum, hist->data[h]); \
+            ASSERT_EQ(sum, omp_hist->data[h]); \
+        } \
+    } \
+    omp_set_num_threads(max_threads); \
+    PASS(); \
+}
+
+TEST_GATHER(i64)
+TEST_GATHER(u64)
+TEST_GATHER(i32)
+TEST_GATHER(u32)
+TEST_GATHER(f64)
+TEST_GATHER(f32)
+
+SUITE(arith) {
+    RUN_TEST(i64_arith);
+    RUN_TEST(u64_arith);
+    RUN_TEST(i32_arith);
+    RUN_TEST(u32_arith);
+    RUN_TEST(f64_arith);
+    RUN_TEST(f32_arith);
+    RUN_TEST(arith_smart_array_len);
+    RUN_TEST(arith_float_specials);
+    RUN_TEST(i64_reduce_add);
+    RUN_TEST(u64_reduce_add);
+    RUN_TEST(i32_reduce_add);
+    RUN_TEST(u32_reduce_add);
+    RUN_TEST(f64_reduce_add);
+    RUN_TEST(f32_reduce_add);
+    RUN_TEST(reduce_add_accuracy);
+    RUN_TEST(reduce_add_wide);
+    RUN_TEST(i64_scan);
+    RUN_TEST(u64_scan);
+    RUN_TEST(i32_scan);
+    RUN_TEST(u32_scan);
+    RUN_TEST(f64_scan);
+    RUN_TEST(f32_scan);
+    RUN_TEST(i64_gather_scatter);
+    RUN_TEST(u64_gather_scatter);
+    RUN_TEST(i32_gather_scatter);
+    RUN_TEST(u32_gather_scatter);
+    RUN_TEST(f64_gather_scatter);
+    RUN_TEST(f32_gather_scatter);
+    RUN_TEST(fused_kernel);
+    RUN_TEST(fused_kernel_in_place);
+}
+
+GREATEST_MAIN_DEFS();
+
+int main(int argc UNUSED, char **argv UNUSED) {
+    GREATEST_MAIN_BEGIN();
+
+    RUN_SUITE(arith);
+
+    GREATEST_MAIN_END();
+}
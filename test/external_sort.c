@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "smartarr/defines.h"
+
+#define _ARRAY_OMP_ENABLE
+#define _ARRAY_EXTERNAL_SORT_ENABLE
+#include "smartarr/basic_type_array.h"
+
+// see https://github.com/silentbicycle/greatest
+#include "third/greatest.h"
+
+// Test files are generated in /tmp and removed by the test.
+static void
+make_tmp_path(char path[64])
+{
+    snprintf(path, 64, "/tmp/smartarr_test_XXXXXX");
+    int fd = mkstemp(path);
+    close(fd);
+}
+
+static void
+write_file(const char* path, size_t size, const void* data)
+{
+    FILE* f = fopen(path, "wb");
+    fwrite(data, 1, size, f);
+    fclose(f);
+}
+
+static size_t
+read_file(const char* path, size_t size, void* data)
+{
+    FILE* f = fopen(path, "rb");
+    size_t n = fread(data, 1, size, f);
+    fclose(f);
+    return n;
+}
+
+// Memory budget of 64 KB makes 4K element runs, lengths give
+// one partial run, one full run and many runs with a partial last one.
+#define TEST_EXTERNAL_SORT(T) \
+TEST T##_external_sort(void) \
+{ \
+    const size_t lens[] = {0, 1, 1000, 4096, 4097, 100000, 300001}; \
+    const unsigned int nr_threads[] = {1, 3}; \
+    char in_path[64], out_path[64]; \
+    make_tmp_path(in_path); \
+    make_tmp_path(out_path); \
+    for (size_t l = 0; l < fixlen_array_len(lens); ++l) { \
+        const size_t len = lens[l]; \
+        auto_free T##_smart_array_t* a = T##_smart_array_heap_new(len + 1); \
+        auto_free T##_smart_array_t* b = T##_smart_array_heap_new(len + 1); \
+        for (size_t i = 0; i < len; ++i) { \
+            a->data[i] = ((uint64_t)rand() << 33) ^ ((uint64_t)rand() << 11) ^ rand(); \
+        } \
+        write_file(in_path, len * sizeof(a->data[0]), a->data); \
+        T##_array_sort(len, a->data); \
+        for (size_t t = 0; t < fixlen_array_len(nr_threads); ++t) { \
+            smartarr_external_sort_config_t config = { \
+                .memory_budget = 64 * 1024, .nr_threads = nr_threads[t], .tmp_dir = "/tmp"}; \
+            auto res = T##_array_external_sort(in_path, out_path, &config); \
+            ASSERT_FALSE(res.iserr); \
+            ASSERT_EQ(len, res.value); \
+            ASSERT_EQ(len * sizeof(a->data[0]), \
+                read_file(out_path, (len + 1) * sizeof(a->data[0]), b->data)); \
+            ASSERT_MEM_EQ(a->data, b->data, len * sizeof(a->data[0])); \
+        } \
+    } \
+    unlink(in_path); \
+    unlink(out_path); \
+    PASS(); \
+}
+
+TEST_EXTERNAL_SORT(u64)
+TEST_EXTERNAL_SORT(i64)
+TEST_EXTERNAL_SORT(f64)
+TEST_EXTERNAL_SORT(i32)
+
+// Budget of 4 smallest merge buffers merges 3 runs at once, 16K element runs
+// give one pass, one pass with a run left over and 2, 3 and 4 passes.
+TEST external_sort_merge_passes(void)
+{
+    constexpr size_t run_len = 16 * 1024;
+    const size_t lens[] = {3 * run_len, 3 * run_len + 1, 9 * run_len, 10 * run_len, 27 * run_len + 5};
+    char in_path[64], out_path[64];
+    make_tmp_path(in_path);
+    make_tmp_path(out_path);
+
+    for (size_t l = 0; l < fixlen_array_len(lens); ++l) {
+        const size_t len = lens[l];
+        auto_free u64_smart_array_t* a = u64_smart_array_heap_new(len + 1);
+        auto_free u64_smart_array_t* b = u64_smart_array_heap_new(len + 1);
+        for (size_t i = 0; i < len; ++i) {
+            a->data[i] = rand() % 1000; // equal keys from many runs
+        }
+        write_file(in_path, len * sizeof(uint64_t), a->data);
+        u64_array_sort(len, a->data);
+
+        smartarr_external_sort_config_t config = {
+            .memory_budget = 4 * SMARTARR_EXTERNAL_SORT_MIN_BUFFER, .nr_threads = 1, .tmp_dir = "/tmp"};
+        auto res = u64_array_external_sort(in_path, out_path, &config);
+        ASSERT_FALSE(res.iserr);
+        ASSERT_EQ(len, res.value);
+        ASSERT_EQ(len * sizeof(uint64_t), read_file(out_path, (len + 1) * sizeof(uint64_t), b->data));
+        ASSERT_MEM_EQ(a->data, b->data, len * sizeof(uint64_t));
+    }
+
+    unlink(in_path);
+    unlink(out_path);
+    PASS();
+}
+
+TEST external_sort_default_config(void)
+{
+    constexpr size_t len = 1000;
+    auto_free u64_smart_array_t* a = u64_smart_array_heap_new(len);
+    auto_free u64_smart_array_t* b = u64_smart_array_heap_new(len);
+    char in_path[64], out_path[64];
+    make_tmp_path(in_path);
+    make_tmp_path(out_path);
+
+    for (size_t i = 0; i < len; ++i) {
+        a->data[i] = len - i;
+    }
+    write_file(in_path, len * sizeof(uint64_t), a->data);
+
+    auto res = u64_array_external_sort(in_path, out_path, NULL);
+    ASSERT_FALSE(res.iserr);
+    ASSERT_EQ(len, res.value);
+    ASSERT_EQ(len * sizeof(uint64_t), read_file(out_path, len * sizeof(uint64_t), b->data));
+    for (size_t i = 0; i < len; ++i) {
+        ASSERT_EQ(i + 1, b->data[i]);
+    }
+
+    unlink(in_path);
+    unlink(out_path);
+    PASS();
+}
+
+TEST external_sort_errors(void)
+{
+    char in_path[64], out_path[64];
+    make_tmp_path(in_path);
+    make_tmp_path(out_path);
+
+    auto res = u64_array_external_sort("/tmp/smartarr_no_such_file", out_path, NULL);
+    ASSERT(res.iserr);
+    ASSERT_EQ(ENOENT, res.error);
+
+    // size is not a multiple of element size
+    write_file(in_path, 12, "0123456789ab");
+    res = u64_array_external_sort(in_path, out_path, NULL);
+    ASSERT(res.iserr);
+    ASSERT_EQ(EINVAL, res.error);
+
+    uint64_t x = 7;
+    write_file(in_path, sizeof(x), &x);
+    smartarr_external_sort_config_t config = {.tmp_dir = "/tmp/smartarr_no_such_dir"};
+    res = u64_array_external_sort(in_path, out_path, &config);
+    ASSERT_FALSE(res.iserr); // single run does not need temporary files
+
+    unlink(in_path);
+    unlink(out_path);
+    PASS();
+}
+
+SUITE(external_sort) {
+    RUN_TEST(u64_external_sort);
+    RUN_TEST(i64_external_sort);
+    RUN_TEST(f64_external_sort);
+    RUN_TEST(i32_external_sort);
+    RUN_TEST(external_sort_merge_passes);
+    RUN_TEST(external_sort_default_config);
+    RUN_TEST(external_sort_errors);
+}
+
+GREATEST_MAIN_DEFS();
+
+int main(int argc UNUSED, char **argv UNUSED) {
+    GREATEST_MAIN_BEGIN();
+
+    RUN_SUITE(external_sort);
+
+    GREATEST_MAIN_END();
+}
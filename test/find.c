@@ -0,0 +1,533 @@
+#include "smartarr/defines.h"
+
+#define _ARRAY_OMP_ENABLE
+#include "smartarr/basic_type_array.h"
+
+// Scalar kernels of `double`, results must not depend on SIMD.
+#define _ARRAY_TYPE double
+#define _ARRAY_TYPE_NAME sf64
+#define _ARRAY_NO_SIMD
+#include "smartarr/array.inc.h"
+
+// see https://github.com/silentbicycle/greatest
+#include "third/greatest.h"
+
+// Compare SIMD find against scalar find for every length and hit position,
+// including arrays shorter than one vector.
+#define TEST_FIND(T) \
+TEST T##_find(void) \
+{ \
+    constexpr size_t max_len = 200; \
+    auto_free T##_smart_array_t* a = T##_smart_array_heap_new(max_len); \
+    for (size_t len = 0; len < max_len; ++len) { \
+        for (size_t i = 0; i < len; ++i) { \
+            a->data[i] = i + 1; \
+        } \
+        for (size_t pos = 0; pos < len; ++pos) { \
+            auto found = T##_array_find(len, a->data, pos + 1); \
+            ASSERT(found.present); \
+            ASSERT_EQ(pos, found.value); \
+        } \
+        ASSERT_FALSE(T##_array_find(len, a->data, 0).present); \
+        ASSERT_FALSE(T##_array_find(len, a->data, len + 1).present); \
+        if (len > 0) { \
+            a->data[len - 1] = 1; /* duplicate, first one must be found */ \
+            ASSERT_EQ(0, T##_array_find(len, a->data, 1).value); \
+            ASSERT_EQ(T##_array_find_scalar(len, a->data, len).present, \
+                      T##_array_find(len, a->data, len).present); \
+        } \
+    } \
+    PASS(); \
+}
+
+TEST_FIND(i64)
+TEST_FIND(u64)
+TEST_FIND(i32)
+TEST_FIND(u32)
+TEST_FIND(f64)
+TEST_FIND(f32)
+
+TEST find_nan(void)
+{
+    ATTR_SMART_ARRAY_ALIGNED
+    double a[5] = {1.0, __builtin_nan(""), -0.0, 3.0, 4.0};
+
+    ASSERT_FALSE(f64_array_find(5, a, __builtin_nan("")).present);
+    ASSERT_EQ(2, f64_array_find(5, a, 0.0).value);
+
+    PASS();
+}
+
+// Parallel find must return the first occurrence like the serial one,
+// hits are placed in different chunks and duplicated in later chunks.
+#define TEST_OMP_FIND(T) \
+TEST T##_omp_find(void) \
+{ \
+    constexpr size_t len = 5 * SMARTARR_OMP_CHUNK_LEN + 13; \
+    auto_free T##_smart_array_t* a = T##_smart_array_heap_new(len); \
+    for (size_t i = 0; i < len; ++i) { \
+        a->data[i] = i % 100; \
+    } \
+    const size_t hits[] = {0, 1, SMARTARR_OMP_CHUNK_LEN - 1, SMARTARR_OMP_CHUNK_LEN, \
+        3 * SMARTARR_OMP_CHUNK_LEN + 5, len - 1}; \
+    for (size_t h = 0; h < fixlen_array_len(hits); ++h) { \
+        a->data[hits[h]] = 200; \
+        a->data[len - 1] = 200; \
+        auto found = T##_omp_smart_array_find(a, 200); \
+        ASSERT(found.present); \
+        ASSERT_EQ(hits[h], found.value); \
+        ASSERT_EQ(T##_smart_array_find(a, 200).value, found.value); \
+        a->data[hits[h]] = hits[h] % 100; \
+    } \
+    ASSERT_FALSE(T##_omp_smart_array_find(a, 300).present); \
+    ASSERT_FALSE(T##_omp_array_find(0, a->data, 0).present); \
+    ASSERT_EQ(5, T##_omp_array_find(100, a->data, 5).value); \
+    PASS(); \
+}
+
+TEST_OMP_FIND(i64)
+TEST_OMP_FIND(u64)
+TEST_OMP_FIND(i32)
+TEST_OMP_FIND(u32)
+TEST_OMP_FIND(f64)
+TEST_OMP_FIND(f32)
+
+// Compare find_any and count_any with one find and count per needle,
+// small sets use the broadcast path and large ones the filter.
+#define TEST_FIND_ANY(T) \
+TEST T##_find_any(void) \
+{ \
+    constexpr size_t len = 2 * SMARTARR_OMP_CHUNK_LEN + 101; \
+    constexpr size_t max_needles = 64; \
+    auto_free T##_smart_array_t* a = T##_smart_array_heap_new(len); \
+    auto_free T##_smart_array_t* needles = T##_smart_array_heap_new(max_needles); \
+    for (size_t i = 0; i < len; ++i) { \
+        a->data[i] = rand() % 100000; \
+    } \
+    const size_t nr_needles[] = {0, 1, 2, 5, SMARTARR_FIND_ANY_BROADCAST_MAX, \
+        SMARTARR_FIND_ANY_BROADCAST_MAX + 1, max_needles}; \
+    for (size_t k = 0; k < fixlen_array_len(nr_needles); ++k) { \
+        needles->len = nr_needles[k]; \
+        for (size_t n = 0; n < needles->len; ++n) { \
+            needles->data[n] = rand() % 200000; \
+        } \
+        optional_uint_t first = {.present = false}; \
+        size_t count = 0; \
+        for (size_t n = 0; n < needles->len; ++n) { \
+            auto pos = T##_smart_array_find(a, needles->data[n]); \
+            if (pos.present && (!first.present || pos.value < first.value)) first = pos; \
+            /* repeated needles are counted once */ \
+            if (!T##_array_find(n, needles->data, needles->data[n]).present) { \
+                count += T##_smart_array_count(a, needles->data[n]); \
+            } \
+        } \
+        auto found = T##_smart_array_find_any(a, needles); \
+        ASSERT_EQ(first.present, found.present); \
+        if (first.present) ASSERT_EQ(first.value, found.value); \
+        found = T##_omp_smart_array_find_any(a, needles); \
+        ASSERT_EQ(first.present, found.present); \
+        if (first.present) ASSERT_EQ(first.value, found.value); \
+        ASSERT_EQ(count, T##_smart_array_count_any(a, needles)); \
+        ASSERT_EQ(count, T##_omp_smart_array_count_any(a, needles)); \
+        /* hit in the tail shorter than 64 elements */ \
+        if (needles->len > 0) { \
+            ASSERT_EQ(T##_array_find(len, a->data, a->data[len - 1]).value, \
+                      T##_array_find_any(len, a->data, 1, &a->data[len - 1]).value); \
+            needles->data[needles->len - 1] = a->data[len - 1]; \
+            auto pos = T##_array_find_any(len - 64, &a->data[64], needles->len, needles->data); \
+            ASSERT(pos.present); \
+            ASSERT(pos.value <= len - 65); \
+        } \
+    } \
+    PASS(); \
+}
+
+TEST_FIND_ANY(i64)
+TEST_FIND_ANY(u64)
+TEST_FIND_ANY(i32)
+TEST_FIND_ANY(u32)
+TEST_FIND_ANY(f64)
+TEST_FIND_ANY(f32)
+
+TEST find_any_zero_nan(void)
+{
+    ATTR_SMART_ARRAY_ALIGNED
+    double a[6] = {1.0, __builtin_nan(""), 2.0, -0.0, 3.0, 0.0};
+    double needles[20];
+    for (size_t n = 0; n < 20; ++n) {
+        needles[n] = 100.0 + n;
+    }
+    needles[7] = __builtin_nan("");
+    needles[11] = 0.0;
+
+    // NaN never matches, -0.0 is equal to 0.0 with both broadcast and filter
+    ASSERT_EQ(3, f64_array_find_any(6, a, 2, &needles[10]).value);
+    ASSERT_EQ(2, f64_array_count_any(6, a, 2, &needles[10]));
+    ASSERT_EQ(3, f64_array_find_any(6, a, 20, needles).value);
+    ASSERT_EQ(2, f64_array_count_any(6, a, 20, needles));
+
+    PASS();
+}
+
+// Compare find_within and count_within against a plain loop,
+// unsigned types check that the difference does not wrap around.
+#define TEST_FIND_WITHIN(T) \
+TEST T##_find_within(void) \
+{ \
+    constexpr size_t len = 2 * SMARTARR_OMP_CHUNK_LEN + 45; \
+    auto_free T##_smart_array_t* a = T##_smart_array_heap_new(len); \
+    for (size_t i = 0; i < len; ++i) { \
+        a->data[i] = rand() % 1000; \
+    } \
+    typedef typeof(a->data[0]) elem_t; \
+    const elem_t vals[] = {0, 3, 500, 999, 1500}; \
+    const elem_t tols[] = {0, 1, 7}; \
+    for (size_t v = 0; v < fixlen_array_len(vals); ++v) { \
+        for (size_t t = 0; t < fixlen_array_len(tols); ++t) { \
+            optional_uint_t first = {.present = false}; \
+            size_t count = 0; \
+            for (size_t i = 0; i < len; ++i) { \
+                elem_t d = (a->data[i] < vals[v])? vals[v] - a->data[i] : a->data[i] - vals[v]; \
+                if (d <= tols[t]) { \
+                    if (!first.present) first = (optional_uint_t){.present = true, .value = i}; \
+                    ++count; \
+                } \
+            } \
+            auto found = T##_smart_array_find_within(a, vals[v], tols[t]); \
+            ASSERT_EQ(first.present, found.present); \
+            if (first.present) ASSERT_EQ(first.value, found.value); \
+            found = T##_omp_smart_array_find_within(a, vals[v], tols[t]); \
+            ASSERT_EQ(first.present, found.present); \
+            if (first.present) ASSERT_EQ(first.value, found.value); \
+            ASSERT_EQ(count, T##_smart_array_count_within(a, vals[v], tols[t])); \
+            ASSERT_EQ(count, T##_omp_smart_array_count_within(a, vals[v], tols[t])); \
+            ASSERT_EQ(T##_smart_array_count(a, vals[v]), T##_smart_array_count_within_ulps(a, vals[v], 0)); \
+            if ((elem_t)0.5 == 0 || tols[t] == 0) { /* ulp of integer is 1 */ \
+                ASSERT_EQ(count, T##_omp_smart_array_count_within_ulps(a, vals[v], tols[t])); \
+            } \
+        } \
+    } \
+    PASS(); \
+}
+
+TEST_FIND_WITHIN(i64)
+TEST_FIND_WITHIN(u64)
+TEST_FIND_WITHIN(i32)
+TEST_FIND_WITHIN(u32)
+TEST_FIND_WITHIN(f64)
+TEST_FIND_WITHIN(f32)
+
+TEST find_within_ulps(void)
+{
+    constexpr size_t len = 100;
+    auto_free f64_smart_array_t* a = f64_smart_array_heap_new(len);
+    f64_smart_array_fill(a, 7.0);
+
+    const double one = 1.0;
+    int64_t bits;
+    __builtin_memcpy(&bits, &one, sizeof(bits));
+    for (int64_t k = 0; k < 5; ++k) {
+        int64_t b = bits + k;
+        __builtin_memcpy(&a->data[70 + k], &b, sizeof(b)); // 1.0 + k ulps
+        b = bits - k;
+        __builtin_memcpy(&a->data[20 + k], &b, sizeof(b)); // 1.0 - k ulps
+    }
+    a->data[10] = __builtin_nan("");
+
+    ASSERT_EQ(2, f64_smart_array_count_within_ulps(a, 1.0, 0));
+    ASSERT_EQ(20, f64_smart_array_find_within_ulps(a, 1.0, 0).value);
+    ASSERT_EQ(6, f64_smart_array_count_within_ulps(a, 1.0, 2));
+    ASSERT_EQ(10, f64_smart_array_count_within_ulps(a, 1.0, 4));
+    ASSERT_EQ(24, f64_smart_array_find_within_ulps(a, 1.0 - 0x1p-51, 0).value);
+    ASSERT_EQ(74, f64_omp_smart_array_find_within_ulps(a, 1.0 + 0x1p-50, 0).value);
+    ASSERT_EQ(0, f64_smart_array_count_within_ulps(a, __builtin_nan(""), UINT64_MAX));
+    ASSERT_EQ(len - 1, f64_smart_array_count_within_ulps(a, 7.0, UINT64_MAX));
+    ASSERT_EQ(0, f64_smart_array_count_within(a, __builtin_nan(""), 1.0e300));
+
+    // scalar kernels without SIMD give the same results
+    auto_free sf64_smart_array_t* s = sf64_smart_array_heap_new(len);
+    for (size_t i = 0; i < len; ++i) {
+        s->data[i] = a->data[i];
+    }
+    ASSERT_EQ(10, sf64_smart_array_count_within_ulps(s, 1.0, 4));
+    ASSERT_EQ(24, sf64_smart_array_find_within_ulps(s, 1.0 - 0x1p-51, 0).value);
+    ASSERT_EQ(74, sf64_omp_smart_array_find_within_ulps(s, 1.0 + 0x1p-50, 0).value);
+    ASSERT_EQ(0, sf64_omp_smart_array_count_within_ulps(s, __builtin_nan(""), UINT64_MAX));
+
+    // -0.0 and +0.0 are the same, the smallest subnormals are one ulp away
+    ATTR_SMART_ARRAY_ALIGNED
+    float b[4] = {-0.0f, 0x1p-149f, -0x1p-149f, 0x1p-148f};
+    ASSERT_EQ(1, f32_array_count_within_ulps(4, b, 0.0f, 0));
+    ASSERT_EQ(3, f32_array_count_within_ulps(4, b, 0.0f, 1));
+    ASSERT_EQ(4, f32_array_count_within_ulps(4, b, -0x1p-149f, 3));
+    ASSERT_EQ(3, f32_array_count_within(4, b, 0.0f, 0x1p-149f));
+
+    PASS();
+}
+
+// Every 3rd element matches, check count, bitmap and indices
+// against each other and OMP versions against serial ones.
+#define TEST_FIND_ALL(T) \
+TEST T##_find_all(void) \
+{ \
+    constexpr size_t len = 3 * SMARTARR_OMP_CHUNK_LEN + 77; \
+    auto_free T##_smart_array_t* a = T##_smart_array_heap_new(len); \
+    for (size_t i = 0; i < len; ++i) { \
+        a->data[i] = (i % 3 == 0)? 7 : i % 5; \
+    } \
+    const size_t expected = (len + 2) / 3; \
+    ASSERT_EQ(expected, T##_smart_array_count(a, 7)); \
+    ASSERT_EQ(expected, T##_omp_smart_array_count(a, 7)); \
+    ASSERT_EQ(0, T##_array_count(len, a->data, 9)); \
+    auto_free uint64_t* bitmap = calloc((len + 63) / 64, sizeof(uint64_t)); \
+    ASSERT_EQ(expected, T##_smart_array_find_all_bitmap(a, 7, bitmap)); \
+    for (size_t i = 0; i < len; ++i) { \
+        ASSERT_EQ(i % 3 == 0, (bitmap[i / 64] >> (i % 64)) & 1); \
+    } \
+    __builtin_memset(bitmap, 0, ((len + 63) / 64) * sizeof(uint64_t)); \
+    ASSERT_EQ(expected, T##_omp_smart_array_find_all_bitmap(a, 7, bitmap)); \
+    for (size_t i = 0; i < len; ++i) { \
+        ASSERT_EQ(i % 3 == 0, (bitmap[i / 64] >> (i % 64)) & 1); \
+    } \
+    auto_free size_t* idx = malloc(expected * sizeof(size_t)); \
+    ASSERT_EQ(expected, T##_smart_array_find_all_indices(a, 7, expected, idx)); \
+    for (size_t i = 0; i < expected; ++i) { \
+        ASSERT_EQ(3 * i, idx[i]); \
+    } \
+    __builtin_memset(idx, 0, expected * sizeof(size_t)); \
+    ASSERT_EQ(expected, T##_omp_smart_array_find_all_indices(a, 7, expected, idx)); \
+    for (size_t i = 0; i < expected; ++i) { \
+        ASSERT_EQ(3 * i, idx[i]); \
+    } \
+    /* output smaller than number of found elements */ \
+    __builtin_memset(idx, 0, expected * sizeof(size_t)); \
+    ASSERT_EQ(expected, T##_omp_array_find_all_indices(len, a->data, 7, 10, idx)); \
+    ASSERT_EQ(27, idx[9]); \
+    ASSERT_EQ(0, idx[10]); \
+    ASSERT_EQ(expected, T##_array_find_all_indices(len - 1, a->data, 7, 5, idx)); \
+    ASSERT_EQ(12, idx[4]); \
+    ASSERT_EQ(0, idx[10]); \
+    PASS(); \
+}
+
+TEST_FIND_ALL(i64)
+TEST_FIND_ALL(u64)
+TEST_FIND_ALL(i32)
+TEST_FIND_ALL(u32)
+TEST_FIND_ALL(f64)
+TEST_FIND_ALL(f32)
+
+// Check filter of `a` against a plain loop with predicate `pass`.
+#define CHECK_FILTER(call, pass) do { \
+    const size_t count = (call); \
+    size_t n = 0; \
+    for (size_t i = 0; i < len; ++i) { \
+        const typeof(a->data[0]) x = a->data[i]; \
+        if (pass) { \
+            ASSERT_EQ(x, out->data[n]); \
+            ++n; \
+        } \
+    } \
+    ASSERT_EQ(n, count); \
+} while (0)
+
+// Filters and compress in serial, OMP and in-place forms,
+// lengths cover the vector tail and several OMP chunks.
+#define TEST_FILTER(T) \
+TEST T##_filter(void) \
+{ \
+    const size_t lens[] = {0, 1, 5, 64, 1001, 3 * SMARTARR_OMP_CHUNK_LEN + 77}; \
+    for (size_t l = 0; l < fixlen_array_len(lens); ++l) { \
+        const size_t len = lens[l]; \
+        auto_free T##_smart_array_t* a = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* out = T##_smart_array_heap_new(len); \
+        auto_free uint64_t* bitmap = calloc((len + 63) / 64 + 1, sizeof(uint64_t)); \
+        for (size_t i = 0; i < len; ++i) { \
+            a->data[i] = rand() % 100; \
+            bitmap[i / 64] |= (uint64_t)(rand() % 3 == 0) << (i % 64); \
+        } \
+        CHECK_FILTER(T##_smart_array_filter_lt(a, 30, out), x < 30); \
+        CHECK_FILTER(T##_omp_smart_array_filter_lt(a, 30, out), x < 30); \
+        CHECK_FILTER(T##_smart_array_filter_gt(a, 90, out), x > 90); \
+        CHECK_FILTER(T##_omp_smart_array_filter_gt(a, 90, out), x > 90); \
+        CHECK_FILTER(T##_smart_array_filter_eq(a, 7, out), x == 7); \
+        CHECK_FILTER(T##_omp_smart_array_filter_eq(a, 7, out), x == 7); \
+        CHECK_FILTER(T##_smart_array_filter_between(a, 20, 60, out), x >= 20 && x <= 60); \
+        CHECK_FILTER(T##_omp_smart_array_filter_between(a, 20, 60, out), x >= 20 && x <= 60); \
+        CHECK_FILTER(T##_smart_array_filter_lt(a, 0, out), false); \
+        CHECK_FILTER(T##_omp_smart_array_filter_between(a, 0, 99, out), true); \
+        CHECK_FILTER(T##_smart_array_compress(a, bitmap, out), (bitmap[i / 64] >> (i % 64)) & 1); \
+        CHECK_FILTER(T##_omp_smart_array_compress(a, bitmap, out), (bitmap[i / 64] >> (i % 64)) & 1); \
+        /* in place */ \
+        T##_array_copy(len, a->data, out->data); \
+        const size_t count = T##_array_filter_between(len, out->data, 20, 60, out->data); \
+        ASSERT_EQ(count, T##_array_filter_between(len, a->data, 20, 60, a->data)); \
+        for (size_t i = 0; i < count; ++i) { \
+            ASSERT(a->data[i] >= 20 && a->data[i] <= 60); \
+        } \
+    } \
+    PASS(); \
+}
+
+TEST_FILTER(i64)
+TEST_FILTER(u64)
+TEST_FILTER(i32)
+TEST_FILTER(u32)
+TEST_FILTER(f64)
+TEST_FILTER(f32)
+
+TEST filter_nan(void)
+{
+    ATTR_SMART_ARRAY_ALIGNED double a[11] = {1, __builtin_nan(""), 3, 4, 5, 6, 7, 8, __builtin_nan(""), 2, 9};
+    ATTR_SMART_ARRAY_ALIGNED double out[11];
+
+    ASSERT_EQ(3, f64_array_filter_between(11, a, 2, 4, out));
+    ASSERT_EQ(3, out[0]);
+    ASSERT_EQ(4, out[1]);
+    ASSERT_EQ(2, out[2]);
+    ASSERT_EQ(0, f64_array_filter_eq(11, a, __builtin_nan(""), out));
+    ASSERT_EQ(1, f64_array_filter_lt(11, a, 2, out));
+    ASSERT_EQ(1, f64_array_filter_gt(11, a, 8, out));
+    ASSERT_EQ(9, out[0]);
+
+    PASS();
+}
+
+// Compare min/max against a plain loop for different lengths,
+// min and max are repeated to check that the first one is returned.
+#define TEST_MINMAX(T) \
+TEST T##_minmax(void) \
+{ \
+    constexpr size_t max_len = 2 * SMARTARR_OMP_CHUNK_LEN + 33; \
+    auto_free T##_smart_array_t* a = T##_smart_array_heap_new(max_len); \
+    for (size_t len = 1; len < max_len; len = len * 3 + 1) { \
+        for (size_t i = 0; i < len; ++i) { \
+            a->data[i] = (rand() % 1000) + 10; \
+        } \
+        size_t min_pos = 0, max_pos = 0; \
+        for (size_t i = 1; i < len; ++i) { \
+            if (a->data[i] < a->data[min_pos]) min_pos = i; \
+            if (a->data[max_pos] < a->data[i]) max_pos = i; \
+        } \
+        auto mm = T##_array_find_minmax(len, a->data); \
+        ASSERT_EQ(min_pos, mm.min.pos); \
+        ASSERT_EQ(max_pos, mm.max.pos); \
+        ASSERT_EQ(a->data[min_pos], mm.min.val); \
+        ASSERT_EQ(a->data[max_pos], mm.max.val); \
+        ASSERT_EQ(min_pos, T##_array_find_min(len, a->data)); \
+        ASSERT_EQ(max_pos, T##_array_find_max(len, a->data)); \
+        ASSERT_EQ(min_pos, T##_omp_array_find_min(len, a->data)); \
+        ASSERT_EQ(max_pos, T##_omp_array_find_max(len, a->data)); \
+        auto omp_mm = T##_omp_array_find_minmax(len, a->data); \
+        ASSERT_EQ(mm.min.pos, omp_mm.min.pos); \
+        ASSERT_EQ(mm.max.pos, omp_mm.max.pos); \
+    } \
+    PASS(); \
+}
+
+TEST_MINMAX(i64)
+TEST_MINMAX(u64)
+TEST_MINMAX(i32)
+TEST_MINMAX(u32)
+TEST_MINMAX(f64)
+TEST_MINMAX(f32)
+TEST_MINMAX(sf64)
+
+TEST minmax_nan(void)
+{
+    constexpr size_t len = 100;
+    auto_free f64_smart_array_t* a = f64_smart_array_heap_new(len);
+    f64_smart_array_fill(a, __builtin_nan(""));
+
+    auto mm = f64_smart_array_find_minmax(a);
+    ASSERT_EQ(0, mm.min.pos);
+    ASSERT_EQ(0, mm.max.pos);
+
+    a->data[37] = 5.0;
+    a->data[77] = -5.0;
+    a->data[99] = 7.0;
+    mm = f64_smart_array_find_minmax(a);
+    ASSERT_EQ(77, mm.min.pos);
+    ASSERT_EQ(99, mm.max.pos);
+    ASSERT_EQ(-5.0, mm.min.val);
+
+    auto_free f32_smart_array_t* b = f32_smart_array_heap_new(len);
+    for (size_t i = 0; i < len; ++i) {
+        b->data[i] = (i % 2)? __builtin_nanf("") : (float)i;
+    }
+    auto omp_mm = f32_omp_smart_array_find_minmax(b);
+    ASSERT_EQ(0, omp_mm.min.pos);
+    ASSERT_EQ(98, omp_mm.max.pos);
+
+    const double vals[] = {__builtin_nan(""), 3.0, 1.0, 2.0};
+    auto_free sf64_smart_array_t* c = sf64_smart_array_heap_new(4);
+    __builtin_memcpy(c->data, vals, sizeof(vals));
+    auto scalar_mm = sf64_smart_array_find_minmax(c);
+    ASSERT_EQ(2, scalar_mm.min.pos);
+    ASSERT_EQ(1, scalar_mm.max.pos);
+    ASSERT_EQ(1.0, scalar_mm.min.val);
+    ASSERT_EQ(3.0, scalar_mm.max.val);
+
+    PASS();
+}
+
+SUITE(find) {
+    RUN_TEST(i64_find);
+    RUN_TEST(u64_find);
+    RUN_TEST(i32_find);
+    RUN_TEST(u32_find);
+    RUN_TEST(f64_find);
+    RUN_TEST(f32_find);
+    RUN_TEST(find_nan);
+    RUN_TEST(i64_omp_find);
+    RUN_TEST(u64_omp_find);
+    RUN_TEST(i32_omp_find);
+    RUN_TEST(u32_omp_find);
+    RUN_TEST(f64_omp_find);
+    RUN_TEST(f32_omp_find);
+    RUN_TEST(i64_find_any);
+    RUN_TEST(u64_find_any);
+    RUN_TEST(i32_find_any);
+    RUN_TEST(u32_find_any);
+    RUN_TEST(f64_find_any);
+    RUN_TEST(f32_find_any);
+    RUN_TEST(find_any_zero_nan);
+    RUN_TEST(i64_find_within);
+    RUN_TEST(u64_find_within);
+    RUN_TEST(i32_find_within);
+    RUN_TEST(u32_find_within);
+    RUN_TEST(f64_find_within);
+    RUN_TEST(f32_find_within);
+    RUN_TEST(find_within_ulps);
+    RUN_TEST(i64_find_all);
+    RUN_TEST(u64_find_all);
+    RUN_TEST(i32_find_all);
+    RUN_TEST(u32_find_all);
+    RUN_TEST(f64_find_all);
+    RUN_TEST(f32_find_all);
+    RUN_TEST(i64_filter);
+    RUN_TEST(u64_filter);
+    RUN_TEST(i32_filter);
+    RUN_TEST(u32_filter);
+    RUN_TEST(f64_filter);
+    RUN_TEST(f32_filter);
+    RUN_TEST(filter_nan);
+    RUN_TEST(i64_minmax);
+    RUN_TEST(u64_minmax);
+    RUN_TEST(i32_minmax);
+    RUN_TEST(u32_minmax);
+    RUN_TEST(f64_minmax);
+    RUN_TEST(f32_minmax);
+    RUN_TEST(sf64_minmax);
+    RUN_TEST(minmax_nan);
+}
+
+GREATEST_MAIN_DEFS();
+
+int main(int argc UNUSED, char **argv UNUSED) {
+    GREATEST_MAIN_BEGIN();
+
+    RUN_SUITE(find);
+
+    GREATEST_MAIN_END();
+}
@@ -0,0 +1,207 @@
+#include <math.h>
+
+#include "smartarr/defines.h"
+
+#define _ARRAY_OMP_ENABLE
+#include "smartarr/histogram.h"
+
+// Scalar kernels of `double`, results must not depend on SIMD.
+#define _ARRAY_TYPE double
+#define _ARRAY_TYPE_NAME sf64
+#define _ARRAY_NO_SIMD
+#include "smartarr/array.inc.h"
+ARRAY_HISTOGRAM_FUNCTIONS(sf64)
+
+// see https://github.com/silentbicycle/greatest
+#include "third/greatest.h"
+
+// Lengths around the number of sub-histograms and the OMP chunk boundary.
+static const size_t hist_lens[] = {0, 1, 7, 1000, SMARTARR_OMP_CHUNK_LEN + 3,
+    4 * SMARTARR_OMP_CHUNK_LEN + 5};
+
+// Values in [0, 60), 50 and above are out of uniform bins over [0, 50]
+// except 50 that is in the last bin.
+#define HIST_A(i) ((i) * 7 % 60)
+
+// Serial, OMP and smart array versions must count the same as plain loops.
+#define TEST_HISTOGRAM(T) \
+TEST T##_histogram(void) \
+{ \
+    constexpr size_t nbins = 10; \
+    constexpr size_t nr_codes = 40; \
+    const int max_threads = omp_get_max_threads(); \
+    omp_set_num_threads(4); \
+    auto_free T##_smart_array_t* edges = T##_smart_array_heap_new(5); \
+    edges->data[0] = 0; edges->data[1] = 5; edges->data[2] = 10; \
+    edges->data[3] = 20; edges->data[4] = 50; \
+    for (size_t l = 0; l < sizeof(hist_lens) / sizeof(hist_lens[0]); ++l) { \
+        const size_t len = hist_lens[l]; \
+        auto_free T##_smart_array_t* a = T##_smart_array_heap_new(len); \
+        uint64_t uniform[nbins] = {}, by_edges[4] = {}, codes[nr_codes] = {}; \
+        for (size_t i = 0; i < len; ++i) { \
+            const unsigned int x = HIST_A(i); \
+            a->data[i] = x; \
+            if (x <= 50) { \
+                uniform[(x < 50)? x / 5 : nbins - 1] += 1; \
+                by_edges[(x < 5)? 0 : (x < 10)? 1 : (x < 20)? 2 : 3] += 1; \
+            } \
+            if (x < nr_codes) { \
+                codes[x] += 1; \
+            } \
+        } \
+        auto_free u64_smart_array_t* h1 = T##_smart_array_histogram_uniform(a, 0, 50, nbins); \
+        auto_free u64_smart_array_t* h2 = T##_omp_smart_array_histogram_uniform(a, 0, 50, nbins); \
+        ASSERT_EQ(nbins, h1->len); \
+        for (size_t b = 0; b < nbins; ++b) { \
+            ASSERT_EQ(uniform[b], h1->data[b]); \
+            ASSERT_EQ(uniform[b], h2->data[b]); \
+        } \
+        auto_free u64_smart_array_t* e1 = T##_smart_array_histogram_edges(a, edges); \
+        auto_free u64_smart_array_t* e2 = T##_omp_smart_array_histogram_edges(a, edges); \
+        ASSERT_EQ(4, e1->len); \
+        for (size_t b = 0; b < 4; ++b) { \
+            ASSERT_EQ(by_edges[b], e1->data[b]); \
+            ASSERT_EQ(by_edges[b], e2->data[b]); \
+        } \
+        auto_free u64_smart_array_t* c1 = T##_smart_array_bincount(a, nr_codes); \
+        auto_free u64_smart_array_t* c2 = T##_omp_smart_array_bincount(a, nr_codes); \
+        ASSERT_EQ(nr_codes, c1->len); \
+        for (size_t b = 0; b < nr_codes; ++b) { \
+            ASSERT_EQ(codes[b], c1->data[b]); \
+            ASSERT_EQ(codes[b], c2->data[b]); \
+        } \
+        /* raw kernels add to existing counts */ \
+        T##_array_bincount(len, a->data, nr_codes, c1->data); \
+        for (size_t b = 0; b < nr_codes; ++b) { \
+            ASSERT_EQ(2 * codes[b], c1->data[b]); \
+        } \
+    } \
+    omp_set_num_threads(max_threads); \
+    PASS(); \
+}
+
+TEST_HISTOGRAM(i64)
+TEST_HISTOGRAM(u64)
+TEST_HISTOGRAM(i32)
+TEST_HISTOGRAM(u32)
+TEST_HISTOGRAM(f64)
+TEST_HISTOGRAM(f32)
+
+TEST histogram_negative_codes(void)
+{
+    auto_free i32_smart_array_t* a = i32_smart_array_heap_new(6);
+    const int32_t vals[] = {-1, 0, 2, 3, -100, 2};
+    for (size_t i = 0; i < 6; ++i) {
+        a->data[i] = vals[i];
+    }
+    auto_free u64_smart_array_t* c = i32_smart_array_bincount(a, 3);
+    ASSERT_EQ(1, c->data[0]);
+    ASSERT_EQ(0, c->data[1]);
+    ASSERT_EQ(2, c->data[2]);
+
+    auto_free u64_smart_array_t* h = i32_smart_array_histogram_uniform(a, -100, 0, 2);
+    ASSERT_EQ(1, h->data[0]);
+    ASSERT_EQ(2, h->data[1]);
+
+    PASS();
+}
+
+TEST histogram_float_specials(void)
+{
+    auto_free f64_smart_array_t* a = f64_smart_array_heap_new(8);
+    const double vals[] = {NAN, -INFINITY, INFINITY, -0.0, 1.0, 0.999, 2.5, -0.5};
+    for (size_t i = 0; i < 8; ++i) {
+        a->data[i] = vals[i];
+    }
+
+    // NaN and infinities are out of range, -0.0 is min, 1.0 is max.
+    auto_free u64_smart_array_t* h = f64_smart_array_histogram_uniform(a, 0.0, 1.0, 4);
+    ASSERT_EQ(1, h->data[0]);
+    ASSERT_EQ(0, h->data[1]);
+    ASSERT_EQ(0, h->data[2]);
+    ASSERT_EQ(2, h->data[3]);
+
+    auto_free f64_smart_array_t* edges = f64_smart_array_heap_new(3);
+    edges->data[0] = -INFINITY;
+    edges->data[1] = 0.0;
+    edges->data[2] = INFINITY;
+    auto_free u64_smart_array_t* e = f64_smart_array_histogram_edges(a, edges);
+    ASSERT_EQ(2, e->data[0]);
+    ASSERT_EQ(5, e->data[1]);
+
+    // Fractional part of codes is dropped, negative codes are not counted.
+    auto_free u64_smart_array_t* c = f64_smart_array_bincount(a, 3);
+    ASSERT_EQ(2, c->data[0]);
+    ASSERT_EQ(1, c->data[1]);
+    ASSERT_EQ(1, c->data[2]);
+
+    PASS();
+}
+
+// Negative float codes are not counted by scalar kernels either.
+TEST histogram_no_simd(void)
+{
+    const double vals[] = {-0.5, 0.5, 1.5, -3.0};
+    auto_free sf64_smart_array_t* a = sf64_smart_array_heap_new(4);
+    __builtin_memcpy(a->data, vals, sizeof(vals));
+
+    auto_free u64_smart_array_t* c = sf64_smart_array_bincount(a, 3);
+    ASSERT_EQ(1, c->data[0]);
+    ASSERT_EQ(1, c->data[1]);
+    ASSERT_EQ(0, c->data[2]);
+
+    auto_free u64_smart_array_t* h = sf64_omp_smart_array_histogram_uniform(a, -4.0, 2.0, 3);
+    ASSERT_EQ(1, h->data[0]);
+    ASSERT_EQ(1, h->data[1]);
+    ASSERT_EQ(2, h->data[2]);
+
+    PASS();
+}
+
+// More bins than `SMARTARR_HISTOGRAM_SUBS_MAX_BINS` are counted directly.
+TEST histogram_many_bins(void)
+{
+    constexpr size_t nbins = 3 * SMARTARR_HISTOGRAM_SUBS_MAX_BINS + 1;
+    constexpr size_t len = 4 * SMARTARR_OMP_CHUNK_LEN;
+    auto_free u32_smart_array_t* a = u32_smart_array_heap_new(len);
+    for (size_t i = 0; i < len; ++i) {
+        a->data[i] = i * 13 % (nbins + 7);
+    }
+    auto_free u64_smart_array_t* c1 = u32_smart_array_bincount(a, nbins);
+    auto_free u64_smart_array_t* c2 = u32_omp_smart_array_bincount(a, nbins);
+    uint64_t total = 0;
+    for (size_t b = 0; b < nbins; ++b) {
+        ASSERT_EQ(c1->data[b], c2->data[b]);
+        total += c1->data[b];
+    }
+    size_t expected = 0;
+    for (size_t i = 0; i < len; ++i) {
+        expected += a->data[i] < nbins;
+    }
+    ASSERT_EQ(expected, total);
+
+    PASS();
+}
+
+SUITE(histogram) {
+    RUN_TEST(i64_histogram);
+    RUN_TEST(u64_histogram);
+    RUN_TEST(i32_histogram);
+    RUN_TEST(u32_histogram);
+    RUN_TEST(f64_histogram);
+    RUN_TEST(f32_histogram);
+    RUN_TEST(histogram_negative_codes);
+    RUN_TEST(histogram_float_specials);
+    RUN_TEST(histogram_no_simd);
+    RUN_TEST(histogram_many_bins);
+}
+
+GREATEST_MAIN_DEFS();
+
+int main(int argc UNUSED, char **argv UNUSED) {
+    GREATEST_MAIN_BEGIN();
+
+    RUN_SUITE(histogram);
+
+    GREATEST_MAIN_END();
+}
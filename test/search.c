@@ -0,0 +1,175 @@
+#include "smartarr/defines.h"
+
+#define _ARRAY_OMP_ENABLE
+#include "smartarr/basic_type_array.h"
+
+// Array sorted in descending order by custom comparator.
+#define _ARRAY_TYPE int
+#define _ARRAY_TYPE_NAME desc
+#define _ARRAY_TYPE_LT(a, b) ({(a) > (b);})
+#include "smartarr/array.inc.h"
+
+// see https://github.com/silentbicycle/greatest
+#include "third/greatest.h"
+
+static size_t
+naive_lower_bound(size_t len, const int64_t a[len], int64_t val)
+{
+    size_t i = 0;
+    while (i < len && a[i] < val) ++i;
+    return i;
+}
+
+static size_t
+naive_upper_bound(size_t len, const int64_t a[len], int64_t val)
+{
+    size_t i = 0;
+    while (i < len && a[i] <= val) ++i;
+    return i;
+}
+
+TEST binary_search(void)
+{
+    constexpr size_t max_len = 70;
+    auto_free i64_smart_array_t* a = i64_smart_array_heap_new(max_len);
+
+    for (size_t len = 0; len < max_len; ++len) {
+        // values 0, 2, 2, 4, 4, 4, 6 ... with duplicates and gaps
+        for (size_t i = 0; i < len; ++i) {
+            a->data[i] = 2 * (i / 3);
+        }
+        for (int64_t val = -1; val <= (int64_t)len; ++val) {
+            ASSERT_EQ(naive_lower_bound(len, a->data, val), i64_array_lower_bound(len, a->data, val));
+            ASSERT_EQ(naive_upper_bound(len, a->data, val), i64_array_upper_bound(len, a->data, val));
+            auto range = i64_array_equal_range(len, a->data, val);
+            ASSERT_EQ(naive_lower_bound(len, a->data, val), range.first);
+            ASSERT_EQ(naive_upper_bound(len, a->data, val), range.last);
+            auto found = i64_array_find_sorted(len, a->data, val);
+            ASSERT_EQ(range.first != range.last, found.present);
+            if (found.present) {
+                ASSERT_EQ(range.first, found.value);
+            }
+        }
+    }
+
+    PASS();
+}
+
+TEST binary_search_smart_array(void)
+{
+    constexpr size_t len = 1000;
+    auto_free f64_smart_array_t* a = f64_smart_array_heap_new(len);
+    f64_smart_array_random_sequence(a);
+    f64_smart_array_qsort(a);
+
+    ASSERT_EQ(500, f64_smart_array_lower_bound(a, 500.0));
+    ASSERT_EQ(501, f64_smart_array_upper_bound(a, 500.0));
+    ASSERT_EQ(501, f64_smart_array_lower_bound(a, 500.5));
+    ASSERT_EQ(0, f64_smart_array_lower_bound(a, -1.0));
+    ASSERT_EQ(len, f64_smart_array_lower_bound(a, 1000.0));
+    ASSERT_EQ(len, f64_smart_array_upper_bound(a, 999.0));
+    ASSERT_EQ(77, f64_smart_array_find_sorted(a, 77.0).value);
+    ASSERT_FALSE(f64_smart_array_find_sorted(a, 77.5).present);
+
+    PASS();
+}
+
+TEST binary_search_custom_compare(void)
+{
+    ATTR_SMART_ARRAY_ALIGNED
+    int a[8] = {9, 7, 7, 5, 3, 3, 3, 1};
+
+    ASSERT_EQ(1, desc_array_lower_bound(8, a, 7));
+    ASSERT_EQ(3, desc_array_upper_bound(8, a, 7));
+    ASSERT_EQ(3, desc_array_lower_bound(8, a, 6));
+    auto range = desc_array_equal_range(8, a, 3);
+    ASSERT_EQ(4, range.first);
+    ASSERT_EQ(7, range.last);
+    ASSERT_EQ(8, desc_array_lower_bound(8, a, 0));
+    ASSERT_EQ(0, desc_array_lower_bound(8, a, 10));
+
+    PASS();
+}
+
+// Index must give the same answers as binary search on the sorted array,
+// sizes cover partially filled last node and several tree levels.
+#define TEST_BTREE(T) \
+TEST T##_btree(void) \
+{ \
+    const size_t lens[] = {0, 1, 2, 7, 8, 9, 16, 17, 100, 1000, 4321}; \
+    for (size_t l = 0; l < fixlen_array_len(lens); ++l) { \
+        const size_t len = lens[l]; \
+        auto_free T##_smart_array_t* a = T##_smart_array_heap_new(len); \
+        for (size_t i = 0; i < len; ++i) { \
+            a->data[i] = 10 + 2 * (i / 2); /* pairs of equal values */ \
+        } \
+        T##_smart_array_insertion_sort(a); /* sort by T's comparator */ \
+        auto_free T##_btree_t* index = T##_btree_new(a); \
+        ASSERT(index != NULL); \
+        for (size_t val = 0; val < len + 14; ++val) { \
+            ASSERT_EQ(T##_smart_array_lower_bound(a, val), T##_btree_lower_bound(index, val)); \
+        } \
+    } \
+    PASS(); \
+}
+
+TEST_BTREE(i64)
+TEST_BTREE(u64)
+TEST_BTREE(i32)
+TEST_BTREE(u32)
+TEST_BTREE(f64)
+TEST_BTREE(f32)
+TEST_BTREE(desc)
+
+TEST batch_search(void)
+{
+    const size_t lens[] = {0, 1, 2, 3, 17, 1000, 12345};
+    constexpr size_t nr_queries = 3 * SMARTARR_SEARCH_BATCH_LEN * 64 + 5;
+
+    auto_free i64_smart_array_t* queries = i64_smart_array_heap_new(nr_queries);
+    auto_free size_t* pos = malloc(nr_queries * sizeof(size_t));
+    auto_free size_t* omp_pos = malloc(nr_queries * sizeof(size_t));
+
+    for (size_t l = 0; l < fixlen_array_len(lens); ++l) {
+        const size_t len = lens[l];
+        auto_free i64_smart_array_t* a = i64_smart_array_heap_new(len);
+        for (size_t i = 0; i < len; ++i) {
+            a->data[i] = 3 * i;
+        }
+        for (size_t q = 0; q < nr_queries; ++q) {
+            queries->data[q] = rand() % (3 * len + 5) - 2;
+        }
+        i64_smart_array_lower_bound_batch(a, queries, pos);
+        i64_omp_smart_array_lower_bound_batch(a, queries, omp_pos);
+        for (size_t q = 0; q < nr_queries; ++q) {
+            ASSERT_EQ(i64_smart_array_lower_bound(a, queries->data[q]), pos[q]);
+            ASSERT_EQ(pos[q], omp_pos[q]);
+        }
+    }
+
+    PASS();
+}
+
+SUITE(search) {
+    RUN_TEST(binary_search);
+    RUN_TEST(binary_search_smart_array);
+    RUN_TEST(binary_search_custom_compare);
+    RUN_TEST(i64_btree);
+    RUN_TEST(u64_btree);
+    RUN_TEST(i32_btree);
+    RUN_TEST(u32_btree);
+    RUN_TEST(f64_btree);
+    RUN_TEST(f32_btree);
+    RUN_TEST(desc_btree);
+    RUN_TEST(batch_search);
+}
+
+GREATEST_MAIN_DEFS();
+
+int main(int argc UNUSED, char **argv UNUSED) {
+    GREATEST_MAIN_BEGIN();
+
+    RUN_SUITE(search);
+
+    GREATEST_MAIN_END();
+}
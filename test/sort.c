@@ -0,0 +1,695 @@
+#include "smartarr/defines.h"
+
+#define _ARRAY_OMP_ENABLE
+#include "smartarr/basic_type_array.h"
+
+// Array sorted in descending order by custom comparator.
+#define _ARRAY_TYPE int
+#define _ARRAY_TYPE_NAME desc
+#define _ARRAY_TYPE_LT(a, b) ({(a) > (b);})
+#include "smartarr/array.inc.h"
+
+// Scalar kernels of `double`, radix sort does not need SIMD.
+#define _ARRAY_TYPE double
+#define _ARRAY_TYPE_NAME sf64
+#define _ARRAY_NO_SIMD
+#include "smartarr/array.inc.h"
+
+// Struct elements ordered by key only.
+typedef struct {
+    int key;
+    unsigned int id;
+} kv_t;
+
+#define _ARRAY_TYPE kv_t
+#define _ARRAY_TYPE_NAME kv
+#define _ARRAY_TYPE_COMPOUND
+#define _ARRAY_TYPE_EQ(a, b) ({(a).key == (b).key;})
+#define _ARRAY_TYPE_LT(a, b) ({(a).key < (b).key;})
+#include "smartarr/array.inc.h"
+
+// see https://github.com/silentbicycle/greatest
+#include "third/greatest.h"
+
+// Sort random, few-unique and negative values and compare with libc qsort,
+// short arrays go to insertion sort.
+#define TEST_RADIX_SORT(T) \
+TEST T##_radix_sort(void) \
+{ \
+    const size_t lens[] = {0, 1, 2, 63, 64, 65, 1000, 100000}; \
+    for (size_t l = 0; l < fixlen_array_len(lens); ++l) { \
+        const size_t len = lens[l]; \
+        auto_free T##_smart_array_t* a = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* b = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* scratch = T##_smart_array_heap_new(len); \
+        for (int pattern = 0; pattern < 3; ++pattern) { \
+            for (size_t i = 0; i < len; ++i) { \
+                switch (pattern) { \
+                case 0: a->data[i] = rand(); break; \
+                case 1: a->data[i] = rand() % 4; break; \
+                default: a->data[i] = (rand() - RAND_MAX / 2) / 7; break; \
+                } \
+            } \
+            T##_array_memcopy(len, a->data, b->data); \
+            T##_smart_array_radix_sort(a, scratch); \
+            T##_smart_array_qsort(b); \
+            ASSERT_MEM_EQ(b->data, a->data, len * sizeof(a->data[0])); \
+        } \
+    } \
+    PASS(); \
+}
+
+TEST_RADIX_SORT(i64)
+TEST_RADIX_SORT(u64)
+TEST_RADIX_SORT(i32)
+TEST_RADIX_SORT(u32)
+TEST_RADIX_SORT(f64)
+TEST_RADIX_SORT(f32)
+TEST_RADIX_SORT(sf64)
+
+// Every length up to the largest network and past it, values with
+// many duplicates and values equal to the padding.
+#define TEST_SMALL_SORT(T) \
+TEST T##_small_sort(void) \
+{ \
+    constexpr size_t max_len = SMARTARR_SMALL_SORT_MAX_LEN + 3; \
+    auto_free T##_smart_array_t* a = T##_smart_array_heap_new(max_len); \
+    auto_free T##_smart_array_t* b = T##_smart_array_heap_new(max_len); \
+    for (size_t len = 0; len <= max_len; ++len) { \
+        for (int round = 0; round < 20; ++round) { \
+            for (size_t i = 0; i < len; ++i) { \
+                a->data[i] = (round % 2)? rand() % 10 : rand(); \
+            } \
+            if (len > 2 && round == 3) { \
+                a->data[0] = -1; /* largest for unsigned, same as padding */ \
+                a->data[len - 1] = -1; \
+            } \
+            T##_array_memcopy(len, a->data, b->data); \
+            T##_array_small_sort(len, &a->data[0]); \
+            T##_array_insertion_sort(len, b->data); \
+            ASSERT_MEM_EQ(b->data, a->data, len * sizeof(a->data[0])); \
+        } \
+    } \
+    PASS(); \
+}
+
+TEST_SMALL_SORT(i64)
+TEST_SMALL_SORT(u64)
+TEST_SMALL_SORT(i32)
+TEST_SMALL_SORT(u32)
+TEST_SMALL_SORT(f64)
+TEST_SMALL_SORT(f32)
+
+TEST small_sort_float_specials(void)
+{
+    ATTR_SMART_ARRAY_ALIGNED
+    float a[11] = {3, __builtin_inff(), -0.0f, 1, -__builtin_inff(), 0.0f, 2, 7, 5, -1, __builtin_inff()};
+    f32_array_small_sort(11, a);
+    ASSERT_EQ(-__builtin_inff(), a[0]);
+    ASSERT_EQ(-1, a[1]);
+    ASSERT_EQ(0, a[2]);
+    ASSERT_EQ(0, a[3]);
+    ASSERT_EQ(7, a[8]);
+    ASSERT_EQ(__builtin_inff(), a[9]);
+    ASSERT_EQ(__builtin_inff(), a[10]);
+
+    // NaN goes to insertion sort, all elements must be kept
+    ATTR_SMART_ARRAY_ALIGNED
+    double b[5] = {3, __builtin_nan(""), 1, 2, 0};
+    f64_array_small_sort(5, b);
+    size_t nans = 0;
+    double sum = 0;
+    for (size_t i = 0; i < 5; ++i) {
+        if (__builtin_isnan(b[i])) ++nans; else sum += b[i];
+    }
+    ASSERT_EQ(1, nans);
+    ASSERT_EQ(6, sum);
+
+    PASS();
+}
+
+static const size_t sort_lens[] = {0, 1, 2, 3, 32, 33, 129, 1000, 100000};
+
+enum {
+    PATTERN_RANDOM,
+    PATTERN_SORTED,
+    PATTERN_REVERSED,
+    PATTERN_FEW_UNIQUE,
+    PATTERN_EQUAL,
+    PATTERN_ORGAN_PIPE,
+    NR_PATTERNS
+};
+
+static int
+pattern_value(int pattern, size_t i, size_t len)
+{
+    switch (pattern) {
+    case PATTERN_RANDOM: return rand();
+    case PATTERN_SORTED: return i;
+    case PATTERN_REVERSED: return len - i;
+    case PATTERN_FEW_UNIQUE: return rand() % 5;
+    case PATTERN_EQUAL: return 7;
+    default: return (i < len / 2)? i : len - i;
+    }
+}
+
+// Sort inputs that are bad for naive quicksort and compare with qsort.
+#define TEST_SORT(T) \
+TEST T##_sort(void) \
+{ \
+    for (size_t l = 0; l < fixlen_array_len(sort_lens); ++l) { \
+        const size_t len = sort_lens[l]; \
+        auto_free T##_smart_array_t* a = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* b = T##_smart_array_heap_new(len); \
+        for (int pattern = 0; pattern < NR_PATTERNS; ++pattern) { \
+            for (size_t i = 0; i < len; ++i) { \
+                a->data[i] = pattern_value(pattern, i, len); \
+            } \
+            T##_array_memcopy(len, a->data, b->data); \
+            T##_smart_array_sort(a); \
+            T##_smart_array_qsort(b); \
+            ASSERT_MEM_EQ(b->data, a->data, len * sizeof(a->data[0])); \
+            T##_array_memcopy(len, b->data, a->data); \
+            T##_array_heap_sort(len, a->data); \
+            ASSERT_MEM_EQ(b->data, a->data, len * sizeof(a->data[0])); \
+        } \
+    } \
+    PASS(); \
+}
+
+TEST_SORT(i64)
+TEST_SORT(u64)
+TEST_SORT(i32)
+TEST_SORT(u32)
+TEST_SORT(f64)
+TEST_SORT(f32)
+TEST_SORT(desc)
+
+// Thread counts that do and do not divide the array evenly,
+// runs of different lengths and odd number of runs.
+#define TEST_OMP_SORT(T) \
+TEST T##_omp_sort(void) \
+{ \
+    const size_t lens[] = {1000, SMARTARR_OMP_SORT_MIN_LEN + 1, 1000003}; \
+    const int nr_threads[] = {1, 2, 3, 4, 7}; \
+    const int max_threads = omp_get_max_threads(); \
+    for (size_t l = 0; l < fixlen_array_len(lens); ++l) { \
+        const size_t len = lens[l]; \
+        auto_free T##_smart_array_t* a = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* b = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* input = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* scratch = T##_smart_array_heap_new(len); \
+        for (int pattern = 0; pattern < NR_PATTERNS; ++pattern) { \
+            for (size_t i = 0; i < len; ++i) { \
+                input->data[i] = pattern_value(pattern, i, len); \
+            } \
+            T##_array_memcopy(len, input->data, b->data); \
+            T##_smart_array_sort(b); \
+            for (size_t t = 0; t < fixlen_array_len(nr_threads); ++t) { \
+                omp_set_num_threads(nr_threads[t]); \
+                T##_array_memcopy(len, input->data, a->data); \
+                T##_omp_smart_array_sort(a, (t % 2)? scratch : NULL); \
+                ASSERT_MEM_EQ(b->data, a->data, len * sizeof(a->data[0])); \
+            } \
+        } \
+    } \
+    omp_set_num_threads(max_threads); \
+    PASS(); \
+}
+
+TEST_OMP_SORT(i64)
+TEST_OMP_SORT(u32)
+TEST_OMP_SORT(f64)
+TEST_OMP_SORT(desc)
+
+// Compare with fully sorted copy on inputs that are bad for quickselect.
+#define TEST_SELECT(T) \
+TEST T##_select(void) \
+{ \
+    for (size_t l = 1; l < fixlen_array_len(sort_lens); ++l) { \
+        const size_t len = sort_lens[l]; \
+        auto_free T##_smart_array_t* a = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* input = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* sorted = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* top = T##_smart_array_heap_new(len + 1); \
+        for (int pattern = 0; pattern < NR_PATTERNS; ++pattern) { \
+            for (size_t i = 0; i < len; ++i) { \
+                input->data[i] = pattern_value(pattern, i, len); \
+            } \
+            T##_array_memcopy(len, input->data, sorted->data); \
+            T##_smart_array_sort(sorted); \
+            const size_t ns[] = {0, len / 2, len * 99 / 100, len - 1}; \
+            for (size_t j = 0; j < fixlen_array_len(ns); ++j) { \
+                const size_t n = ns[j]; \
+                T##_array_memcopy(len, input->data, a->data); \
+                ASSERT_EQ(sorted->data[n], T##_smart_array_nth_element(a, n)); \
+                T##_smart_array_sort(a); \
+                ASSERT_MEM_EQ(sorted->data, a->data, len * sizeof(a->data[0])); \
+            } \
+            const size_t ks[] = {0, 1, 10, len / 3, len, len + 1}; \
+            for (size_t j = 0; j < fixlen_array_len(ks); ++j) { \
+                const size_t k = ks[j]; \
+                const size_t nr = (k < len)? k : len; \
+                T##_array_memcopy(len, input->data, a->data); \
+                T##_smart_array_partial_sort(a, k); \
+                ASSERT_MEM_EQ(sorted->data, a->data, nr * sizeof(a->data[0])); \
+                ASSERT_EQ(nr, T##_smart_array_topk(input, k, top->data)); \
+                for (size_t i = 0; i < nr; ++i) { \
+                    ASSERT_EQ(sorted->data[len - 1 - i], top->data[i]); \
+                } \
+            } \
+        } \
+    } \
+    PASS(); \
+}
+
+TEST_SELECT(i64)
+TEST_SELECT(u64)
+TEST_SELECT(i32)
+TEST_SELECT(u32)
+TEST_SELECT(f64)
+TEST_SELECT(f32)
+TEST_SELECT(desc)
+
+// Streaming over chunks and per-thread candidates give the same top.
+TEST topk_chunks(void)
+{
+    constexpr size_t len = 1000003;
+    constexpr size_t k = 100;
+    auto_free f64_smart_array_t* a = f64_smart_array_heap_new(len);
+    double heap[k], top[k], omp_top[k];
+
+    for (size_t i = 0; i < len; ++i) {
+        a->data[i] = rand() % 100000;
+    }
+
+    f64_topk_t state;
+    f64_array_topk_init(&state, k, heap);
+    for (size_t i = 0; i < len; i += 64 * 1000) {
+        f64_array_topk_push(&state, (len - i < 64 * 1000)? len - i : 64 * 1000, &a->data[i]);
+    }
+    ASSERT_EQ(k, f64_array_topk_finish(&state));
+    ASSERT_EQ(k, f64_smart_array_topk(a, k, top));
+    ASSERT_MEM_EQ(top, heap, sizeof(top));
+
+    const int max_threads = omp_get_max_threads();
+    for (int t = 1; t <= 4; ++t) {
+        omp_set_num_threads(t);
+        ASSERT_EQ(k, f64_omp_smart_array_topk(a, k, omp_top));
+        ASSERT_MEM_EQ(top, omp_top, sizeof(top));
+    }
+    omp_set_num_threads(max_threads);
+
+    f64_smart_array_sort(a);
+    for (size_t i = 0; i < k; ++i) {
+        ASSERT_EQ(a->data[len - 1 - i], top[i]);
+    }
+
+    PASS();
+}
+
+// Two elements out of order at every position of blocks and tails.
+#define TEST_IS_SORTED(T) \
+TEST T##_is_sorted(void) \
+{ \
+    constexpr size_t len = 200; \
+    auto_free T##_smart_array_t* a = T##_smart_array_heap_new(len); \
+    for (size_t i = 0; i < len; ++i) { \
+        a->data[i] = i; \
+    } \
+    T##_smart_array_sort(a); \
+    ASSERT(T##_smart_array_is_sorted(a)); \
+    ASSERT(T##_array_is_sorted(0, a->data)); \
+    for (size_t pos = 1; pos < len; ++pos) { \
+        T##_array_swap_two_pointers(&a->data[pos - 1], &a->data[pos]); \
+        ASSERT_EQ(pos, T##_smart_array_is_sorted_until(a)); \
+        ASSERT_FALSE(T##_smart_array_is_sorted(a)); \
+        T##_array_swap_two_pointers(&a->data[pos - 1], &a->data[pos]); \
+    } \
+    PASS(); \
+}
+
+TEST_IS_SORTED(i64)
+TEST_IS_SORTED(u64)
+TEST_IS_SORTED(i32)
+TEST_IS_SORTED(u32)
+TEST_IS_SORTED(f64)
+TEST_IS_SORTED(f32)
+TEST_IS_SORTED(desc)
+
+// Sorted column with appended unsorted tail.
+#define PATTERN_SORTED_TAIL NR_PATTERNS
+// Alternating ascending and descending runs of random length.
+#define PATTERN_RUNS (NR_PATTERNS + 1)
+
+static int
+stable_pattern_value(int pattern, size_t i, size_t len)
+{
+    static int run_dir = 1, run_left = 0, run_val = 0;
+
+    switch (pattern) {
+    case PATTERN_SORTED_TAIL:
+        return (i < len - len / 10)? (int)i : rand();
+    case PATTERN_RUNS:
+        if (run_left == 0) {
+            run_left = 1 + rand() % 300;
+            run_dir = -run_dir;
+        }
+        --run_left;
+        return run_val += run_dir * (rand() % 3);
+    default:
+        return pattern_value(pattern, i, len);
+    }
+}
+
+#define TEST_STABLE_SORT(T) \
+TEST T##_stable_sort(void) \
+{ \
+    for (size_t l = 0; l < fixlen_array_len(sort_lens); ++l) { \
+        const size_t len = sort_lens[l]; \
+        auto_free T##_smart_array_t* a = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* b = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* scratch = T##_smart_array_heap_new(len); \
+        for (int pattern = 0; pattern < NR_PATTERNS + 2; ++pattern) { \
+            for (size_t i = 0; i < len; ++i) { \
+                a->data[i] = stable_pattern_value(pattern, i, len); \
+            } \
+            T##_array_memcopy(len, a->data, b->data); \
+            T##_smart_array_stable_sort(a, scratch); \
+            T##_smart_array_sort(b); \
+            ASSERT_MEM_EQ(b->data, a->data, len * sizeof(a->data[0])); \
+        } \
+    } \
+    PASS(); \
+}
+
+TEST_STABLE_SORT(i64)
+TEST_STABLE_SORT(u64)
+TEST_STABLE_SORT(i32)
+TEST_STABLE_SORT(u32)
+TEST_STABLE_SORT(f64)
+TEST_STABLE_SORT(f32)
+TEST_STABLE_SORT(desc)
+
+// Few distinct keys, equal keys must keep order of ids.
+TEST stable_sort_struct(void)
+{
+    for (size_t l = 0; l < fixlen_array_len(sort_lens); ++l) {
+        const size_t len = sort_lens[l];
+        auto_free kv_smart_array_t* a = kv_smart_array_heap_new(len);
+        auto_free kv_smart_array_t* scratch = kv_smart_array_heap_new(len);
+        for (int pattern = 0; pattern < NR_PATTERNS + 2; ++pattern) {
+            for (size_t i = 0; i < len; ++i) {
+                a->data[i] = (kv_t){.key = stable_pattern_value(pattern, i, len) % 7, .id = i};
+            }
+            kv_smart_array_stable_sort(a, scratch);
+            for (size_t i = 1; i < len; ++i) {
+                ASSERT(a->data[i - 1].key <= a->data[i].key);
+                if (a->data[i - 1].key == a->data[i].key) {
+                    ASSERT(a->data[i - 1].id < a->data[i].id);
+                }
+            }
+        }
+    }
+
+    PASS();
+}
+
+// Few unique values, so stability is checked: equal elements
+// must keep increasing indices.
+#define TEST_ARGSORT(T) \
+TEST T##_argsort(void) \
+{ \
+    const size_t lens[] = {0, 1, 2, 17, 63, 64, 65, 1000, 100000}; \
+    for (size_t l = 0; l < fixlen_array_len(lens); ++l) { \
+        const size_t len = lens[l]; \
+        auto_free T##_smart_array_t* a = T##_smart_array_heap_new(len); \
+        auto_free T##_smart_array_t* b = T##_smart_array_heap_new(len); \
+        auto_free uint32_t* idx = malloc(len * sizeof(uint32_t) + 1); \
+        auto_free uint64_t* idx64 = malloc(len * sizeof(uint64_t) + 1); \
+        for (size_t i = 0; i < len; ++i) { \
+            a->data[i] = rand() % 50; \
+        } \
+        ASSERT_EQ(idx, T##_smart_array_argsort_u32(a, idx)); \
+        ASSERT_EQ(idx64, T##_smart_array_argsort_u64(a, idx64)); \
+        for (size_t i = 0; i < len; ++i) { \
+            ASSERT_EQ(idx[i], idx64[i]); \
+        } \
+        T##_smart_array_apply_permutation_u32(a, idx, b); \
+        for (size_t i = 1; i < len; ++i) { \
+            if (b->data[i - 1] == b->data[i]) { \
+                ASSERT(idx[i - 1] < idx[i]); \
+            } \
+        } \
+        T##_smart_array_sort(a); \
+        ASSERT_MEM_EQ(a->data, b->data, len * sizeof(a->data[0])); \
+    } \
+    PASS(); \
+}
+
+TEST_ARGSORT(i64)
+TEST_ARGSORT(u64)
+TEST_ARGSORT(i32)
+TEST_ARGSORT(u32)
+TEST_ARGSORT(f64)
+TEST_ARGSORT(f32)
+TEST_ARGSORT(desc)
+
+// Payloads of the sizes with fast path and of odd size.
+TEST sort_by_key(void)
+{
+    typedef struct { uint32_t row; char tag[8]; } row_t;
+    const size_t lens[] = {5, 64, 1000, 100000};
+
+    for (size_t l = 0; l < fixlen_array_len(lens); ++l) {
+        const size_t len = lens[l];
+        auto_free i32_smart_array_t* keys = i32_smart_array_heap_new(len);
+        auto_free i32_smart_array_t* keys2 = i32_smart_array_heap_new(len);
+        auto_free f64_smart_array_t* vals = f64_smart_array_heap_new(len);
+        auto_free row_t* rows = malloc(len * sizeof(row_t));
+        for (size_t i = 0; i < len; ++i) {
+            keys->data[i] = rand() % 100 - 50;
+            vals->data[i] = keys->data[i] * 0.5;
+            rows[i] = (row_t){.row = i, .tag = {[7] = i % 128}};
+        }
+        i32_array_memcopy(len, keys->data, keys2->data);
+
+        ASSERT(i32_smart_array_sort_by_key(keys, sizeof(double), vals->data) != NULL);
+        ASSERT(i32_smart_array_sort_by_key(keys2, sizeof(row_t), rows) != NULL);
+
+        ASSERT_MEM_EQ(keys->data, keys2->data, len * sizeof(int32_t));
+        for (size_t i = 0; i < len; ++i) {
+            ASSERT_EQ(keys->data[i] * 0.5, vals->data[i]);
+            ASSERT_EQ(rows[i].row % 128, (size_t)rows[i].tag[7]);
+            if (i > 0) {
+                ASSERT(keys->data[i - 1] <= keys->data[i]);
+                if (keys->data[i - 1] == keys->data[i]) {
+                    ASSERT(rows[i - 1].row < rows[i].row);
+                }
+            }
+        }
+    }
+
+    PASS();
+}
+
+// Custom comparator is honored, radix sort would order keys ascending.
+TEST sort_by_key_desc(void)
+{
+    constexpr size_t len = 1000;
+    auto_free desc_smart_array_t* keys = desc_smart_array_heap_new(len);
+    auto_free u32_smart_array_t* rows = u32_smart_array_heap_new(len);
+    for (size_t i = 0; i < len; ++i) {
+        keys->data[i] = rand() % 100 - 50;
+        rows->data[i] = i;
+    }
+
+    ASSERT(desc_smart_array_sort_by_key(keys, sizeof(uint32_t), rows->data) != NULL);
+
+    for (size_t i = 1; i < len; ++i) {
+        ASSERT(keys->data[i - 1] >= keys->data[i]);
+        if (keys->data[i - 1] == keys->data[i]) {
+            ASSERT(rows->data[i - 1] < rows->data[i]);
+        }
+    }
+
+    PASS();
+}
+
+// Struct keys go through stable merge sort.
+TEST argsort_struct(void)
+{
+    constexpr size_t len = 1000;
+    auto_free kv_smart_array_t* a = kv_smart_array_heap_new(len);
+    auto_free kv_smart_array_t* b = kv_smart_array_heap_new(len);
+    auto_free uint32_t* idx = malloc(len * sizeof(uint32_t));
+
+    for (size_t i = 0; i < len; ++i) {
+        a->data[i] = (kv_t){.key = rand() % 10, .id = i};
+    }
+    ASSERT_EQ(idx, kv_smart_array_argsort_u32(a, idx));
+    kv_smart_array_apply_permutation_u32(a, idx, b);
+    for (size_t i = 0; i < len; ++i) {
+        ASSERT_EQ(idx[i], b->data[i].id);
+        if (i > 0) {
+            ASSERT(b->data[i - 1].key <= b->data[i].key);
+            if (b->data[i - 1].key == b->data[i].key) {
+                ASSERT(b->data[i - 1].id < b->data[i].id);
+            }
+        }
+    }
+
+    PASS();
+}
+
+TEST sort_struct(void)
+{
+    for (size_t l = 0; l < fixlen_array_len(sort_lens); ++l) {
+        const size_t len = sort_lens[l];
+        auto_free kv_smart_array_t* a = kv_smart_array_heap_new(len);
+        auto_free bool* seen = malloc(len + 1);
+        for (int pattern = 0; pattern < NR_PATTERNS; ++pattern) {
+            for (size_t i = 0; i < len; ++i) {
+                a->data[i] = (kv_t){.key = pattern_value(pattern, i, len), .id = i};
+            }
+            kv_smart_array_sort(a);
+            __builtin_memset(seen, 0, len + 1);
+            for (size_t i = 0; i < len; ++i) {
+                if (i > 0) ASSERT(a->data[i - 1].key <= a->data[i].key);
+                ASSERT_FALSE(seen[a->data[i].id]); // elements are moved, not lost
+                seen[a->data[i].id] = true;
+            }
+        }
+    }
+
+    PASS();
+}
+
+TEST radix_sort_float_specials(void)
+{
+    // short arrays go to insertion sort and must give the same order
+    const size_t lens[] = {20, 63, 64, 100};
+    for (size_t l = 0; l < fixlen_array_len(lens); ++l) {
+        const size_t len = lens[l];
+        auto_free f64_smart_array_t* a = f64_smart_array_heap_new(len);
+        auto_free f64_smart_array_t* scratch = f64_smart_array_heap_new(len);
+
+        for (size_t i = 0; i < len; ++i) {
+            a->data[i] = 50.0 - i;
+        }
+        a->data[3] = __builtin_inf();
+        a->data[7] = -__builtin_inf();
+        a->data[11] = __builtin_nan("");
+        a->data[13] = -__builtin_nan("");
+        a->data[17] = -0.0;
+        a->data[19] = 1.0e-310; // subnormal
+
+        f64_smart_array_radix_sort(a, scratch);
+
+        ASSERT(__builtin_isnan(a->data[0]) && __builtin_signbit(a->data[0]));
+        ASSERT_EQ(-__builtin_inf(), a->data[1]);
+        ASSERT_EQ(__builtin_inf(), a->data[len - 2]);
+        ASSERT(__builtin_isnan(a->data[len - 1]) && !__builtin_signbit(a->data[len - 1]));
+        for (size_t i = 2; i < len - 1; ++i) {
+            ASSERT(a->data[i - 1] <= a->data[i]);
+        }
+    }
+
+    PASS();
+}
+
+// Radix sort goes by built-in `<` on both sides of the insertion sort length.
+TEST radix_sort_custom_lt(void)
+{
+    const size_t lens[] = {10, 63, 64, 100};
+    for (size_t l = 0; l < fixlen_array_len(lens); ++l) {
+        const size_t len = lens[l];
+        auto_free desc_smart_array_t* a = desc_smart_array_heap_new(len);
+        auto_free desc_smart_array_t* scratch = desc_smart_array_heap_new(len);
+        for (size_t i = 0; i < len; ++i) {
+            a->data[i] = rand() % 100 - 50;
+        }
+
+        desc_smart_array_radix_sort(a, scratch);
+
+        for (size_t i = 1; i < len; ++i) {
+            ASSERT(a->data[i - 1] <= a->data[i]);
+        }
+    }
+
+    PASS();
+}
+
+SUITE(sort) {
+    RUN_TEST(i64_radix_sort);
+    RUN_TEST(u64_radix_sort);
+    RUN_TEST(i32_radix_sort);
+    RUN_TEST(u32_radix_sort);
+    RUN_TEST(f64_radix_sort);
+    RUN_TEST(f32_radix_sort);
+    RUN_TEST(sf64_radix_sort);
+    RUN_TEST(radix_sort_float_specials);
+    RUN_TEST(radix_sort_custom_lt);
+    RUN_TEST(i64_small_sort);
+    RUN_TEST(u64_small_sort);
+    RUN_TEST(i32_small_sort);
+    RUN_TEST(u32_small_sort);
+    RUN_TEST(f64_small_sort);
+    RUN_TEST(f32_small_sort);
+    RUN_TEST(small_sort_float_specials);
+    RUN_TEST(i64_sort);
+    RUN_TEST(u64_sort);
+    RUN_TEST(i32_sort);
+    RUN_TEST(u32_sort);
+    RUN_TEST(f64_sort);
+    RUN_TEST(f32_sort);
+    RUN_TEST(desc_sort);
+    RUN_TEST(sort_struct);
+    RUN_TEST(i64_select);
+    RUN_TEST(u64_select);
+    RUN_TEST(i32_select);
+    RUN_TEST(u32_select);
+    RUN_TEST(f64_select);
+    RUN_TEST(f32_select);
+    RUN_TEST(desc_select);
+    RUN_TEST(topk_chunks);
+    RUN_TEST(i64_is_sorted);
+    RUN_TEST(u64_is_sorted);
+    RUN_TEST(i32_is_sorted);
+    RUN_TEST(u32_is_sorted);
+    RUN_TEST(f64_is_sorted);
+    RUN_TEST(f32_is_sorted);
+    RUN_TEST(desc_is_sorted);
+    RUN_TEST(i64_stable_sort);
+    RUN_TEST(u64_stable_sort);
+    RUN_TEST(i32_stable_sort);
+    RUN_TEST(u32_stable_sort);
+    RUN_TEST(f64_stable_sort);
+    RUN_TEST(f32_stable_sort);
+    RUN_TEST(desc_stable_sort);
+    RUN_TEST(stable_sort_struct);
+    RUN_TEST(i64_argsort);
+    RUN_TEST(u64_argsort);
+    RUN_TEST(i32_argsort);
+    RUN_TEST(u32_argsort);
+    RUN_TEST(f64_argsort);
+    RUN_TEST(f32_argsort);
+    RUN_TEST(desc_argsort);
+    RUN_TEST(sort_by_key);
+    RUN_TEST(sort_by_key_desc);
+    RUN_TEST(argsort_struct);
+    RUN_TEST(i64_omp_sort);
+    RUN_TEST(u32_omp_sort);
+    RUN_TEST(f64_omp_sort);
+    RUN_TEST(desc_omp_sort);
+}
+
+GREATEST_MAIN_DEFS();
+
+int main(int argc UNUSED, char **argv UNUSED) {
+    GREATEST_MAIN_BEGIN();
+
+    RUN_SUITE(sort);
+
+    GREATEST_MAIN_END();
+}
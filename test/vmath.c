@@ -0,0 +1,255 @@
+#include <math.h>
+#include <string.h>
+
+#include "smartarr/defines.h"
+
+#define _ARRAY_OMP_ENABLE
+#include "smartarr/vmath.h"
+
+// see https://github.com/silentbicycle/greatest
+#include "third/greatest.h"
+
+// Inputs are checked in batches, length is not a multiple of vector length
+// to go through the tail of every batch.
+static const size_t batch_len = 4 * SMARTARR_OMP_CHUNK_LEN + 3;
+
+/** Distance in ULP, both NaN is 0, -0.0 and 0.0 are the same.
+ *
+ */
+static uint64_t f32_ulps(float a, float b)
+{
+    if (isnan(a) || isnan(b)) {
+        return (isnan(a) && isnan(b))? 0 : UINT64_MAX;
+    }
+    int32_t ia, ib;
+    memcpy(&ia, &a, sizeof(a));
+    memcpy(&ib, &b, sizeof(b));
+    const int64_t oa = (ia < 0)? INT32_MIN - ia : ia;
+    const int64_t ob = (ib < 0)? INT32_MIN - ib : ib;
+    return (oa > ob)? oa - ob : ob - oa;
+}
+
+static uint64_t f64_ulps(double a, double b)
+{
+    if (isnan(a) || isnan(b)) {
+        return (isnan(a) && isnan(b))? 0 : UINT64_MAX;
+    }
+    int64_t ia, ib;
+    memcpy(&ia, &a, sizeof(a));
+    memcpy(&ib, &b, sizeof(b));
+    const int64_t oa = (ia < 0)? INT64_MIN - ia : ia;
+    const int64_t ob = (ib < 0)? INT64_MIN - ib : ib;
+    return (oa > ob)? (uint64_t)oa - (uint64_t)ob : (uint64_t)ob - (uint64_t)oa;
+}
+
+// f32 references are rounded from double libm, f64 from long double libm.
+#define REF_f32_exp(x)     exp(x)
+#define REF_f32_log(x)     log(x)
+#define REF_f32_log1p(x)   log1p(x)
+#define REF_f32_sqrt(x)    sqrt(x)
+#define REF_f32_rsqrt(x)   (1.0 / sqrt(x))
+#define REF_f32_tanh(x)    tanh(x)
+#define REF_f32_sigmoid(x) (1.0 / (1.0 + exp(-(double)(x))))
+#define REF_f32_sin(x)     sin(x)
+#define REF_f32_cos(x)     cos(x)
+#define REF_f64_exp(x)     expl(x)
+#define REF_f64_log(x)     logl(x)
+#define REF_f64_log1p(x)   log1pl(x)
+#define REF_f64_sqrt(x)    sqrt(x)
+#define REF_f64_rsqrt(x)   (1.0L / sqrtl(x))
+#define REF_f64_tanh(x)    tanhl(x)
+#define REF_f64_sigmoid(x) (1.0L / (1.0L + expl(-(long double)(x))))
+#define REF_f64_sin(x)     sinl(x)
+#define REF_f64_cos(x)     cosl(x)
+
+/** Check a batch against libm and OMP version against serial one.
+ *
+ * Returns max ULP error of the batch.
+ */
+#define CHECK_VMATH_BATCH(T, name, a, b, c) ({ \
+    T##_smart_array_##name(a, b); \
+    T##_omp_smart_array_##name(a, c); \
+    uint64_t _max = 0; \
+    for (size_t _i = 0; _i < (a)->len; ++_i) { \
+        const uint64_t _ulps = T##_ulps((b)->data[_i], REF_##T##_##name((a)->data[_i])); \
+        if (_ulps > _max) { \
+            _max = _ulps; \
+        } \
+        ASSERT_EQ(0, T##_ulps((b)->data[_i], (c)->data[_i])); \
+    } \
+    _max; \
+})
+
+// Every 509th bit pattern of `float`, all exponents and signs including NaN and infinities.
+#define TEST_VMATH_F32(name, max_ulps) \
+TEST f32_##name(void) \
+{ \
+    const int max_threads = omp_get_max_threads(); \
+    omp_set_num_threads(4); \
+    auto_free f32_smart_array_t* a = f32_smart_array_heap_new(batch_len); \
+    auto_free f32_smart_array_t* b = f32_smart_array_heap_new(batch_len); \
+    auto_free f32_smart_array_t* c = f32_smart_array_heap_new(batch_len); \
+    uint64_t max = 0; \
+    size_t n = 0; \
+    for (uint64_t bits = 0; bits <= UINT32_MAX; bits += 509) { \
+        const uint32_t u = bits; \
+        memcpy(&a->data[n++], &u, sizeof(u)); \
+        if (n == batch_len || bits + 509 > UINT32_MAX) { \
+            a->len = n; \
+            const uint64_t m = CHECK_VMATH_BATCH(f32, name, a, b, c); \
+            max = (m > max)? m : max; \
+            n = 0; \
+        } \
+    } \
+    omp_set_num_threads(max_threads); \
+    ASSERT_GTEm(#name " error is above documented ULP", max_ulps, max); \
+    PASS(); \
+}
+
+// Random bit patterns of `double` and random values of moderate magnitude.
+#define TEST_VMATH_F64(name, max_ulps) \
+TEST f64_##name(void) \
+{ \
+    const int max_threads = omp_get_max_threads(); \
+    omp_set_num_threads(4); \
+    auto_free f64_smart_array_t* a = f64_smart_array_heap_new(batch_len); \
+    auto_free f64_smart_array_t* b = f64_smart_array_heap_new(batch_len); \
+    auto_free f64_smart_array_t* c = f64_smart_array_heap_new(batch_len); \
+    uint64_t max = 0; \
+    uint64_t state = 0x9e3779b97f4a7c15; \
+    for (unsigned int batch = 0; batch < 8; ++batch) { \
+        for (size_t i = 0; i < batch_len; ++i) { \
+            state ^= state << 13; state ^= state >> 7; state ^= state << 17; \
+            if (batch % 2 == 0) { \
+                memcpy(&a->data[i], &state, sizeof(state)); \
+            } \
+            else { \
+                a->data[i] = ((double)(state >> 11) * 0x1p-53 - 0.5) * 2.0 * (batch * batch); \
+            } \
+        } \
+        const uint64_t m = CHECK_VMATH_BATCH(f64, name, a, b, c); \
+        max = (m > max)? m : max; \
+    } \
+    omp_set_num_threads(max_threads); \
+    ASSERT_GTEm(#name " error is above documented ULP", max_ulps, max); \
+    PASS(); \
+}
+
+TEST_VMATH_F32(exp, 1)
+TEST_VMATH_F32(log, 1)
+TEST_VMATH_F32(log1p, 1)
+TEST_VMATH_F32(sqrt, 0)
+TEST_VMATH_F32(rsqrt, 1)
+TEST_VMATH_F32(tanh, 1)
+TEST_VMATH_F32(sigmoid, 2)
+TEST_VMATH_F32(sin, 2)
+TEST_VMATH_F32(cos, 2)
+
+TEST_VMATH_F64(exp, 1)
+TEST_VMATH_F64(log, 1)
+TEST_VMATH_F64(log1p, 1)
+TEST_VMATH_F64(sqrt, 0)
+TEST_VMATH_F64(rsqrt, 1)
+TEST_VMATH_F64(tanh, 1)
+TEST_VMATH_F64(sigmoid, 2)
+TEST_VMATH_F64(sin, 1)
+TEST_VMATH_F64(cos, 1)
+
+// Special values must be exactly those of C99 Annex F.
+TEST vmath_specials(void)
+{
+    const double x[] = {0.0, -0.0, INFINITY, -INFINITY, NAN, -1.0, 1.0, 0x1p-1074};
+    auto_free f64_smart_array_t* a = f64_smart_array_heap_new(8);
+    auto_free f64_smart_array_t* b = f64_smart_array_heap_new(8);
+    memcpy(a->data, x, sizeof(x));
+
+    f64_smart_array_exp(a, b);
+    ASSERT_EQ(1.0, b->data[0]);
+    ASSERT_EQ(1.0, b->data[1]);
+    ASSERT_EQ(INFINITY, b->data[2]);
+    ASSERT_EQ(0.0, b->data[3]);
+    ASSERT(isnan(b->data[4]));
+
+    f64_smart_array_log(a, b);
+    ASSERT_EQ(-INFINITY, b->data[0]);
+    ASSERT_EQ(-INFINITY, b->data[1]);
+    ASSERT_EQ(INFINITY, b->data[2]);
+    ASSERT(isnan(b->data[3]));
+    ASSERT(isnan(b->data[5]));
+    ASSERT_EQ(0.0, b->data[6]);
+    ASSERT_EQ(log(0x1p-1074), b->data[7]);
+
+    f64_smart_array_log1p(a, b);
+    ASSERT(signbit(b->data[1]));
+    ASSERT_EQ(INFINITY, b->data[2]);
+    ASSERT_EQ(-INFINITY, b->data[5]);
+    ASSERT_EQ(0x1p-1074, b->data[7]);
+
+    f64_smart_array_tanh(a, b);
+    ASSERT(signbit(b->data[1]));
+    ASSERT_EQ(1.0, b->data[2]);
+    ASSERT_EQ(-1.0, b->data[3]);
+
+    f64_smart_array_sigmoid(a, b);
+    ASSERT_EQ(0.5, b->data[0]);
+    ASSERT_EQ(1.0, b->data[2]);
+    ASSERT_EQ(0.0, b->data[3]);
+
+    f64_smart_array_sin(a, b);
+    ASSERT(signbit(b->data[1]));
+    ASSERT(isnan(b->data[2]));
+    ASSERT(isnan(b->data[3]));
+
+    PASS();
+}
+
+// Raw array functions on lengths shorter than a vector, in place.
+TEST vmath_short_destruct(void)
+{
+    for (size_t len = 0; len < 20; ++len) {
+        auto_free f32_smart_array_t* a = f32_smart_array_heap_new(len + 1);
+        for (size_t i = 0; i <= len; ++i) {
+            a->data[i] = i;
+        }
+        f32_array_sqrt_destruct(len, a->data);
+        for (size_t i = 0; i < len; ++i) {
+            ASSERT_EQ(sqrtf(i), a->data[i]);
+        }
+        ASSERT_EQ(len, a->data[len]);
+    }
+
+    PASS();
+}
+
+SUITE(vmath) {
+    RUN_TEST(f32_exp);
+    RUN_TEST(f32_log);
+    RUN_TEST(f32_log1p);
+    RUN_TEST(f32_sqrt);
+    RUN_TEST(f32_rsqrt);
+    RUN_TEST(f32_tanh);
+    RUN_TEST(f32_sigmoid);
+    RUN_TEST(f32_sin);
+    RUN_TEST(f32_cos);
+    RUN_TEST(f64_exp);
+    RUN_TEST(f64_log);
+    RUN_TEST(f64_log1p);
+    RUN_TEST(f64_sqrt);
+    RUN_TEST(f64_rsqrt);
+    RUN_TEST(f64_tanh);
+    RUN_TEST(f64_sigmoid);
+    RUN_TEST(f64_sin);
+    RUN_TEST(f64_cos);
+    RUN_TEST(vmath_specials);
+    RUN_TEST(vmath_short_destruct);
+}
+
+GREATEST_MAIN_DEFS();
+
+int main(int argc UNUSED, char **argv UNUSED) {
+    GREATEST_MAIN_BEGIN();
+
+    RUN_SUITE(vmath);
+
+    GREATEST_MAIN_END();
+}